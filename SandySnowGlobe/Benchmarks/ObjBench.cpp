@@ -0,0 +1,1168 @@
+//OBJ load throughput, the memory-mapped ObjParser against the two pass ifstream loader Model used before it
+//Usage: objbench [--runs n] [--index] [--cache] [--tangents] [--packed] [--lod] [--threads n] [--parallel MB] [file.obj ...], defaults to the shipped meshes in ../SandySnowGlobe
+//--index adds a table of what welding and the vertex cache optimizer do to each mesh
+//--cache adds cold (parse, optimize, build LODs, write .mesh) against warm (map .mesh) load times, the .mesh files are removed after
+//--tangents compares per-face tangents (as Model had) with TangentFrame's per-vertex ones: vertex counts, time, SIMD against scalar
+//--packed encodes each mesh's welded bump vertices into VertexPacking's 16 byte layout and checks the decoded errors against its bounds, then sweeps the sphere
+//--lod builds each mesh's LOD chain with MeshSimplifier and measures how far each LOD's surface really is from the full mesh's vertices
+//--parallel MB parses a generated terrain of about MB megabytes serially and on 1 to 2x hardware threads, and checks all match
+
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
+#include "MeshCache.h"
+#include "WorkerPool.h"
+#include "TangentFrame.h"
+#include "VertexPacking.h"
+#include "MeshSimplifier.h"
+
+namespace
+{
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	struct Float2
+	{
+		float x, y;
+	};
+
+	struct Face
+	{
+		unsigned int vert1, vert2, vert3,
+					 tex1, tex2, tex3,
+					 norm1, norm2, norm3;
+	};
+
+	//Model::Vertex without DirectXMath
+	struct MeshVertex
+	{
+		float position[3];
+		float texCoord[2];
+		float normal[3];
+	};
+
+	//what the old Model::CheckModelCounts and LoadModel read, before the vertices are expanded
+	struct LegacyMesh
+	{
+		std::vector<Float3> v, n;
+		std::vector<Float2> t;
+		std::vector<Face> f;
+	};
+
+	const char *DEFAULT_FILES[] = { "../SandySnowGlobe/cactus.obj", "../SandySnowGlobe/desert.obj", "../SandySnowGlobe/dome.obj",
+		"../SandySnowGlobe/snowglobe.obj", "../SandySnowGlobe/snowglobebase.obj" };
+
+	/// <summary>
+	/// Old Model::CheckModelCounts, one char at a time
+	/// </summary>
+	bool LegacyCounts(const char *filename, unsigned int &vCount, unsigned int &tCount, unsigned int &nCount, unsigned int &fCount)
+	{
+		std::ifstream input;
+		char c;
+
+		input.open(filename);
+
+		if(input.fail())
+		{
+			return false;
+		}
+
+		input.get(c);
+		while(!input.eof())
+		{
+			switch(c)
+			{
+				case 'v':
+					input.get(c);
+					if(c == ' ')
+						vCount++;
+					if(c == 't')
+						tCount++;
+					if(c == 'n')
+						nCount++;
+					break;
+				case 'f':
+					fCount++;
+					break;
+			}
+
+			while(c != '\n')
+			{
+				input.get(c);
+			}
+
+			input.get(c);
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Old Model::LoadModel read loop, triangles with all of v/t/n only
+	/// </summary>
+	bool LegacyLoad(const char *filename, LegacyMesh &mesh)
+	{
+		unsigned int vCount = 0, tCount = 0, nCount = 0, fCount = 0;
+
+		if(!LegacyCounts(filename, vCount, tCount, nCount, fCount))
+		{
+			return false;
+		}
+
+		mesh.v.assign(vCount, Float3());
+		mesh.t.assign(tCount, Float2());
+		mesh.n.assign(nCount, Float3());
+		mesh.f.assign(fCount, Face());
+
+		std::ifstream input;
+		char c;
+
+		unsigned int vertIndex = 0;
+		unsigned int texIndex = 0;
+		unsigned int normIndex = 0;
+		unsigned int faceIndex = 0;
+
+		input.open(filename);
+
+		if(input.fail())
+		{
+			return false;
+		}
+
+		input.get(c);
+		while(!input.eof())
+		{
+			switch(c)
+			{
+			case 'v':
+				input.get(c);
+				if(c == ' ')
+				{
+					input >> mesh.v[vertIndex].x >> mesh.v[vertIndex].y >> mesh.v[vertIndex].z;
+					mesh.v[vertIndex].z *= -1.0f;
+					vertIndex++;
+					break;
+				}
+
+				if(c == 't')
+				{
+					input >> mesh.t[texIndex].x >> mesh.t[texIndex].y;
+					mesh.t[texIndex].y = 1.0f - mesh.t[texIndex].y;
+					texIndex++;
+					break;
+				}
+
+				if(c == 'n')
+				{
+					input >> mesh.n[normIndex].x >> mesh.n[normIndex].y >> mesh.n[normIndex].z;
+					mesh.n[normIndex].z *= -1.0f;
+					normIndex++;
+					break;
+				}
+
+				//the old loader reads any other v line as a face
+				//falls through
+			case 'f':
+				char c2;
+				input >> mesh.f[faceIndex].vert3 >> c2 >> mesh.f[faceIndex].tex3 >> c2 >> mesh.f[faceIndex].norm3
+					>> mesh.f[faceIndex].vert2 >> c2 >> mesh.f[faceIndex].tex2 >> c2 >> mesh.f[faceIndex].norm2
+					>> mesh.f[faceIndex].vert1 >> c2 >> mesh.f[faceIndex].tex1 >> c2 >> mesh.f[faceIndex].norm1;
+				faceIndex++;
+				break;
+			}
+
+			while(c != '\n')
+			{
+				input.get(c);
+			}
+
+			input.get(c);
+		}
+
+		return true;
+	}
+
+	bool SameCorner(const ObjParser::Corner &corner, unsigned int v, unsigned int t, unsigned int n)
+	{
+		return corner.position == v - 1 && corner.texCoord == t - 1 && corner.normal == n - 1;
+	}
+
+	/// <summary>
+	/// Largest value difference between the two loaders, negative if the faces disagree
+	/// Only meaningful for all-triangle files, the old loader drops the extra corners of a polygon
+	/// </summary>
+	float Compare(const LegacyMesh &legacy, const ObjParser &obj)
+	{
+		if(legacy.v.size() != obj.PositionCount() || legacy.t.size() != obj.TexCoordCount() || legacy.n.size() != obj.NormalCount() ||
+			legacy.f.size() != obj.TriangleCount())
+		{
+			return -1.0f;
+		}
+
+		float worst = 0.0f;
+
+		for(unsigned int i = 0; i < legacy.v.size(); i++)
+		{
+			const float *p = &obj.Positions()[i * 3];
+			worst = std::fmax(worst, std::fmax(std::fabs(p[0] - legacy.v[i].x), std::fmax(std::fabs(p[1] - legacy.v[i].y), std::fabs(p[2] - legacy.v[i].z))));
+		}
+
+		for(unsigned int i = 0; i < legacy.t.size(); i++)
+		{
+			const float *p = &obj.TexCoords()[i * 2];
+			worst = std::fmax(worst, std::fmax(std::fabs(p[0] - legacy.t[i].x), std::fabs(p[1] - legacy.t[i].y)));
+		}
+
+		for(unsigned int i = 0; i < legacy.n.size(); i++)
+		{
+			const float *p = &obj.Normals()[i * 3];
+			worst = std::fmax(worst, std::fmax(std::fabs(p[0] - legacy.n[i].x), std::fmax(std::fabs(p[1] - legacy.n[i].y), std::fabs(p[2] - legacy.n[i].z))));
+		}
+
+		for(unsigned int i = 0; i < legacy.f.size(); i++)
+		{
+			const Face &f = legacy.f[i];
+			const ObjParser::Corner *c = &obj.Corners()[i * 3];
+
+			if(!SameCorner(c[0], f.vert1, f.tex1, f.norm1) || !SameCorner(c[1], f.vert2, f.tex2, f.norm2) || !SameCorner(c[2], f.vert3, f.tex3, f.norm3))
+			{
+				return -1.0f;
+			}
+		}
+
+		return worst;
+	}
+
+	double FileMegabytes(const char *filename)
+	{
+		std::ifstream input(filename, std::ios::binary | std::ios::ate);
+
+		return input.good() ? (double)input.tellg() / (1024.0 * 1024.0) : 0.0;
+	}
+
+	/// <summary>
+	/// Best of runs for both loaders, best rather than mean so page cache and scheduler noise drop out
+	/// </summary>
+	void RunFile(const char *filename, unsigned int runs)
+	{
+		double megabytes = FileMegabytes(filename);
+		double legacyBest = 1e30, parserBest = 1e30;
+		LegacyMesh legacy;
+		ObjParser obj;
+
+		for(unsigned int r = 0; r < runs; r++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+			if(!LegacyLoad(filename, legacy))
+			{
+				std::printf("%-22s could not be opened\n", filename);
+				return;
+			}
+
+			std::chrono::high_resolution_clock::time_point middle = std::chrono::high_resolution_clock::now();
+
+			obj.Load(filename);
+
+			std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+			legacyBest = std::fmin(legacyBest, std::chrono::duration<double>(middle - start).count());
+			parserBest = std::fmin(parserBest, std::chrono::duration<double>(end - middle).count());
+		}
+
+		float difference = Compare(legacy, obj);
+		const char *name = std::strrchr(filename, '/') ? std::strrchr(filename, '/') + 1 : filename;
+		char match[32];
+
+		if(difference < 0.0f)
+		{
+			std::snprintf(match, sizeof(match), "differs");
+		}
+		else
+		{
+			std::snprintf(match, sizeof(match), "%.2g", difference);
+		}
+
+		std::printf("%-18s %8.2f %9u %9u %10.2f %10.2f %10.1f %10.1f %8.1fx %10s\n", name, megabytes, (unsigned int)legacy.f.size(), obj.TriangleCount(),
+			legacyBest * 1000.0, parserBest * 1000.0, megabytes / legacyBest, megabytes / parserBest, legacyBest / parserBest, match);
+	}
+
+	//Model::BumpVertex with per-face tangent and binormal, as it was
+	struct FlatBumpVertex
+	{
+		MeshVertex base;
+		float tangent[3];
+		float binormal[3];
+	};
+
+	//Model::BumpVertex
+	struct BumpVertex
+	{
+		MeshVertex base;
+		float tangent[4];
+	};
+
+	//Three vertices per triangle, as Model expands them before indexing
+	void ExpandSoup(const ObjParser &obj, std::vector<MeshVertex> &vertices)
+	{
+		const std::vector<ObjParser::Corner> &corners = obj.Corners();
+		unsigned int cornerCount = (unsigned int)corners.size();
+
+		vertices.resize(cornerCount);
+
+		for(unsigned int i = 0; i < cornerCount; i++)
+		{
+			const ObjParser::Corner &corner = corners[i];
+			MeshVertex &vertex = vertices[i];
+
+			std::memset(&vertex, 0, sizeof(vertex));
+			std::memcpy(vertex.position, &obj.Positions()[corner.position * 3], sizeof(vertex.position));
+
+			if(corner.texCoord != ObjParser::NO_INDEX)
+			{
+				std::memcpy(vertex.texCoord, &obj.TexCoords()[corner.texCoord * 2], sizeof(vertex.texCoord));
+			}
+
+			if(corner.normal != ObjParser::NO_INDEX)
+			{
+				std::memcpy(vertex.normal, &obj.Normals()[corner.normal * 3], sizeof(vertex.normal));
+			}
+		}
+	}
+
+	/// <summary>
+	/// Expand to a soup as Model does, then weld, cache-order and fetch-order it, ACMR on a FIFO of ACMR_CACHE_SIZE
+	/// </summary>
+	void IndexFile(const char *filename)
+	{
+		ObjParser obj;
+
+		if(!obj.Load(filename))
+		{
+			std::printf("%-18s could not be opened\n", filename);
+			return;
+		}
+
+		std::vector<MeshVertex> vertices;
+		ExpandSoup(obj, vertices);
+
+		unsigned int cornerCount = (unsigned int)vertices.size();
+		std::vector<unsigned int> indices(cornerCount);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		unsigned int unique = MeshOptimizer::Weld(&vertices[0], cornerCount, sizeof(MeshVertex), &indices[0]);
+
+		std::chrono::high_resolution_clock::time_point welded = std::chrono::high_resolution_clock::now();
+
+		float weldedAcmr = MeshOptimizer::Acmr(&indices[0], cornerCount, unique);
+		MeshOptimizer::OptimizeVertexCache(&indices[0], cornerCount, unique);
+		MeshOptimizer::OptimizeVertexFetch(&vertices[0], unique, sizeof(MeshVertex), &indices[0], cornerCount);
+
+		std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+		float optimizedAcmr = MeshOptimizer::Acmr(&indices[0], cornerCount, unique);
+		unsigned int indexSize = (unique < 65536) ? 2 : 4;
+		double soupKb = (double)(cornerCount * sizeof(MeshVertex)) / 1024.0;
+		double indexedKb = (double)((unique * sizeof(MeshVertex)) + (cornerCount * indexSize)) / 1024.0;
+		const char *name = std::strrchr(filename, '/') ? std::strrchr(filename, '/') + 1 : filename;
+
+		std::printf("%-18s %9u %9u %6u %10.1f %10.1f %8.3f %8.3f %8.3f %9.2f %9.2f\n", name, cornerCount / 3, unique, indexSize * 8, soupKb, indexedKb,
+			3.0f, weldedAcmr, optimizedAcmr, std::chrono::duration<double>(welded - start).count() * 1000.0, std::chrono::duration<double>(end - welded).count() * 1000.0);
+	}
+
+	/// <summary>
+	/// Cold is the first run of Model: parse, expand, index, write the cache. Warm is every later run: map the cache
+	/// Warm touches every byte of both streams, as CreateBuffer would, so lazy mapping is not mistaken for speed
+	/// </summary>
+	void CacheFile(const char *filename, unsigned int runs)
+	{
+		std::remove(MeshCache::CachePath(filename).c_str());
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		ObjParser obj;
+
+		if(!obj.Load(filename))
+		{
+			std::printf("%-18s could not be opened\n", filename);
+			return;
+		}
+
+		std::vector<MeshVertex> vertices;
+		ExpandSoup(obj, vertices);
+
+		unsigned int cornerCount = (unsigned int)vertices.size();
+		std::vector<unsigned int> indices(cornerCount);
+		unsigned int unique = MeshOptimizer::Weld(&vertices[0], cornerCount, sizeof(MeshVertex), &indices[0]);
+
+		MeshOptimizer::OptimizeVertexCache(&indices[0], cornerCount, unique);
+		MeshOptimizer::OptimizeVertexFetch(&vertices[0], unique, sizeof(MeshVertex), &indices[0], cornerCount);
+
+		MeshSimplifier::Layout layout = { sizeof(MeshVertex), 0, sizeof(float) * 3, sizeof(float) * 5 };
+		MeshSimplifier::Lod lods[MeshSimplifier::MAX_LODS];
+		unsigned int lodCount = MeshSimplifier::GenerateLods(&vertices[0], unique, layout, indices, lods);
+		unsigned int indexCount = (unsigned int)indices.size();
+
+		std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		float boundsMin[3] = { 1e30f, 1e30f, 1e30f }, boundsMax[3] = { -1e30f, -1e30f, -1e30f };
+
+		for(unsigned int v = 0; v < unique; v++)
+		{
+			for(unsigned int k = 0; k < 3; k++)
+			{
+				boundsMin[k] = std::fmin(boundsMin[k], vertices[v].position[k]);
+				boundsMax[k] = std::fmax(boundsMax[k], vertices[v].position[k]);
+			}
+		}
+
+		float boundsRadius = 0.0f;
+
+		for(unsigned int v = 0; v < unique; v++)
+		{
+			float offset[3];
+
+			for(unsigned int k = 0; k < 3; k++)
+			{
+				offset[k] = vertices[v].position[k] - ((boundsMin[k] + boundsMax[k]) * 0.5f);
+			}
+
+			boundsRadius = std::fmax(boundsRadius, std::sqrt((offset[0] * offset[0]) + (offset[1] * offset[1]) + (offset[2] * offset[2])));
+		}
+
+		bool wide = unique >= 65536;
+		bool written = MeshCache::Write(filename, 1, &vertices[0], unique, sizeof(MeshVertex), wide ? (const void *)&indices[0] : (const void *)&shortIndices[0],
+			indexCount, wide ? 4 : 2, boundsMin, boundsMax, boundsRadius, lods, lodCount);
+
+		std::chrono::high_resolution_clock::time_point cold = std::chrono::high_resolution_clock::now();
+		const char *name = std::strrchr(filename, '/') ? std::strrchr(filename, '/') + 1 : filename;
+
+		if(!written)
+		{
+			std::printf("%-18s cache could not be written\n", name);
+			return;
+		}
+
+		double warmBest = 1e30;
+		double cacheMegabytes = FileMegabytes(MeshCache::CachePath(filename).c_str());
+		unsigned int checksum = 0;
+
+		for(unsigned int r = 0; r < runs; r++)
+		{
+			std::chrono::high_resolution_clock::time_point warmStart = std::chrono::high_resolution_clock::now();
+			MeshCache cache;
+
+			if(!cache.Open(filename, 1, sizeof(MeshVertex)))
+			{
+				std::printf("%-18s cache written but rejected\n", name);
+				break;
+			}
+
+			const unsigned char *bytes = static_cast<const unsigned char *>(cache.Vertices());
+			unsigned int size = cache.VertexCount() * sizeof(MeshVertex);
+
+			for(unsigned int i = 0; i < size; i++)
+			{
+				checksum += bytes[i];
+			}
+
+			bytes = static_cast<const unsigned char *>(cache.Indices());
+			size = cache.IndexCount() * cache.IndexSize();
+
+			for(unsigned int i = 0; i < size; i++)
+			{
+				checksum += bytes[i];
+			}
+
+			warmBest = std::fmin(warmBest, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - warmStart).count());
+		}
+
+		double coldSeconds = std::chrono::duration<double>(cold - start).count();
+
+		std::printf("%-18s %8.2f %8.2f %10.2f %10.3f %10.1f %9.1fx %10x\n", name, FileMegabytes(filename), cacheMegabytes, coldSeconds * 1000.0, warmBest * 1000.0,
+			cacheMegabytes / warmBest, coldSeconds / warmBest, checksum);
+
+		std::remove(MeshCache::CachePath(filename).c_str());
+	}
+
+	inline void Normalize3(float *v)
+	{
+		float length = std::sqrt((v[0] * v[0]) + (v[1] * v[1]) + (v[2] * v[2]));
+
+		for(unsigned int k = 0; k < 3; k++)
+		{
+			v[k] /= length;
+		}
+	}
+
+	/// <summary>
+	/// Flat: the old CalculateTangBinorm stamped on each corner, then welded. Smooth: welded, then TangentFrame
+	/// Times are TangentFrame alone, best of runs, scalar and SIMD on one thread and SIMD on the pool
+	/// </summary>
+	void TangentFile(const char *filename, unsigned int runs, WorkerPool &workers)
+	{
+		ObjParser obj;
+
+		if(!obj.Load(filename))
+		{
+			std::printf("%-18s could not be opened\n", filename);
+			return;
+		}
+
+		std::vector<MeshVertex> soup;
+		ExpandSoup(obj, soup);
+
+		unsigned int cornerCount = (unsigned int)soup.size();
+		std::vector<FlatBumpVertex> flat(cornerCount);
+		std::vector<BumpVertex> smooth(cornerCount);
+		std::vector<unsigned int> indices(cornerCount);
+
+		for(unsigned int i = 0; i < cornerCount; i += 3)
+		{
+			const MeshVertex *v = &soup[i];
+			float e1[3], e2[3], t[3], b[3];
+			float du1 = v[1].texCoord[0] - v[0].texCoord[0], du2 = v[2].texCoord[0] - v[0].texCoord[0];
+			float dv1 = v[1].texCoord[1] - v[0].texCoord[1], dv2 = v[2].texCoord[1] - v[0].texCoord[1];
+			float r = 1.0f / ((du1 * dv2) - (du2 * dv1));
+
+			for(unsigned int k = 0; k < 3; k++)
+			{
+				e1[k] = v[1].position[k] - v[0].position[k];
+				e2[k] = v[2].position[k] - v[0].position[k];
+				t[k] = ((dv2 * e1[k]) - (dv1 * e2[k])) * r;
+				b[k] = ((du1 * e2[k]) - (du2 * e1[k])) * r;
+			}
+
+			Normalize3(t);
+			Normalize3(b);
+
+			for(unsigned int c = i; c < i + 3; c++)
+			{
+				flat[c].base = soup[c];
+				std::memcpy(flat[c].tangent, t, sizeof(t));
+				std::memcpy(flat[c].binormal, b, sizeof(b));
+			}
+		}
+
+		unsigned int flatCount = MeshOptimizer::Weld(&flat[0], cornerCount, sizeof(FlatBumpVertex), &indices[0]);
+
+		for(unsigned int i = 0; i < cornerCount; i++)
+		{
+			std::memset(&smooth[i], 0, sizeof(BumpVertex));
+			smooth[i].base = soup[i];
+		}
+
+		unsigned int welded = MeshOptimizer::Weld(&smooth[0], cornerCount, sizeof(BumpVertex), &indices[0]);
+		TangentFrame::Layout layout = { sizeof(BumpVertex), 0, sizeof(float) * 3, sizeof(float) * 5, sizeof(MeshVertex) };
+		std::vector<BumpVertex> results[3];
+		std::vector<unsigned int> resultIndices[3];
+		double best[3] = { 1e30, 1e30, 1e30 };
+		unsigned int smoothCount = 0;
+
+		for(unsigned int path = 0; path < 3; path++)
+		{
+			for(unsigned int r = 0; r < runs; r++)
+			{
+				results[path] = smooth;
+				resultIndices[path] = indices;
+
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+				if(path == 0)
+				{
+					smoothCount = TangentFrame::GenerateScalar(&results[path][0], welded, cornerCount, layout, &resultIndices[path][0], cornerCount, nullptr);
+				}
+				else
+				{
+					smoothCount = TangentFrame::Generate(&results[path][0], welded, cornerCount, layout, &resultIndices[path][0], cornerCount, (path == 2) ? &workers : nullptr);
+				}
+
+				best[path] = std::fmin(best[path], std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+			}
+		}
+
+		bool match = resultIndices[0] == resultIndices[1] && resultIndices[0] == resultIndices[2] &&
+			std::memcmp(&results[0][0], &results[1][0], smoothCount * sizeof(BumpVertex)) == 0 &&
+			std::memcmp(&results[0][0], &results[2][0], smoothCount * sizeof(BumpVertex)) == 0;
+		const char *name = std::strrchr(filename, '/') ? std::strrchr(filename, '/') + 1 : filename;
+
+		std::printf("%-18s %9u %10u %10u %7u %10.3f %10.3f %10.3f %8s\n", name, cornerCount / 3, flatCount, smoothCount, smoothCount - welded,
+			best[0] * 1000.0, best[1] * 1000.0, best[2] * 1000.0, match ? "yes" : "NO");
+	}
+
+	inline float AngleBetween(const float *a, const float *b)
+	{
+		float cosine = (a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]);
+
+		return std::acos((cosine < 1.0f) ? cosine : 1.0f);
+	}
+
+	/// <summary>
+	/// Weld and tangent a mesh as Model does, pack it, decode every vertex and take the worst error of each attribute
+	/// Every error must be within VertexPacking's bound for it, positions against this mesh's bounds
+	/// </summary>
+	void PackFile(const char *filename, unsigned int runs)
+	{
+		ObjParser obj;
+
+		if(!obj.Load(filename))
+		{
+			std::printf("%-18s could not be opened\n", filename);
+			return;
+		}
+
+		std::vector<MeshVertex> soup;
+		ExpandSoup(obj, soup);
+
+		unsigned int cornerCount = (unsigned int)soup.size();
+		std::vector<BumpVertex> vertices(cornerCount);
+		std::vector<unsigned int> indices(cornerCount);
+
+		for(unsigned int i = 0; i < cornerCount; i++)
+		{
+			std::memset(&vertices[i], 0, sizeof(BumpVertex));
+			vertices[i].base = soup[i];
+		}
+
+		TangentFrame::Layout layout = { sizeof(BumpVertex), 0, sizeof(float) * 3, sizeof(float) * 5, sizeof(MeshVertex) };
+		unsigned int welded = MeshOptimizer::Weld(&vertices[0], cornerCount, sizeof(BumpVertex), &indices[0]);
+		unsigned int count = TangentFrame::Generate(&vertices[0], welded, cornerCount, layout, &indices[0], cornerCount, nullptr);
+
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		float uvMagnitude = 0.0f;
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			for(unsigned int k = 0; k < 3; k++)
+			{
+				boundsMin[k] = std::fmin(boundsMin[k], vertices[i].base.position[k]);
+				boundsMax[k] = std::fmax(boundsMax[k], vertices[i].base.position[k]);
+			}
+
+			uvMagnitude = std::fmax(uvMagnitude, std::fmax(std::fabs(vertices[i].base.texCoord[0]), std::fabs(vertices[i].base.texCoord[1])));
+		}
+
+		VertexPacking::Bounds bounds = VertexPacking::MakeBounds(boundsMin, boundsMax);
+		std::vector<VertexPacking::PackedBumpVertex> packed(count);
+		double best = 1e30;
+
+		for(unsigned int r = 0; r < runs; r++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			VertexPacking::EncodeMesh(&vertices[0], count, layout, bounds, &packed[0]);
+			best = std::fmin(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+		}
+
+		float positionError = 0.0f, texCoordError = 0.0f, normalError = 0.0f, tangentError = 0.0f;
+		bool handedness = true;
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			const BumpVertex &vertex = vertices[i];
+			float position[3], texCoord[2], normal[3], tangent[4], unit[3];
+
+			VertexPacking::Decode(bounds, packed[i], position, texCoord, normal, tangent);
+
+			for(unsigned int k = 0; k < 3; k++)
+			{
+				positionError = std::fmax(positionError, std::fabs(position[k] - vertex.base.position[k]));
+				unit[k] = vertex.base.normal[k];
+			}
+
+			for(unsigned int k = 0; k < 2; k++)
+			{
+				texCoordError = std::fmax(texCoordError, std::fabs(texCoord[k] - vertex.base.texCoord[k]));
+			}
+
+			Normalize3(unit);
+			normalError = std::fmax(normalError, AngleBetween(normal, unit));
+			tangentError = std::fmax(tangentError, AngleBetween(tangent, vertex.tangent));
+			handedness = handedness && tangent[3] == vertex.tangent[3];
+		}
+
+		bool ok = positionError <= VertexPacking::MaxPositionError(bounds) && texCoordError <= VertexPacking::MaxTexCoordError(uvMagnitude) &&
+			normalError <= VertexPacking::MAX_NORMAL_ERROR && tangentError <= VertexPacking::MAX_TANGENT_ERROR && handedness;
+		const char *name = std::strrchr(filename, '/') ? std::strrchr(filename, '/') + 1 : filename;
+
+		std::printf("%-18s %9u %10.1f %10.1f %6.2fx %10.3f %10.6f %10.6f %9.5f %9.5f %10s\n", name, count, (count * sizeof(BumpVertex)) / 1024.0,
+			(count * sizeof(VertexPacking::PackedBumpVertex)) / 1024.0, (double)sizeof(BumpVertex) / sizeof(VertexPacking::PackedBumpVertex), best * 1000.0,
+			positionError, texCoordError, normalError, tangentError, ok ? "ok" : "OVER BOUND");
+	}
+
+	/// <summary>
+	/// Normals spread evenly over the sphere (Fibonacci lattice), each with tangents all the way round it and both handednesses
+	/// The worst errors here are what VertexPacking's angle bounds promise for any mesh
+	/// </summary>
+	void PackSphere(unsigned int normalCount)
+	{
+		const float GOLDEN_ANGLE = 2.39996323f;
+		const unsigned int TANGENTS = 16;
+		VertexPacking::Bounds bounds = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		float normalError = 0.0f, tangentError = 0.0f;
+		bool handedness = true;
+
+		for(unsigned int i = 0; i < normalCount; i++)
+		{
+			float z = 1.0f - ((2.0f * (i + 0.5f)) / normalCount);
+			float radius = std::sqrt(1.0f - (z * z));
+			float normal[3] = { radius * std::cos(GOLDEN_ANGLE * i), radius * std::sin(GOLDEN_ANGLE * i), z };
+
+			//any vector not parallel to the normal, crossed twice, gives a start for the tangents
+			float helper[3] = { (std::fabs(normal[0]) < 0.9f) ? 1.0f : 0.0f, (std::fabs(normal[0]) < 0.9f) ? 0.0f : 1.0f, 0.0f };
+			float u[3] = { (normal[1] * helper[2]) - (normal[2] * helper[1]), (normal[2] * helper[0]) - (normal[0] * helper[2]), (normal[0] * helper[1]) - (normal[1] * helper[0]) };
+			Normalize3(u);
+			float v[3] = { (normal[1] * u[2]) - (normal[2] * u[1]), (normal[2] * u[0]) - (normal[0] * u[2]), (normal[0] * u[1]) - (normal[1] * u[0]) };
+
+			for(unsigned int t = 0; t < TANGENTS; t++)
+			{
+				float angle = (6.28318531f * (t + 0.37f)) / TANGENTS;
+				float tangent[4] = { 0.0f, 0.0f, 0.0f, (t % 2 == 0) ? 1.0f : -1.0f };
+				float zero[3] = { 0.0f, 0.0f, 0.0f };
+				float position[3], texCoord[2], decodedNormal[3], decodedTangent[4];
+				VertexPacking::PackedBumpVertex vertex;
+
+				for(unsigned int k = 0; k < 3; k++)
+				{
+					tangent[k] = (std::cos(angle) * u[k]) + (std::sin(angle) * v[k]);
+				}
+
+				VertexPacking::Encode(bounds, zero, zero, normal, tangent, vertex);
+				VertexPacking::Decode(bounds, vertex, position, texCoord, decodedNormal, decodedTangent);
+
+				normalError = std::fmax(normalError, AngleBetween(decodedNormal, normal));
+				tangentError = std::fmax(tangentError, AngleBetween(decodedTangent, tangent));
+				handedness = handedness && decodedTangent[3] == tangent[3];
+			}
+		}
+
+		std::printf("%-18s %9u %10s %10s %7s %10s %10s %10s %9.5f %9.5f %10s\n", "sphere", normalCount * TANGENTS, "-", "-", "-", "-", "-", "-",
+			normalError, tangentError, (normalError <= VertexPacking::MAX_NORMAL_ERROR && tangentError <= VertexPacking::MAX_TANGENT_ERROR && handedness) ? "ok" : "OVER BOUND");
+	}
+
+	/// <summary>
+	/// Distance from p to the closest point of triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+	/// </summary>
+	float PointTriangleDistance(const float *p, const float *a, const float *b, const float *c)
+	{
+		float ab[3], ac[3], ap[3], closest[3];
+
+		for(unsigned int k = 0; k < 3; k++)
+		{
+			ab[k] = b[k] - a[k];
+			ac[k] = c[k] - a[k];
+			ap[k] = p[k] - a[k];
+		}
+
+		float d1 = (ab[0] * ap[0]) + (ab[1] * ap[1]) + (ab[2] * ap[2]);
+		float d2 = (ac[0] * ap[0]) + (ac[1] * ap[1]) + (ac[2] * ap[2]);
+		float bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] };
+		float d3 = (ab[0] * bp[0]) + (ab[1] * bp[1]) + (ab[2] * bp[2]);
+		float d4 = (ac[0] * bp[0]) + (ac[1] * bp[1]) + (ac[2] * bp[2]);
+		float cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+		float d5 = (ab[0] * cp[0]) + (ab[1] * cp[1]) + (ab[2] * cp[2]);
+		float d6 = (ac[0] * cp[0]) + (ac[1] * cp[1]) + (ac[2] * cp[2]);
+		float vc = (d1 * d4) - (d3 * d2);
+		float vb = (d5 * d2) - (d1 * d6);
+		float va = (d3 * d6) - (d5 * d4);
+		float u = 0.0f, v = 0.0f;
+
+		if(d1 <= 0.0f && d2 <= 0.0f)
+		{
+		}
+		else if(d3 >= 0.0f && d4 <= d3)
+		{
+			u = 1.0f;
+		}
+		else if(d6 >= 0.0f && d5 <= d6)
+		{
+			v = 1.0f;
+		}
+		else if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		{
+			u = d1 / (d1 - d3);
+		}
+		else if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		{
+			v = d2 / (d2 - d6);
+		}
+		else if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		{
+			v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			u = 1.0f - v;
+		}
+		else
+		{
+			float denominator = 1.0f / (va + vb + vc);
+			u = vb * denominator;
+			v = vc * denominator;
+		}
+
+		for(unsigned int k = 0; k < 3; k++)
+		{
+			closest[k] = a[k] + (ab[k] * u) + (ac[k] * v) - p[k];
+		}
+
+		return std::sqrt((closest[0] * closest[0]) + (closest[1] * closest[1]) + (closest[2] * closest[2]));
+	}
+
+	/// <summary>
+	/// Weld and order a mesh as Model does, build its LOD chain, then for a sample of the full mesh's vertices find the nearest
+	/// point on each LOD: the worst of those is a measured lower bound on how far the LOD strays, next to the error it claims
+	/// </summary>
+	void LodFile(const char *filename, unsigned int runs)
+	{
+		ObjParser obj;
+
+		if(!obj.Load(filename))
+		{
+			std::printf("%-18s could not be opened\n", filename);
+			return;
+		}
+
+		std::vector<MeshVertex> vertices;
+		ExpandSoup(obj, vertices);
+
+		unsigned int cornerCount = (unsigned int)vertices.size();
+		std::vector<unsigned int> full(cornerCount);
+		unsigned int vertexCount = MeshOptimizer::Weld(&vertices[0], cornerCount, sizeof(MeshVertex), &full[0]);
+
+		MeshOptimizer::OptimizeVertexCache(&full[0], cornerCount, vertexCount);
+
+		MeshSimplifier::Layout layout = { sizeof(MeshVertex), 0, sizeof(float) * 3, sizeof(float) * 5 };
+		MeshSimplifier::Lod lods[MeshSimplifier::MAX_LODS];
+		std::vector<unsigned int> indices;
+		unsigned int lodCount = 0;
+		double best = 1e30;
+
+		for(unsigned int r = 0; r < runs; r++)
+		{
+			indices = full;
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			lodCount = MeshSimplifier::GenerateLods(&vertices[0], vertexCount, layout, indices, lods);
+			best = std::fmin(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+		}
+
+		float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			for(unsigned int k = 0; k < 3; k++)
+			{
+				low[k] = std::fmin(low[k], vertices[v].position[k]);
+				high[k] = std::fmax(high[k], vertices[v].position[k]);
+			}
+		}
+
+		float extent = std::fmax(std::fmax(high[0] - low[0], high[1] - low[1]), high[2] - low[2]);
+		const char *name = std::strrchr(filename, '/') ? std::strrchr(filename, '/') + 1 : filename;
+		const unsigned int SAMPLES = 512;
+
+		for(unsigned int l = 0; l < lodCount; l++)
+		{
+			const unsigned int *lod = &indices[lods[l].indexOffset];
+			unsigned int step = (vertexCount > SAMPLES) ? vertexCount / SAMPLES : 1;
+			float measured = 0.0f;
+			bool valid = lods[l].indexCount % 3 == 0;
+
+			for(unsigned int i = 0; i < lods[l].indexCount; i++)
+			{
+				valid = valid && lod[i] < vertexCount;
+			}
+
+			for(unsigned int v = 0; v < vertexCount && valid; v += step)
+			{
+				float nearest = FLT_MAX;
+
+				for(unsigned int i = 0; i < lods[l].indexCount; i += 3)
+				{
+					nearest = std::fmin(nearest, PointTriangleDistance(vertices[v].position, vertices[lod[i]].position, vertices[lod[i + 1]].position, vertices[lod[i + 2]].position));
+				}
+
+				measured = std::fmax(measured, nearest);
+			}
+
+			char milliseconds[16] = "";
+
+			if(l == 0)
+			{
+				std::snprintf(milliseconds, sizeof(milliseconds), "%.2f", best * 1000.0);
+			}
+
+			std::printf("%-18s %4u %9u %7.1f%% %10.4f %10.4f %9.3f%% %10s %8s\n", (l == 0) ? name : "", l, lods[l].indexCount / 3,
+				(100.0 * lods[l].indexCount) / lods[0].indexCount, lods[l].error, measured, (100.0 * lods[l].error) / extent, milliseconds, valid ? "yes" : "NO");
+		}
+	}
+
+	/// <summary>
+	/// Scanned-terrain stand-in: tiles of a height grid, each its own object with v/vt/vn lines followed by its faces
+	/// Tiles alternate absolute and negative indices and triangles and quads, so chunks see both kinds and split mid tile
+	/// </summary>
+	void GenerateTerrain(double megabytes, std::string &text)
+	{
+		const unsigned int TILE = 64;
+		char line[160];
+		unsigned int base = 0;
+
+		text.clear();
+
+		for(unsigned int tile = 0; (double)text.size() < megabytes * 1024.0 * 1024.0; tile++)
+		{
+			std::snprintf(line, sizeof(line), "o tile%u\n", tile);
+			text += line;
+
+			for(unsigned int z = 0; z <= TILE; z++)
+			{
+				for(unsigned int x = 0; x <= TILE; x++)
+				{
+					float fx = (float)(tile * TILE + x) * 0.5f, fz = (float)z * 0.5f;
+					float height = std::sin(fx * 0.13f) * std::cos(fz * 0.07f) * 4.0f;
+
+					std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n", fx, height, fz,
+						(float)x / TILE, (float)z / TILE, -std::cos(fx * 0.13f) * 0.1f, 1.0f, std::sin(fz * 0.07f) * 0.1f);
+					text += line;
+				}
+			}
+
+			unsigned int tileVertices = (TILE + 1) * (TILE + 1);
+			bool relative = (tile % 2) == 1;
+			bool quads = (tile % 4) >= 2;
+
+			for(unsigned int z = 0; z < TILE; z++)
+			{
+				for(unsigned int x = 0; x < TILE; x++)
+				{
+					unsigned int local[4] = { z * (TILE + 1) + x, z * (TILE + 1) + x + 1, (z + 1) * (TILE + 1) + x + 1, (z + 1) * (TILE + 1) + x };
+					long index[4];
+
+					for(unsigned int k = 0; k < 4; k++)
+					{
+						index[k] = relative ? (long)local[k] - (long)tileVertices : (long)(base + local[k] + 1);
+					}
+
+					if(quads)
+					{
+						std::snprintf(line, sizeof(line), "f %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld\n", index[0], index[0], index[0],
+							index[1], index[1], index[1], index[2], index[2], index[2], index[3], index[3], index[3]);
+					}
+					else
+					{
+						std::snprintf(line, sizeof(line), "f %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld\nf %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld\n",
+							index[0], index[0], index[0], index[1], index[1], index[1], index[2], index[2], index[2],
+							index[0], index[0], index[0], index[2], index[2], index[2], index[3], index[3], index[3]);
+					}
+
+					text += line;
+				}
+			}
+
+			base += tileVertices;
+		}
+	}
+
+	bool SameParse(const ObjParser &a, const ObjParser &b)
+	{
+		if(a.Positions() != b.Positions() || a.TexCoords() != b.TexCoords() || a.Normals() != b.Normals() || a.Corners().size() != b.Corners().size())
+		{
+			return false;
+		}
+
+		return a.Corners().empty() || std::memcmp(&a.Corners()[0], &b.Corners()[0], a.Corners().size() * sizeof(ObjParser::Corner)) == 0;
+	}
+
+	/// <summary>
+	/// Serial Parse against parallel on growing thread counts, best of runs, every parallel result must equal the serial one
+	/// </summary>
+	void RunParallel(double megabytes, unsigned int runs)
+	{
+		std::string text;
+		GenerateTerrain(megabytes, text);
+
+		ObjParser serial;
+		double serialBest = 1e30;
+		double size = (double)text.size() / (1024.0 * 1024.0);
+
+		for(unsigned int r = 0; r < runs; r++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			serial.Parse(text.data(), text.size());
+			serialBest = std::fmin(serialBest, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+		}
+
+		std::printf("\ngenerated terrain %.1f MB, %u positions, %u triangles, %u hardware threads\n", size, serial.PositionCount(), serial.TriangleCount(),
+			std::thread::hardware_concurrency());
+		std::printf("%-8s %10s %10s %9s %8s\n", "threads", "ms", "MB/s", "speedup", "match");
+		std::printf("%-8s %10.2f %10.1f %8.2fx %8s\n", "serial", serialBest * 1000.0, size / serialBest, 1.0, "-");
+
+		unsigned int maxThreads = std::thread::hardware_concurrency() * 2;
+
+		for(unsigned int threads = 1; threads <= ((maxThreads > 4) ? maxThreads : 4); threads *= 2)
+		{
+			WorkerPool workers(threads);
+			ObjParser parallel;
+			double best = 1e30;
+
+			parallel.Workers(&workers);
+
+			for(unsigned int r = 0; r < runs; r++)
+			{
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				parallel.Parse(text.data(), text.size());
+				best = std::fmin(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+			}
+
+			std::printf("%-8u %10.2f %10.1f %8.2fx %8s\n", threads, best * 1000.0, size / best, serialBest / best, SameParse(serial, parallel) ? "yes" : "NO");
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int runs = 5;
+	bool index = false;
+	bool cache = false;
+	bool tangents = false;
+	bool packing = false;
+	bool lod = false;
+	unsigned int threads = 0;
+	double parallelMegabytes = 0.0;
+	std::vector<const char *> files;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+		{
+			runs = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if(std::strcmp(argv[i], "--index") == 0)
+		{
+			index = true;
+		}
+		else if(std::strcmp(argv[i], "--cache") == 0)
+		{
+			cache = true;
+		}
+		else if(std::strcmp(argv[i], "--tangents") == 0)
+		{
+			tangents = true;
+		}
+		else if(std::strcmp(argv[i], "--packed") == 0)
+		{
+			packing = true;
+		}
+		else if(std::strcmp(argv[i], "--lod") == 0)
+		{
+			lod = true;
+		}
+		else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threads = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if(std::strcmp(argv[i], "--parallel") == 0 && i + 1 < argc)
+		{
+			parallelMegabytes = std::strtod(argv[++i], nullptr);
+		}
+		else if(argv[i][0] == '-')
+		{
+			std::fprintf(stderr, "usage: %s [--runs n] [--index] [--cache] [--tangents] [--packed] [--lod] [--threads n] [--parallel MB] [file.obj ...]\n", argv[0]);
+			return 1;
+		}
+		else
+		{
+			files.push_back(argv[i]);
+		}
+	}
+
+	if(files.empty())
+	{
+		files.assign(DEFAULT_FILES, DEFAULT_FILES + sizeof(DEFAULT_FILES) / sizeof(DEFAULT_FILES[0]));
+	}
+
+	runs = (runs > 0) ? runs : 1;
+
+	std::printf("runs %u, best of\n", runs);
+	std::printf("%-18s %8s %9s %9s %10s %10s %10s %10s %9s %10s\n", "file", "MB", "old tris", "new tris", "old ms", "new ms", "old MB/s", "new MB/s", "speedup", "max diff");
+
+	for(unsigned int i = 0; i < files.size(); i++)
+	{
+		RunFile(files[i], runs);
+	}
+
+	if(index)
+	{
+		std::printf("\nACMR on a %u entry FIFO, the optimizer targets a %u entry LRU\n", MeshOptimizer::ACMR_CACHE_SIZE, MeshOptimizer::CACHE_SIZE);
+		std::printf("%-18s %9s %9s %6s %10s %10s %8s %8s %8s %9s %9s\n", "file", "tris", "verts", "index", "soup KB", "indexed KB", "soup", "welded", "forsyth", "weld ms", "order ms");
+
+		for(unsigned int i = 0; i < files.size(); i++)
+		{
+			IndexFile(files[i]);
+		}
+	}
+
+	if(cache)
+	{
+		std::printf("\nmesh cache, cold is the first load, warm the best of %u later ones from the page cache\n", runs);
+		std::printf("%-18s %8s %8s %10s %10s %10s %10s %10s\n", "file", "obj MB", "mesh MB", "cold ms", "warm ms", "warm MB/s", "speedup", "checksum");
+
+		for(unsigned int i = 0; i < files.size(); i++)
+		{
+			CacheFile(files[i], runs);
+		}
+	}
+
+	if(tangents)
+	{
+		WorkerPool workers(threads);
+
+		std::printf("\ntangent frames, %s, pool of %u threads, best of %u\n", TangentFrame::SIMDEnabled() ? "SSE2" : "no SIMD", workers.ThreadCount(), runs);
+		std::printf("%-18s %9s %10s %10s %7s %10s %10s %10s %8s\n", "file", "tris", "flat verts", "vertex tan", "splits", "scalar ms", "simd ms", "pool ms", "match");
+
+		for(unsigned int i = 0; i < files.size(); i++)
+		{
+			TangentFile(files[i], runs, workers);
+		}
+	}
+
+	if(packing)
+	{
+		std::printf("\npacked bump vertices, %u bytes against %u, errors are the worst over every vertex (angles in radians), best of %u\n",
+			(unsigned int)sizeof(VertexPacking::PackedBumpVertex), (unsigned int)sizeof(BumpVertex), runs);
+		std::printf("%-18s %9s %10s %10s %7s %10s %10s %10s %9s %9s %10s\n", "file", "verts", "float KB", "packed KB", "ratio", "encode ms", "position", "texcoord", "normal", "tangent", "bounds");
+
+		for(unsigned int i = 0; i < files.size(); i++)
+		{
+			PackFile(files[i], runs);
+		}
+
+		PackSphere(65536);
+	}
+
+	if(lod)
+	{
+		std::printf("\nLOD chains, errors in object units, measured is the worst distance from a sample of full mesh vertices to the LOD, best of %u\n", runs);
+		std::printf("%-18s %4s %9s %8s %10s %10s %10s %10s %8s\n", "file", "lod", "tris", "of full", "error", "measured", "of extent", "build ms", "valid");
+
+		for(unsigned int i = 0; i < files.size(); i++)
+		{
+			LodFile(files[i], runs);
+		}
+	}
+
+	if(parallelMegabytes > 0.0)
+	{
+		RunParallel(parallelMegabytes, runs);
+	}
+
+	return 0;
+}
@@ -0,0 +1,911 @@
+//Headless benchmark for ParticleSim and the instance upload, builds without D3D (see Makefile)
+//Usage: particlebench [--threads n] [--frames n] [--sort] [--cull] [--ground] [--arena] [--objects] [--queue] [--ring] [--kernels] [--seed n]
+//--ground loads the desert and globe base from ../SandySnowGlobe, run from this directory
+//--arena adds a table of many fire emitters sharing one ParticleArena
+//--objects adds a table of object bounding spheres culled against the close-up frustum, SSE2 batches against one sphere at a time
+//--ring adds a table of frames where rain, snow and fire share one MemoryInstanceRing, each checking its uploads survive until the frame is drawn
+//--kernels adds a table of IntegrateAndKillSIMD checked bit for bit against IntegrateAndKillScalar, on counts with a SIMD tail,
+//against the kill box and a sloped ground, and the desert with --ground
+//--queue adds a table of RenderQueue radix sorts checked against std::stable_sort, with the binds an unsorted and a sorted frame need,
+//then drawn through InstanceBatcher into a recording target, every draw and packed transform checked against the queue,
+//and the constant buffer maps of a frame after the camera moved, which must be one per draw plus one per shader
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "ParticleSim.h"
+#include "ParticleKernels.h"
+#include "ParticleArena.h"
+#include "ParticleUpload.h"
+#include "Frustum.h"
+#include "HeightField.h"
+#include "Random.h"
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
+#include "ConstantBlocks.h"
+
+namespace
+{
+	std::atomic<unsigned long long> allocCount(0);
+	std::atomic<unsigned long long> allocBytes(0);
+
+	struct Options
+	{
+		unsigned int threads;
+		unsigned int frames;
+		bool sort;
+		bool cull;
+		bool ground;
+		bool arena;
+		bool objects;
+		bool queue;
+		bool ring;
+		bool kernels;
+		unsigned long long seed;
+	};
+
+	struct PresetInfo
+	{
+		ParticleSim::Preset preset;
+		const char *name;
+	};
+
+	const PresetInfo PRESETS[] = { { ParticleSim::SNOW, "SNOW" }, { ParticleSim::RAIN, "RAIN" }, { ParticleSim::FIRE, "FIRE" } };
+	const unsigned int SIZES[] = { 10000, 100000, 1000000, 5000000 };
+	const unsigned int EMITTER_COUNTS[] = { 8, 80, 800, 8000 };
+	const unsigned int KERNEL_COUNTS[] = { 1, 3, 5, 7, 13, 1001, 4099, 100003 };	//none a multiple of 4 or 8, every one leaves a scalar tail
+	const unsigned int OBJECT_COUNTS[] = { 13, 1000, 10000, 100000 };	//13 is the scene today, desert, globe base and the cacti
+	const float FRAME_DT = 1.0f / 60.0f;
+
+	bool ParseOptions(int argc, char **argv, Options &options)
+	{
+		options.threads = 1;
+		options.frames = 60;
+		options.sort = false;
+		options.cull = false;
+		options.ground = false;
+		options.arena = false;
+		options.objects = false;
+		options.queue = false;
+		options.ring = false;
+		options.kernels = false;
+		options.seed = 1;
+
+		for(int i = 1; i < argc; i++)
+		{
+			if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			{
+				options.threads = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if(std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			{
+				options.frames = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if(std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			{
+				options.seed = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if(std::strcmp(argv[i], "--sort") == 0)
+			{
+				options.sort = true;
+			}
+			else if(std::strcmp(argv[i], "--cull") == 0)
+			{
+				options.cull = true;
+			}
+			else if(std::strcmp(argv[i], "--ground") == 0)
+			{
+				options.ground = true;
+			}
+			else if(std::strcmp(argv[i], "--arena") == 0)
+			{
+				options.arena = true;
+			}
+			else if(std::strcmp(argv[i], "--objects") == 0)
+			{
+				options.objects = true;
+			}
+			else if(std::strcmp(argv[i], "--queue") == 0)
+			{
+				options.queue = true;
+			}
+			else if(std::strcmp(argv[i], "--ring") == 0)
+			{
+				options.ring = true;
+			}
+			else if(std::strcmp(argv[i], "--kernels") == 0)
+			{
+				options.kernels = true;
+			}
+			else
+			{
+				std::fprintf(stderr, "usage: %s [--threads n] [--frames n] [--sort] [--cull] [--ground] [--arena] [--objects] [--queue] [--ring] [--kernels] [--seed n]\n", argv[0]);
+				return false;
+			}
+		}
+
+		if(options.frames == 0)
+		{
+			options.frames = 1;
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Frustum of the close-up c3 camera, at (0, 0, -20) looking down +z with a 45 degree 16:9 projection
+	/// </summary>
+	Frustum CloseUpFrustum()
+	{
+		const float nearDepth = 0.1f;
+		const float farDepth = 1000.0f;
+		float yScale = 1.0f / std::tan(0.3926991f);
+		float zScale = farDepth / (farDepth - nearDepth);
+
+		//translation view matrix times a left handed perspective projection, row-major
+		float viewProj[16] =
+		{
+			yScale / (16.0f / 9.0f), 0.0f, 0.0f, 0.0f,
+			0.0f, yScale, 0.0f, 0.0f,
+			0.0f, 0.0f, zScale, 1.0f,
+			0.0f, 0.0f, (20.0f * zScale) - (nearDepth * zScale), 20.0f
+		};
+
+		Frustum frustum;
+		frustum.Build(viewProj);
+
+		return frustum;
+	}
+
+	/// <summary>
+	/// Same ground SnowGlobe::GroundInit builds, with the config.xml positions
+	/// </summary>
+	bool LoadGround(HeightField &ground)
+	{
+		const float desertScale[3] = { 0.985f, 0.985f, 0.985f };
+		const float desertPosition[3] = { 0.0f, -19.0f, 0.0f };
+		const float baseScale[3] = { 3.75f, 1.8f, 3.75f };
+		const float basePosition[3] = { 0.0f, -40.0f, 0.0f };
+
+		return ground.Init(-112.5f, -112.5f, 112.5f, 112.5f, 257, 257, basePosition[1]) &&
+			ground.AddMesh("../SandySnowGlobe/desert.obj", desertScale, desertPosition) &&
+			ground.AddMesh("../SandySnowGlobe/snowglobebase.obj", baseScale, basePosition);
+	}
+
+	/// <summary>
+	/// Pick the chunks to upload the same way ParticleSystem does and return the box around them
+	/// </summary>
+	ParticleUpload::Bounds CullChunks(const ParticleSim &sim, const Frustum *frustum, std::vector<ParticleUpload::Range> &ranges)
+	{
+		const float reach = 0.3f * 1.415f;
+		ParticleKernels::Aabb visible = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+
+		ranges.clear();
+
+		for(unsigned int i = 0; i < sim.ChunkCount(); i++)
+		{
+			const ParticleSim::Chunk &chunk = sim.Chunks()[i];
+			float lo[3] = { chunk.bounds.min[0] - reach, chunk.bounds.min[1] - reach, chunk.bounds.min[2] - reach };
+			float hi[3] = { chunk.bounds.max[0] + reach, chunk.bounds.max[1] + reach, chunk.bounds.max[2] + reach };
+
+			if(frustum != nullptr && !frustum->Intersects(lo, hi))
+			{
+				continue;
+			}
+
+			for(unsigned int axis = 0; axis < 3; axis++)
+			{
+				bool first = ranges.empty();
+				visible.min[axis] = (first || chunk.bounds.min[axis] < visible.min[axis]) ? chunk.bounds.min[axis] : visible.min[axis];
+				visible.max[axis] = (first || chunk.bounds.max[axis] > visible.max[axis]) ? chunk.bounds.max[axis] : visible.max[axis];
+			}
+
+			ParticleUpload::Range range = { chunk.begin, chunk.count };
+			ranges.push_back(range);
+		}
+
+		return ParticleUpload::MakeBounds(visible);
+	}
+
+	/// <summary>
+	/// Decode the last upload and return the largest position error against the pool
+	/// </summary>
+	float QuantizationError(const ParticlePool &pool, const std::vector<ParticleUpload::Range> &ranges, const ParticleUpload::Bounds &bounds, const MemoryInstanceSink &sink)
+	{
+		const ParticleUpload::Instance *instances = reinterpret_cast<const ParticleUpload::Instance *>(sink.Data());
+		float worst = 0.0f;
+
+		for(unsigned int r = 0; r < ranges.size(); r++)
+		{
+			for(unsigned int i = ranges[r].begin; i < ranges[r].begin + ranges[r].count; i++)
+			{
+				float x, y, z, size;
+				ParticleUpload::Decode(bounds, *instances++, x, y, z, size);
+
+				float e[3] = { std::fabs(x - pool.PosX()[i]), std::fabs(y - pool.PosY()[i]), std::fabs(z - pool.PosZ()[i]) };
+
+				for(unsigned int a = 0; a < 3; a++)
+				{
+					worst = (e[a] > worst) ? e[a] : worst;
+				}
+			}
+		}
+
+		return worst;
+	}
+
+	/// <summary>
+	/// Fill a pool of the given size and time frames of steady state updates
+	/// Upload into a MemoryInstanceSink is timed separately from the simulation
+	/// Emission is scaled with the budget so the pool stays roughly as full as the shipped preset
+	/// </summary>
+	void RunCase(const PresetInfo &info, unsigned int size, const Options &options, WorkerPool &workers, const HeightField *ground)
+	{
+		ParticleSim::Settings settings = ParticleSim::PresetSettings(info.preset);
+		float scale = (float)size / (float)settings.maxParticles;
+
+		settings.frequency *= scale;
+		settings.maxParticles = size;
+
+		unsigned long long setupAllocs = allocCount;
+
+		ParticleSim sim;
+		sim.Seed(options.seed);
+		sim.Workers(&workers);
+		sim.Ground((info.preset == ParticleSim::FIRE) ? nullptr : ground);
+		sim.Init(settings);
+		sim.Emit((float)size / settings.frequency);
+
+		MemoryInstanceSink sink(size * sizeof(ParticleUpload::Instance) + InstanceSink::ALIGNMENT);
+
+		ParticleSort::DepthAxis axis = { 0.0f, 0.0f, 1.0f, 200.0f };
+		const ParticleSort::DepthAxis *sortAxis = options.sort ? &axis : nullptr;
+
+		Frustum closeUp = CloseUpFrustum();
+		const Frustum *frustum = options.cull ? &closeUp : nullptr;
+		std::vector<ParticleUpload::Range> ranges;
+		ParticleUpload::Bounds bounds;
+		ranges.reserve(size / ParticleSim::CHUNK_SIZE + 1);
+
+		//one untimed frame so scratch buffers reach their working size
+		sim.Update(FRAME_DT, true, sortAxis);
+
+		setupAllocs = allocCount - setupAllocs;
+
+		unsigned long long frameAllocs = allocCount;
+		unsigned long long frameBytes = allocBytes;
+		unsigned long long processed = 0;
+		unsigned long long alive = 0;
+		unsigned long long uploaded = 0;
+		double uploadSeconds = 0.0;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		for(unsigned int f = 0; f < options.frames; f++)
+		{
+			processed += sim.Count();
+			sim.Update(FRAME_DT, true, sortAxis);
+
+			std::chrono::high_resolution_clock::time_point uploadStart = std::chrono::high_resolution_clock::now();
+			unsigned int offset;
+			sink.Reset();
+			alive += sim.Count();
+			bounds = CullChunks(sim, frustum, ranges);
+
+			if(!ranges.empty())
+			{
+				ParticleUpload::Write(sim.Particles(), &ranges[0], (unsigned int)ranges.size(), bounds, sink, offset);
+			}
+
+			for(unsigned int r = 0; r < ranges.size(); r++)
+			{
+				uploaded += ranges[r].count;
+			}
+			uploadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - uploadStart).count();
+		}
+
+		std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+		frameAllocs = allocCount - frameAllocs;
+		frameBytes = allocBytes - frameBytes;
+
+		double seconds = std::chrono::duration<double>(end - start).count() - uploadSeconds;
+		float maxError = QuantizationError(sim.Particles(), ranges, bounds, sink);
+		float errorBound = ParticleUpload::MaxError(bounds);
+		double visible = (alive > 0) ? (100.0 * (double)uploaded) / (double)alive : 0.0;
+
+		double nsPerParticle = (processed > 0) ? (seconds * 1e9) / (double)processed : 0.0;
+		double particlesPerSecond = (seconds > 0.0) ? (double)processed / seconds : 0.0;
+
+		std::printf("%-5s %9u %9u %10.3f %10.2f %12.1f %10.3f %9.1f %8llu %10llu %8llu %10.6f %s\n", info.name, size, sim.Count(), (seconds * 1000.0) / options.frames,
+			nsPerParticle, particlesPerSecond / 1e6, (uploadSeconds * 1000.0) / options.frames, visible, frameAllocs, frameBytes, setupAllocs,
+			maxError, (maxError <= errorBound) ? "ok" : "OVER BOUND");
+	}
+
+	/// <summary>
+	/// Fire emitters on a grid sharing one arena, stepped and uploaded as one instance run per frame
+	/// ns/emitter should stay flat as the emitter count grows
+	/// </summary>
+	void RunArena(unsigned int emitterCount, const Options &options, WorkerPool &workers)
+	{
+		ParticleSim::Settings settings = ParticleSim::PresetSettings(ParticleSim::FIRE);
+		unsigned int side = (unsigned int)std::ceil(std::sqrt((float)emitterCount));
+
+		unsigned long long setupAllocs = allocCount;
+
+		ParticleArena arena;
+		arena.Seed(options.seed);
+		arena.Workers(&workers);
+		arena.Init(settings.maxParticles * emitterCount);
+
+		for(unsigned int i = 0; i < emitterCount; i++)
+		{
+			ParticleSim::Float3 origin = { (float)(i % side) * 5.0f, 0.0f, (float)(i / side) * 5.0f };
+			ParticleArena::Handle emitter = arena.AddEmitter(settings);
+
+			arena.Position(emitter, origin);
+			arena.Active(emitter, true);
+		}
+
+		MemoryInstanceSink sink(arena.Capacity() * sizeof(ParticleUpload::Instance) + InstanceSink::ALIGNMENT);
+		std::vector<ParticleUpload::Range> ranges;
+		ranges.reserve(emitterCount);
+
+		//run until the emitters reach steady state, particles live a few seconds
+		for(unsigned int f = 0; f < 600; f++)
+		{
+			arena.Update(FRAME_DT);
+		}
+
+		setupAllocs = allocCount - setupAllocs;
+
+		unsigned long long frameAllocs = allocCount;
+		double uploadSeconds = 0.0;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		for(unsigned int f = 0; f < options.frames; f++)
+		{
+			arena.Update(FRAME_DT);
+
+			std::chrono::high_resolution_clock::time_point uploadStart = std::chrono::high_resolution_clock::now();
+			ParticleKernels::Aabb visible = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+			unsigned int offset;
+
+			sink.Reset();
+			ranges.clear();
+
+			for(unsigned int c = 0; c < arena.ChunkCount(); c++)
+			{
+				const ParticleSim::Chunk &chunk = arena.Chunks()[c];
+
+				for(unsigned int a = 0; a < 3; a++)
+				{
+					visible.min[a] = (c == 0 || chunk.bounds.min[a] < visible.min[a]) ? chunk.bounds.min[a] : visible.min[a];
+					visible.max[a] = (c == 0 || chunk.bounds.max[a] > visible.max[a]) ? chunk.bounds.max[a] : visible.max[a];
+				}
+
+				ParticleUpload::Range range = { chunk.begin, chunk.count };
+				ranges.push_back(range);
+			}
+
+			if(!ranges.empty())
+			{
+				ParticleUpload::Write(arena.Particles(), &ranges[0], (unsigned int)ranges.size(), ParticleUpload::MakeBounds(visible), sink, offset);
+			}
+
+			uploadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - uploadStart).count();
+		}
+
+		std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+		frameAllocs = allocCount - frameAllocs;
+
+		double seconds = std::chrono::duration<double>(end - start).count() - uploadSeconds;
+		double nsPerEmitter = (seconds * 1e9) / ((double)options.frames * emitterCount);
+
+		std::printf("%9u %9u %10.3f %11.1f %10.3f %8llu %8llu\n", emitterCount, arena.Count(), (seconds * 1000.0) / options.frames,
+			nsPerEmitter, (uploadSeconds * 1000.0) / options.frames, frameAllocs, setupAllocs);
+	}
+
+	/// <summary>
+	/// Cull a field of props scattered over the globe's floor the way SnowGlobe::Render does, one frame's spheres at a time,
+	/// and check the SSE2 batch agrees with the one sphere test on every object
+	/// </summary>
+	void RunObjects(unsigned int objectCount, const Options &options)
+	{
+		Random rng(options.seed);
+		std::vector<float> x(objectCount), y(objectCount), z(objectCount), radius(objectCount);
+		std::vector<unsigned char> visible(objectCount);
+
+		rng.Fill(&x[0], objectCount, -100.0f, 100.0f);
+		rng.Fill(&y[0], objectCount, -10.0f, 30.0f);
+		rng.Fill(&z[0], objectCount, -100.0f, 100.0f);
+		rng.Fill(&radius[0], objectCount, 0.5f, 5.0f);
+
+		Frustum frustum = CloseUpFrustum();
+		unsigned int visibleCount = 0, mismatches = 0;
+		double batchSeconds = 1e30, singleSeconds = 1e30;
+
+		for(unsigned int f = 0; f < options.frames; f++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			visibleCount = frustum.IntersectSpheres(&x[0], &y[0], &z[0], &radius[0], objectCount, &visible[0]);
+			std::chrono::high_resolution_clock::time_point middle = std::chrono::high_resolution_clock::now();
+
+			unsigned int singleCount = 0;
+			mismatches = 0;
+
+			for(unsigned int i = 0; i < objectCount; i++)
+			{
+				float center[3] = { x[i], y[i], z[i] };
+				bool inside = frustum.Intersects(center, radius[i]);
+
+				singleCount += inside ? 1 : 0;
+				mismatches += (inside != (visible[i] != 0)) ? 1 : 0;
+			}
+
+			std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+			batchSeconds = std::fmin(batchSeconds, std::chrono::duration<double>(middle - start).count());
+			singleSeconds = std::fmin(singleSeconds, std::chrono::duration<double>(end - middle).count());
+			mismatches += (singleCount != visibleCount) ? 1 : 0;
+		}
+
+		std::printf("%9u %9u %9u %12.2f %12.2f %9.1fx %10u\n", objectCount, visibleCount, objectCount - visibleCount, (batchSeconds * 1e9) / objectCount,
+			(singleSeconds * 1e9) / objectCount, singleSeconds / batchSeconds, mismatches);
+	}
+
+	/// <summary>
+	/// Binds a frame needs walking items in order, a state is bound when its key prefix differs from the previous item's
+	/// </summary>
+	void CountBinds(const RenderQueue::Item *items, unsigned int count, unsigned int *binds)
+	{
+		const RenderQueue::Field fields[3] = { RenderQueue::FIELD_SHADER, RenderQueue::FIELD_TEXTURES, RenderQueue::FIELD_MESH };
+
+		for(unsigned int f = 0; f < 3; f++)
+		{
+			binds[f] = 0;
+
+			for(unsigned int i = 0; i < count; i++)
+			{
+				binds[f] += (i == 0 || !RenderQueue::SamePrefix(items[i - 1].key, items[i].key, fields[f])) ? 1 : 0;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Queue objectCount draws over a handful of shaders and a few dozen texture sets and meshes as SnowGlobe::QueueObjects does,
+	/// sort with the radix sort, check the order against std::stable_sort and count the binds before and after
+	/// </summary>
+	void RunQueue(unsigned int objectCount, const Options &options)
+	{
+		Random rng(options.seed);
+		RenderQueue queue;
+		std::vector<RenderQueue::Item> unsorted(objectCount), expected;
+		std::vector<float> worlds(objectCount * 16);
+		const unsigned int SHADERS = 4, TEXTURE_SETS = 24, MESHES = 48;
+		static char resources[SHADERS + TEXTURE_SETS + MESHES];
+
+		for(unsigned int i = 0; i < objectCount; i++)
+		{
+			unsigned int shader = (unsigned int)(rng.Next() % SHADERS);
+			unsigned int textures = (unsigned int)(rng.Next() % TEXTURE_SETS);
+			unsigned int mesh = (unsigned int)(rng.Next() % MESHES);
+			unsigned int lod = (unsigned int)(rng.Next() % 3);
+
+			unsigned int shaderId = queue.Intern(RenderQueue::FIELD_SHADER, &resources[shader]);
+			unsigned int textureId = queue.Intern(RenderQueue::FIELD_TEXTURES, &resources[SHADERS + textures]);
+			unsigned int meshId = (queue.Intern(RenderQueue::FIELD_MESH, &resources[SHADERS + TEXTURE_SETS + mesh]) * 4) + lod;
+
+			unsorted[i].key = RenderQueue::MakeKey(shader >= 2 ? 1 : 0, shaderId, textureId, meshId, rng.NextFloat());
+			unsorted[i].payload = i;
+
+			for(unsigned int m = 0; m < 16; m++)
+			{
+				worlds[(i * 16) + m] = rng.NextFloat();
+			}
+		}
+
+		expected = unsorted;
+		std::stable_sort(expected.begin(), expected.end(), [](const RenderQueue::Item &a, const RenderQueue::Item &b) { return a.key < b.key; });
+
+		double best = 1e30;
+		unsigned int mismatches = 0;
+
+		for(unsigned int f = 0; f < options.frames; f++)
+		{
+			queue.Clear();
+
+			for(unsigned int i = 0; i < objectCount; i++)
+			{
+				queue.Submit(unsorted[i].key, unsorted[i].payload);
+			}
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			queue.Sort();
+			best = std::fmin(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+		}
+
+		for(unsigned int i = 0; i < objectCount; i++)
+		{
+			mismatches += (queue.Items()[i].payload != expected[i].payload) ? 1 : 0;
+		}
+
+		unsigned int before[3], after[3];
+		CountBinds(&unsorted[0], objectCount, before);
+		CountBinds(queue.Items(), objectCount, after);
+
+		//each item must be drawn once, in queue order, and an instanced draw's transforms must be its run's world matrices
+		MemoryInstanceSink sink(objectCount * sizeof(InstanceBatcher::Transform));
+		RecordingDrawTarget target(true);
+		InstanceBatcher::Layout layout = { &worlds[0], sizeof(float) * 16, 0 };
+		InstanceBatcher::Stats stats;
+		InstanceBatcher::Submit(queue.Items(), objectCount, layout, sink, target, stats);
+
+		unsigned int next = 0;
+
+		for(unsigned int c = 0; c < (unsigned int)target.Calls().size(); c++)
+		{
+			const RecordingDrawTarget::Call &call = target.Calls()[c];
+			unsigned int instances = (call.instanceCount > 0) ? call.instanceCount : 1;
+			const InstanceBatcher::Transform *packed = reinterpret_cast<const InstanceBatcher::Transform *>(sink.Data() + call.instanceOffset);
+
+			if(next + instances > objectCount || call.payload != queue.Items()[next].payload)
+			{
+				mismatches++;
+				break;
+			}
+
+			for(unsigned int i = 0; i < call.instanceCount; i++)
+			{
+				InstanceBatcher::Transform expectedTransform;
+				InstanceBatcher::Pack(&worlds[queue.Items()[next + i].payload * 16], expectedTransform);
+				mismatches += (std::memcmp(&expectedTransform, &packed[i], sizeof(expectedTransform)) != 0) ? 1 : 0;
+			}
+
+			next += instances;
+		}
+
+		mismatches += (next != objectCount) ? 1 : 0;
+
+		//constant uploads in the order SnowGlobe::DrawQueue makes them when nothing is instanced, sizes as Shader's blocks
+		ConstantBlocks blocks[SHADERS];
+		CountingConstantWriter writer;
+		float frame[36] = { 0.0f }, lights[24] = { 0.0f };
+		unsigned int shadersUsed = 0;
+
+		for(unsigned int b = 0; b < SHADERS; b++)
+		{
+			blocks[b].Init(ConstantBlocks::BLOCK_FRAME, sizeof(frame));
+			blocks[b].Init(ConstantBlocks::BLOCK_PASS, sizeof(lights));
+			blocks[b].Init(ConstantBlocks::BLOCK_OBJECT, sizeof(float) * 16);
+		}
+
+		for(unsigned int f = 0; f < 2; f++)
+		{
+			frame[12] = (float)f;	//the camera moves between frames, the lights do not
+			writer.Reset();
+			shadersUsed = 0;
+
+			for(unsigned int i = 0; i < objectCount; i++)
+			{
+				const RenderQueue::Item &item = queue.Items()[i];
+				ConstantBlocks &shader = blocks[RenderQueue::FieldValue(item.key, RenderQueue::FIELD_SHADER)];
+
+				if(i == 0 || !RenderQueue::SamePrefix(queue.Items()[i - 1].key, item.key, RenderQueue::FIELD_SHADER))
+				{
+					shader.Set(ConstantBlocks::BLOCK_FRAME, frame);
+					shader.Upload(ConstantBlocks::BLOCK_FRAME, writer);
+
+					if(RenderQueue::FieldValue(item.key, RenderQueue::FIELD_PASS) == 1)
+					{
+						shader.Set(ConstantBlocks::BLOCK_PASS, lights);
+						shader.Upload(ConstantBlocks::BLOCK_PASS, writer);
+					}
+
+					shadersUsed++;
+				}
+
+				shader.Set(ConstantBlocks::BLOCK_OBJECT, &worlds[item.payload * 16]);
+				shader.Upload(ConstantBlocks::BLOCK_OBJECT, writer);
+			}
+		}
+
+		mismatches += (writer.TotalWrites() != objectCount + shadersUsed) ? 1 : 0;
+
+		std::printf("%9u %10.1f %7u %9u/%-7u %9u/%-7u %9u/%-7u %12u %12u %10u\n", objectCount, (best * 1e9) / objectCount, queue.LastSortPasses(),
+			before[0], after[0], before[1], after[1], before[2], after[2], stats.draws, writer.TotalWrites(), mismatches);
+	}
+
+	/// <summary>
+	/// Rain, snow and fire upload in turn into one ring each frame as SnowGlobe::Update does, after the frame every upload must still
+	/// hold what its system wrote, a discard between two of them would have replaced it with garbage
+	/// </summary>
+	/// <param name="fill">Fraction of each system's budget used every frame, below 0 a random fraction per system and frame</param>
+	void RunRing(float fill, const Options &options)
+	{
+		const unsigned int SYSTEMS = 3;
+		const unsigned int BUDGETS[SYSTEMS] = { 20000, 12000, 8000 };	//particles, rain, snow and fire
+		Random rng(options.seed);
+		unsigned int frameBytes = 0;
+
+		for(unsigned int s = 0; s < SYSTEMS; s++)
+		{
+			frameBytes += (BUDGETS[s] * sizeof(ParticleUpload::Instance)) + InstanceSink::ALIGNMENT;
+		}
+
+		MemoryInstanceRing ring(frameBytes * 2);
+		unsigned int frames = (options.frames > 64) ? options.frames : 64;
+		unsigned int failedBegins = 0, corruptFrames = 0;
+
+		for(unsigned int f = 0; f < frames; f++)
+		{
+			InstanceSink::Allocation allocations[SYSTEMS];
+			unsigned int bytes[SYSTEMS];
+			bool written[SYSTEMS];
+
+			ring.BeginFrame(frameBytes);
+
+			for(unsigned int s = 0; s < SYSTEMS; s++)
+			{
+				float used = (fill < 0.0f) ? rng.NextFloat() : fill;
+				bytes[s] = ((unsigned int)(BUDGETS[s] * used) + 1) * sizeof(ParticleUpload::Instance);
+				written[s] = ring.Begin(bytes[s], allocations[s]);
+
+				if(!written[s])
+				{
+					failedBegins++;
+					continue;
+				}
+
+				std::memset(allocations[s].data, (int)(((f * SYSTEMS) + s) & 0x7F), bytes[s]);
+				ring.End();
+			}
+
+			bool corrupt = false;
+
+			for(unsigned int s = 0; s < SYSTEMS; s++)
+			{
+				const unsigned char *data = ring.Data() + allocations[s].offset;
+				unsigned char expected = (unsigned char)(((f * SYSTEMS) + s) & 0x7F);
+
+				for(unsigned int b = 0; written[s] && b < bytes[s]; b++)
+				{
+					corrupt = corrupt || data[b] != expected;
+				}
+			}
+
+			corruptFrames += corrupt ? 1 : 0;
+		}
+
+		if(fill < 0.0f)
+		{
+			std::printf("%9s %9u %9u %12u %14u\n", "random", frames, ring.Discards(), failedBegins, corruptFrames);
+		}
+		else
+		{
+			std::printf("%9.2f %9u %9u %12u %14u\n", fill, frames, ring.Discards(), failedBegins, corruptFrames);
+		}
+	}
+
+	/// <summary>
+	/// Ground rising from -5 at x = -50 to 15 at x = 50, particles either side of it and outside the grid
+	/// </summary>
+	bool SlopeGround(HeightField &ground)
+	{
+		const float corners[4][3] = { { -50.0f, -5.0f, -50.0f }, { 50.0f, 15.0f, -50.0f }, { 50.0f, 15.0f, 50.0f }, { -50.0f, -5.0f, 50.0f } };
+
+		if(!ground.Init(-50.0f, -50.0f, 50.0f, 50.0f, 65, 65, -10.0f))
+		{
+			return false;
+		}
+
+		ground.AddTriangle(corners[0], corners[1], corners[2]);
+		ground.AddTriangle(corners[0], corners[2], corners[3]);
+
+		return true;
+	}
+
+	/// <summary>
+	/// Run the scalar and SIMD integrate kernels over two copies of one random pool, both must keep the same particles in the same
+	/// order with identical bits in every stream
+	/// </summary>
+	/// <param name="name">Bounds label</param>
+	/// <param name="count">Particles</param>
+	/// <param name="bounds">Kill box and ground</param>
+	void RunKernels(const char *name, unsigned int count, const ParticleKernels::KillBounds &bounds, const Options &options)
+	{
+		const float dt = 0.1f;
+		ParticlePool scalar, simd;
+		Random rng(options.seed + count);
+
+		if(!scalar.Init(count) || !simd.Init(count))
+		{
+			std::printf("%-7s %9u could not allocate\n", name, count);
+			return;
+		}
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			float x = rng.Range(-60.0f, 60.0f);
+			float y = rng.Range(-15.0f, 30.0f);
+			float z = rng.Range(-60.0f, 60.0f);
+			float vx = rng.Range(-10.0f, 10.0f);
+			float vy = rng.Range(-10.0f, 10.0f);
+			float vz = rng.Range(-10.0f, 10.0f);
+			unsigned int rgba = (unsigned int)rng.Next();
+
+			scalar.Add(x, y, z, vx, vy, vz, rgba);
+			simd.Add(x, y, z, vx, vy, vz, rgba);
+		}
+
+		unsigned int kept = ParticleKernels::IntegrateAndKillScalar(scalar, 0, count, dt, bounds);
+		unsigned int keptSIMD = ParticleKernels::IntegrateAndKillSIMD(simd, 0, count, dt, bounds);
+		unsigned int mismatches = (kept > keptSIMD) ? kept - keptSIMD : keptSIMD - kept;
+		const void *streams[7][2] =
+		{
+			{ scalar.PosX(), simd.PosX() }, { scalar.PosY(), simd.PosY() }, { scalar.PosZ(), simd.PosZ() },
+			{ scalar.VelX(), simd.VelX() }, { scalar.VelY(), simd.VelY() }, { scalar.VelZ(), simd.VelZ() },
+			{ scalar.Colour(), simd.Colour() }
+		};
+
+		for(unsigned int i = 0; i < kept && i < keptSIMD; i++)
+		{
+			bool same = true;
+
+			for(unsigned int s = 0; s < 7; s++)
+			{
+				same = same && std::memcmp(static_cast<const unsigned char *>(streams[s][0]) + (i * 4), static_cast<const unsigned char *>(streams[s][1]) + (i * 4), 4) == 0;
+			}
+
+			mismatches += same ? 0 : 1;
+		}
+
+		std::printf("%-7s %9u %9u %9u %10u\n", name, count, kept, count - kept, mismatches);
+	}
+}
+
+void *operator new(std::size_t size)
+{
+	allocCount++;
+	allocBytes += size;
+
+	void *p = std::malloc(size ? size : 1);
+
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+
+	if(!ParseOptions(argc, argv, options))
+	{
+		return 1;
+	}
+
+	WorkerPool workers(options.threads);
+	HeightField ground;
+
+	if(options.ground && !LoadGround(ground))
+	{
+		std::fprintf(stderr, "could not load ../SandySnowGlobe/desert.obj or snowglobebase.obj\n");
+		return 1;
+	}
+
+	std::printf("threads %u, frames %u, sort %s, cull %s, ground %s, simd %s, seed %llu\n", workers.ThreadCount(), options.frames,
+		options.sort ? "on" : "off", options.cull ? "on" : "off", options.ground ? "on" : "off", ParticleKernels::SIMDEnabled() ? "on" : "off", options.seed);
+	std::printf("%-5s %9s %9s %10s %10s %12s %10s %9s %8s %10s %8s %10s\n", "type", "budget", "alive", "ms/frame", "ns/part", "Mpart/s", "upload ms", "visible %", "allocs", "bytes", "setup", "max err");
+
+	for(unsigned int p = 0; p < sizeof(PRESETS) / sizeof(PRESETS[0]); p++)
+	{
+		for(unsigned int s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++)
+		{
+			RunCase(PRESETS[p], SIZES[s], options, workers, options.ground ? &ground : nullptr);
+		}
+	}
+
+	if(options.arena)
+	{
+		std::printf("\n%9s %9s %10s %11s %10s %8s %8s\n", "emitters", "alive", "ms/frame", "ns/emitter", "upload ms", "allocs", "setup");
+
+		for(unsigned int e = 0; e < sizeof(EMITTER_COUNTS) / sizeof(EMITTER_COUNTS[0]); e++)
+		{
+			RunArena(EMITTER_COUNTS[e], options, workers);
+		}
+	}
+
+	if(options.objects)
+	{
+		std::printf("\n%9s %9s %9s %12s %12s %10s %10s\n", "objects", "drawn", "culled", "batch ns/obj", "single ns/obj", "speedup", "mismatches");
+
+		for(unsigned int o = 0; o < sizeof(OBJECT_COUNTS) / sizeof(OBJECT_COUNTS[0]); o++)
+		{
+			RunObjects(OBJECT_COUNTS[o], options);
+		}
+	}
+
+	if(options.kernels)
+	{
+		HeightField slope;
+		ParticleKernels::KillBounds box = { 0.0f, 25.0f, nullptr };
+		ParticleKernels::KillBounds sloped = { 0.0f, 25.0f, nullptr };
+		ParticleKernels::KillBounds desert = { 0.0f, 25.0f, options.ground ? &ground : nullptr };
+
+		sloped.ground = SlopeGround(slope) ? &slope : nullptr;
+
+		std::printf("\n%-7s %9s %9s %9s %10s\n", "bounds", "count", "kept", "killed", "mismatches");
+
+		for(unsigned int c = 0; c < sizeof(KERNEL_COUNTS) / sizeof(KERNEL_COUNTS[0]); c++)
+		{
+			RunKernels("box", KERNEL_COUNTS[c], box, options);
+			RunKernels("slope", KERNEL_COUNTS[c], sloped, options);
+
+			if(options.ground)
+			{
+				RunKernels("desert", KERNEL_COUNTS[c], desert, options);
+			}
+		}
+	}
+
+	if(options.ring)
+	{
+		const float FILLS[] = { 1.0f, 0.7f, 0.5f, 0.3f, -1.0f };
+
+		std::printf("\n%9s %9s %9s %12s %14s\n", "fill", "frames", "discards", "failed begins", "corrupt frames");
+
+		for(unsigned int i = 0; i < sizeof(FILLS) / sizeof(FILLS[0]); i++)
+		{
+			RunRing(FILLS[i], options);
+		}
+	}
+
+	if(options.queue)
+	{
+		std::printf("\n%9s %10s %7s %17s %17s %17s %12s %12s %10s\n", "draws", "sort ns", "passes", "shader binds", "texture binds", "mesh binds", "draw calls", "const maps", "mismatches");
+
+		for(unsigned int o = 0; o < sizeof(OBJECT_COUNTS) / sizeof(OBJECT_COUNTS[0]); o++)
+		{
+			RunQueue(OBJECT_COUNTS[o], options);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,480 @@
+#include "AssetCache.h"
+
+namespace
+{
+	/// <summary>
+	/// Absolute, lower case path with backslashes, paths naming the same file on NTFS compare equal
+	/// </summary>
+	/// <param name="path">Path as given, relative to the working directory or absolute</param>
+	/// <returns>Canonical path, or the path as given if it cannot be resolved</returns>
+	std::wstring Canonical(const WCHAR *path)
+	{
+		std::wstring canonical;
+		DWORD length = GetFullPathNameW(path, 0, nullptr, nullptr);
+
+		if(length > 0)
+		{
+			canonical.resize(length);
+			length = GetFullPathNameW(path, length, &canonical[0], nullptr);
+			canonical.resize(length);
+		}
+
+		if(canonical.empty())
+		{
+			canonical = path;
+		}
+
+		for(std::size_t i = 0; i < canonical.size(); i++)
+		{
+			if(canonical[i] == L'/')
+			{
+				canonical[i] = L'\\';
+			}
+		}
+
+		CharLowerBuffW(&canonical[0], (DWORD)canonical.size());
+
+		return canonical;
+	}
+
+	/// <summary>
+	/// File name without its folder, narrowed for the load timeline
+	/// </summary>
+	std::string Name(const WCHAR *path)
+	{
+		std::wstring wide(path);
+		std::size_t slash = wide.find_last_of(L"/\\");
+		std::string name;
+
+		for(std::size_t i = (slash == std::wstring::npos) ? 0 : slash + 1; i < wide.size(); i++)
+		{
+			name.push_back((wide[i] < 128) ? (char)wide[i] : '?');
+		}
+
+		return name;
+	}
+}
+
+AssetCache::AssetCache(AssetLoader *assetLoader)
+{
+	loader = assetLoader;
+	stats.modelHits = 0;
+	stats.modelMisses = 0;
+	stats.models = 0;
+	stats.textureHits = 0;
+	stats.textureMisses = 0;
+	stats.textures = 0;
+}
+
+AssetCache::~AssetCache()
+{
+	Clear();
+}
+
+/// <summary>
+/// Shared textureless model
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="filename">Model filepath</param>
+/// <returns></returns>
+std::shared_ptr<Model> AssetCache::GetModel(ID3D11Device *device, const WCHAR *filename)
+{
+	return Acquire(device, L"vertex", filename, Model::MESH_VERTEX);
+}
+
+/// <summary>
+/// Shared simple textured model
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="filename">Model filepath</param>
+/// <param name="textureName">Colour texture filepath</param>
+/// <returns></returns>
+std::shared_ptr<Model> AssetCache::GetModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *textureName)
+{
+	return Acquire(device, L"textured", filename, Model::MESH_VERTEX, textureName);
+}
+
+/// <summary>
+/// Shared sky dome model
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="filename">Model filepath</param>
+/// <param name="skyTexture">Colour texture filepath</param>
+/// <param name="gradientTexture">Gradient texture for day/night cycle</param>
+/// <returns></returns>
+std::shared_ptr<Model> AssetCache::GetModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture)
+{
+	return Acquire(device, L"sky", filename, Model::MESH_VERTEX, skyTexture, gradientTexture);
+}
+
+/// <summary>
+/// Shared normal mapped model
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="filename">Model filepath</param>
+/// <param name="colourTexture">Colour texture filepath</param>
+/// <param name="normalTexture">Normal map texture filepath</param>
+/// <param name="specularTexture">Specular map texture filepath</param>
+/// <returns></returns>
+std::shared_ptr<Model> AssetCache::GetModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture)
+{
+	return Acquire(device, L"bump", filename, Model::MESH_BUMP_PACKED, colourTexture, normalTexture, specularTexture);
+}
+
+/// <summary>
+/// Shared billboarded quad
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="texture1">Texture 1 filepath</param>
+/// <param name="texture2">Texture 2 filepath</param>
+/// <param name="texture3">Texture 3 filepath</param>
+/// <returns></returns>
+std::shared_ptr<Model> AssetCache::GetBillboard(ID3D11Device *device, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3)
+{
+	return Acquire(device, L"billboard", nullptr, Model::MESH_VERTEX, texture1, texture2, texture3);
+}
+
+/// <summary>
+/// Shared texture, a texture that failed to load is returned without its view and dropped so the next request retries
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="filename">DDS filepath</param>
+/// <returns>Never nullptr</returns>
+std::shared_ptr<Texture> AssetCache::GetTexture(ID3D11Device *device, const WCHAR *filename)
+{
+	AssetLoader::Handle job;
+	std::shared_ptr<Texture> texture = RequestTexture(device, filename, job);
+
+	CompleteTexture(Canonical(filename));
+
+	return texture;
+}
+
+//Prefetch* start the same loads as the matching Get*, the handle is null when the asset was already loaded
+AssetLoader::Handle AssetCache::PrefetchModel(ID3D11Device *device, const WCHAR *filename)
+{
+	return Prefetch(device, L"vertex", filename, Model::MESH_VERTEX);
+}
+
+AssetLoader::Handle AssetCache::PrefetchModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *textureName)
+{
+	return Prefetch(device, L"textured", filename, Model::MESH_VERTEX, textureName);
+}
+
+AssetLoader::Handle AssetCache::PrefetchModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture)
+{
+	return Prefetch(device, L"sky", filename, Model::MESH_VERTEX, skyTexture, gradientTexture);
+}
+
+AssetLoader::Handle AssetCache::PrefetchModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture)
+{
+	return Prefetch(device, L"bump", filename, Model::MESH_BUMP_PACKED, colourTexture, normalTexture, specularTexture);
+}
+
+AssetLoader::Handle AssetCache::PrefetchBillboard(ID3D11Device *device, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3)
+{
+	return Prefetch(device, L"billboard", nullptr, Model::MESH_VERTEX, texture1, texture2, texture3);
+}
+
+/// <summary>
+/// Wait on every load still pending, creating their device objects on this thread
+/// </summary>
+void AssetCache::Complete()
+{
+	while(!pendingModels.empty())
+	{
+		CompleteModel(pendingModels.begin()->first);
+	}
+
+	while(!pendingTextures.empty())
+	{
+		CompleteTexture(pendingTextures.begin()->first);
+	}
+}
+
+/// <summary>
+/// Drop the assets no one but the cache holds, models first as they hold textures
+/// Pending loads hold their assets, they are never dropped here
+/// </summary>
+/// <returns>Number of assets released</returns>
+unsigned int AssetCache::Purge()
+{
+	unsigned int released = 0;
+
+	for(std::unordered_map<std::wstring, std::shared_ptr<Model>>::iterator it = models.begin(); it != models.end();)
+	{
+		if(it->second.use_count() == 1)
+		{
+			it = models.erase(it);
+			released++;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for(std::unordered_map<std::wstring, std::shared_ptr<Texture>>::iterator it = textures.begin(); it != textures.end();)
+	{
+		if(it->second.use_count() == 1)
+		{
+			it = textures.erase(it);
+			released++;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	stats.models = (unsigned int)models.size();
+	stats.textures = (unsigned int)textures.size();
+
+	return released;
+}
+
+/// <summary>
+/// Drop every cached reference, handles still held elsewhere stay valid and pending loads still finish when waited on
+/// </summary>
+void AssetCache::Clear()
+{
+	models.clear();
+	textures.clear();
+	pendingModels.clear();
+	pendingTextures.clear();
+	stats.models = 0;
+	stats.textures = 0;
+}
+
+void AssetCache::LogStats() const
+{
+	Logger::Log("Asset cache: models " + std::to_string(stats.models) + " (" + std::to_string(stats.modelHits) + " hits, " + std::to_string(stats.modelMisses) + " misses), textures " +
+		std::to_string(stats.textures) + " (" + std::to_string(stats.textureHits) + " hits, " + std::to_string(stats.textureMisses) + " misses)");
+}
+
+/// <summary>
+/// Cache key for a model, its options followed by the canonical path of its mesh and each of its textures
+/// </summary>
+/// <param name="options">Vertex format/texture set the model is loaded with</param>
+/// <param name="mesh">Mesh filepath, nullptr for the billboard</param>
+/// <param name="texture1">Texture filepath or nullptr</param>
+/// <param name="texture2">Texture filepath or nullptr</param>
+/// <param name="texture3">Texture filepath or nullptr</param>
+/// <returns></returns>
+std::wstring AssetCache::Key(const WCHAR *options, const WCHAR *mesh, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3) const
+{
+	const WCHAR *paths[] = { mesh, texture1, texture2, texture3 };
+	std::wstring key(options);
+
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		if(paths[i] != nullptr)
+		{
+			key += L'|';
+			key += Canonical(paths[i]);
+		}
+	}
+
+	return key;
+}
+
+/// <summary>
+/// Model loaded and ready to render, waiting for its load if it is still pending
+/// A model that failed is still handed out, as before, but dropped so the next request retries it
+/// </summary>
+std::shared_ptr<Model> AssetCache::Acquire(ID3D11Device *device, const WCHAR *options, const WCHAR *mesh, Model::MeshFormat format,
+	const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3)
+{
+	std::wstring key = Key(options, mesh, texture1, texture2, texture3);
+	std::shared_ptr<Model> model = RequestModel(device, key, mesh, format, texture1, texture2, texture3);
+
+	CompleteModel(key);
+
+	return model;
+}
+
+AssetLoader::Handle AssetCache::Prefetch(ID3D11Device *device, const WCHAR *options, const WCHAR *mesh, Model::MeshFormat format,
+	const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3)
+{
+	std::wstring key = Key(options, mesh, texture1, texture2, texture3);
+
+	RequestModel(device, key, mesh, format, texture1, texture2, texture3);
+
+	std::unordered_map<std::wstring, AssetLoader::Handle>::iterator it = pendingModels.find(key);
+
+	return (it != pendingModels.end()) ? it->second : nullptr;
+}
+
+/// <summary>
+/// Cached model, or a new one whose load is started: its textures are requested first so they read alongside the mesh,
+/// the mesh is read (parsed, welded, tangents generated) on a worker, and its finish creates the textures then the buffers
+/// </summary>
+/// <param name="device">Standard ID3D11Device, used when the load is waited on</param>
+/// <param name="key">Model key</param>
+/// <param name="mesh">Mesh filepath, nullptr for the billboard</param>
+/// <param name="format">Mesh vertex format</param>
+/// <param name="texture1">Texture filepath or nullptr</param>
+/// <param name="texture2">Texture filepath or nullptr</param>
+/// <param name="texture3">Texture filepath or nullptr</param>
+/// <returns></returns>
+std::shared_ptr<Model> AssetCache::RequestModel(ID3D11Device *device, const std::wstring &key, const WCHAR *mesh, Model::MeshFormat format, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3)
+{
+	std::unordered_map<std::wstring, std::shared_ptr<Model>>::iterator it = models.find(key);
+
+	if(it != models.end())
+	{
+		stats.modelHits++;
+		return it->second;
+	}
+
+	stats.modelMisses++;
+
+	std::shared_ptr<Model> model = std::make_shared<Model>();
+	const WCHAR *names[] = { texture1, texture2, texture3 };
+	std::vector<AssetLoader::Handle> textureJobs;
+
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		if(names[i] != nullptr)
+		{
+			AssetLoader::Handle job;
+			model->AddTexture(RequestTexture(device, names[i], job));
+			textureJobs.push_back(job);
+		}
+	}
+
+	std::wstring file = (mesh != nullptr) ? mesh : L"";
+	AssetLoader *waiter = loader;
+
+	std::function<bool()> work = [model, file, format]()
+	{
+		if(file.empty())
+		{
+			model->ReadBillboard();
+			return true;
+		}
+
+		return model->ReadMesh(file.c_str(), format);
+	};
+
+	//waiting on a texture already created returns its result straight away
+	std::function<bool()> finish = [model, device, textureJobs, waiter]()
+	{
+		bool result = true;
+
+		for(unsigned int i = 0; i < textureJobs.size(); i++)
+		{
+			if(textureJobs[i])
+			{
+				result = waiter->Wait(textureJobs[i]) && result;
+			}
+		}
+
+		return model->Create(device) && result;
+	};
+
+	models[key] = model;
+	pendingModels[key] = loader->Submit((mesh != nullptr) ? Name(mesh) : "billboard", work, finish);
+	stats.models = (unsigned int)models.size();
+
+	return model;
+}
+
+/// <summary>
+/// Cached texture, or a new one whose file read and header check is started on a worker
+/// </summary>
+/// <param name="device">Standard ID3D11Device, used when the load is waited on</param>
+/// <param name="filename">DDS filepath</param>
+/// <param name="job">Out, its load while pending, else null</param>
+/// <returns></returns>
+std::shared_ptr<Texture> AssetCache::RequestTexture(ID3D11Device *device, const WCHAR *filename, AssetLoader::Handle &job)
+{
+	std::wstring key = Canonical(filename);
+	std::unordered_map<std::wstring, AssetLoader::Handle>::iterator pending = pendingTextures.find(key);
+
+	//a load that already read its file is finished now, so one that failed is retried below instead of handed out
+	if(pending != pendingTextures.end() && loader->Ready(pending->second))
+	{
+		CompleteTexture(key);
+		pending = pendingTextures.end();
+	}
+
+	std::unordered_map<std::wstring, std::shared_ptr<Texture>>::iterator it = textures.find(key);
+
+	if(it != textures.end())
+	{
+		stats.textureHits++;
+		job = (pending != pendingTextures.end()) ? pending->second : nullptr;
+
+		return it->second;
+	}
+
+	stats.textureMisses++;
+
+	std::shared_ptr<Texture> texture = std::make_shared<Texture>();
+	std::wstring file(filename);
+
+	job = loader->Submit(Name(filename), [texture, file]() { return texture->Read(file); }, [texture, device]() { return texture->Create(device); });
+
+	textures[key] = texture;
+	pendingTextures[key] = job;
+	stats.textures = (unsigned int)textures.size();
+
+	return texture;
+}
+
+/// <summary>
+/// Wait on a pending model, dropping it from the cache if it failed
+/// </summary>
+/// <param name="key">Model key</param>
+/// <returns>false if it failed</returns>
+bool AssetCache::CompleteModel(const std::wstring &key)
+{
+	std::unordered_map<std::wstring, AssetLoader::Handle>::iterator it = pendingModels.find(key);
+
+	if(it == pendingModels.end())
+	{
+		return true;
+	}
+
+	AssetLoader::Handle job = it->second;
+	pendingModels.erase(it);
+
+	if(!loader->Wait(job))
+	{
+		models.erase(key);
+		stats.models = (unsigned int)models.size();
+
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Wait on a pending texture, dropping it from the cache if it failed
+/// </summary>
+/// <param name="key">Canonical texture path</param>
+/// <returns>false if it failed</returns>
+bool AssetCache::CompleteTexture(const std::wstring &key)
+{
+	std::unordered_map<std::wstring, AssetLoader::Handle>::iterator it = pendingTextures.find(key);
+
+	if(it == pendingTextures.end())
+	{
+		return true;
+	}
+
+	AssetLoader::Handle job = it->second;
+	pendingTextures.erase(it);
+
+	if(!loader->Wait(job))
+	{
+		textures.erase(key);
+		stats.textures = (unsigned int)textures.size();
+
+		return false;
+	}
+
+	return true;
+}
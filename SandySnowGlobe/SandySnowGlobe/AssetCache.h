@@ -0,0 +1,68 @@
+#pragma once
+#include <d3d11.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Model.h"
+#include "Texture.h"
+#include "AssetLoader.h"
+
+//Loads each model and texture once and hands out shared handles to it
+//Keyed by canonical path (absolute, lower case, backslashes) plus load options, so "Cactus.obj" and ".\cactus.obj" are one asset
+//A model's options are its vertex format and its textures, which it owns, the textures themselves are shared across models
+//Loads go through the AssetLoader: Prefetch* starts one and returns, Get* returns the asset once its device objects exist
+//A miss is a load started, a hit is a request served by an asset already loaded or loading
+//The cache holds a reference too, so an asset outlives its last user until Purge or the cache is deleted
+class AssetCache
+{
+public:
+	struct Statistics
+	{
+		unsigned int modelHits, modelMisses, models;
+		unsigned int textureHits, textureMisses, textures;
+	};
+
+	explicit AssetCache(AssetLoader *assetLoader);
+	~AssetCache();
+
+	std::shared_ptr<Model> GetModel(ID3D11Device *device, const WCHAR *filename);
+	std::shared_ptr<Model> GetModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *textureName);
+	std::shared_ptr<Model> GetModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture);
+	std::shared_ptr<Model> GetModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture);
+	std::shared_ptr<Model> GetBillboard(ID3D11Device *device, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3);
+	std::shared_ptr<Texture> GetTexture(ID3D11Device *device, const WCHAR *filename);
+
+	AssetLoader::Handle PrefetchModel(ID3D11Device *device, const WCHAR *filename);
+	AssetLoader::Handle PrefetchModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *textureName);
+	AssetLoader::Handle PrefetchModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture);
+	AssetLoader::Handle PrefetchModel(ID3D11Device *device, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture);
+	AssetLoader::Handle PrefetchBillboard(ID3D11Device *device, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3);
+
+	void Complete();
+	unsigned int Purge();
+	void Clear();
+
+	Statistics *Stats() { return &stats; }
+	void LogStats() const;
+
+private:
+	AssetCache& operator= (const AssetCache&);
+	AssetCache(const AssetCache&);
+
+	std::wstring Key(const WCHAR *options, const WCHAR *mesh, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3) const;
+	std::shared_ptr<Model> Acquire(ID3D11Device *device, const WCHAR *options, const WCHAR *mesh, Model::MeshFormat format,
+		const WCHAR *texture1 = nullptr, const WCHAR *texture2 = nullptr, const WCHAR *texture3 = nullptr);
+	AssetLoader::Handle Prefetch(ID3D11Device *device, const WCHAR *options, const WCHAR *mesh, Model::MeshFormat format,
+		const WCHAR *texture1 = nullptr, const WCHAR *texture2 = nullptr, const WCHAR *texture3 = nullptr);
+	std::shared_ptr<Model> RequestModel(ID3D11Device *device, const std::wstring &key, const WCHAR *mesh, Model::MeshFormat format, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3);
+	std::shared_ptr<Texture> RequestTexture(ID3D11Device *device, const WCHAR *filename, AssetLoader::Handle &job);
+	bool CompleteModel(const std::wstring &key);
+	bool CompleteTexture(const std::wstring &key);
+
+	AssetLoader *loader;
+	std::unordered_map<std::wstring, std::shared_ptr<Model>> models;
+	std::unordered_map<std::wstring, std::shared_ptr<Texture>> textures;
+	std::unordered_map<std::wstring, AssetLoader::Handle> pendingModels, pendingTextures;	//loads not waited on yet
+	Statistics stats;
+};
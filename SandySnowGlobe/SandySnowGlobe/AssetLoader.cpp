@@ -0,0 +1,311 @@
+#include "AssetLoader.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <chrono>
+#endif
+
+struct AssetLoader::Job
+{
+	std::string name;
+	std::function<bool()> work, finish;
+	bool started, worked, finished, result;
+	std::thread::id thread;
+	long long queued, workStart, workEnd, finishStart, finishEnd, blocked;
+};
+
+struct AssetLoader::Sync
+{
+	std::mutex mutex;
+	std::condition_variable worked;
+};
+
+namespace
+{
+	long long Now()
+	{
+#ifdef _WIN32
+		long long ticks;
+		QueryPerformanceCounter((LARGE_INTEGER*)&ticks);
+
+		return ticks;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/// <summary>
+	/// Run a job's work unless someone already took it
+	/// </summary>
+	/// <param name="sync">Loader's lock</param>
+	/// <param name="job">Job</param>
+	void RunWork(AssetLoader::Sync &sync, AssetLoader::Job &job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sync.mutex);
+
+			if(job.started)
+			{
+				return;
+			}
+
+			job.started = true;
+			job.thread = std::this_thread::get_id();
+			job.workStart = Now();
+		}
+
+		bool result = job.work();
+
+		{
+			std::lock_guard<std::mutex> lock(sync.mutex);
+			job.workEnd = Now();
+			job.result = result;
+			job.worked = true;
+		}
+
+		sync.worked.notify_all();
+	}
+
+	bool ByWorkStart(const AssetLoader::Handle &a, const AssetLoader::Handle &b)
+	{
+		return a->workStart < b->workStart;
+	}
+
+	std::string Format(const char *format, double a, double b, double c)
+	{
+		char line[128];
+		std::snprintf(line, sizeof(line), format, a, b, c);
+
+		return line;
+	}
+}
+
+AssetLoader::AssetLoader()
+{
+	workers = nullptr;
+	sync = std::make_shared<Sync>();
+	owner = std::this_thread::get_id();
+#ifdef _WIN32
+	QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+#else
+	frequency = 1000000000;
+#endif
+	start = Now();
+}
+
+/// <summary>
+/// Jobs still queued hold this loader, wait for their work before it goes
+/// Their finish is dropped, the device objects they would make are not wanted any more
+/// </summary>
+AssetLoader::~AssetLoader()
+{
+	std::unique_lock<std::mutex> lock(sync->mutex);
+
+	for(unsigned int i = 0; i < jobs.size(); i++)
+	{
+		jobs[i]->started = true;	//still queued, its pool job returns without working
+
+		while(jobs[i]->thread != std::thread::id() && !jobs[i]->worked)
+		{
+			sync->worked.wait(lock);
+		}
+	}
+}
+
+double AssetLoader::Milliseconds(long long ticks) const
+{
+	return (double)ticks * 1000.0 / (double)frequency;
+}
+
+/// <summary>
+/// Queue a load, its work starts on the pool straight away
+/// </summary>
+/// <param name="name">Name in the timeline</param>
+/// <param name="work">Runs on a worker, or on the owner if it waits before a worker takes it, false on failure</param>
+/// <param name="finish">Runs on the owner in Wait once work succeeded, nullptr for none, false on failure</param>
+/// <returns>Handle to Wait on</returns>
+AssetLoader::Handle AssetLoader::Submit(const std::string &name, const std::function<bool()> &work, const std::function<bool()> &finish)
+{
+	Handle job = std::make_shared<Job>();
+	job->name = name;
+	job->work = work;
+	job->finish = finish;
+	job->started = false;
+	job->worked = false;
+	job->finished = false;
+	job->result = false;
+	job->queued = Now();
+	job->workStart = 0;
+	job->workEnd = 0;
+	job->finishStart = 0;
+	job->finishEnd = 0;
+	job->blocked = 0;
+
+	jobs.push_back(job);
+
+	if(workers != nullptr && workers->ThreadCount() > 1)
+	{
+		std::shared_ptr<Sync> shared = sync;
+		workers->Run([shared, job]() { RunWork(*shared, *job); });
+	}
+
+	return job;
+}
+
+/// <summary>
+/// Block until a job's work is done, running it here if no worker has started it, then run its finish on this thread once
+/// </summary>
+/// <param name="job">Handle from Submit</param>
+/// <returns>false if its work or its finish failed</returns>
+bool AssetLoader::Wait(const Handle &job)
+{
+	if(!job)
+	{
+		return false;
+	}
+
+	RunWork(*sync, *job);
+
+	{
+		std::unique_lock<std::mutex> lock(sync->mutex);
+
+		if(!job->worked)
+		{
+			long long blockStart = Now();
+
+			while(!job->worked)
+			{
+				sync->worked.wait(lock);
+			}
+
+			job->blocked += Now() - blockStart;
+		}
+	}
+
+	if(!job->finished)
+	{
+		job->finished = true;
+		job->finishStart = Now();
+
+		if(job->result && job->finish)
+		{
+			job->result = job->finish();
+		}
+
+		job->finishEnd = Now();
+
+		//only the timings stay for Report, the closures let go of what they loaded
+		job->work = nullptr;
+		job->finish = nullptr;
+	}
+
+	return job->result;
+}
+
+/// <summary>
+/// Wait on every job submitted so far, in submission order
+/// </summary>
+/// <returns>false if any of them failed</returns>
+bool AssetLoader::WaitAll()
+{
+	bool result = true;
+
+	for(unsigned int i = 0; i < jobs.size(); i++)
+	{
+		result = Wait(jobs[i]) && result;
+	}
+
+	return result;
+}
+
+/// <summary>
+/// Whether Wait on a job would return without blocking
+/// </summary>
+bool AssetLoader::Ready(const Handle &job)
+{
+	std::lock_guard<std::mutex> lock(sync->mutex);
+
+	return job && job->worked;
+}
+
+/// <summary>
+/// Timestamp a point on the owner's side, e.g. "objects created", shown in the timeline
+/// </summary>
+void AssetLoader::Mark(const std::string &name)
+{
+	Event e = { name, Now() };
+	marks.push_back(e);
+}
+
+/// <summary>
+/// Startup timeline, every job's queue/work/finish spans in ms since the loader was made and the thread its work ran on,
+/// then the critical path: the jobs the owner blocked on, and how busy the workers were while it did
+/// </summary>
+/// <returns>Multi line report</returns>
+std::string AssetLoader::Report()
+{
+	std::lock_guard<std::mutex> lock(sync->mutex);
+
+	std::vector<Handle> sorted(jobs);
+	std::sort(sorted.begin(), sorted.end(), ByWorkStart);
+
+	std::vector<std::thread::id> threads;
+	threads.push_back(owner);
+
+	std::string report = "Load timeline (ms), " + std::to_string(jobs.size()) + " jobs\n";
+	long long end = start, busy = 0, blocked = 0;
+
+	for(unsigned int i = 0; i < sorted.size(); i++)
+	{
+		const Job &job = *sorted[i];
+
+		if(!job.finished)
+		{
+			report += "  " + job.name + ": not waited on\n";
+			continue;
+		}
+
+		unsigned int thread = (unsigned int)(std::find(threads.begin(), threads.end(), job.thread) - threads.begin());
+
+		if(thread == threads.size())
+		{
+			threads.push_back(job.thread);
+		}
+
+		report += "  " + job.name + ":" + Format(" queued %.2f, work %.2f-%.2f", Milliseconds(job.queued - start), Milliseconds(job.workStart - start), Milliseconds(job.workEnd - start)) +
+			((thread == 0) ? " on owner" : " on worker " + std::to_string(thread)) +
+			Format(", finish %.2f-%.2f", Milliseconds(job.finishStart - start), Milliseconds(job.finishEnd - start), 0.0) + "\n";
+
+		end = (std::max)(end, job.finishEnd);
+		busy += job.workEnd - job.workStart;
+		blocked += job.blocked;
+	}
+
+	for(unsigned int i = 0; i < marks.size(); i++)
+	{
+		report += "  mark " + marks[i].name + Format(": %.2f", Milliseconds(marks[i].time - start), 0.0, 0.0) + "\n";
+		end = (std::max)(end, marks[i].time);
+	}
+
+	//the owner creates every device object, so startup ends when it does; what it blocked on is what a faster load must shorten
+	report += "Critical path:" + Format(" %.2f ms total, owner blocked %.2f ms on", Milliseconds(end - start), Milliseconds(blocked), 0.0);
+
+	for(unsigned int i = 0; i < sorted.size(); i++)
+	{
+		if(sorted[i]->blocked > 0)
+		{
+			report += " " + sorted[i]->name + Format(" (%.2f)", Milliseconds(sorted[i]->blocked), 0.0, 0.0);
+		}
+	}
+
+	report += Format("\nWork: %.2f ms summed over %.0f threads, %.2f concurrent on average", Milliseconds(busy), (double)threads.size(),
+		(end > start) ? (double)busy / (double)(end - start) : 0.0);
+
+	return report;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+
+class WorkerPool;
+
+//Loads assets in two halves: work (file reads, parsing, anything without the device) runs as a job on the worker pool,
+//finish (device object creation) runs on the thread that owns the loader, when it Waits on the job
+//Submit, Wait and Report belong to the owning thread, work must not touch anything finish or the owner still uses
+//Every job is timed from submission, Report logs the startup timeline and what the owner was blocked on
+class AssetLoader
+{
+public:
+	struct Job;
+	struct Sync;
+	typedef std::shared_ptr<Job> Handle;
+
+	AssetLoader();
+	~AssetLoader();
+
+	//the pool work runs on, without one (or with no worker threads) work runs when it is waited on
+	WorkerPool *Workers() const { return workers; }
+	void Workers(WorkerPool *val) { workers = val; }
+
+	Handle Submit(const std::string &name, const std::function<bool()> &work, const std::function<bool()> &finish);
+	bool Wait(const Handle &job);
+	bool WaitAll();
+	bool Ready(const Handle &job);
+
+	void Mark(const std::string &name);
+	std::string Report();
+
+private:
+	AssetLoader& operator= (const AssetLoader&);
+	AssetLoader(const AssetLoader&);
+
+	struct Event
+	{
+		std::string name;
+		long long time;
+	};
+
+	double Milliseconds(long long ticks) const;
+
+	WorkerPool *workers;
+	std::vector<Handle> jobs;
+	std::vector<Event> marks;
+	std::shared_ptr<Sync> sync;	//shared with queued pool jobs, which may run after the loader is gone
+	std::thread::id owner;
+	long long start, frequency;
+};
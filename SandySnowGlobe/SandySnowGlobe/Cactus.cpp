@@ -1,6 +1,6 @@
 #include "Cactus.h"
 
-Cactus::Cactus(ID3D11Device *device, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture, Fire *fireSys, Shader *objectShader) : GameObject(device, filename, colourTexture, normalTexture, specularTexture, objectShader)
+Cactus::Cactus(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture, Fire *fireSys, Shader *objectShader) : GameObject(device, assets, filename, colourTexture, normalTexture, specularTexture, objectShader)
 {
 	fire = fireSys;
 	maxScale = 1.5f;
@@ -33,13 +33,13 @@ void Cactus::Update(ID3D11DeviceContext *devCon, float dt, bool prevSun)
 
 		if(prevSun && *sunny)	//if prev sunny && sunny, chance for ignition
 		{
-			if(((float)(rand()) / (float)(RAND_MAX)) <= 0.001f)
+			if(rng.Chance(0.001f))
 			{
 				fire->Active(true);
 			}
 			if(fire->Active())
 			{
-				if(((float)(rand()) / (float)(RAND_MAX)) <= 0.005f)
+				if(rng.Chance(0.005f))
 				{
 					fire->Grow(dt);	//if already on fire, chance for fire to grow
 				}
@@ -1,8 +1,16 @@
-cbuffer MatricesBuffer
+//Shader::ObjectBuffer, per draw
+cbuffer ObjectBuffer : register(b0)
 {
 	matrix worldMatrix;
+};
+
+//Shader::FrameBuffer, once a frame
+cbuffer FrameBuffer : register(b1)
+{
 	matrix viewMatrix;
 	matrix projMatrix;
+	float3 cameraPosition;
+	float padding;
 };
 
 struct VertexInputType
@@ -0,0 +1,112 @@
+#include "ConstantBlocks.h"
+#include <cstring>
+
+CountingConstantWriter::CountingConstantWriter()
+{
+	Reset();
+}
+
+bool CountingConstantWriter::Write(unsigned int block, const void *, unsigned int)
+{
+	if(block >= MAX_BLOCKS)
+	{
+		return false;
+	}
+
+	writes[block]++;
+
+	return true;
+}
+
+void CountingConstantWriter::Reset()
+{
+	std::memset(writes, 0, sizeof(writes));
+}
+
+unsigned int CountingConstantWriter::Writes(unsigned int block) const
+{
+	return (block < MAX_BLOCKS) ? writes[block] : 0;
+}
+
+unsigned int CountingConstantWriter::TotalWrites() const
+{
+	unsigned int total = 0;
+
+	for(unsigned int b = 0; b < MAX_BLOCKS; b++)
+	{
+		total += writes[b];
+	}
+
+	return total;
+}
+
+ConstantBlocks::ConstantBlocks()
+{
+	for(unsigned int b = 0; b < BLOCK_COUNT; b++)
+	{
+		dirty[b] = false;
+	}
+
+	uploads = 0;
+}
+
+/// <summary>
+/// Size a block, zero filled and dirty so its first Upload writes it whatever Set was given
+/// </summary>
+/// <param name="block">Block</param>
+/// <param name="bytes">Size of the constant buffer it mirrors</param>
+void ConstantBlocks::Init(Block block, unsigned int bytes)
+{
+	data[block].assign(bytes, 0);
+	dirty[block] = bytes > 0;
+}
+
+/// <summary>
+/// New contents for a block, marked dirty only if they differ from what it holds
+/// </summary>
+/// <param name="block">Block</param>
+/// <param name="data">As many bytes as the block was sized with</param>
+void ConstantBlocks::Set(Block block, const void *data)
+{
+	std::vector<unsigned char> &bytes = this->data[block];
+
+	if(bytes.empty() || std::memcmp(&bytes[0], data, bytes.size()) == 0)
+	{
+		return;
+	}
+
+	std::memcpy(&bytes[0], data, bytes.size());
+	dirty[block] = true;
+}
+
+/// <summary>
+/// Write a dirty block through writer, a clean one costs nothing
+/// </summary>
+/// <param name="block">Block</param>
+/// <param name="writer">Destination</param>
+/// <returns>false if the write failed, the block stays dirty and is tried again next time</returns>
+bool ConstantBlocks::Upload(Block block, ConstantWriter &writer)
+{
+	if(!dirty[block])
+	{
+		return true;
+	}
+
+	if(!writer.Write(block, &data[block][0], (unsigned int)data[block].size()))
+	{
+		return false;
+	}
+
+	dirty[block] = false;
+	uploads++;
+
+	return true;
+}
+
+void ConstantBlocks::Invalidate()
+{
+	for(unsigned int b = 0; b < BLOCK_COUNT; b++)
+	{
+		dirty[b] = !data[b].empty();
+	}
+}
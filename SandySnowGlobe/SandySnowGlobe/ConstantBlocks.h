@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+//Writes a block's bytes into its constant buffer, Shader maps the D3D buffer with WRITE_DISCARD, CountingConstantWriter stands in for the context
+class ConstantWriter
+{
+public:
+	virtual ~ConstantWriter() {}
+
+	virtual bool Write(unsigned int block, const void *data, unsigned int bytes) = 0;
+};
+
+//Device context stand-in, counts the writes per block
+class CountingConstantWriter : public ConstantWriter
+{
+public:
+	CountingConstantWriter();
+
+	bool Write(unsigned int block, const void *data, unsigned int bytes) override;
+
+	void Reset();
+	unsigned int Writes(unsigned int block) const;
+	unsigned int TotalWrites() const;
+
+private:
+	static const unsigned int MAX_BLOCKS = 8;
+
+	unsigned int writes[MAX_BLOCKS];
+};
+
+//CPU copies of a shader's constant buffers grouped by how often they change, no D3D dependency
+//Set compares against what was last uploaded and Upload only writes a block that differs, so frame and pass data
+//is mapped once however many objects are drawn with it and only the object block is mapped per draw
+class ConstantBlocks
+{
+public:
+	enum Block
+	{
+		BLOCK_FRAME,	//view, projection, camera
+		BLOCK_PASS,		//lights
+		BLOCK_OBJECT,	//world matrix
+		BLOCK_COUNT
+	};
+
+	ConstantBlocks();
+
+	void Init(Block block, unsigned int bytes);
+	void Set(Block block, const void *data);
+	bool Upload(Block block, ConstantWriter &writer);
+	void Invalidate();	//every block is written on its next Upload
+
+	bool Dirty(Block block) const { return dirty[block]; }
+	unsigned int Uploads() const { return uploads; }	//writes made, from construction
+
+private:
+	ConstantBlocks& operator= (const ConstantBlocks&);
+	ConstantBlocks(const ConstantBlocks&);
+
+	std::vector<unsigned char> data[BLOCK_COUNT];
+	bool dirty[BLOCK_COUNT];
+	unsigned int uploads;
+};
@@ -1,4 +1,5 @@
 #include "DXUtil.h"
+#include <mutex>
 
 namespace Validation
 {
@@ -35,6 +36,7 @@ namespace Logger
 	std::string date = "";
 	std::string currentTime = "";
 	std::ofstream fileStream;
+	std::mutex logMutex;	//assets load on worker threads and log as they go
 	bool initialised = false;
 
 	void InitLogFile(const std::string &folderPath)
@@ -84,6 +86,8 @@ namespace Logger
 	/// <param name="msg">Message to be logged</param>
 	void Log(const std::string &msg)
 	{
+		std::lock_guard<std::mutex> lock(logMutex);
+
 		if(initialised)
 		{
 			fileStream.open(filePath, std::ofstream::out | std::ofstream::app);
@@ -1,9 +1,13 @@
 #include "Fire.h"
 
-Fire::Fire(ID3D11Device *device, const WCHAR *colourTexture, const WCHAR *noiseTexture, const WCHAR *alphaTexture, ParticleSystem fireSys, Shader *objectShader) : GameObject(device, colourTexture, noiseTexture, alphaTexture, objectShader, true)
+/// <summary>
+/// Billboarded flame plus an emitter in the shared fire arena
+/// </summary>
+/// <param name="particleArena">Arena to emit sparks into, must outlive this, nullptr for no sparks</param>
+Fire::Fire(ID3D11Device *device, AssetCache *assets, const WCHAR *colourTexture, const WCHAR *noiseTexture, const WCHAR *alphaTexture, ParticleArena *particleArena, Shader *objectShader) : GameObject(device, assets, colourTexture, noiseTexture, alphaTexture, objectShader, true)
 {
-	//fireParticles = fireSys;
-	//fireParticles.Init(device, L"fire01.dds");
+	arena = particleArena;
+	emitter = (arena != nullptr) ? arena->AddEmitter(ParticleSim::PresetSettings(ParticleSim::FIRE)) : ParticleArena::INVALID_HANDLE;
 	scrollSpeeds = DirectX::XMFLOAT3(1.3f, 2.1f, 2.3f);
 	scales = DirectX::XMFLOAT3(1.0f, 2.0f, 3.0f);
 	distortion1 = DirectX::XMFLOAT2(0.1f, 0.2f);
@@ -18,6 +22,10 @@ Fire::Fire(ID3D11Device *device, const WCHAR *colourTexture, const WCHAR *noiseT
 
 Fire::~Fire()
 {
+	if(emitter != ParticleArena::INVALID_HANDLE)
+	{
+		arena->RemoveEmitter(emitter);
+	}
 }
 
 void Fire::Update(float dt)
@@ -30,6 +38,15 @@ void Fire::Update(float dt)
 			animTime = 0.0f;
 		}
 	}
+
+	//the arena steps every emitter at once, just keep this one's state current
+	if(emitter != ParticleArena::INVALID_HANDLE)
+	{
+		ParticleSim::Float3 origin = { position.x, position.y + posOffset * scale.y, position.z };
+
+		arena->Position(emitter, origin);
+		arena->Active(emitter, active);
+	}
 }
 
 void Fire::Render(ID3D11DeviceContext *devCon, const DirectX::XMFLOAT4X4 *wMatrix, DirectX::XMFLOAT4X4 *vMatrix, DirectX::XMFLOAT4X4 *pMatrix)
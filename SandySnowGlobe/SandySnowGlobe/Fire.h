@@ -1,12 +1,12 @@
 #pragma once
 #include "GameObject.h"
-#include "ParticleSystem.h"
+#include "ParticleArena.h"
 
 
 class Fire : public GameObject
 {
 public:
-	Fire(ID3D11Device *device, const WCHAR *colourTexture, const WCHAR *noiseTexture, const WCHAR *alphaTexture, ParticleSystem fireSys, Shader *objectShader);
+	Fire(ID3D11Device *device, AssetCache *assets, const WCHAR *colourTexture, const WCHAR *noiseTexture, const WCHAR *alphaTexture, ParticleArena *particleArena, Shader *objectShader);
 	~Fire();
 
 	void Update(float dt);
@@ -17,7 +17,8 @@ public:
 	void Active(bool val) { active = val; }
 	
 private:
-	ParticleSystem fireParticles;
+	ParticleArena *arena;
+	ParticleArena::Handle emitter;
 
 	DirectX::XMFLOAT3 scrollSpeeds, scales;
 	DirectX::XMFLOAT2 distortion1, distortion2, distortion3;
@@ -0,0 +1,166 @@
+#include "Frustum.h"
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define FRUSTUM_SSE2
+#include <emmintrin.h>
+#endif
+
+Frustum::Frustum()
+{
+	//no planes until Build, everything intersects
+	for(unsigned int i = 0; i < PLANE_COUNT; i++)
+	{
+		planes[i].x = 0.0f;
+		planes[i].y = 0.0f;
+		planes[i].z = 0.0f;
+		planes[i].w = 1.0f;
+	}
+}
+
+/// <summary>
+/// Extract the planes from the columns of a combined matrix, so points can be tested in whatever space it maps from
+/// </summary>
+/// <param name="viewProj">16 floats, row-major, e.g. &XMFLOAT4X4::m[0][0] of world * view * projection</param>
+void Frustum::Build(const float *viewProj)
+{
+	const float *m = viewProj;
+
+	for(unsigned int axis = 0; axis < 3; axis++)
+	{
+		//column axis against column 3, D3D near plane is z >= 0 so it has no w term
+		for(unsigned int side = 0; side < 2; side++)
+		{
+			Plane &p = planes[axis * 2 + side];
+			float sign = (side == 0) ? 1.0f : -1.0f;
+			float wScale = (axis == 2 && side == 0) ? 0.0f : 1.0f;
+
+			p.x = (m[0 + axis] * sign) + (m[3] * wScale);
+			p.y = (m[4 + axis] * sign) + (m[7] * wScale);
+			p.z = (m[8 + axis] * sign) + (m[11] * wScale);
+			p.w = (m[12 + axis] * sign) + (m[15] * wScale);
+
+			float length = std::sqrt((p.x * p.x) + (p.y * p.y) + (p.z * p.z));
+
+			if(length > 0.0f)
+			{
+				p.x /= length;
+				p.y /= length;
+				p.z /= length;
+				p.w /= length;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Conservative box test, false only when the box is fully outside at least one plane
+/// Boxes near a frustum corner can pass while still outside
+/// </summary>
+/// <param name="min">Box minimum, 3 floats</param>
+/// <param name="max">Box maximum, 3 floats</param>
+/// <returns></returns>
+bool Frustum::Intersects(const float *min, const float *max) const
+{
+	for(unsigned int i = 0; i < PLANE_COUNT; i++)
+	{
+		const Plane &p = planes[i];
+
+		//corner furthest along the plane normal
+		float x = (p.x >= 0.0f) ? max[0] : min[0];
+		float y = (p.y >= 0.0f) ? max[1] : min[1];
+		float z = (p.z >= 0.0f) ? max[2] : min[2];
+
+		if((x * p.x) + (y * p.y) + (z * p.z) + p.w < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Sphere test, false only when the sphere is fully outside at least one plane
+/// </summary>
+/// <param name="center">Sphere centre, 3 floats</param>
+/// <param name="radius">Sphere radius</param>
+/// <returns></returns>
+bool Frustum::Intersects(const float *center, float radius) const
+{
+	for(unsigned int i = 0; i < PLANE_COUNT; i++)
+	{
+		const Plane &p = planes[i];
+
+		if((center[0] * p.x) + (center[1] * p.y) + (center[2] * p.z) + p.w < -radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Sphere test over structure of arrays, four spheres against one plane per step, same results as Intersects(center, radius)
+/// </summary>
+/// <param name="x">Centre x of every sphere</param>
+/// <param name="y">Centre y</param>
+/// <param name="z">Centre z</param>
+/// <param name="radius">Radius</param>
+/// <param name="count">Spheres</param>
+/// <param name="visible">Out, count bytes</param>
+/// <returns>Visible spheres</returns>
+unsigned int Frustum::IntersectSpheres(const float *x, const float *y, const float *z, const float *radius, unsigned int count, unsigned char *visible) const
+{
+	unsigned int i = 0, visibleCount = 0;
+
+#ifdef FRUSTUM_SSE2
+	__m128 planeX[PLANE_COUNT], planeY[PLANE_COUNT], planeZ[PLANE_COUNT], planeW[PLANE_COUNT];
+
+	for(unsigned int j = 0; j < PLANE_COUNT; j++)
+	{
+		planeX[j] = _mm_set1_ps(planes[j].x);
+		planeY[j] = _mm_set1_ps(planes[j].y);
+		planeZ[j] = _mm_set1_ps(planes[j].z);
+		planeW[j] = _mm_set1_ps(planes[j].w);
+	}
+
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i);
+		__m128 py = _mm_loadu_ps(y + i);
+		__m128 pz = _mm_loadu_ps(z + i);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for(unsigned int j = 0; j < PLANE_COUNT; j++)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(px, planeX[j]), _mm_mul_ps(py, planeY[j]));
+
+			//summed in Intersects' order so both agree to the bit
+			distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(pz, planeZ[j])), planeW[j]);
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+
+		for(unsigned int k = 0; k < 4; k++)
+		{
+			visible[i + k] = (unsigned char)((mask >> k) & 1);
+			visibleCount += visible[i + k];
+		}
+	}
+#endif
+
+	for(; i < count; i++)
+	{
+		float center[3] = { x[i], y[i], z[i] };
+
+		visible[i] = Intersects(center, radius[i]) ? 1 : 0;
+		visibleCount += visible[i];
+	}
+
+	return visibleCount;
+}
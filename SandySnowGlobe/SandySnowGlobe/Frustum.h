@@ -0,0 +1,27 @@
+#pragma once
+
+//View frustum as six planes, device independent so the particle benchmark can use it too
+//Built from a row-major view * projection matrix in D3D clip space (row vectors, 0 <= z <= w)
+class Frustum
+{
+public:
+	Frustum();
+
+	void Build(const float *viewProj);
+	bool Intersects(const float *min, const float *max) const;
+	bool Intersects(const float *center, float radius) const;
+
+	//four spheres per plane test with SSE2, visible[i] is 1 or 0, returns how many are visible
+	unsigned int IntersectSpheres(const float *x, const float *y, const float *z, const float *radius, unsigned int count, unsigned char *visible) const;
+
+private:
+	//inside where x * px + y * py + z * pz + w >= 0, normalised so w is a distance for the sphere tests
+	struct Plane
+	{
+		float x, y, z, w;
+	};
+
+	static const unsigned int PLANE_COUNT = 6;
+
+	Plane planes[PLANE_COUNT];
+};
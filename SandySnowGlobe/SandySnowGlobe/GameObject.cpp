@@ -1,9 +1,12 @@
 #include "GameObject.h"
+#include <algorithm>
+#include <cmath>
 
-GameObject::GameObject(ID3D11Device *device, const WCHAR *filename, Shader *objectShader)
+float GameObject::lodScreenError = 0.002f;
+
+GameObject::GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, Shader *objectShader)
 {
-	model = new Model();
-	model->Init(device, filename);
+	model = assets->GetModel(device, filename);
 	shader = objectShader;
 
 	position = { 0, 0, 0 };
@@ -14,12 +17,12 @@ GameObject::GameObject(ID3D11Device *device, const WCHAR *filename, Shader *obje
 	pitch = 0.0f;
 	roll = 0.0f;
 	freeRotate = false;
+	visible = true;
 }
 
-GameObject::GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR *textureName, Shader *objectShader)
+GameObject::GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *textureName, Shader *objectShader)
 {
-	model = new Model();
-	model->Init(device, filename, textureName);
+	model = assets->GetModel(device, filename, textureName);
 	shader = objectShader;
 
 	position = { 0, 0, 0 };
@@ -30,13 +33,13 @@ GameObject::GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR
 	pitch = 0.0f;
 	roll = 0.0f;
 	freeRotate = false;
+	visible = true;
 }
 
 
-GameObject::GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture, Shader *objectShader)
+GameObject::GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture, Shader *objectShader)
 {
-	model = new Model();
-	model->Init(device, filename, skyTexture, gradientTexture);
+	model = assets->GetModel(device, filename, skyTexture, gradientTexture);
 	shader = objectShader;
 
 	position = { 0, 0, 0 };
@@ -47,12 +50,12 @@ GameObject::GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR
 	pitch = 0.0f;
 	roll = 0.0f;
 	freeRotate = false;
+	visible = true;
 }
 
-GameObject::GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture, Shader *objectShader)
+GameObject::GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture, Shader *objectShader)
 {
-	model = new Model();
-	model->Init(device, filename, colourTexture, normalTexture, specularTexture);
+	model = assets->GetModel(device, filename, colourTexture, normalTexture, specularTexture);
 	shader = objectShader;
 
 	position = { 0, 0, 0 };
@@ -63,12 +66,12 @@ GameObject::GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR
 	pitch = 0.0f;
 	roll = 0.0f;
 	freeRotate = false;
+	visible = true;
 }
 
-GameObject::GameObject(ID3D11Device *device, const WCHAR *colourTexture, const WCHAR *noiseTexture, const WCHAR *alphaTexture, Shader *objectShader, bool billboard)
+GameObject::GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *colourTexture, const WCHAR *noiseTexture, const WCHAR *alphaTexture, Shader *objectShader, bool billboard)
 {
-	model = new Model();
-	model->InitBillboared(device, colourTexture, noiseTexture, alphaTexture);
+	model = assets->GetBillboard(device, colourTexture, noiseTexture, alphaTexture);
 	shader = objectShader;
 
 	position = { 0, 0, 0 };
@@ -79,18 +82,11 @@ GameObject::GameObject(ID3D11Device *device, const WCHAR *colourTexture, const W
 	pitch = 0.0f;
 	roll = 0.0f;
 	freeRotate = false;
+	visible = true;
 }
 
 GameObject::~GameObject()
 {
-	try
-	{
-		Memory::SafeDelete(model);
-	}
-	catch(int &e)
-	{
-		delete model;
-	}
 }
 
 
@@ -111,35 +107,119 @@ void GameObject::Update(float dt)
 
 void GameObject::Render(ID3D11DeviceContext *devCon, const DirectX::XMFLOAT4X4 *wMatrix, DirectX::XMFLOAT4X4 *vMatrix, DirectX::XMFLOAT4X4 *pMatrix)
 {
-	DirectX::XMMATRIX m = DirectX::XMLoadFloat4x4(wMatrix);
-	m = DirectX::XMMatrixScalingFromVector(DirectX::XMLoadFloat3(&scale));
+	DirectX::XMFLOAT4X4 worldTemp = World();
+
+	unsigned int lod = SelectLod(worldTemp, vMatrix, pMatrix);
+
+	model->Render(devCon, lod);
+	shader->Render(devCon, model->LodIndexCount(lod), &worldTemp, vMatrix, pMatrix, model->GetTexture(0));
+}
+
+//Order: Scale -> Rotation -> Translation
+DirectX::XMFLOAT4X4 GameObject::World() const
+{
+	DirectX::XMMATRIX m = DirectX::XMMatrixScalingFromVector(DirectX::XMLoadFloat3(&scale));
 	m = DirectX::XMMatrixMultiply(m, DirectX::XMMatrixRotationRollPitchYaw(pitch, yaw, roll));
 	m = DirectX::XMMatrixMultiply(m, DirectX::XMMatrixTranslation(position.x, position.y, position.z));
-	DirectX::XMFLOAT4X4 worldTemp;
-	DirectX::XMStoreFloat4x4(&worldTemp, m);
 
-	model->Render(devCon);
-	shader->Render(devCon, model->IndexCount(), &worldTemp, vMatrix, pMatrix, model->GetTexture(0));
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMStoreFloat4x4(&world, m);
+
+	return world;
 }
 
-//Order: Scale -> Rotation -> Translation
 void GameObject::Render(ID3D11DeviceContext *devCon, const DirectX::XMFLOAT4X4 *wMatrix, DirectX::XMFLOAT4X4 *vMatrix, DirectX::XMFLOAT4X4 *pMatrix, DirectX::XMFLOAT3 cameraPosition,
 	DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[], DirectX::XMFLOAT4 specularColour[])
 {
-	DirectX::XMMATRIX m = DirectX::XMLoadFloat4x4(wMatrix);
-	m = DirectX::XMMatrixScalingFromVector(DirectX::XMLoadFloat3(&scale));
-	m = DirectX::XMMatrixMultiply(m, DirectX::XMMatrixRotationRollPitchYaw(pitch, yaw, roll));
-	m = DirectX::XMMatrixMultiply(m, DirectX::XMMatrixTranslation(position.x, position.y, position.z));
-	DirectX::XMFLOAT4X4 worldTemp;
-	DirectX::XMStoreFloat4x4(&worldTemp, m);
+	DirectX::XMFLOAT4X4 worldTemp = World();
 
-	model->Render(devCon);
+	unsigned int lod = SelectLod(worldTemp, vMatrix, pMatrix);
+
+	model->Render(devCon, lod);
 	if(model->TextureCount() == 1)
-		shader->Render(devCon, model->IndexCount(), &worldTemp, vMatrix, pMatrix, model->GetTexture(0), cameraPosition, diffuseColour, lightDirection, specularIntensity, specularColour);
+		shader->Render(devCon, model->LodIndexCount(lod), &worldTemp, vMatrix, pMatrix, model->GetTexture(0), cameraPosition, diffuseColour, lightDirection, specularIntensity, specularColour);
 	else if(model->TextureCount() == 3)
 	{
+		if(model->Format() == Model::MESH_BUMP_PACKED)
+		{
+			DirectX::XMFLOAT3 extent(model->BoundsMax().x - model->BoundsMin().x, model->BoundsMax().y - model->BoundsMin().y, model->BoundsMax().z - model->BoundsMin().z);
+			shader->SetMeshBounds(devCon, model->BoundsMin(), extent);
+		}
+
 		ID3D11ShaderResourceView **textureArray = nullptr;
-		shader->Render(devCon, model->IndexCount(), &worldTemp, vMatrix, pMatrix, model->GetTextureArray(textureArray), cameraPosition, diffuseColour, lightDirection, specularIntensity, specularColour);
+		shader->Render(devCon, model->LodIndexCount(lod), &worldTemp, vMatrix, pMatrix, model->GetTextureArray(textureArray), cameraPosition, diffuseColour, lightDirection, specularIntensity, specularColour);
 		delete textureArray;
 	}
-}
\ No newline at end of file
+}
+
+/// <summary>
+/// Coarsest LOD whose error, projected at the nearest point of the model's bounding sphere, stays under LodScreenError
+/// </summary>
+/// <param name="world">Object's world matrix</param>
+/// <param name="vMatrix">View matrix</param>
+/// <param name="pMatrix">Projection matrix, _22 is the cotangent of half the vertical field of view</param>
+/// <returns>LOD to render, 0 when the camera is inside the bounds</returns>
+unsigned int GameObject::SelectLod(const DirectX::XMFLOAT4X4 &world, const DirectX::XMFLOAT4X4 *vMatrix, const DirectX::XMFLOAT4X4 *pMatrix) const
+{
+	if(model->LodCount() < 2)
+	{
+		return 0;
+	}
+
+	DirectX::XMVECTOR low = DirectX::XMLoadFloat3(&model->BoundsMin());
+	DirectX::XMVECTOR high = DirectX::XMLoadFloat3(&model->BoundsMax());
+	DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(low, high), 0.5f);
+	float maxScale = (std::max)((std::max)(fabsf(scale.x), fabsf(scale.y)), fabsf(scale.z));	//parenthesized past windows.h's max macro
+	float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(high, center))) * maxScale;
+
+	center = DirectX::XMVector3TransformCoord(center, DirectX::XMLoadFloat4x4(&world));
+	center = DirectX::XMVector3TransformCoord(center, DirectX::XMLoadFloat4x4(vMatrix));
+
+	float depth = DirectX::XMVectorGetZ(center) - radius;
+
+	if(depth <= 0.0f)
+	{
+		return 0;
+	}
+
+	//world units per screen height at that depth is 2 * depth / _22
+	float toScreen = (maxScale * pMatrix->_22) / (2.0f * depth);
+	unsigned int lod = 0;
+
+	while(lod + 1 < model->LodCount() && model->LodError(lod + 1) * toScreen <= lodScreenError)
+	{
+		lod++;
+	}
+
+	return lod;
+}
+
+/// <summary>
+/// World space bounds of the model under this object's World matrix
+/// The box is the model's box transformed and re-fitted (Arvo), the sphere the model's sphere scaled by the largest axis scale
+/// </summary>
+/// <param name="center">Sphere and box centre</param>
+/// <param name="radius">Sphere radius</param>
+/// <param name="boundsMin">Box minimum</param>
+/// <param name="boundsMax">Box maximum</param>
+void GameObject::WorldBounds(DirectX::XMFLOAT3 &center, float &radius, DirectX::XMFLOAT3 &boundsMin, DirectX::XMFLOAT3 &boundsMax) const
+{
+	DirectX::XMFLOAT4X4 world = World();
+	DirectX::XMMATRIX m = DirectX::XMLoadFloat4x4(&world);
+
+	DirectX::XMVECTOR low = DirectX::XMLoadFloat3(&model->BoundsMin());
+	DirectX::XMVECTOR high = DirectX::XMLoadFloat3(&model->BoundsMax());
+	DirectX::XMVECTOR localCenter = DirectX::XMVectorScale(DirectX::XMVectorAdd(low, high), 0.5f);
+	DirectX::XMVECTOR localExtent = DirectX::XMVectorScale(DirectX::XMVectorSubtract(high, low), 0.5f);
+	DirectX::XMVECTOR worldCenter = DirectX::XMVector3TransformCoord(localCenter, m);
+
+	//each world axis gathers the local extents through the absolute rotation and scale
+	DirectX::XMVECTOR worldExtent = DirectX::XMVectorMultiply(DirectX::XMVectorAbs(m.r[0]), DirectX::XMVectorSplatX(localExtent));
+	worldExtent = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorAbs(m.r[1]), DirectX::XMVectorSplatY(localExtent), worldExtent);
+	worldExtent = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorAbs(m.r[2]), DirectX::XMVectorSplatZ(localExtent), worldExtent);
+
+	DirectX::XMStoreFloat3(&center, worldCenter);
+	DirectX::XMStoreFloat3(&boundsMin, DirectX::XMVectorSubtract(worldCenter, worldExtent));
+	DirectX::XMStoreFloat3(&boundsMax, DirectX::XMVectorAdd(worldCenter, worldExtent));
+	radius = model->BoundsRadius() * (std::max)((std::max)(fabsf(scale.x), fabsf(scale.y)), fabsf(scale.z));
+}
@@ -3,16 +3,17 @@
 #include "DirectXMath.h"
 #include "Shader.h"
 #include "Model.h"
+#include "AssetCache.h"
 #include "DXUtil.h"
 
 class GameObject
 {
 public:
-	GameObject(ID3D11Device *device, const WCHAR *filename, Shader *objectShader);
-	GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR *textureName, Shader *objectShader);
-	GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture, Shader *objectShader);
-	GameObject(ID3D11Device *device, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture, Shader *objectShader);
-	GameObject(ID3D11Device *device, const WCHAR *colourTexture, const WCHAR *noiseTexture, const WCHAR *alphaTexture, Shader *objectShader, bool billboarded);
+	GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, Shader *objectShader);
+	GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *textureName, Shader *objectShader);
+	GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture, Shader *objectShader);
+	GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture, Shader *objectShader);
+	GameObject(ID3D11Device *device, AssetCache *assets, const WCHAR *colourTexture, const WCHAR *noiseTexture, const WCHAR *alphaTexture, Shader *objectShader, bool billboarded);
 	virtual ~GameObject();
 
 	virtual void Update(float dt);
@@ -35,17 +36,34 @@ public:
 	bool FreeRotate() const { return freeRotate; }
 	void FreeRotate(const bool &val) { freeRotate = val; }
 
+	//set by SnowGlobe's culling pass each frame, hidden objects are skipped before any draw
+	bool Visible() const { return visible; }
+	void Visible(bool val) { visible = val; }
+
+	void WorldBounds(DirectX::XMFLOAT3 &center, float &radius, DirectX::XMFLOAT3 &boundsMin, DirectX::XMFLOAT3 &boundsMax) const;
+
+	//what Render draws with, for SnowGlobe's render queue to sort by and bind once
+	Shader *GetShader() const { return shader; }
+	Model *GetModel() const { return model.get(); }
+	DirectX::XMFLOAT4X4 World() const;
+	unsigned int SelectLod(const DirectX::XMFLOAT4X4 &world, const DirectX::XMFLOAT4X4 *vMatrix, const DirectX::XMFLOAT4X4 *pMatrix) const;
+
+	//largest error a LOD may show on screen, as a fraction of the screen's height, shared by every object
+	static float LodScreenError() { return lodScreenError; }
+	static void LodScreenError(float val) { lodScreenError = val; }
+
 protected:
 	Shader *shader;
-	Model *model;
+	std::shared_ptr<Model> model;	//shared with every object loaded from the same files
 
 	DirectX::XMFLOAT3 position, rotation, constantRotation, scale;
 	float pitch, yaw, roll;
-	bool freeRotate;
+	bool freeRotate, visible;
 
 private:
 	GameObject& operator= (const GameObject&);
 	GameObject(const GameObject&);
 
+	static float lodScreenError;
 };
 
@@ -0,0 +1,284 @@
+#include "HeightField.h"
+#include "ObjParser.h"
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define HEIGHT_FIELD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//tolerance so samples on a shared edge are not lost between two triangles
+	const float EDGE_EPSILON = 1e-4f;
+
+	inline float Min3(float a, float b, float c)
+	{
+		float m = (a < b) ? a : b;
+		return (m < c) ? m : c;
+	}
+
+	inline float Max3(float a, float b, float c)
+	{
+		float m = (a > b) ? a : b;
+		return (m > c) ? m : c;
+	}
+}
+
+HeightField::HeightField()
+{
+	originX = 0.0f;
+	originZ = 0.0f;
+	invCellX = 0.0f;
+	invCellZ = 0.0f;
+	cellX = 0.0f;
+	cellZ = 0.0f;
+	lastX = 0.0f;
+	lastZ = 0.0f;
+	maxHeight = -FLT_MAX;
+	samplesX = 0;
+	samplesZ = 0;
+	workers = nullptr;
+}
+
+HeightField::~HeightField()
+{
+}
+
+/// <summary>
+/// Allocate the grid, every sample starts at baseHeight
+/// </summary>
+/// <param name="minX">Grid start on x</param>
+/// <param name="minZ">Grid start on z</param>
+/// <param name="maxX">Grid end on x</param>
+/// <param name="maxZ">Grid end on z</param>
+/// <param name="sampleCountX">Samples along x, at least 2</param>
+/// <param name="sampleCountZ">Samples along z, at least 2</param>
+/// <param name="baseHeight">Height where no triangle covers a sample</param>
+/// <returns></returns>
+bool HeightField::Init(float minX, float minZ, float maxX, float maxZ, unsigned int sampleCountX, unsigned int sampleCountZ, float baseHeight)
+{
+	if(sampleCountX < 2 || sampleCountZ < 2 || !(maxX > minX) || !(maxZ > minZ))
+	{
+		return false;
+	}
+
+	samplesX = sampleCountX;
+	samplesZ = sampleCountZ;
+	originX = minX;
+	originZ = minZ;
+	cellX = (maxX - minX) / (float)(samplesX - 1);
+	cellZ = (maxZ - minZ) / (float)(samplesZ - 1);
+	invCellX = 1.0f / cellX;
+	invCellZ = 1.0f / cellZ;
+	lastX = (float)(samplesX - 1);
+	lastZ = (float)(samplesZ - 1);
+	maxHeight = baseHeight;
+
+	heights.assign(samplesX * samplesZ, baseHeight);
+
+	return true;
+}
+
+/// <summary>
+/// Rasterize the top surface of an OBJ mesh
+/// The mesh is placed like GameObject draws it: z flipped as Model loads it, then scaled, then offset (no rotation)
+/// </summary>
+/// <param name="filename">OBJ file</param>
+/// <param name="scale">Scale, 3 floats</param>
+/// <param name="offset">Position, 3 floats</param>
+/// <returns></returns>
+bool HeightField::AddMesh(const char *filename, const float *scale, const float *offset)
+{
+	ObjParser obj;
+	obj.Workers(workers);
+
+	if(!obj.Load(filename))
+	{
+		return false;
+	}
+
+	std::vector<float> vertices(obj.Positions());
+
+	for(unsigned int i = 0; i < vertices.size(); i += 3)
+	{
+		vertices[i] = (vertices[i] * scale[0]) + offset[0];
+		vertices[i + 1] = (vertices[i + 1] * scale[1]) + offset[1];
+		vertices[i + 2] = (vertices[i + 2] * scale[2]) + offset[2];
+	}
+
+	//winding does not matter for a height
+	const std::vector<ObjParser::Corner> &corners = obj.Corners();
+
+	for(unsigned int i = 0; i < corners.size(); i += 3)
+	{
+		AddTriangle(&vertices[corners[i].position * 3], &vertices[corners[i + 1].position * 3], &vertices[corners[i + 2].position * 3]);
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Raise every sample under the triangle's XZ footprint to the triangle's height there
+/// Near vertical triangles have no footprint and are skipped
+/// </summary>
+/// <param name="a">Vertex, 3 floats</param>
+/// <param name="b">Vertex, 3 floats</param>
+/// <param name="c">Vertex, 3 floats</param>
+void HeightField::AddTriangle(const float *a, const float *b, const float *c)
+{
+	float area = ((b[0] - a[0]) * (c[2] - a[2])) - ((c[0] - a[0]) * (b[2] - a[2]));
+
+	if(heights.empty() || std::fabs(area) < FLT_EPSILON)
+	{
+		return;
+	}
+
+	float minX = Min3(a[0], b[0], c[0]);
+	float maxX = Max3(a[0], b[0], c[0]);
+	float minZ = Min3(a[2], b[2], c[2]);
+	float maxZ = Max3(a[2], b[2], c[2]);
+
+	//sample index range covering the footprint, clamped to the grid
+	float fx0 = std::ceil((minX - originX) * invCellX);
+	float fx1 = std::floor((maxX - originX) * invCellX);
+	float fz0 = std::ceil((minZ - originZ) * invCellZ);
+	float fz1 = std::floor((maxZ - originZ) * invCellZ);
+
+	if(fx1 < 0.0f || fz1 < 0.0f || fx0 > lastX || fz0 > lastZ)
+	{
+		return;
+	}
+
+	unsigned int x0 = (fx0 > 0.0f) ? (unsigned int)fx0 : 0;
+	unsigned int z0 = (fz0 > 0.0f) ? (unsigned int)fz0 : 0;
+	unsigned int x1 = (fx1 < lastX) ? (unsigned int)fx1 : samplesX - 1;
+	unsigned int z1 = (fz1 < lastZ) ? (unsigned int)fz1 : samplesZ - 1;
+	float invArea = 1.0f / area;
+
+	for(unsigned int iz = z0; iz <= z1; iz++)
+	{
+		float pz = originZ + ((float)iz * cellZ);
+
+		for(unsigned int ix = x0; ix <= x1; ix++)
+		{
+			float px = originX + ((float)ix * cellX);
+
+			//barycentric weights from the signed areas opposite each vertex
+			float wa = (((b[0] - px) * (c[2] - pz)) - ((c[0] - px) * (b[2] - pz))) * invArea;
+			float wb = (((c[0] - px) * (a[2] - pz)) - ((a[0] - px) * (c[2] - pz))) * invArea;
+			float wc = 1.0f - wa - wb;
+
+			if(wa < -EDGE_EPSILON || wb < -EDGE_EPSILON || wc < -EDGE_EPSILON)
+			{
+				continue;
+			}
+
+			float y = (wa * a[1]) + (wb * b[1]) + (wc * c[1]);
+			float &sample = heights[(iz * samplesX) + ix];
+
+			if(y > sample)
+			{
+				sample = y;
+				maxHeight = (y > maxHeight) ? y : maxHeight;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Bilinear ground height under one point
+/// </summary>
+/// <param name="x">World x</param>
+/// <param name="z">World z</param>
+/// <returns></returns>
+float HeightField::Height(float x, float z) const
+{
+	if(heights.empty())
+	{
+		return -FLT_MAX;
+	}
+
+	float fx = (x - originX) * invCellX;
+	float fz = (z - originZ) * invCellZ;
+
+	//clamps as selects to match Height4, the cell index stops one short of the last sample
+	fx = (fx > 0.0f) ? fx : 0.0f;
+	fx = (fx < lastX) ? fx : lastX;
+	fz = (fz > 0.0f) ? fz : 0.0f;
+	fz = (fz < lastZ) ? fz : lastZ;
+
+	float cx = (fx < lastX - 1.0f) ? fx : lastX - 1.0f;
+	float cz = (fz < lastZ - 1.0f) ? fz : lastZ - 1.0f;
+	int ix = (int)cx;
+	int iz = (int)cz;
+	float tx = fx - (float)ix;
+	float tz = fz - (float)iz;
+
+	const float *row0 = &heights[(iz * samplesX) + ix];
+	const float *row1 = row0 + samplesX;
+
+	float h0 = row0[0] + ((row0[1] - row0[0]) * tx);
+	float h1 = row1[0] + ((row1[1] - row1[0]) * tx);
+
+	return h0 + ((h1 - h0) * tz);
+}
+
+/// <summary>
+/// Height for four points at once, the grid math is 4-wide with SSE2 and matches Height exactly
+/// </summary>
+/// <param name="x">World x, 4 floats</param>
+/// <param name="z">World z, 4 floats</param>
+/// <param name="out">Heights, 4 floats</param>
+void HeightField::Height4(const float *x, const float *z, float *out) const
+{
+#ifdef HEIGHT_FIELD_SSE2
+	if(heights.empty())
+	{
+		out[0] = out[1] = out[2] = out[3] = -FLT_MAX;
+		return;
+	}
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 fx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x), _mm_set1_ps(originX)), _mm_set1_ps(invCellX));
+	__m128 fz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(z), _mm_set1_ps(originZ)), _mm_set1_ps(invCellZ));
+
+	fx = _mm_min_ps(_mm_max_ps(fx, zero), _mm_set1_ps(lastX));
+	fz = _mm_min_ps(_mm_max_ps(fz, zero), _mm_set1_ps(lastZ));
+
+	__m128i ix = _mm_cvttps_epi32(_mm_min_ps(fx, _mm_set1_ps(lastX - 1.0f)));
+	__m128i iz = _mm_cvttps_epi32(_mm_min_ps(fz, _mm_set1_ps(lastZ - 1.0f)));
+	__m128 tx = _mm_sub_ps(fx, _mm_cvtepi32_ps(ix));
+	__m128 tz = _mm_sub_ps(fz, _mm_cvtepi32_ps(iz));
+
+	//SSE2 has no gather, fetch the four corners of each cell by hand
+	int column[4], row[4];
+	float h00[4], h10[4], h01[4], h11[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(column), ix);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(row), iz);
+
+	for(unsigned int lane = 0; lane < 4; lane++)
+	{
+		const float *row0 = &heights[(row[lane] * samplesX) + column[lane]];
+		const float *row1 = row0 + samplesX;
+
+		h00[lane] = row0[0];
+		h10[lane] = row0[1];
+		h01[lane] = row1[0];
+		h11[lane] = row1[1];
+	}
+
+	__m128 r0 = _mm_loadu_ps(h00);
+	__m128 r1 = _mm_loadu_ps(h01);
+	__m128 h0 = _mm_add_ps(r0, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(h10), r0), tx));
+	__m128 h1 = _mm_add_ps(r1, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(h11), r1), tx));
+
+	_mm_storeu_ps(out, _mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), tz)));
+#else
+	for(unsigned int lane = 0; lane < 4; lane++)
+	{
+		out[lane] = Height(x[lane], z[lane]);
+	}
+#endif
+}
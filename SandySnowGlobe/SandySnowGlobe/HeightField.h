@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+class WorkerPool;
+
+//Grid of ground heights over the XZ plane, rasterized once from meshes at load
+//Lookups are O(1) bilinear, positions outside the grid clamp to the nearest edge
+class HeightField
+{
+public:
+	HeightField();
+	~HeightField();
+
+	bool Init(float minX, float minZ, float maxX, float maxZ, unsigned int samplesX, unsigned int samplesZ, float baseHeight);
+	bool AddMesh(const char *filename, const float *scale, const float *offset);
+	void AddTriangle(const float *a, const float *b, const float *c);
+
+	float Height(float x, float z) const;
+	void Height4(const float *x, const float *z, float *out) const;
+
+	float MaxHeight() const { return maxHeight; }
+	unsigned int SamplesX() const { return samplesX; }
+	unsigned int SamplesZ() const { return samplesZ; }
+
+	WorkerPool *Workers() const { return workers; }	//parses large meshes in AddMesh
+	void Workers(WorkerPool *val) { workers = val; }
+
+private:
+	HeightField& operator= (const HeightField&);
+	HeightField(const HeightField&);
+
+	WorkerPool *workers;
+	std::vector<float> heights;
+	float originX, originZ, invCellX, invCellZ, cellX, cellZ;
+	float lastX, lastZ;		//highest sample index as a float, for clamping
+	float maxHeight;
+	unsigned int samplesX, samplesZ;
+};
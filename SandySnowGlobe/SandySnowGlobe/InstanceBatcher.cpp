@@ -0,0 +1,131 @@
+#include "InstanceBatcher.h"
+
+namespace
+{
+	/// <summary>
+	/// End of the run starting at first, items agreeing with their neighbour on every key field down to the mesh
+	/// </summary>
+	unsigned int RunEnd(const RenderQueue::Item *items, unsigned int count, unsigned int first)
+	{
+		unsigned int end = first + 1;
+
+		while(end < count && RenderQueue::SamePrefix(items[end - 1].key, items[end].key, RenderQueue::FIELD_MESH))
+		{
+			end++;
+		}
+
+		return end;
+	}
+}
+
+bool RecordingDrawTarget::Instanced(const RenderQueue::Item &)
+{
+	return instanced;
+}
+
+void RecordingDrawTarget::Draw(const RenderQueue::Item &item)
+{
+	Call call = { item.payload, 0, 0 };
+	calls.push_back(call);
+}
+
+void RecordingDrawTarget::DrawInstanced(const RenderQueue::Item &first, unsigned int instanceCount, unsigned int instanceOffset)
+{
+	Call call = { first.payload, instanceCount, instanceOffset };
+	calls.push_back(call);
+}
+
+namespace InstanceBatcher
+{
+	/// <summary>
+	/// Keep the columns of world that carry anything, the fourth is always 0, 0, 0, 1 for an object transform
+	/// </summary>
+	/// <param name="world">16 row-major floats</param>
+	/// <param name="out">Packed transform</param>
+	void Pack(const float *world, Transform &out)
+	{
+		for(unsigned int c = 0; c < 3; c++)
+		{
+			for(unsigned int r = 0; r < 4; r++)
+			{
+				out.columns[c][r] = world[(r * 4) + c];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Draw a sorted queue through target, runs of at least MIN_INSTANCES the target can instance become one DrawInstanced each
+	/// Every run's transforms go into a single sink allocation first, if that fails the whole queue is drawn item by item
+	/// </summary>
+	/// <param name="items">Sorted queue items</param>
+	/// <param name="count">Items</param>
+	/// <param name="layout">Where each payload's world matrix is</param>
+	/// <param name="sink">Destination for the transforms</param>
+	/// <param name="target">Receives the draws in queue order</param>
+	/// <param name="stats">Calls made</param>
+	void Submit(const RenderQueue::Item *items, unsigned int count, const Layout &layout, InstanceSink &sink, DrawTarget &target, Stats &stats)
+	{
+		const unsigned char *records = static_cast<const unsigned char *>(layout.records);
+		unsigned int instances = 0;
+
+		stats.draws = 0;
+		stats.instancedDraws = 0;
+		stats.instances = 0;
+
+		for(unsigned int first = 0, end = 0; first < count; first = end)
+		{
+			end = RunEnd(items, count, first);
+
+			if(end - first >= MIN_INSTANCES && target.Instanced(items[first]))
+			{
+				instances += end - first;
+			}
+		}
+
+		InstanceSink::Allocation allocation;
+		bool packed = instances > 0 && sink.Begin(instances * sizeof(Transform), allocation);
+
+		if(packed)
+		{
+			Transform *out = static_cast<Transform *>(allocation.data);
+
+			for(unsigned int first = 0, end = 0; first < count; first = end)
+			{
+				end = RunEnd(items, count, first);
+
+				if(end - first >= MIN_INSTANCES && target.Instanced(items[first]))
+				{
+					for(unsigned int i = first; i < end; i++)
+					{
+						Pack(reinterpret_cast<const float *>(records + (items[i].payload * layout.stride) + layout.world), *out++);
+					}
+				}
+			}
+
+			sink.End();
+		}
+
+		unsigned int offset = packed ? allocation.offset : 0;
+
+		for(unsigned int first = 0, end = 0; first < count; first = end)
+		{
+			end = RunEnd(items, count, first);
+
+			if(packed && end - first >= MIN_INSTANCES && target.Instanced(items[first]))
+			{
+				target.DrawInstanced(items[first], end - first, offset);
+				offset += (end - first) * sizeof(Transform);
+				stats.instancedDraws++;
+				stats.instances += end - first;
+				stats.draws++;
+				continue;
+			}
+
+			for(unsigned int i = first; i < end; i++)
+			{
+				target.Draw(items[i]);
+				stats.draws++;
+			}
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include "RenderQueue.h"
+#include "InstanceSink.h"
+
+//Receives the draws of a sorted RenderQueue, SnowGlobe issues them to the device context, RecordingDrawTarget keeps them for checking
+class DrawTarget
+{
+public:
+	virtual ~DrawTarget() {}
+
+	virtual bool Instanced(const RenderQueue::Item &item) = 0;	//whether the item's shader has an instanced path
+	virtual void Draw(const RenderQueue::Item &item) = 0;
+	virtual void DrawInstanced(const RenderQueue::Item &first, unsigned int instanceCount, unsigned int instanceOffset) = 0;	//byte offset in the sink
+};
+
+//Device context stand-in, records every call in order
+class RecordingDrawTarget : public DrawTarget
+{
+public:
+	struct Call
+	{
+		unsigned int payload;			//first item's
+		unsigned int instanceCount;		//0 for a plain Draw
+		unsigned int instanceOffset;
+	};
+
+	explicit RecordingDrawTarget(bool instanced) : instanced(instanced) {}
+
+	bool Instanced(const RenderQueue::Item &item) override;
+	void Draw(const RenderQueue::Item &item) override;
+	void DrawInstanced(const RenderQueue::Item &first, unsigned int instanceCount, unsigned int instanceOffset) override;
+
+	void Clear() { calls.clear(); }
+	const std::vector<Call> &Calls() const { return calls; }
+
+private:
+	std::vector<Call> calls;
+	bool instanced;
+};
+
+//Turns runs of a sorted RenderQueue that share shader, textures and mesh into instanced draws, no D3D dependency
+//A run's world matrices are packed into one InstanceSink allocation for the whole queue, written before any draw is issued
+namespace InstanceBatcher
+{
+	//3 x R32G32B32A32_FLOAT, the first three columns of a row vector world matrix, position dotted with each is the world position
+	struct Transform
+	{
+		float columns[3][4];
+	};
+
+	//where the caller's draw records keep their world matrix, 16 row-major floats
+	struct Layout
+	{
+		const void *records;		//indexed by item payload
+		unsigned int stride;
+		unsigned int world;			//byte offset in a record
+	};
+
+	struct Stats
+	{
+		unsigned int draws, instancedDraws, instances;
+	};
+
+	const unsigned int MIN_INSTANCES = 2;	//shorter runs are drawn item by item
+
+	void Pack(const float *world, Transform &out);
+	void Submit(const RenderQueue::Item *items, unsigned int count, const Layout &layout, InstanceSink &sink, DrawTarget &target, Stats &stats);
+}
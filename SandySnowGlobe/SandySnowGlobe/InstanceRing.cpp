@@ -0,0 +1,100 @@
+#include "InstanceRing.h"
+#include "DXUtil.h"
+
+InstanceRing::InstanceRing()
+{
+	buffer = nullptr;
+	context = nullptr;
+	mapped = false;
+}
+
+InstanceRing::~InstanceRing()
+{
+	if(mapped)
+	{
+		End();
+	}
+}
+
+/// <summary>
+/// Create the dynamic buffer
+/// </summary>
+/// <param name="dev">Standard ID3D11Device</param>
+/// <param name="devCon">Context used for Map/Unmap</param>
+/// <param name="capacityBytes">Buffer size, room for a couple of frames avoids a DISCARD every frame</param>
+/// <returns></returns>
+bool InstanceRing::Init(ID3D11Device *dev, ID3D11DeviceContext *devCon, unsigned int capacityBytes)
+{
+	D3D11_BUFFER_DESC desc;
+
+	unsigned int capacity = (capacityBytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	context = devCon;
+
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	desc.ByteWidth = capacity;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+
+	HRESULT result = dev->CreateBuffer(&desc, nullptr, buffer.GetAddressOf());
+
+	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create instance ring buffer"))
+	{
+		return false;
+	}
+
+	ring.Init(capacity);	//first frame discards, the buffer starts with undefined contents
+
+	return true;
+}
+
+/// <summary>
+/// Start a frame, call once before any writer's Begin, the ring only goes back to 0 (and discards) here
+/// </summary>
+/// <param name="frameBytes">Most the frame's writers can ask for together, plus ALIGNMENT per writer</param>
+/// <returns>False if frameBytes is more than the ring holds</returns>
+bool InstanceRing::BeginFrame(unsigned int frameBytes)
+{
+	return ring.BeginFrame(frameBytes);
+}
+
+/// <summary>
+/// Map the next aligned block of the frame, DISCARD for the first block after BeginFrame rewound, else NO_OVERWRITE
+/// </summary>
+/// <param name="bytes">Bytes to write</param>
+/// <param name="allocation">Write pointer and byte offset to bind the buffer at</param>
+/// <returns>False if the frame ran past the size given to BeginFrame or Map failed</returns>
+bool InstanceRing::Begin(unsigned int bytes, Allocation &allocation)
+{
+	unsigned int offset;
+	bool discard;
+
+	if(mapped || !ring.Allocate(bytes, offset, discard))
+	{
+		return false;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE resource;
+	HRESULT result = context->Map(buffer.Get(), 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &resource);
+
+	if(result != S_OK)
+	{
+		return false;
+	}
+
+	allocation.data = static_cast<unsigned char *>(resource.pData) + offset;
+	allocation.offset = offset;
+	mapped = true;
+
+	return true;
+}
+
+void InstanceRing::End()
+{
+	if(mapped)
+	{
+		context->Unmap(buffer.Get(), 0);
+		mapped = false;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl.h>
+#include "InstanceSink.h"
+
+//Dynamic vertex buffer sub-allocated as a ring, several systems can append to it each frame
+//Appends map with NO_OVERWRITE, BeginFrame restarts at 0 when the frame's worst case does not fit and the next append maps with DISCARD
+class InstanceRing : public InstanceSink
+{
+public:
+	InstanceRing();
+	~InstanceRing();
+
+	bool Init(ID3D11Device *dev, ID3D11DeviceContext *devCon, unsigned int capacityBytes);
+
+	bool BeginFrame(unsigned int frameBytes);
+	bool Begin(unsigned int bytes, Allocation &allocation) override;
+	void End() override;
+
+	ID3D11Buffer *Buffer() const { return buffer.Get(); }
+	unsigned int Capacity() const { return ring.Capacity(); }
+	unsigned int Discards() const { return ring.Discards(); }
+
+private:
+	InstanceRing& operator= (const InstanceRing&);
+	InstanceRing(const InstanceRing&);
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	RingAllocator ring;
+	bool mapped;
+};
@@ -0,0 +1,135 @@
+#include "InstanceSink.h"
+#include <cstring>
+
+MemoryInstanceSink::MemoryInstanceSink(unsigned int capacityBytes) : memory(capacityBytes)
+{
+	used = 0;
+	open = false;
+}
+
+/// <summary>
+/// Carve the next aligned block out of the memory, fails once it is full
+/// </summary>
+/// <param name="bytes">Bytes to write</param>
+/// <param name="allocation">Write pointer and offset</param>
+/// <returns></returns>
+bool MemoryInstanceSink::Begin(unsigned int bytes, Allocation &allocation)
+{
+	unsigned int offset = (used + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	if(open || bytes == 0 || offset + bytes > memory.size())
+	{
+		return false;
+	}
+
+	allocation.data = &memory[offset];
+	allocation.offset = offset;
+	used = offset + bytes;
+	open = true;
+
+	return true;
+}
+
+void MemoryInstanceSink::End()
+{
+	open = false;
+}
+
+RingAllocator::RingAllocator()
+{
+	capacity = 0;
+	head = 0;
+	discards = 0;
+	rewound = false;
+}
+
+/// <summary>
+/// Size the ring, the first frame starts at 0 with a discard since the buffer contents are undefined
+/// </summary>
+/// <param name="capacityBytes">Ring size, a multiple of InstanceSink::ALIGNMENT</param>
+void RingAllocator::Init(unsigned int capacityBytes)
+{
+	capacity = capacityBytes;
+	head = capacity;
+	rewound = false;
+}
+
+/// <summary>
+/// Start a frame, rewinding to 0 if its worst case does not fit in what is left after the last frame
+/// </summary>
+/// <param name="frameBytes">Most the frame's writers can ask for together, alignment padding included</param>
+/// <returns>False if frameBytes can never fit</returns>
+bool RingAllocator::BeginFrame(unsigned int frameBytes)
+{
+	if(frameBytes > capacity)
+	{
+		return false;
+	}
+
+	unsigned int offset = (head + InstanceSink::ALIGNMENT - 1) & ~(InstanceSink::ALIGNMENT - 1);
+
+	if(offset > capacity || frameBytes > capacity - offset)
+	{
+		head = 0;
+		rewound = true;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Next aligned block of the frame
+/// </summary>
+/// <param name="bytes">Bytes to write</param>
+/// <param name="offset">Byte offset of the block</param>
+/// <param name="discard">Map with DISCARD, else NO_OVERWRITE</param>
+/// <returns>False if the block does not fit before the end of the ring, which only a frame past its worst case hits</returns>
+bool RingAllocator::Allocate(unsigned int bytes, unsigned int &offset, bool &discard)
+{
+	offset = (head + InstanceSink::ALIGNMENT - 1) & ~(InstanceSink::ALIGNMENT - 1);
+
+	if(bytes == 0 || offset > capacity || bytes > capacity - offset)
+	{
+		return false;
+	}
+
+	discard = rewound;
+	discards += rewound ? 1 : 0;
+	rewound = false;
+	head = offset + bytes;
+
+	return true;
+}
+
+MemoryInstanceRing::MemoryInstanceRing(unsigned int capacityBytes) : memory((capacityBytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1), GARBAGE)
+{
+	ring.Init((unsigned int)memory.size());
+	open = false;
+}
+
+bool MemoryInstanceRing::Begin(unsigned int bytes, Allocation &allocation)
+{
+	unsigned int offset;
+	bool discard;
+
+	if(open || !ring.Allocate(bytes, offset, discard))
+	{
+		return false;
+	}
+
+	if(discard)
+	{
+		std::memset(&memory[0], GARBAGE, memory.size());
+	}
+
+	allocation.data = &memory[offset];
+	allocation.offset = offset;
+	open = true;
+
+	return true;
+}
+
+void MemoryInstanceRing::End()
+{
+	open = false;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+//Destination for per-frame instance data
+//Begin hands out memory to write straight into, End publishes it
+class InstanceSink
+{
+public:
+	struct Allocation
+	{
+		void *data;				//bytes requested in Begin, write only
+		unsigned int offset;	//byte offset of data in the backing buffer
+	};
+
+	virtual ~InstanceSink() {}
+
+	virtual bool Begin(unsigned int bytes, Allocation &allocation) = 0;
+	virtual void End() = 0;
+
+	static const unsigned int ALIGNMENT = 16;	//allocation offsets are multiples of this
+};
+
+//Plain memory stand-in, runs the upload path without a device
+class MemoryInstanceSink : public InstanceSink
+{
+public:
+	explicit MemoryInstanceSink(unsigned int capacityBytes);
+
+	bool Begin(unsigned int bytes, Allocation &allocation) override;
+	void End() override;
+
+	void Reset() { used = 0; }
+	const unsigned char *Data() const { return memory.empty() ? nullptr : &memory[0]; }
+	unsigned int Used() const { return used; }
+
+private:
+	std::vector<unsigned char> memory;
+	unsigned int used;
+	bool open;
+};
+
+//Offsets of a ring shared by several writers a frame, no D3D dependency
+//It only rewinds in BeginFrame, never between two writers of one frame, so nothing written earlier in the frame is discarded
+//before it is drawn, a frame that runs past its worst case fails instead
+class RingAllocator
+{
+public:
+	RingAllocator();
+
+	void Init(unsigned int capacityBytes);
+	bool BeginFrame(unsigned int frameBytes);
+	bool Allocate(unsigned int bytes, unsigned int &offset, bool &discard);
+
+	unsigned int Capacity() const { return capacity; }
+	unsigned int Discards() const { return discards; }
+
+private:
+	unsigned int capacity, head, discards;
+	bool rewound;	//BeginFrame went back to 0, the frame's first Allocate discards
+};
+
+//Plain memory stand-in for InstanceRing, a discard fills the memory with garbage as the driver may
+class MemoryInstanceRing : public InstanceSink
+{
+public:
+	explicit MemoryInstanceRing(unsigned int capacityBytes);
+
+	bool BeginFrame(unsigned int frameBytes) { return ring.BeginFrame(frameBytes); }
+	bool Begin(unsigned int bytes, Allocation &allocation) override;
+	void End() override;
+
+	const unsigned char *Data() const { return memory.empty() ? nullptr : &memory[0]; }
+	unsigned int Discards() const { return ring.Discards(); }
+
+	static const unsigned char GARBAGE = 0xCD;
+
+private:
+	std::vector<unsigned char> memory;
+	RingAllocator ring;
+	bool open;
+};
@@ -1,12 +1,14 @@
-cbuffer MatricesBuffer
+//Shader::ObjectBuffer, per draw
+cbuffer ObjectBuffer : register(b0)
 {
 	matrix worldMatrix;
-	matrix viewMatrix;
-	matrix projMatrix;
 };
 
-cbuffer CameraBuffer
+//Shader::FrameBuffer, once a frame
+cbuffer FrameBuffer : register(b1)
 {
+	matrix viewMatrix;
+	matrix projMatrix;
 	float3 cameraPosition;
 	float padding;
 };
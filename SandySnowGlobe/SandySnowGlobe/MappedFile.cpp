@@ -0,0 +1,181 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+#else
+	descriptor = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+/// <summary>
+/// Map a whole file read-only, an empty file opens with a null view
+/// </summary>
+/// <param name="filename">File path</param>
+/// <returns></returns>
+bool MappedFile::Open(const char *filename)
+{
+	Close();
+
+	return Map(CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+}
+
+bool MappedFile::Open(const wchar_t *filename)
+{
+	Close();
+
+	return Map(CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+}
+
+bool MappedFile::Map(void *fileHandle)
+{
+	file = fileHandle;
+
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if(!GetFileSizeEx(file, &fileSize) || (unsigned long long)fileSize.QuadPart > (std::size_t)-1)
+	{
+		Close();
+		return false;
+	}
+
+	size = (std::size_t)fileSize.QuadPart;
+
+	if(size == 0)
+	{
+		return true;
+	}
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if(mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if(data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+
+	if(mapping != nullptr)
+	{
+		CloseHandle(mapping);
+	}
+
+	if(file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file);
+	}
+
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+	data = nullptr;
+	size = 0;
+}
+
+#else
+
+/// <summary>
+/// Map a whole file read-only, an empty file opens with a null view
+/// </summary>
+/// <param name="filename">File path</param>
+/// <returns></returns>
+bool MappedFile::Open(const char *filename)
+{
+	Close();
+
+	descriptor = open(filename, O_RDONLY);
+
+	if(descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+
+	if(fstat(descriptor, &info) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	size = (std::size_t)info.st_size;
+
+	if(size == 0)
+	{
+		return true;
+	}
+
+	void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+	if(view == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	madvise(view, size, MADV_SEQUENTIAL);
+	data = static_cast<const char *>(view);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(data != nullptr)
+	{
+		munmap(const_cast<char *>(data), size);
+	}
+
+	if(descriptor >= 0)
+	{
+		close(descriptor);
+	}
+
+	descriptor = -1;
+	data = nullptr;
+	size = 0;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+//Read-only view of a whole file, mapped rather than read so large assets are never copied
+//The view is not null terminated, always bound reads by Size()
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char *filename);
+#ifdef _WIN32
+	bool Open(const wchar_t *filename);
+#endif
+	void Close();
+
+	const char *Data() const { return data; }
+	std::size_t Size() const { return size; }
+
+private:
+	MappedFile& operator= (const MappedFile&);
+	MappedFile(const MappedFile&);
+
+#ifdef _WIN32
+	bool Map(void *fileHandle);
+
+	void *file, *mapping;
+#else
+	int descriptor;
+#endif
+	const char *data;
+	std::size_t size;
+};
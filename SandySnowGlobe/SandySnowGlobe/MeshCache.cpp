@@ -0,0 +1,363 @@
+#include "MeshCache.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+struct MeshCache::Header
+{
+	char magic[4];
+	unsigned int version;
+	unsigned int vertexFormat, vertexStride;
+	unsigned int vertexCount, indexCount, indexSize, padding;
+	unsigned long long sourceSize, sourceTime, sourceHash;
+	unsigned long long vertexOffset, indexOffset;
+	float boundsMin[3], boundsMax[3];
+	float boundsRadius;
+	unsigned int lodCount;
+	MeshSimplifier::Lod lods[MeshSimplifier::MAX_LODS];
+};
+
+namespace
+{
+	const char MAGIC[4] = { 'S', 'S', 'G', 'M' };
+	const unsigned int STREAM_ALIGNMENT = 16;
+
+	struct SourceStamp
+	{
+		unsigned long long size, time;
+	};
+
+	inline unsigned long long AlignUp(unsigned long long value)
+	{
+		return (value + STREAM_ALIGNMENT - 1) & ~(unsigned long long)(STREAM_ALIGNMENT - 1);
+	}
+
+	bool Stamp(const PathChar *source, SourceStamp &stamp)
+	{
+#ifdef _WIN32
+		struct __stat64 info;
+
+		if(_wstat64(source, &info) != 0)
+		{
+			return false;
+		}
+#else
+		struct stat info;
+
+		if(stat(source, &info) != 0)
+		{
+			return false;
+		}
+#endif
+		stamp.size = (unsigned long long)info.st_size;
+		stamp.time = (unsigned long long)info.st_mtime;
+
+		return true;
+	}
+
+	//64 bit FNV-1a of the whole source, only needed when the mtime alone cannot vouch for it
+	bool HashSource(const PathChar *source, unsigned long long &hash)
+	{
+		MappedFile file;
+
+		if(!file.Open(source))
+		{
+			return false;
+		}
+
+		const unsigned char *data = reinterpret_cast<const unsigned char *>(file.Data());
+		hash = 14695981039346656037ull;
+
+		for(std::size_t i = 0; i < file.Size(); i++)
+		{
+			hash = (hash ^ data[i]) * 1099511628211ull;
+		}
+
+		return true;
+	}
+
+	FILE *OpenForWrite(const PathChar *path)
+	{
+		FILE *file = nullptr;
+#ifdef _WIN32
+		_wfopen_s(&file, path, L"wb");
+#else
+		file = std::fopen(path, "wb");
+#endif
+		return file;
+	}
+
+	FILE *OpenForUpdate(const PathChar *path)
+	{
+		FILE *file = nullptr;
+#ifdef _WIN32
+		_wfopen_s(&file, path, L"r+b");
+#else
+		file = std::fopen(path, "r+b");
+#endif
+		return file;
+	}
+
+	bool Replace(const PathChar *from, const PathChar *to)
+	{
+#ifdef _WIN32
+		_wremove(to);
+		return _wrename(from, to) == 0;
+#else
+		return std::rename(from, to) == 0;
+#endif
+	}
+
+	bool WritePadded(FILE *file, const void *data, std::size_t size, unsigned long long &written)
+	{
+		static const char zeros[STREAM_ALIGNMENT] = { 0 };
+		std::size_t padding = (std::size_t)(AlignUp(written) - written);
+
+		if(padding > 0 && std::fwrite(zeros, 1, padding, file) != padding)
+		{
+			return false;
+		}
+
+		written += padding;
+
+		if(size > 0 && std::fwrite(data, 1, size, file) != size)
+		{
+			return false;
+		}
+
+		written += size;
+
+		return true;
+	}
+}
+
+MeshCache::MeshCache()
+{
+	header = nullptr;
+}
+
+MeshCache::~MeshCache()
+{
+}
+
+/// <summary>
+/// Cache file for a source mesh, <source>.mesh
+/// </summary>
+/// <param name="source">Source mesh path</param>
+/// <returns></returns>
+std::basic_string<PathChar> MeshCache::CachePath(const PathChar *source)
+{
+	static const PathChar extension[] = { '.', 'm', 'e', 's', 'h', 0 };
+
+	return std::basic_string<PathChar>(source) + extension;
+}
+
+/// <summary>
+/// Map the cache of a source mesh and check it is current and holds the expected vertex format
+/// </summary>
+/// <param name="source">Source mesh path, the cache is found next to it</param>
+/// <param name="vertexFormat">Caller's id for the vertex layout</param>
+/// <param name="vertexStride">Bytes per vertex</param>
+/// <returns>false on a miss: no cache, stale, or a different format/version</returns>
+bool MeshCache::Open(const PathChar *source, unsigned int vertexFormat, unsigned int vertexStride)
+{
+	Close();
+
+	SourceStamp stamp;
+
+	if(!Stamp(source, stamp) || !file.Open(CachePath(source).c_str()) || file.Size() < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	const Header *h = reinterpret_cast<const Header *>(file.Data());
+	unsigned long long vertexBytes = (unsigned long long)h->vertexCount * h->vertexStride;
+	unsigned long long indexBytes = (unsigned long long)h->indexCount * h->indexSize;
+
+	bool valid = std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 && h->version == VERSION &&
+		h->vertexFormat == vertexFormat && h->vertexStride == vertexStride &&
+		(h->indexSize == 2 || h->indexSize == 4) && h->sourceSize == stamp.size &&
+		h->vertexOffset % STREAM_ALIGNMENT == 0 && h->indexOffset % STREAM_ALIGNMENT == 0 &&
+		h->vertexOffset + vertexBytes <= file.Size() && h->indexOffset + indexBytes <= file.Size();
+
+	//every LOD's run must lie inside the index stream
+	valid = valid && h->lodCount >= 1 && h->lodCount <= MeshSimplifier::MAX_LODS;
+
+	for(unsigned int i = 0; valid && i < h->lodCount; i++)
+	{
+		valid = (unsigned long long)h->lods[i].indexOffset + h->lods[i].indexCount <= h->indexCount;
+	}
+
+	//a copied or touched source keeps its cache as long as the content is the same
+	bool touched = valid && h->sourceTime != stamp.time;
+
+	if(touched)
+	{
+		unsigned long long hash;
+		valid = HashSource(source, hash) && hash == h->sourceHash;
+	}
+
+	if(!valid)
+	{
+		Close();
+		return false;
+	}
+
+	if(touched)
+	{
+		//stamp the new mtime so the next start trusts size and mtime again instead of hashing, the mapping is read only so
+		//it is closed around the write, a failed write only costs another hash next time
+		std::basic_string<PathChar> path = CachePath(source);
+		file.Close();
+
+		FILE *out = OpenForUpdate(path.c_str());
+
+		if(out != nullptr)
+		{
+			if(std::fseek(out, (long)offsetof(Header, sourceTime), SEEK_SET) == 0)
+			{
+				std::fwrite(&stamp.time, sizeof(stamp.time), 1, out);
+			}
+
+			std::fclose(out);
+		}
+
+		if(!file.Open(path.c_str()) || file.Size() < sizeof(Header))
+		{
+			Close();
+			return false;
+		}
+
+		h = reinterpret_cast<const Header *>(file.Data());
+	}
+
+	header = h;
+
+	return true;
+}
+
+void MeshCache::Close()
+{
+	header = nullptr;
+	file.Close();
+}
+
+/// <summary>
+/// Write the cache for a source mesh through a temporary file, so a crash never leaves a half written cache
+/// </summary>
+/// <param name="source">Source mesh path, stamped and hashed now</param>
+/// <param name="vertexFormat">Caller's id for the vertex layout</param>
+/// <param name="vertices">Final vertex stream</param>
+/// <param name="vertexCount">Vertex count</param>
+/// <param name="vertexStride">Bytes per vertex</param>
+/// <param name="indices">Final index stream</param>
+/// <param name="indexCount">Index count, every LOD's indices</param>
+/// <param name="indexSize">Bytes per index, 2 or 4</param>
+/// <param name="boundsMin">Bounding box min, 3 floats</param>
+/// <param name="boundsMax">Bounding box max, 3 floats</param>
+/// <param name="boundsRadius">Bounding sphere radius around the box centre</param>
+/// <param name="lods">LOD table, the full mesh first</param>
+/// <param name="lodCount">LODs, 1 to MeshSimplifier::MAX_LODS</param>
+/// <returns></returns>
+bool MeshCache::Write(const PathChar *source, unsigned int vertexFormat, const void *vertices, unsigned int vertexCount, unsigned int vertexStride,
+	const void *indices, unsigned int indexCount, unsigned int indexSize, const float *boundsMin, const float *boundsMax, float boundsRadius,
+	const MeshSimplifier::Lod *lods, unsigned int lodCount)
+{
+	SourceStamp stamp;
+	Header h;
+
+	std::memset(&h, 0, sizeof(h));
+
+	if(lodCount < 1 || lodCount > MeshSimplifier::MAX_LODS || !Stamp(source, stamp) || !HashSource(source, h.sourceHash))
+	{
+		return false;
+	}
+
+	std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = VERSION;
+	h.vertexFormat = vertexFormat;
+	h.vertexStride = vertexStride;
+	h.vertexCount = vertexCount;
+	h.indexCount = indexCount;
+	h.indexSize = indexSize;
+	h.sourceSize = stamp.size;
+	h.sourceTime = stamp.time;
+	h.vertexOffset = AlignUp(sizeof(Header));
+	h.indexOffset = AlignUp(h.vertexOffset + ((unsigned long long)vertexCount * vertexStride));
+	std::memcpy(h.boundsMin, boundsMin, sizeof(h.boundsMin));
+	std::memcpy(h.boundsMax, boundsMax, sizeof(h.boundsMax));
+	h.boundsRadius = boundsRadius;
+	h.lodCount = lodCount;
+	std::memcpy(h.lods, lods, sizeof(MeshSimplifier::Lod) * lodCount);
+
+	static const PathChar temporary[] = { '.', 't', 'm', 'p', 0 };
+	std::basic_string<PathChar> path = CachePath(source);
+	std::basic_string<PathChar> temporaryPath = path + temporary;
+	FILE *out = OpenForWrite(temporaryPath.c_str());
+
+	if(out == nullptr)
+	{
+		return false;
+	}
+
+	unsigned long long written = 0;
+	bool ok = WritePadded(out, &h, sizeof(h), written) &&
+		WritePadded(out, vertices, (std::size_t)vertexCount * vertexStride, written) &&
+		WritePadded(out, indices, (std::size_t)indexCount * indexSize, written);
+
+	ok = (std::fclose(out) == 0) && ok;
+
+	return ok && Replace(temporaryPath.c_str(), path.c_str());
+}
+
+const void *MeshCache::Vertices() const
+{
+	return (header != nullptr) ? file.Data() + header->vertexOffset : nullptr;
+}
+
+const void *MeshCache::Indices() const
+{
+	return (header != nullptr) ? file.Data() + header->indexOffset : nullptr;
+}
+
+unsigned int MeshCache::VertexCount() const
+{
+	return (header != nullptr) ? header->vertexCount : 0;
+}
+
+unsigned int MeshCache::IndexCount() const
+{
+	return (header != nullptr) ? header->indexCount : 0;
+}
+
+unsigned int MeshCache::IndexSize() const
+{
+	return (header != nullptr) ? header->indexSize : 0;
+}
+
+const float *MeshCache::BoundsMin() const
+{
+	return (header != nullptr) ? header->boundsMin : nullptr;
+}
+
+const float *MeshCache::BoundsMax() const
+{
+	return (header != nullptr) ? header->boundsMax : nullptr;
+}
+
+float MeshCache::BoundsRadius() const
+{
+	return (header != nullptr) ? header->boundsRadius : 0.0f;
+}
+
+unsigned int MeshCache::LodCount() const
+{
+	return (header != nullptr) ? header->lodCount : 0;
+}
+
+const MeshSimplifier::Lod *MeshCache::Lods() const
+{
+	return (header != nullptr) ? header->lods : nullptr;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
+
+#ifdef _WIN32
+typedef wchar_t PathChar;
+#else
+typedef char PathChar;
+#endif
+
+//Final vertex/index streams of a mesh and its LOD table, stored next to its source as <source>.mesh
+//Open maps the file and hands out pointers straight into the mapping, nothing is copied or parsed
+//A cache is stale when the source size changed, or its mtime changed and its content hash no longer matches
+class MeshCache
+{
+public:
+	static const unsigned int VERSION = 4;	//bump when the layout of the file or of a vertex format changes
+
+	MeshCache();
+	~MeshCache();
+
+	bool Open(const PathChar *source, unsigned int vertexFormat, unsigned int vertexStride);
+	void Close();
+
+	static bool Write(const PathChar *source, unsigned int vertexFormat, const void *vertices, unsigned int vertexCount, unsigned int vertexStride,
+		const void *indices, unsigned int indexCount, unsigned int indexSize, const float *boundsMin, const float *boundsMax, float boundsRadius,
+		const MeshSimplifier::Lod *lods, unsigned int lodCount);
+	static std::basic_string<PathChar> CachePath(const PathChar *source);
+
+	const void *Vertices() const;
+	const void *Indices() const;
+	unsigned int VertexCount() const;
+	unsigned int IndexCount() const;
+	unsigned int IndexSize() const;
+	const float *BoundsMin() const;
+	const float *BoundsMax() const;
+	float BoundsRadius() const;
+	unsigned int LodCount() const;
+	const MeshSimplifier::Lod *Lods() const;
+
+private:
+	MeshCache& operator= (const MeshCache&);
+	MeshCache(const MeshCache&);
+
+	struct Header;
+
+	MappedFile file;
+	const Header *header;
+};
@@ -0,0 +1,352 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const unsigned int NONE = 0xFFFFFFFF;
+
+	//Forsyth's tuning, see "Linear-Speed Vertex Cache Optimisation"
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+	const unsigned int MAX_VALENCE_SCORED = 32;	//higher valences score as this, the boost is nearly flat by then
+
+	unsigned int HashVertex(const unsigned char *vertex, unsigned int stride)
+	{
+		unsigned int hash = 2166136261u;
+
+		for(unsigned int i = 0; i < stride; i++)
+		{
+			hash = (hash ^ vertex[i]) * 16777619u;
+		}
+
+		return hash;
+	}
+
+	inline float VertexScore(const float *cacheScores, const float *valenceScores, int cachePosition, unsigned int valence)
+	{
+		if(valence == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = (cachePosition >= 0) ? cacheScores[cachePosition] : 0.0f;
+
+		return score + valenceScores[(valence < MAX_VALENCE_SCORED) ? valence : MAX_VALENCE_SCORED - 1];
+	}
+}
+
+namespace MeshOptimizer
+{
+	/// <summary>
+	/// Collapse byte-identical vertices with a hash table, unique vertices are compacted to the front in first-use order
+	/// </summary>
+	/// <param name="vertices">Triangle soup, rewritten in place</param>
+	/// <param name="vertexCount">Vertices in the soup</param>
+	/// <param name="stride">Bytes per vertex</param>
+	/// <param name="indices">Out, vertexCount indices into the compacted vertices</param>
+	/// <returns>Unique vertex count</returns>
+	unsigned int Weld(void *vertices, unsigned int vertexCount, unsigned int stride, unsigned int *indices)
+	{
+		if(vertexCount == 0)
+		{
+			return 0;
+		}
+
+		unsigned char *data = static_cast<unsigned char *>(vertices);
+		unsigned int tableSize = 1;
+
+		while(tableSize < vertexCount * 2)
+		{
+			tableSize <<= 1;
+		}
+
+		std::vector<unsigned int> table(tableSize, NONE);
+		unsigned int mask = tableSize - 1;
+		unsigned int unique = 0;
+
+		for(unsigned int i = 0; i < vertexCount; i++)
+		{
+			const unsigned char *vertex = data + (i * stride);
+			unsigned int slot = HashVertex(vertex, stride) & mask;
+
+			for(;;)
+			{
+				unsigned int entry = table[slot];
+
+				if(entry == NONE)
+				{
+					if(unique != i)
+					{
+						std::memcpy(data + (unique * stride), vertex, stride);
+					}
+
+					table[slot] = unique;
+					indices[i] = unique++;
+					break;
+				}
+
+				if(std::memcmp(data + (entry * stride), vertex, stride) == 0)
+				{
+					indices[i] = entry;
+					break;
+				}
+
+				slot = (slot + 1) & mask;
+			}
+		}
+
+		return unique;
+	}
+
+	/// <summary>
+	/// Reorder triangles for the post-transform vertex cache (Forsyth), greedy on a simulated CACHE_SIZE LRU cache
+	/// Vertices score higher when recently used or when few of their triangles are left, so the mesh is eaten in strips
+	/// </summary>
+	/// <param name="indices">Triangle list, reordered in place</param>
+	/// <param name="indexCount">Index count</param>
+	/// <param name="vertexCount">Vertex count, every index must be below it</param>
+	void OptimizeVertexCache(unsigned int *indices, unsigned int indexCount, unsigned int vertexCount)
+	{
+		unsigned int triangleCount = indexCount / 3;
+
+		if(triangleCount < 2)
+		{
+			return;
+		}
+
+		float cacheScores[CACHE_SIZE];
+		float valenceScores[MAX_VALENCE_SCORED];
+
+		for(unsigned int i = 0; i < CACHE_SIZE; i++)
+		{
+			cacheScores[i] = (i < 3) ? LAST_TRIANGLE_SCORE : std::pow(1.0f - ((float)(i - 3) / (float)(CACHE_SIZE - 3)), CACHE_DECAY_POWER);
+		}
+
+		valenceScores[0] = 0.0f;
+
+		for(unsigned int i = 1; i < MAX_VALENCE_SCORED; i++)
+		{
+			valenceScores[i] = VALENCE_BOOST_SCALE * std::pow((float)i, -VALENCE_BOOST_POWER);
+		}
+
+		//triangles around each vertex, the first remaining[v] of each list are not yet emitted
+		std::vector<unsigned int> remaining(vertexCount, 0);
+		std::vector<unsigned int> offsets(vertexCount + 1, 0);
+		std::vector<unsigned int> adjacency(triangleCount * 3);
+
+		for(unsigned int i = 0; i < triangleCount * 3; i++)
+		{
+			remaining[indices[i]]++;
+		}
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			offsets[v + 1] = offsets[v] + remaining[v];
+		}
+
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+
+		for(unsigned int i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[fill[indices[i]]++] = i / 3;
+		}
+
+		std::vector<float> vertexScore(vertexCount);
+		std::vector<char> emitted(triangleCount, 0);
+		std::vector<unsigned int> output(triangleCount * 3);
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			vertexScore[v] = VertexScore(cacheScores, valenceScores, -1, remaining[v]);
+		}
+
+		unsigned int best = 0;
+		float bestScore = -1.0f;
+
+		for(unsigned int t = 0; t < triangleCount; t++)
+		{
+			const unsigned int *tri = indices + (t * 3);
+			float score = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+
+			if(score > bestScore)
+			{
+				bestScore = score;
+				best = t;
+			}
+		}
+
+		unsigned int cache[CACHE_SIZE + 3], nextCache[CACHE_SIZE + 3];
+		unsigned int cacheCount = 0;
+		unsigned int cursor = 0;
+
+		for(unsigned int out = 0; out < triangleCount; out++)
+		{
+			//nothing in the cache touches a live triangle, restart from the first one left
+			if(best == NONE)
+			{
+				while(emitted[cursor])
+				{
+					cursor++;
+				}
+
+				best = cursor;
+			}
+
+			const unsigned int *tri = indices + (best * 3);
+			unsigned int nextCount = 0;
+
+			emitted[best] = 1;
+			output[out * 3] = tri[0];
+			output[(out * 3) + 1] = tri[1];
+			output[(out * 3) + 2] = tri[2];
+
+			for(unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int v = tri[k];
+				unsigned int *list = &adjacency[offsets[v]];
+
+				for(unsigned int j = 0; j < remaining[v]; j++)
+				{
+					if(list[j] == best)
+					{
+						list[j] = list[remaining[v] - 1];
+						break;
+					}
+				}
+
+				remaining[v]--;
+
+				if(k == 0 || (v != tri[0] && (k == 1 || v != tri[1])))
+				{
+					nextCache[nextCount++] = v;
+				}
+			}
+
+			//LRU: the emitted triangle moves to the front, anything pushed past CACHE_SIZE drops out
+			for(unsigned int j = 0; j < cacheCount; j++)
+			{
+				unsigned int v = cache[j];
+
+				if(v != tri[0] && v != tri[1] && v != tri[2])
+				{
+					nextCache[nextCount++] = v;
+				}
+			}
+
+			for(unsigned int j = 0; j < nextCount; j++)
+			{
+				unsigned int v = nextCache[j];
+				int position = (j < CACHE_SIZE) ? (int)j : -1;
+
+				vertexScore[v] = VertexScore(cacheScores, valenceScores, position, remaining[v]);
+			}
+
+			//only triangles touching the cache changed score, the next pick is the best of them
+			bestScore = -1.0f;
+			best = NONE;
+
+			for(unsigned int j = 0; j < nextCount; j++)
+			{
+				unsigned int v = nextCache[j];
+				const unsigned int *list = &adjacency[offsets[v]];
+
+				for(unsigned int a = 0; a < remaining[v]; a++)
+				{
+					const unsigned int *other = indices + (list[a] * 3);
+					float score = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+
+					if(score > bestScore)
+					{
+						bestScore = score;
+						best = list[a];
+					}
+				}
+			}
+
+			cacheCount = (nextCount < CACHE_SIZE) ? nextCount : CACHE_SIZE;
+			std::memcpy(cache, nextCache, cacheCount * sizeof(unsigned int));
+		}
+
+		std::memcpy(indices, &output[0], triangleCount * 3 * sizeof(unsigned int));
+	}
+
+	/// <summary>
+	/// Reorder vertices into the order the indices first use them, so vertex fetch walks memory forwards
+	/// Vertices no index uses end up past the returned count
+	/// </summary>
+	/// <param name="vertices">Vertices, reordered in place</param>
+	/// <param name="vertexCount">Vertex count</param>
+	/// <param name="stride">Bytes per vertex</param>
+	/// <param name="indices">Triangle list, remapped in place</param>
+	/// <param name="indexCount">Index count</param>
+	void OptimizeVertexFetch(void *vertices, unsigned int vertexCount, unsigned int stride, unsigned int *indices, unsigned int indexCount)
+	{
+		if(vertexCount == 0)
+		{
+			return;
+		}
+
+		unsigned char *data = static_cast<unsigned char *>(vertices);
+		std::vector<unsigned int> remap(vertexCount, NONE);
+		unsigned int next = 0;
+
+		for(unsigned int i = 0; i < indexCount; i++)
+		{
+			unsigned int &target = remap[indices[i]];
+
+			if(target == NONE)
+			{
+				target = next++;
+			}
+
+			indices[i] = target;
+		}
+
+		std::vector<unsigned char> source(data, data + (vertexCount * stride));
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			if(remap[v] != NONE)
+			{
+				std::memcpy(data + (remap[v] * stride), &source[v * stride], stride);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Average cache miss ratio, vertex shader runs per triangle on a FIFO cache
+	/// 3 is an unindexed soup, around 0.6-0.7 is good for a regular grid
+	/// </summary>
+	/// <param name="indices">Triangle list</param>
+	/// <param name="indexCount">Index count</param>
+	/// <param name="vertexCount">Vertex count, every index must be below it</param>
+	/// <param name="cacheSize">FIFO entries</param>
+	/// <returns></returns>
+	float Acmr(const unsigned int *indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+	{
+		if(indexCount < 3)
+		{
+			return 0.0f;
+		}
+
+		//a vertex is cached while fewer than cacheSize misses happened since its own
+		std::vector<unsigned int> insertedAt(vertexCount, 0);
+		unsigned int misses = 0;
+
+		for(unsigned int i = 0; i < indexCount; i++)
+		{
+			unsigned int &stamp = insertedAt[indices[i]];
+
+			if(stamp == 0 || stamp + cacheSize <= misses)
+			{
+				stamp = ++misses;
+			}
+		}
+
+		return (float)misses / (float)(indexCount / 3);
+	}
+}
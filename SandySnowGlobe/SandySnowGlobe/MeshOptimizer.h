@@ -0,0 +1,15 @@
+#pragma once
+
+//CPU passes that turn a triangle soup into a compact indexed mesh, no D3D dependency
+//Run in order: Weld, OptimizeVertexCache, OptimizeVertexFetch
+namespace MeshOptimizer
+{
+	const unsigned int CACHE_SIZE = 32;			//LRU cache the triangle order is optimized for
+	const unsigned int ACMR_CACHE_SIZE = 16;	//FIFO cache ACMR is measured with, a conservative stand-in for real hardware
+
+	unsigned int Weld(void *vertices, unsigned int vertexCount, unsigned int stride, unsigned int *indices);
+	void OptimizeVertexCache(unsigned int *indices, unsigned int indexCount, unsigned int vertexCount);
+	void OptimizeVertexFetch(void *vertices, unsigned int vertexCount, unsigned int stride, unsigned int *indices, unsigned int indexCount);
+
+	float Acmr(const unsigned int *indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize = ACMR_CACHE_SIZE);
+}
@@ -0,0 +1,785 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	const unsigned int NONE = 0xFFFFFFFF;
+	const unsigned int ATTRIBUTES = 8;				//position, texCoord, normal
+	const unsigned int QUADRIC_TERMS = 36;			//upper triangle of an 8x8 matrix
+	const double BORDER_WEIGHT = 10.0;				//how hard an open border holds its line, against a face of the same area
+	const float FLIP_LIMIT = 0.25f;					//cosine, a triangle may turn at most ~75 degrees in one collapse
+	const float MIN_LOD_REDUCTION = 0.75f;			//a LOD must drop at least a quarter of the triangles of the one before
+
+	enum Kind
+	{
+		KIND_INTERIOR,	//one wedge, closed fan, collapses onto any neighbour
+		KIND_BORDER,	//one wedge on a single open border, collapses along it
+		KIND_SEAM,		//two wedges on a single texture/normal seam, collapses along it with its twin
+		KIND_LOCKED		//corners, seam ends, non-manifold edges, never moved
+	};
+
+	//sum of squared distances to planes in position/texCoord/normal space, area weighted
+	struct Quadric
+	{
+		double a[QUADRIC_TERMS];
+		double b[ATTRIBUTES];
+		double c, weight;
+	};
+
+	struct Edge
+	{
+		unsigned int count;
+		unsigned int first, second;	//wedges of the first triangle seen, at the lower and higher position id
+		bool seam;
+	};
+
+	struct Candidate
+	{
+		unsigned int from;
+		float cost;
+	};
+
+	bool ByCost(const Candidate &a, const Candidate &b)
+	{
+		return a.cost < b.cost;
+	}
+
+	inline unsigned long long EdgeKey(unsigned int a, unsigned int b)
+	{
+		return (a < b) ? (((unsigned long long)a << 32) | b) : (((unsigned long long)b << 32) | a);
+	}
+
+	void QuadricAdd(Quadric &q, const Quadric &r)
+	{
+		for(unsigned int i = 0; i < QUADRIC_TERMS; i++)
+		{
+			q.a[i] += r.a[i];
+		}
+
+		for(unsigned int i = 0; i < ATTRIBUTES; i++)
+		{
+			q.b[i] += r.b[i];
+		}
+
+		q.c += r.c;
+		q.weight += r.weight;
+	}
+
+	double QuadricEvaluate(const Quadric &q, const float *x)
+	{
+		double result = q.c;
+		unsigned int k = 0;
+
+		for(unsigned int i = 0; i < ATTRIBUTES; i++)
+		{
+			result += 2.0 * q.b[i] * x[i];
+			result += q.a[k++] * x[i] * x[i];
+
+			for(unsigned int j = i + 1; j < ATTRIBUTES; j++)
+			{
+				result += 2.0 * q.a[k++] * x[i] * x[j];
+			}
+		}
+
+		return (result > 0.0) ? result : 0.0;
+	}
+
+	/// <summary>
+	/// Add the plane through a triangle in attribute space: distance to it is what is left of x after
+	/// projecting x - p onto the triangle's two orthonormal edge directions
+	/// </summary>
+	void QuadricAddTriangle(Quadric &q, const float *p0, const float *p1, const float *p2, double weight)
+	{
+		double e1[ATTRIBUTES], e2[ATTRIBUTES];
+		double length1 = 0.0, along = 0.0, length2 = 0.0;
+
+		for(unsigned int i = 0; i < ATTRIBUTES; i++)
+		{
+			e1[i] = (double)p1[i] - p0[i];
+			length1 += e1[i] * e1[i];
+		}
+
+		if(length1 <= 0.0)
+		{
+			return;
+		}
+
+		length1 = std::sqrt(length1);
+
+		for(unsigned int i = 0; i < ATTRIBUTES; i++)
+		{
+			e1[i] /= length1;
+			along += e1[i] * ((double)p2[i] - p0[i]);
+		}
+
+		for(unsigned int i = 0; i < ATTRIBUTES; i++)
+		{
+			e2[i] = ((double)p2[i] - p0[i]) - (along * e1[i]);
+			length2 += e2[i] * e2[i];
+		}
+
+		if(length2 <= 0.0)
+		{
+			return;
+		}
+
+		length2 = std::sqrt(length2);
+
+		double pe1 = 0.0, pe2 = 0.0, pp = 0.0;
+
+		for(unsigned int i = 0; i < ATTRIBUTES; i++)
+		{
+			e2[i] /= length2;
+			pe1 += p0[i] * e1[i];
+			pe2 += p0[i] * e2[i];
+			pp += (double)p0[i] * p0[i];
+		}
+
+		unsigned int k = 0;
+
+		for(unsigned int i = 0; i < ATTRIBUTES; i++)
+		{
+			for(unsigned int j = i; j < ATTRIBUTES; j++)
+			{
+				q.a[k++] += weight * (((i == j) ? 1.0 : 0.0) - (e1[i] * e1[j]) - (e2[i] * e2[j]));
+			}
+
+			q.b[i] += weight * ((pe1 * e1[i]) + (pe2 * e2[i]) - p0[i]);
+		}
+
+		q.c += weight * (pp - (pe1 * pe1) - (pe2 * pe2));
+		q.weight += weight;
+	}
+
+	/// <summary>
+	/// Add a plane in position only, used to pin open borders: it holds the border edge and stands perpendicular to its face
+	/// </summary>
+	void QuadricAddPlane(Quadric &q, const double *normal, double distance, double weight)
+	{
+		unsigned int k = 0;
+
+		for(unsigned int i = 0; i < 3; i++)
+		{
+			for(unsigned int j = i; j < ATTRIBUTES; j++)
+			{
+				q.a[k++] += (j < 3) ? weight * normal[i] * normal[j] : 0.0;
+			}
+
+			q.b[i] -= weight * distance * normal[i];
+		}
+
+		q.c += weight * distance * distance;
+		q.weight += weight;
+	}
+
+	inline void Cross(const float *a, const float *b, const float *c, float *normal)
+	{
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+
+		normal[0] = (e1[1] * e2[2]) - (e1[2] * e2[1]);
+		normal[1] = (e1[2] * e2[0]) - (e1[0] * e2[2]);
+		normal[2] = (e1[0] * e2[1]) - (e1[1] * e2[0]);
+	}
+
+	inline float Dot3(const float *a, const float *b)
+	{
+		return (a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]);
+	}
+
+	//everything one simplification works on, attributes are scaled so the error is in fractions of the mesh extent
+	struct Mesh
+	{
+		std::vector<float> points;				//ATTRIBUTES per vertex
+		std::vector<unsigned int> positionId;	//lowest vertex sharing each vertex's position
+		std::vector<Quadric> quadrics;
+		float scale;							//object space to fractions of the extent
+	};
+
+	/// <summary>
+	/// Scale attributes into a unit box and find the vertices that share a position
+	/// </summary>
+	void BuildMesh(const void *vertices, unsigned int vertexCount, const MeshSimplifier::Layout &layout, Mesh &mesh)
+	{
+		const unsigned char *data = static_cast<const unsigned char *>(vertices);
+		float low[5] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+		float high[5] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			const float *position = reinterpret_cast<const float *>(data + (v * layout.stride) + layout.position);
+			const float *texCoord = reinterpret_cast<const float *>(data + (v * layout.stride) + layout.texCoord);
+
+			for(unsigned int i = 0; i < 5; i++)
+			{
+				float value = (i < 3) ? position[i] : texCoord[i - 3];
+				low[i] = std::min(low[i], value);
+				high[i] = std::max(high[i], value);
+			}
+		}
+
+		float extent = std::max(std::max(high[0] - low[0], high[1] - low[1]), high[2] - low[2]);
+		float texExtent = std::max(high[3] - low[3], high[4] - low[4]);
+		float texScale = (texExtent > 0.0f) ? MeshSimplifier::TEXCOORD_WEIGHT / texExtent : 0.0f;
+
+		mesh.scale = (extent > 0.0f) ? 1.0f / extent : 0.0f;
+		mesh.points.resize(vertexCount * ATTRIBUTES);
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			const unsigned char *vertex = data + (v * layout.stride);
+			const float *position = reinterpret_cast<const float *>(vertex + layout.position);
+			const float *texCoord = reinterpret_cast<const float *>(vertex + layout.texCoord);
+			const float *normal = reinterpret_cast<const float *>(vertex + layout.normal);
+			float *point = &mesh.points[v * ATTRIBUTES];
+
+			for(unsigned int i = 0; i < 3; i++)
+			{
+				point[i] = (position[i] - low[i]) * mesh.scale;
+				point[5 + i] = normal[i] * MeshSimplifier::NORMAL_WEIGHT;
+			}
+
+			point[3] = (texCoord[0] - low[3]) * texScale;
+			point[4] = (texCoord[1] - low[4]) * texScale;
+		}
+
+		//wedges: same position, different texCoord or normal, found by hashing the position bytes
+		std::unordered_map<std::string, unsigned int> seen;
+		mesh.positionId.resize(vertexCount);
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			std::string key(reinterpret_cast<const char *>(data + (v * layout.stride) + layout.position), sizeof(float) * 3);
+			std::unordered_map<std::string, unsigned int>::iterator found = seen.find(key);
+
+			if(found == seen.end())
+			{
+				seen[key] = v;
+				mesh.positionId[v] = v;
+			}
+			else
+			{
+				mesh.positionId[v] = found->second;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Face quadrics on every wedge of a triangle, border planes on the wedges at each open edge
+	/// </summary>
+	void BuildQuadrics(Mesh &mesh, unsigned int vertexCount, const unsigned int *indices, unsigned int indexCount)
+	{
+		Quadric zero;
+		std::memset(&zero, 0, sizeof(zero));
+		mesh.quadrics.assign(vertexCount, zero);
+
+		std::unordered_map<unsigned long long, unsigned int> edgeCounts;
+
+		for(unsigned int i = 0; i < indexCount; i += 3)
+		{
+			for(unsigned int e = 0; e < 3; e++)
+			{
+				edgeCounts[EdgeKey(mesh.positionId[indices[i + e]], mesh.positionId[indices[i + ((e + 1) % 3)]])]++;
+			}
+		}
+
+		for(unsigned int i = 0; i < indexCount; i += 3)
+		{
+			const float *p[3] = { &mesh.points[indices[i] * ATTRIBUTES], &mesh.points[indices[i + 1] * ATTRIBUTES], &mesh.points[indices[i + 2] * ATTRIBUTES] };
+			float normal[3];
+
+			Cross(p[0], p[1], p[2], normal);
+
+			double area = 0.5 * std::sqrt((double)Dot3(normal, normal));
+			Quadric face = zero;
+
+			QuadricAddTriangle(face, p[0], p[1], p[2], area);
+
+			for(unsigned int e = 0; e < 3; e++)
+			{
+				QuadricAdd(mesh.quadrics[indices[i + e]], face);
+			}
+
+			for(unsigned int e = 0; e < 3; e++)
+			{
+				unsigned int a = indices[i + e], b = indices[i + ((e + 1) % 3)];
+
+				if(edgeCounts[EdgeKey(mesh.positionId[a], mesh.positionId[b])] != 1)
+				{
+					continue;
+				}
+
+				const float *pa = &mesh.points[a * ATTRIBUTES];
+				const float *pb = &mesh.points[b * ATTRIBUTES];
+				double edge[3] = { (double)pb[0] - pa[0], (double)pb[1] - pa[1], (double)pb[2] - pa[2] };
+				double plane[3] = { (edge[1] * normal[2]) - (edge[2] * normal[1]), (edge[2] * normal[0]) - (edge[0] * normal[2]), (edge[0] * normal[1]) - (edge[1] * normal[0]) };
+				double length = std::sqrt((plane[0] * plane[0]) + (plane[1] * plane[1]) + (plane[2] * plane[2]));
+
+				if(length <= 0.0)
+				{
+					continue;
+				}
+
+				plane[0] /= length;
+				plane[1] /= length;
+				plane[2] /= length;
+
+				double distance = (plane[0] * pa[0]) + (plane[1] * pa[1]) + (plane[2] * pa[2]);
+				double weight = BORDER_WEIGHT * ((edge[0] * edge[0]) + (edge[1] * edge[1]) + (edge[2] * edge[2]));
+				Quadric border = zero;
+
+				QuadricAddPlane(border, plane, distance, weight);
+				QuadricAdd(mesh.quadrics[a], border);
+				QuadricAdd(mesh.quadrics[b], border);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Would moving from onto to turn or crush any triangle around from that survives the collapse
+	/// </summary>
+	bool Flips(const Mesh &mesh, const unsigned int *indices, const unsigned int *around, unsigned int aroundCount, unsigned int from, unsigned int to)
+	{
+		for(unsigned int t = 0; t < aroundCount; t++)
+		{
+			const unsigned int *tri = indices + (around[t] * 3);
+
+			if(tri[0] == to || tri[1] == to || tri[2] == to)
+			{
+				continue;
+			}
+
+			const float *before[3], *after[3];
+
+			for(unsigned int k = 0; k < 3; k++)
+			{
+				before[k] = &mesh.points[tri[k] * ATTRIBUTES];
+				after[k] = (tri[k] == from) ? &mesh.points[to * ATTRIBUTES] : before[k];
+			}
+
+			float n0[3], n1[3];
+			Cross(before[0], before[1], before[2], n0);
+			Cross(after[0], after[1], after[2], n1);
+
+			if(Dot3(n0, n1) <= FLIP_LIMIT * std::sqrt(Dot3(n0, n0) * Dot3(n1, n1)))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+namespace MeshSimplifier
+{
+	/// <summary>
+	/// Collapse edges cheapest first until the mesh is down to a target size or the next collapse would cost more than maxError
+	/// Works in passes: each pass takes the best collapse of every vertex, applies those that do not touch each other, then rewrites the indices
+	/// </summary>
+	/// <param name="vertices">Vertex stream, never changed</param>
+	/// <param name="vertexCount">Vertex count</param>
+	/// <param name="layout">Attribute offsets</param>
+	/// <param name="indices">Triangle list to simplify</param>
+	/// <param name="indexCount">Index count</param>
+	/// <param name="targetIndexCount">Stop at or below this many indices</param>
+	/// <param name="maxError">Object space distance no collapse may exceed</param>
+	/// <param name="destination">Out, up to indexCount indices into the same vertices</param>
+	/// <param name="error">Out, the largest error of any collapse made, object space</param>
+	/// <returns>Index count of destination</returns>
+	unsigned int Simplify(const void *vertices, unsigned int vertexCount, const Layout &layout, const unsigned int *indices, unsigned int indexCount,
+		unsigned int targetIndexCount, float maxError, unsigned int *destination, float &error)
+	{
+		std::memmove(destination, indices, indexCount * sizeof(unsigned int));
+		error = 0.0f;
+
+		if(indexCount <= targetIndexCount || vertexCount == 0)
+		{
+			return indexCount;
+		}
+
+		Mesh mesh;
+		BuildMesh(vertices, vertexCount, layout, mesh);
+		BuildQuadrics(mesh, vertexCount, destination, indexCount);
+
+		float errorLimit = maxError * mesh.scale;
+		float worst = 0.0f;
+		std::vector<unsigned int> offsets(vertexCount + 1), adjacency, fill(vertexCount);
+		std::vector<unsigned int> groupSize(vertexCount), twin(vertexCount), borderEdges(vertexCount), seamEdges(vertexCount);
+		std::vector<unsigned char> kind(vertexCount), nonManifold(vertexCount), locked(vertexCount);
+		std::vector<unsigned int> bestTo(vertexCount), remap(vertexCount);
+		std::vector<float> bestCost(vertexCount);
+		std::vector<Candidate> candidates;
+		std::unordered_map<unsigned long long, Edge> edges;
+
+		while(indexCount > targetIndexCount)
+		{
+			unsigned int triangleCount = indexCount / 3;
+
+			//triangles around each vertex
+			std::fill(offsets.begin(), offsets.end(), 0);
+
+			for(unsigned int i = 0; i < indexCount; i++)
+			{
+				offsets[destination[i] + 1]++;
+			}
+
+			for(unsigned int v = 0; v < vertexCount; v++)
+			{
+				offsets[v + 1] += offsets[v];
+				fill[v] = offsets[v];
+			}
+
+			adjacency.resize(indexCount);
+
+			for(unsigned int i = 0; i < indexCount; i++)
+			{
+				adjacency[fill[destination[i]]++] = i / 3;
+			}
+
+			//wedges still in use at each position, and the twin of every two-wedge position
+			std::fill(groupSize.begin(), groupSize.end(), 0);
+			std::fill(twin.begin(), twin.end(), NONE);
+
+			for(unsigned int v = 0; v < vertexCount; v++)
+			{
+				if(offsets[v + 1] == offsets[v])
+				{
+					continue;
+				}
+
+				unsigned int id = mesh.positionId[v];
+
+				if(groupSize[id]++ == 0)
+				{
+					twin[id] = v;
+				}
+				else
+				{
+					twin[v] = twin[id];
+					twin[twin[id]] = v;
+				}
+			}
+
+			//edges in position space: open (one triangle), seams (two triangles, different wedges) and non-manifold
+			edges.clear();
+			std::fill(borderEdges.begin(), borderEdges.end(), 0);
+			std::fill(seamEdges.begin(), seamEdges.end(), 0);
+			std::fill(nonManifold.begin(), nonManifold.end(), 0);
+
+			for(unsigned int i = 0; i < indexCount; i += 3)
+			{
+				for(unsigned int e = 0; e < 3; e++)
+				{
+					unsigned int a = destination[i + e], b = destination[i + ((e + 1) % 3)];
+					unsigned int pa = mesh.positionId[a], pb = mesh.positionId[b];
+					unsigned int low = (pa < pb) ? a : b, high = (pa < pb) ? b : a;
+					Edge &edge = edges[EdgeKey(pa, pb)];
+
+					if(edge.count++ == 0)
+					{
+						edge.first = low;
+						edge.second = high;
+						edge.seam = false;
+					}
+					else
+					{
+						edge.seam = edge.seam || edge.first != low || edge.second != high;
+					}
+				}
+			}
+
+			for(std::unordered_map<unsigned long long, Edge>::const_iterator it = edges.begin(); it != edges.end(); ++it)
+			{
+				unsigned int pa = (unsigned int)(it->first >> 32), pb = (unsigned int)(it->first & 0xFFFFFFFF);
+
+				if(it->second.count == 1)
+				{
+					borderEdges[pa]++;
+					borderEdges[pb]++;
+				}
+				else if(it->second.count == 2 && it->second.seam)
+				{
+					seamEdges[pa]++;
+					seamEdges[pb]++;
+				}
+				else if(it->second.count > 2)
+				{
+					nonManifold[pa] = 1;
+					nonManifold[pb] = 1;
+				}
+			}
+
+			for(unsigned int v = 0; v < vertexCount; v++)
+			{
+				unsigned int id = mesh.positionId[v];
+
+				if(nonManifold[id])
+				{
+					kind[v] = KIND_LOCKED;
+				}
+				else if(groupSize[id] == 1 && borderEdges[id] == 0 && seamEdges[id] == 0)
+				{
+					kind[v] = KIND_INTERIOR;
+				}
+				else if(groupSize[id] == 1 && borderEdges[id] == 2 && seamEdges[id] == 0)
+				{
+					kind[v] = KIND_BORDER;
+				}
+				else if(groupSize[id] == 2 && borderEdges[id] == 0 && seamEdges[id] == 2)
+				{
+					kind[v] = KIND_SEAM;
+				}
+				else
+				{
+					kind[v] = KIND_LOCKED;
+				}
+			}
+
+			//cheapest allowed collapse of every vertex, a seam vertex's cost includes its twin's matching collapse
+			std::fill(bestTo.begin(), bestTo.end(), NONE);
+			std::fill(bestCost.begin(), bestCost.end(), FLT_MAX);
+
+			for(unsigned int i = 0; i < indexCount; i += 3)
+			{
+				//each corner towards both others
+				for(unsigned int e = 0; e < 6; e++)
+				{
+					unsigned int from = destination[i + (e % 3)];
+					unsigned int to = destination[i + (((e % 3) + 1 + (e / 3)) % 3)];
+					unsigned int pf = mesh.positionId[from], pt = mesh.positionId[to];
+
+					if(from == to || pf == pt || kind[from] == KIND_LOCKED)
+					{
+						continue;
+					}
+
+					const Edge &edge = edges[EdgeKey(pf, pt)];
+
+					if((kind[from] == KIND_BORDER && edge.count != 1) || (kind[from] == KIND_SEAM && !edge.seam))
+					{
+						continue;
+					}
+
+					double cost = QuadricEvaluate(mesh.quadrics[from], &mesh.points[to * ATTRIBUTES]);
+					double weight = mesh.quadrics[from].weight;
+
+					if(kind[from] == KIND_SEAM)
+					{
+						unsigned int other = twin[from], otherTo = (groupSize[pt] == 1) ? to : NONE;
+
+						for(unsigned int t = offsets[other]; t < offsets[other + 1] && otherTo == NONE; t++)
+						{
+							for(unsigned int k = 0; k < 3; k++)
+							{
+								unsigned int w = destination[(adjacency[t] * 3) + k];
+								otherTo = (mesh.positionId[w] == pt) ? w : otherTo;
+							}
+						}
+
+						if(otherTo == NONE)
+						{
+							continue;
+						}
+
+						cost += QuadricEvaluate(mesh.quadrics[other], &mesh.points[otherTo * ATTRIBUTES]);
+						weight += mesh.quadrics[other].weight;
+					}
+
+					float normalized = (weight > 0.0) ? (float)std::sqrt(cost / weight) : 0.0f;
+
+					if(normalized < bestCost[from])
+					{
+						bestCost[from] = normalized;
+						bestTo[from] = to;
+					}
+				}
+			}
+
+			candidates.clear();
+
+			for(unsigned int v = 0; v < vertexCount; v++)
+			{
+				if(bestTo[v] != NONE && bestCost[v] <= errorLimit && (kind[v] != KIND_SEAM || v < twin[v]))
+				{
+					Candidate candidate = { v, bestCost[v] };
+					candidates.push_back(candidate);
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end(), ByCost);
+
+			//apply collapses cheapest first, one per neighbourhood, until enough triangles are gone
+			for(unsigned int v = 0; v < vertexCount; v++)
+			{
+				remap[v] = v;
+			}
+
+			std::fill(locked.begin(), locked.end(), 0);
+			unsigned int removed = 0, collapses = 0;
+
+			for(unsigned int c = 0; c < candidates.size() && triangleCount - removed > targetIndexCount / 3; c++)
+			{
+				unsigned int from[2] = { candidates[c].from, NONE }, to[2] = { bestTo[candidates[c].from], NONE };
+				unsigned int count = 1;
+
+				if(kind[from[0]] == KIND_SEAM)
+				{
+					unsigned int pt = mesh.positionId[to[0]];
+					from[1] = twin[from[0]];
+
+					for(unsigned int t = offsets[from[1]]; t < offsets[from[1] + 1]; t++)
+					{
+						for(unsigned int k = 0; k < 3; k++)
+						{
+							unsigned int w = destination[(adjacency[t] * 3) + k];
+							to[1] = (mesh.positionId[w] == pt) ? w : to[1];
+						}
+					}
+
+					count = 2;
+				}
+
+				bool blocked = false;
+
+				for(unsigned int k = 0; k < count; k++)
+				{
+					blocked = blocked || to[k] == NONE || locked[from[k]] || locked[to[k]] ||
+						Flips(mesh, destination, &adjacency[offsets[from[k]]], offsets[from[k] + 1] - offsets[from[k]], from[k], to[k]);
+				}
+
+				if(blocked)
+				{
+					continue;
+				}
+
+				for(unsigned int k = 0; k < count; k++)
+				{
+					remap[from[k]] = to[k];
+					QuadricAdd(mesh.quadrics[to[k]], mesh.quadrics[from[k]]);
+
+					//nothing around this collapse may move again this pass, so the adjacency stays true
+					for(unsigned int t = offsets[from[k]]; t < offsets[from[k] + 1]; t++)
+					{
+						const unsigned int *tri = &destination[adjacency[t] * 3];
+
+						locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = 1;
+						removed += (tri[0] == to[k] || tri[1] == to[k] || tri[2] == to[k]) ? 1 : 0;
+					}
+
+					locked[to[k]] = 1;
+				}
+
+				worst = std::max(worst, candidates[c].cost);
+				collapses++;
+			}
+
+			if(collapses == 0)
+			{
+				break;
+			}
+
+			//rewrite, dropping triangles that lost a corner or were squashed onto one position
+			unsigned int written = 0;
+
+			for(unsigned int i = 0; i < indexCount; i += 3)
+			{
+				unsigned int a = remap[destination[i]], b = remap[destination[i + 1]], c = remap[destination[i + 2]];
+				unsigned int pa = mesh.positionId[a], pb = mesh.positionId[b], pc = mesh.positionId[c];
+
+				if(pa == pb || pb == pc || pa == pc)
+				{
+					continue;
+				}
+
+				destination[written++] = a;
+				destination[written++] = b;
+				destination[written++] = c;
+			}
+
+			indexCount = written;
+		}
+
+		error = (mesh.scale > 0.0f) ? worst / mesh.scale : 0.0f;
+
+		return indexCount;
+	}
+
+	/// <summary>
+	/// Build up to MAX_LODS levels, each simplified from the one before to about half its triangles
+	/// The chain stops early when a level would drop below MIN_LOD_TRIANGLES, stray more than MAX_LOD_ERROR, or barely shrink
+	/// Each level is first held to an even share of the error budget still unspent and only given all of it if that barely shrinks it
+	/// </summary>
+	/// <param name="vertices">Vertex stream shared by every LOD</param>
+	/// <param name="vertexCount">Vertex count</param>
+	/// <param name="layout">Attribute offsets</param>
+	/// <param name="indices">In the full mesh, out every LOD one after the other, each ordered for the vertex cache</param>
+	/// <param name="lods">Out, MAX_LODS entries, lods[0] is the full mesh</param>
+	/// <returns>LOD count, at least 1</returns>
+	unsigned int GenerateLods(const void *vertices, unsigned int vertexCount, const Layout &layout, std::vector<unsigned int> &indices, Lod *lods)
+	{
+		Lod full = { 0, (unsigned int)indices.size(), 0.0f };
+		lods[0] = full;
+
+		const unsigned char *data = static_cast<const unsigned char *>(vertices);
+		float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			const float *position = reinterpret_cast<const float *>(data + (v * layout.stride) + layout.position);
+
+			for(unsigned int i = 0; i < 3; i++)
+			{
+				low[i] = std::min(low[i], position[i]);
+				high[i] = std::max(high[i], position[i]);
+			}
+		}
+
+		float errorBudget = MAX_LOD_ERROR * std::max(std::max(high[0] - low[0], high[1] - low[1]), high[2] - low[2]);
+		unsigned int lodCount = 1;
+		std::vector<unsigned int> simplified;
+
+		while(lodCount < MAX_LODS)
+		{
+			const Lod &previous = lods[lodCount - 1];
+			unsigned int target = ((previous.indexCount / 3) / 2) * 3;
+
+			if(target / 3 < MIN_LOD_TRIANGLES || previous.error >= errorBudget)
+			{
+				break;
+			}
+
+			float error = 0.0f;
+			float remaining = errorBudget - previous.error;
+			simplified.resize(previous.indexCount);
+
+			unsigned int count = Simplify(vertices, vertexCount, layout, &indices[previous.indexOffset], previous.indexCount, target,
+				remaining / (float)(MAX_LODS - lodCount), &simplified[0], error);
+
+			if(count == 0 || (float)count > (float)previous.indexCount * MIN_LOD_REDUCTION)
+			{
+				count = Simplify(vertices, vertexCount, layout, &indices[previous.indexOffset], previous.indexCount, target,
+					remaining, &simplified[0], error);
+			}
+
+			if(count == 0 || (float)count > (float)previous.indexCount * MIN_LOD_REDUCTION)
+			{
+				break;
+			}
+
+			MeshOptimizer::OptimizeVertexCache(&simplified[0], count, vertexCount);
+
+			Lod lod = { (unsigned int)indices.size(), count, previous.error + error };
+			indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+			lods[lodCount++] = lod;
+		}
+
+		return lodCount;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+//Quadric error simplification for LOD chains, no D3D dependency
+//Only half edge collapses, so every LOD indexes the full mesh's vertex buffer and LODs differ in their index stream alone
+//Error is measured on position, texCoord and normal together (Garland and Heckbert's generalized quadrics)
+//Both sides of a texture seam collapse together, open borders only slide along themselves, collapses that flip a triangle are refused
+//Positions split three or more ways (hard edged, faceted meshes like the cactus) are locked, so such meshes keep their single LOD
+namespace MeshSimplifier
+{
+	const unsigned int MAX_LODS = 4;				//including the full mesh
+	const unsigned int MIN_LOD_TRIANGLES = 256;		//the chain stops before a LOD would have fewer
+	const float TEXCOORD_WEIGHT = 0.5f;				//against positions, both as fractions of their extent
+	const float NORMAL_WEIGHT = 0.5f;
+	const float MAX_LOD_ERROR = 0.05f;				//fraction of the mesh extent, no LOD strays further, shared out over the levels left
+
+	//byte offsets of the attributes in a vertex: float3 position, float2 texCoord, float3 normal
+	struct Layout
+	{
+		unsigned int stride;
+		unsigned int position, texCoord, normal;
+	};
+
+	//one LOD's run of the concatenated index stream
+	struct Lod
+	{
+		unsigned int indexOffset, indexCount;
+		float error;	//object space, the furthest the LOD may be from the full mesh
+	};
+
+	unsigned int Simplify(const void *vertices, unsigned int vertexCount, const Layout &layout, const unsigned int *indices, unsigned int indexCount,
+		unsigned int targetIndexCount, float maxError, unsigned int *destination, float &error);
+	unsigned int GenerateLods(const void *vertices, unsigned int vertexCount, const Layout &layout, std::vector<unsigned int> &indices, Lod *lods);
+}
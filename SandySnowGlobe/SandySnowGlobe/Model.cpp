@@ -1,28 +1,185 @@
 #include "Model.h"
+#include <cfloat>
+#include <cstddef>
+
+namespace
+{
+	/// <summary>
+	/// Fill position/texCoord/normal of three vertices per triangle from the parsed corners
+	/// Missing texcoords are zero, missing normals are the face normal
+	/// </summary>
+	template <typename T> void ExpandCorners(const ObjParser &obj, T *vert)
+	{
+		const std::vector<ObjParser::Corner> &corners = obj.Corners();
+		const float *v = obj.Positions().empty() ? nullptr : &obj.Positions()[0];
+		const float *t = obj.TexCoords().empty() ? nullptr : &obj.TexCoords()[0];
+		const float *n = obj.Normals().empty() ? nullptr : &obj.Normals()[0];
+
+		for(unsigned int i = 0; i < corners.size(); i++)
+		{
+			const ObjParser::Corner &corner = corners[i];
+
+			vert[i].position = DirectX::XMFLOAT3(v[corner.position * 3], v[corner.position * 3 + 1], v[corner.position * 3 + 2]);
+			vert[i].texCoord = (corner.texCoord != ObjParser::NO_INDEX) ? DirectX::XMFLOAT2(t[corner.texCoord * 2], t[corner.texCoord * 2 + 1]) : DirectX::XMFLOAT2(0.0f, 0.0f);
+
+			if(corner.normal != ObjParser::NO_INDEX)
+			{
+				vert[i].normal = DirectX::XMFLOAT3(n[corner.normal * 3], n[corner.normal * 3 + 1], n[corner.normal * 3 + 2]);
+			}
+		}
+
+		for(unsigned int i = 0; i < corners.size(); i += 3)
+		{
+			if(corners[i].normal != ObjParser::NO_INDEX && corners[i + 1].normal != ObjParser::NO_INDEX && corners[i + 2].normal != ObjParser::NO_INDEX)
+			{
+				continue;
+			}
+
+			//clockwise winding, so this points out of the front face
+			DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&vert[i].position);
+			DirectX::XMVECTOR edge1 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vert[i + 1].position), a);
+			DirectX::XMVECTOR edge2 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vert[i + 2].position), a);
+			DirectX::XMFLOAT3 faceNormal;
+			DirectX::XMStoreFloat3(&faceNormal, DirectX::XMVector3Normalize(DirectX::XMVector3Cross(edge1, edge2)));
+
+			for(unsigned int c = i; c < i + 3; c++)
+			{
+				if(corners[c].normal == ObjParser::NO_INDEX)
+				{
+					vert[c].normal = faceNormal;
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Weld a triangle soup into shared vertices, then order triangles for the vertex cache and vertices for fetch
+	/// Tangent frames are generated between welding and ordering, on the shared vertices, when a layout is given
+	/// </summary>
+	/// <param name="vertices">Soup, three vertices per triangle, compacted in place</param>
+	/// <param name="stride">Bytes per vertex</param>
+	/// <param name="cornerCount">Vertices in the soup</param>
+	/// <param name="indices">Out, cornerCount indices</param>
+	/// <param name="tangents">Attribute offsets for tangent generation, nullptr for none</param>
+	/// <param name="workers">Pool for large meshes, may be nullptr</param>
+	/// <returns>Unique vertex count</returns>
+	unsigned int IndexMesh(void *vertices, unsigned int stride, unsigned int cornerCount, std::vector<unsigned int> &indices, const TangentFrame::Layout *tangents, WorkerPool *workers)
+	{
+		indices.resize(cornerCount);
+
+		unsigned int unique = MeshOptimizer::Weld(vertices, cornerCount, stride, &indices[0]);
+
+		if(tangents != nullptr)
+		{
+			unique = TangentFrame::Generate(vertices, unique, cornerCount, *tangents, &indices[0], cornerCount, workers);
+		}
+
+		float weldedAcmr = MeshOptimizer::Acmr(&indices[0], cornerCount, unique);
+
+		MeshOptimizer::OptimizeVertexCache(&indices[0], cornerCount, unique);
+		MeshOptimizer::OptimizeVertexFetch(vertices, unique, stride, &indices[0], cornerCount);
+
+		Logger::Log("Indexed mesh: " + std::to_string(cornerCount) + " vertices welded to " + std::to_string(unique) +
+			", ACMR " + std::to_string(weldedAcmr) + " in file order, " + std::to_string(MeshOptimizer::Acmr(&indices[0], cornerCount, unique)) + " optimized");
+
+		return unique;
+	}
+
+	/// <summary>
+	/// Axis aligned bounds of a vertex stream and the radius of the sphere around their centre, every vertex struct starts with its XMFLOAT3 position
+	/// </summary>
+	void ComputeBounds(const void *vertices, unsigned int stride, unsigned int count, DirectX::XMFLOAT3 &boundsMin, DirectX::XMFLOAT3 &boundsMax, float &boundsRadius)
+	{
+		DirectX::XMVECTOR low = DirectX::XMVectorReplicate(FLT_MAX);
+		DirectX::XMVECTOR high = DirectX::XMVectorReplicate(-FLT_MAX);
+		const unsigned char *data = static_cast<const unsigned char *>(vertices);
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			DirectX::XMVECTOR position = DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3 *>(data + (i * stride)));
+
+			low = DirectX::XMVectorMin(low, position);
+			high = DirectX::XMVectorMax(high, position);
+		}
+
+		if(count == 0)
+		{
+			low = high = DirectX::XMVectorZero();
+		}
+
+		DirectX::XMStoreFloat3(&boundsMin, low);
+		DirectX::XMStoreFloat3(&boundsMax, high);
+
+		DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(low, high), 0.5f);
+		DirectX::XMVECTOR radiusSq = DirectX::XMVectorZero();
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3 *>(data + (i * stride))), center);
+
+			radiusSq = DirectX::XMVectorMax(radiusSq, DirectX::XMVector3LengthSq(offset));
+		}
+
+		boundsRadius = DirectX::XMVectorGetX(DirectX::XMVectorSqrt(radiusSq));
+	}
+
+	/// <summary>
+	/// Narrow indices to 16 bit when every vertex fits, the packed bytes are what the index buffer and the mesh cache hold
+	/// </summary>
+	/// <returns>Index format of the packed bytes</returns>
+	DXGI_FORMAT PackIndices(const std::vector<unsigned int> &indices, unsigned int vertexCount, std::vector<unsigned char> &packed)
+	{
+		if(vertexCount >= 65536)
+		{
+			packed.resize(indices.size() * sizeof(unsigned int));
+			memcpy(&packed[0], &indices[0], packed.size());
+
+			return DXGI_FORMAT_R32_UINT;
+		}
+
+		packed.resize(indices.size() * sizeof(unsigned short));
+		unsigned short *shortIndices = reinterpret_cast<unsigned short *>(&packed[0]);
+
+		for(unsigned int i = 0; i < indices.size(); i++)
+		{
+			shortIndices[i] = (unsigned short)indices[i];
+		}
+
+		return DXGI_FORMAT_R16_UINT;
+	}
+}
+
+//CPU side of a mesh between Read* and Create, the streams point into the cache mapping on a hit, else into the vectors
+struct Model::Staging
+{
+	MeshCache cache;
+	std::vector<unsigned char> vertexBytes, indexBytes, packedBytes;
+	const void *vertices, *indices;
+	unsigned int stride;
+};
+
+WorkerPool *Model::workers = nullptr;
 
 Model::Model()
 {
 	vertexBuffer = nullptr;
 	indexBuffer = nullptr;
-	texture = nullptr;
 	vertexCount = 0;
 	texCoCount = 0;
 	normCount = 0;
 	faceCount = 0;
 	indexCount = 0;
 	textureCount = 0;
+	vertexStride = sizeof(Vertex);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	boundsMin = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	boundsMax = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	boundsRadius = 0.0f;
+	meshFormat = MESH_VERTEX;
 }
 
 Model::~Model()
 {
-	try
-	{
-		Memory::SafeDelete(texture);	//delete pointer to array of comptrs
-	}
-	catch(int &e)
-	{
-		delete texture;
-	}
 }
 
 /// <summary>
@@ -34,24 +191,7 @@ Model::~Model()
 /// <returns></returns>
 bool Model::Init(ID3D11Device *device, const WCHAR *filename)
 {
-	if(!CheckModelCounts(filename, vertexCount, texCoCount, normCount, faceCount))
-	{
-		return false;
-	}
-
-	Vertex *vertices = new Vertex[faceCount * 3];
-
-	if(!LoadModel(filename, vertices))
-	{
-		return false;
-	}
-
-	if(!Init(device, vertices))
-	{
-		return false;
-	}
-
-	return true;
+	return LoadMesh(device, filename, MESH_VERTEX);
 }
 
 /// <summary>
@@ -69,24 +209,7 @@ bool Model::Init(ID3D11Device *device, const WCHAR *filename, const WCHAR *textu
 		return false;
 	}
 
-	if(!CheckModelCounts(filename, vertexCount, texCoCount, normCount, faceCount))
-	{
-		return false;
-	}
-
-	Vertex *vertices = new Vertex[faceCount * 3];
-
-	if(!LoadModel(filename, vertices))
-	{
-		return false;
-	}
-
-	if(!Init(device, vertices))
-	{
-		return false;
-	}
-
-	return true;
+	return LoadMesh(device, filename, MESH_VERTEX);
 }
 
 /// <summary>
@@ -105,21 +228,7 @@ bool Model::Init(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTe
 		return false;
 	}
 
-	if(!CheckModelCounts(filename, vertexCount, texCoCount, normCount, faceCount))
-	{
-		return false;
-	}
-
-	Vertex *vertices = new Vertex[faceCount * 3];
-	if(!LoadModel(filename, vertices))
-	{
-		return false;
-	}
-
-	if(!Init(device, vertices))
-	{
-		return false;
-	}
+	return LoadMesh(device, filename, MESH_VERTEX);
 }
 
 /// <summary>
@@ -139,106 +248,221 @@ bool Model::Init(ID3D11Device *device, const WCHAR *filename, const WCHAR *colou
 		return false;
 	}
 
-	if(!CheckModelCounts(filename, vertexCount, texCoCount, normCount, faceCount))
+	return LoadMesh(device, filename, MESH_BUMP_PACKED);
+}
+
+/// <summary>
+/// Index and optimize preloaded vertices (pos/tex/norm), then initialise buffers
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="vertices">Preloaded vertices (pos/tex/norm), three per triangle, deleted here</param>
+/// <returns></returns>
+bool Model::Init(ID3D11Device *device, Vertex *vertices)
+{
+	IndexSoup(vertices, sizeof(Vertex), MESH_VERTEX, nullptr);
+	bool result = Create(device);
+
+	Memory::SafeDeleteArr(vertices);
+
+	return result;
+}
+
+/// <summary>
+/// Index and optimize preloaded vertices (pos/tex/norm), generate their tangents and pack them, then initialise buffers
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="vertices">Preloaded vertices (pos/tex/norm), three per triangle, tangents zeroed, deleted here</param>
+/// <returns></returns>
+bool Model::InitBump(ID3D11Device *device, BumpVertex *vertices)
+{
+	IndexSoup(vertices, sizeof(BumpVertex), MESH_BUMP_PACKED, nullptr);
+	bool result = Create(device);
+
+	Memory::SafeDeleteArr(vertices);
+
+	return result;
+}
+
+bool Model::LoadMesh(ID3D11Device *device, const WCHAR *filename, MeshFormat format)
+{
+	if(!ReadMesh(filename, format))
 	{
 		return false;
 	}
 
-	BumpVertex *bVertices = new BumpVertex[faceCount * 3];
-	if(!LoadBumpModel(filename, bVertices))
+	return Create(device);
+}
+
+/// <summary>
+/// Load a mesh's streams from its cache when the cache is current, else from the .obj, writing the cache for next time
+/// No D3D calls, safe on a worker as long as nothing else touches this model until Create
+/// </summary>
+/// <param name="filename">Model filepath</param>
+/// <param name="format">Vertex format to load</param>
+/// <returns></returns>
+bool Model::ReadMesh(const WCHAR *filename, MeshFormat format)
+{
+	unsigned int stride = (format == MESH_VERTEX) ? sizeof(Vertex) : sizeof(BumpVertex);	//of the soup, both bump formats start as BumpVertex
+	unsigned int cachedStride = (format == MESH_BUMP_PACKED) ? sizeof(VertexPacking::PackedBumpVertex) : stride;
+	staging.reset(new Staging());
+
+	if(staging->cache.Open(filename, format, cachedStride))
 	{
-		return false;
+		meshFormat = format;
+		vertexCount = staging->cache.VertexCount();
+		lods.assign(staging->cache.Lods(), staging->cache.Lods() + staging->cache.LodCount());
+		indexCount = lods[0].indexCount;
+		faceCount = indexCount / 3;
+		indexFormat = (staging->cache.IndexSize() == sizeof(unsigned short)) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		boundsMin = DirectX::XMFLOAT3(staging->cache.BoundsMin());
+		boundsMax = DirectX::XMFLOAT3(staging->cache.BoundsMax());
+		boundsRadius = staging->cache.BoundsRadius();
+		staging->vertices = staging->cache.Vertices();
+		staging->indices = staging->cache.Indices();
+		staging->stride = cachedStride;
+
+		Logger::Log("Mesh cache hit: " + std::to_string(vertexCount) + " vertices, " + std::to_string(indexCount) + " indices, " + std::to_string(lods.size()) + " LODs");
+
+		return true;
 	}
 
-	if(!InitBump(device, bVertices))
+	ObjParser obj;
+
+	if(!LoadObj(filename, obj))
 	{
+		staging.reset();
 		return false;
 	}
+
+	//the soup is expanded straight into the vertex stream and compacted there
+	staging->vertexBytes.resize(faceCount * 3 * stride);
+
+	if(format != MESH_VERTEX)
+	{
+		LoadBumpModel(obj, reinterpret_cast<BumpVertex *>(&staging->vertexBytes[0]));
+	}
+	else
+	{
+		LoadModel(obj, reinterpret_cast<Vertex *>(&staging->vertexBytes[0]));
+	}
+
+	IndexSoup(&staging->vertexBytes[0], stride, format, filename);
+
+	return true;
 }
 
 /// <summary>
-/// Initialise buffers with preset vertices (pos/tex/norm)
+/// Index and optimize a triangle soup, generate tangents for the bump formats, build its LOD chain and take its bounds, staging the streams for Create
+/// MESH_BUMP_PACKED is then encoded against those bounds into the packed stream, which is what is staged and cached
 /// </summary>
-/// <param name="device">Standard ID3D11Device</param>
-/// <param name="vertices">Preloaded vertices (pos/tex/norm)</param>
-/// <returns></returns>
-bool Model::Init(ID3D11Device *device, Vertex *vertices)
+/// <param name="vertices">Three vertices per triangle (indexCount), compacted in place, must live until Create</param>
+/// <param name="stride">Bytes per vertex of the soup, BumpVertex for both bump formats</param>
+/// <param name="format">Vertex format, recorded in the cache</param>
+/// <param name="cacheSource">Source .obj to write the mesh cache for, nullptr for none</param>
+void Model::IndexSoup(void *vertices, unsigned int stride, MeshFormat format, const WCHAR *cacheSource)
 {
-	unsigned long *indices = new unsigned long[indexCount];
+	std::vector<unsigned int> indices;
 
-	for(int i = 0; i < vertexCount; i++)
+	if(!staging)
 	{
-		indices[i] = i;
+		staging.reset(new Staging());
 	}
 
-	D3D11_BUFFER_DESC vertexDesc;
-	D3D11_SUBRESOURCE_DATA vertexData;
+	TangentFrame::Layout tangents = { sizeof(BumpVertex), offsetof(BumpVertex, position), offsetof(BumpVertex, texCoord), offsetof(BumpVertex, normal), offsetof(BumpVertex, tangent) };
 
-	vertexDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexDesc.ByteWidth = sizeof(Vertex) * vertexCount;
-	vertexDesc.CPUAccessFlags = 0;
-	vertexDesc.MiscFlags = 0;
-	vertexDesc.StructureByteStride = 0;
-	vertexDesc.Usage = D3D11_USAGE_DEFAULT;
+	vertexCount = IndexMesh(vertices, stride, indexCount, indices, (format != MESH_VERTEX) ? &tangents : nullptr, workers);
 
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
+	//simplified on the float vertices, before any packing, the LODs' indices are appended to the full mesh's
+	MeshSimplifier::Layout layout = { stride, offsetof(Vertex, position), offsetof(Vertex, texCoord), offsetof(Vertex, normal) };
+	lods.resize(MeshSimplifier::MAX_LODS);
+	lods.resize(MeshSimplifier::GenerateLods(vertices, vertexCount, layout, indices, &lods[0]));
 
-	HRESULT result = device->CreateBuffer(&vertexDesc, &vertexData, vertexBuffer.GetAddressOf());
+	std::string lodLog = "Mesh LODs:";
 
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create vertex buffer"))
+	for(unsigned int i = 0; i < lods.size(); i++)
 	{
-		return false;
+		lodLog += " " + std::to_string(lods[i].indexCount / 3) + " triangles (error " + std::to_string(lods[i].error) + ")";
 	}
 
-	D3D11_BUFFER_DESC indexDesc;
-	D3D11_SUBRESOURCE_DATA indexData;
+	Logger::Log(lodLog);
 
-	indexDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexDesc.ByteWidth = sizeof(unsigned long) * indexCount;
-	indexDesc.CPUAccessFlags = 0;
-	indexDesc.MiscFlags = 0;
-	indexDesc.StructureByteStride = 0;
-	indexDesc.Usage = D3D11_USAGE_DEFAULT;
+	indexFormat = PackIndices(indices, vertexCount, staging->indexBytes);
+	ComputeBounds(vertices, stride, vertexCount, boundsMin, boundsMax, boundsRadius);
+	meshFormat = format;
 
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
+	staging->vertices = vertices;
+	staging->indices = &staging->indexBytes[0];
+	staging->stride = stride;
 
-	result = device->CreateBuffer(&indexDesc, &indexData, indexBuffer.GetAddressOf());
-
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create index buffer"))
+	if(format == MESH_BUMP_PACKED)
 	{
-		return false;
+		staging->packedBytes.resize(vertexCount * sizeof(VertexPacking::PackedBumpVertex));
+		VertexPacking::PackedBumpVertex *packed = reinterpret_cast<VertexPacking::PackedBumpVertex *>(&staging->packedBytes[0]);
+
+		VertexPacking::EncodeMesh(vertices, vertexCount, tangents, VertexPacking::MakeBounds(&boundsMin.x, &boundsMax.x), packed);
+
+		staging->vertices = packed;
+		staging->stride = sizeof(VertexPacking::PackedBumpVertex);
 	}
 
-	Memory::SafeDeleteArr(vertices);
-	Memory::SafeDeleteArr(indices);
+	if(cacheSource != nullptr)
+	{
+		unsigned int indexSize = (indexFormat == DXGI_FORMAT_R16_UINT) ? sizeof(unsigned short) : sizeof(unsigned int);
 
-	return true;
+		if(!MeshCache::Write(cacheSource, format, staging->vertices, vertexCount, staging->stride, staging->indices, (unsigned int)indices.size(), indexSize,
+			&boundsMin.x, &boundsMax.x, boundsRadius, &lods[0], (unsigned int)lods.size()))
+		{
+			Logger::Log("Mesh cache could not be written, the mesh will be parsed again next run");
+		}
+	}
 }
 
 /// <summary>
-/// Initialise buffers with preset vertices (pos/tex/norm/tang/binorm)
+/// Create the buffers from the staged streams and release them, on the device's thread
 /// </summary>
 /// <param name="device">Standard ID3D11Device</param>
-/// <param name="vertices">Preloaded vertices (pos/tex/norm/tang/binorm)</param>
-/// <returns></returns>
-bool Model::InitBump(ID3D11Device *device, BumpVertex *vertices)
+/// <returns>false if nothing was staged or the buffers could not be made</returns>
+bool Model::Create(ID3D11Device *device)
 {
-	unsigned long *indices = new unsigned long[indexCount];
-
-	for(int i = 0; i < indexCount; i++)
+	if(!staging)
 	{
-		indices[i] = i;
+		return false;
 	}
 
+	bool result = InitBuffers(device, staging->vertices, staging->stride, staging->indices);
+
+	staging.reset();
+
+	return result;
+}
+
+/// <summary>
+/// Share an already loaded texture, textures are bound in the order they are added
+/// </summary>
+/// <param name="tex">Texture</param>
+void Model::AddTexture(const std::shared_ptr<Texture> &tex)
+{
+	texture.push_back(tex);
+	textureCount = (unsigned int)texture.size();
+}
+
+/// <summary>
+/// Create the vertex buffer and the index buffer
+/// </summary>
+/// <param name="device">Standard ID3D11Device</param>
+/// <param name="vertices">vertexCount vertices</param>
+/// <param name="stride">Bytes per vertex</param>
+/// <param name="indices">Every LOD's indices, in indexFormat</param>
+/// <returns></returns>
+bool Model::InitBuffers(ID3D11Device *device, const void *vertices, unsigned int stride, const void *indices)
+{
 	D3D11_BUFFER_DESC vertexDesc;
 	D3D11_SUBRESOURCE_DATA vertexData;
 
+	vertexStride = stride;
+
 	vertexDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexDesc.ByteWidth = sizeof(BumpVertex) * vertexCount;
+	vertexDesc.ByteWidth = stride * vertexCount;
 	vertexDesc.CPUAccessFlags = 0;
 	vertexDesc.MiscFlags = 0;
 	vertexDesc.StructureByteStride = 0;
@@ -259,7 +483,7 @@ bool Model::InitBump(ID3D11Device *device, BumpVertex *vertices)
 	D3D11_SUBRESOURCE_DATA indexData;
 
 	indexDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexDesc.ByteWidth = sizeof(unsigned long) * indexCount;
+	indexDesc.ByteWidth = ((indexFormat == DXGI_FORMAT_R16_UINT) ? sizeof(unsigned short) : sizeof(unsigned int)) * (lods.back().indexOffset + lods.back().indexCount);
 	indexDesc.CPUAccessFlags = 0;
 	indexDesc.MiscFlags = 0;
 	indexDesc.StructureByteStride = 0;
@@ -276,9 +500,6 @@ bool Model::InitBump(ID3D11Device *device, BumpVertex *vertices)
 		return false;
 	}
 
-	Memory::SafeDeleteArr(vertices);
-	Memory::SafeDeleteArr(indices);
-
 	return true;
 }
 
@@ -296,14 +517,27 @@ bool Model::InitBillboared(ID3D11Device *device, const WCHAR *texture1, const WC
 		return false;
 	}
 
+	ReadBillboard();
+
+	return Create(device);
+}
+
+/// <summary>
+/// Stage the billboarded quad's streams for Create
+/// </summary>
+void Model::ReadBillboard()
+{
 	vertexCount = 6;
 	indexCount = 6;
 
-	ParticleVertex *vertices = new ParticleVertex[vertexCount];
+	staging.reset(new Staging());
+	staging->vertexBytes.resize(sizeof(ParticleVertex) * vertexCount);
+	staging->indexBytes.resize(sizeof(unsigned short) * indexCount);
 
-	unsigned long *indices = new unsigned long[indexCount];
+	ParticleVertex *vertices = reinterpret_cast<ParticleVertex *>(&staging->vertexBytes[0]);
+	unsigned short *indices = reinterpret_cast<unsigned short *>(&staging->indexBytes[0]);
 
-	for(int i = 0; i < indexCount; i++)
+	for(unsigned int i = 0; i < indexCount; i++)
 	{
 		indices[i] = i;
 	}
@@ -330,531 +564,129 @@ bool Model::InitBillboared(ID3D11Device *device, const WCHAR *texture1, const WC
 	vertices[5].texCoord = DirectX::XMFLOAT2(1.0f, 0.0f);
 	vertices[5].colour = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 
-	D3D11_BUFFER_DESC vertexDesc;
-	D3D11_SUBRESOURCE_DATA vertexData;
-
-	vertexDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexDesc.ByteWidth = sizeof(ParticleVertex) * vertexCount;
-	vertexDesc.CPUAccessFlags = 0;
-	vertexDesc.MiscFlags = 0;
-	vertexDesc.StructureByteStride = 0;
-	vertexDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-
-	HRESULT result = device->CreateBuffer(&vertexDesc, &vertexData, vertexBuffer.GetAddressOf());
-
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create vertex buffer"))
-	{
-		return false;
-	}
-
-	D3D11_BUFFER_DESC indexDesc;
-	D3D11_SUBRESOURCE_DATA indexData;
-
-	indexDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexDesc.ByteWidth = sizeof(unsigned long) * indexCount;
-	indexDesc.CPUAccessFlags = 0;
-	indexDesc.MiscFlags = 0;
-	indexDesc.StructureByteStride = 0;
-	indexDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-
-	result = device->CreateBuffer(&indexDesc, &indexData, indexBuffer.GetAddressOf());
-
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create index buffer"))
-	{
-		return false;
-	}
-
-	Memory::SafeDeleteArr(vertices);
-	Memory::SafeDeleteArr(indices);
-
-	return true;
+	indexFormat = DXGI_FORMAT_R16_UINT;
+	lods.assign(1, MeshSimplifier::Lod());
+	lods[0].indexOffset = 0;
+	lods[0].indexCount = indexCount;
+	lods[0].error = 0.0f;
+	boundsMin = DirectX::XMFLOAT3(-1.0f, -1.0f, 0.0f);
+	boundsMax = DirectX::XMFLOAT3(1.0f, 1.0f, 0.0f);
+	boundsRadius = 1.41421356f;
+
+	staging->vertices = vertices;
+	staging->indices = indices;
+	staging->stride = sizeof(ParticleVertex);
 }
 
 void Model::Render(ID3D11DeviceContext *devContext)
 {
-	unsigned int stride;
-	stride = sizeof(Vertex);
-
-	if(textureCount == 3)
-	{
-		if(faceCount == 0)
-			stride = sizeof(ParticleVertex);
-		else
-			stride = sizeof(BumpVertex);
-	}
+	Render(devContext, 0);
+}
 
+/// <summary>
+/// Bind the buffers with the index buffer offset to a LOD's run, the draw that follows uses LodIndexCount(lod) indices
+/// </summary>
+/// <param name="devContext">Standard ID3D11DeviceContext</param>
+/// <param name="lod">LOD, 0 is the full mesh, clamped to the coarsest</param>
+void Model::Render(ID3D11DeviceContext *devContext, unsigned int lod)
+{
 	unsigned int offset = 0;
+	unsigned int indexSize = (indexFormat == DXGI_FORMAT_R16_UINT) ? sizeof(unsigned short) : sizeof(unsigned int);
+
+	lod = (lod < lods.size()) ? lod : (unsigned int)lods.size() - 1;
 
-	devContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	devContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	devContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &vertexStride, &offset);
+	devContext->IASetIndexBuffer(indexBuffer.Get(), indexFormat, lods[lod].indexOffset * indexSize);
 	devContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
 /// <summary>
-/// Read in obj file and return counts of vert/tex/norm/face
+/// Map and parse an obj file in one pass, in parallel on the shared workers if it is large, and take its counts
 /// </summary>
 /// <param name="filename">OBJ filepath</param>
-/// <param name="vCount">Vertex count</param>
-/// <param name="tCount">Texture coord count</param>
-/// <param name="nCount">Normal count</param>
-/// <param name="fCount">Face count</param>
-/// <returns></returns>
-bool Model::CheckModelCounts(const WCHAR *filename, unsigned int &vCount, unsigned int &tCount, unsigned int &nCount, unsigned int &fCount) const
+/// <param name="obj">Parsed file</param>
+/// <returns>false if the file could not be read or has no faces</returns>
+bool Model::LoadObj(const WCHAR *filename, ObjParser &obj)
 {
-	std::ifstream input;
-	char c;
-
-	input.open(filename);
+	obj.Workers(workers);
 
-	if(input.fail())
+	if(!obj.Load(filename))
 	{
 		return false;
 	}
 
-	input.get(c);
-	while(!input.eof())
-	{
-		switch(c)
-		{
-			case 'v':
-				input.get(c);
-				if(c == ' ')
-					vCount++;
-				if(c == 't')
-					tCount++;
-				if(c == 'n')
-					nCount++;
-				break;
-			case 'f':
-				fCount++;
-				break;
-		}
-		
-		while(c != '\n')
-		{
-			input.get(c);
-		}
-
-		input.get(c);
-	}
-
-	input.close();
+	vertexCount = obj.PositionCount();
+	texCoCount = obj.TexCoordCount();
+	normCount = obj.NormalCount();
+	faceCount = obj.TriangleCount();
 
-	return true;
+	return faceCount > 0;
 }
 
 /// <summary>
-/// Read in obj file and add to vertex struct
+/// Expand parsed obj corners into the vertex struct, three vertices per triangle
 /// </summary>
-/// <param name="filename">OBJ filepath</param>
-/// <param name="vert">Vertex struct</param>
-/// <returns></returns>
-bool Model::LoadModel(const WCHAR *filename, Vertex *vert)
+/// <param name="obj">Parsed obj</param>
+/// <param name="vert">Vertex struct, faceCount * 3</param>
+void Model::LoadModel(const ObjParser &obj, Vertex *vert)
 {
-	DirectX::XMFLOAT3 *v = new DirectX::XMFLOAT3[vertexCount];
-	DirectX::XMFLOAT2 *t = new DirectX::XMFLOAT2[texCoCount];
-	DirectX::XMFLOAT3 *n = new DirectX::XMFLOAT3[normCount];
-	Face *f = new Face[faceCount];
-
-	std::ifstream input;
-	char c;
-
-	unsigned int vertIndex = 0;
-	unsigned int texIndex = 0;
-	unsigned int normIndex = 0;
-	unsigned int faceIndex = 0;
-
-	input.open(filename);
-
-	if(input.fail())
-	{
-		return false;
-	}
-
-	input.get(c);
-	while(!input.eof())
-	{
-		switch(c)
-		{
-		case 'v':
-			input.get(c);
-			if(c == ' ')
-			{
-				input >> v[vertIndex].x >> v[vertIndex].y >> v[vertIndex].z;
-				v[vertIndex].z *= -1.0f;
-				vertIndex++;
-				break;
-			}
-
-			if(c == 't')
-			{
-				input >> t[texIndex].x >> t[texIndex].y;
-				t[texIndex].y = 1.0f - t[texIndex].y;
-				texIndex++;
-				break;
-			}
-
-			if(c == 'n')
-			{
-				input >> n[normIndex].x >> n[normIndex].y >> n[normIndex].z;
-				n[normIndex].z *= -1.0f;
-				normIndex++;
-				break;
-			}
-
-		case 'f':
-			char c2;
-			input >> f[faceIndex].vert3 >> c2 >> f[faceIndex].tex3 >> c2 >> f[faceIndex].norm3
-				>> f[faceIndex].vert2 >> c2 >> f[faceIndex].tex2 >> c2 >> f[faceIndex].norm2
-				>> f[faceIndex].vert1 >> c2 >> f[faceIndex].tex1 >> c2 >> f[faceIndex].norm1;
-			faceIndex++;
-			break;
-		}
-
-		while(c != '\n')
-		{
-			input.get(c);
-		}
-
-		input.get(c);
-	}
-
-	input.close();
-
-	vertIndex = 0;
-	texIndex = 0;
-	normIndex = 0;
+	ExpandCorners(obj, vert);
 
 	vertexCount = faceCount * 3;
 	indexCount = vertexCount;
-
-	unsigned int newIndex = 0;
-
-	//reorder vertices
-	for(int i = 0; i < faceCount; i++)
-	{
-		vertIndex = f[i].vert1 - 1;
-		texIndex = f[i].tex1 - 1;
-		normIndex = f[i].norm1 - 1;
-
-		vert[newIndex].position.x = v[vertIndex].x;
-		vert[newIndex].position.y = v[vertIndex].y;
-		vert[newIndex].position.z = v[vertIndex].z;
-		vert[newIndex].texCoord.x = t[texIndex].x;
-		vert[newIndex].texCoord.y = t[texIndex].y;
-		vert[newIndex].normal.x = n[normIndex].x;
-		vert[newIndex].normal.y = n[normIndex].y;
-		vert[newIndex].normal.z = n[normIndex].z;
-
-		newIndex++;
-
-		vertIndex = f[i].vert2 - 1;
-		texIndex = f[i].tex2 - 1;
-		normIndex = f[i].norm2 - 1;
-
-		vert[newIndex].position.x = v[vertIndex].x;
-		vert[newIndex].position.y = v[vertIndex].y;
-		vert[newIndex].position.z = v[vertIndex].z;
-		vert[newIndex].texCoord.x = t[texIndex].x;
-		vert[newIndex].texCoord.y = t[texIndex].y;
-		vert[newIndex].normal.x = n[normIndex].x;
-		vert[newIndex].normal.y = n[normIndex].y;
-		vert[newIndex].normal.z = n[normIndex].z;
-
-		newIndex++;
-
-		vertIndex = f[i].vert3 - 1;
-		texIndex = f[i].tex3 - 1;
-		normIndex = f[i].norm3 - 1;
-
-		vert[newIndex].position.x = v[vertIndex].x;
-		vert[newIndex].position.y = v[vertIndex].y;
-		vert[newIndex].position.z = v[vertIndex].z;
-		vert[newIndex].texCoord.x = t[texIndex].x;
-		vert[newIndex].texCoord.y = t[texIndex].y;
-		vert[newIndex].normal.x = n[normIndex].x;
-		vert[newIndex].normal.y = n[normIndex].y;
-		vert[newIndex].normal.z = n[normIndex].z;
-
-		newIndex++;
-	}
-
-	Memory::SafeDeleteArr(v);
-	Memory::SafeDeleteArr(t);
-	Memory::SafeDeleteArr(n);
-	Memory::SafeDeleteArr(f);
-
-	return true;
 }
 
 /// <summary>
-/// Read in obj file, compute tangent/binormal and add to BumpVertex struct
+/// Expand parsed obj corners into BumpVertex, tangents are generated once the vertices are welded
 /// </summary>
-/// <param name="filename">OBJ filepath</param>
-/// <param name="vert">Vertex struct</param>
-/// <returns></returns>
-bool Model::LoadBumpModel(const WCHAR *filename, BumpVertex *vert)	//convert vert/norm/tex to vert
+/// <param name="obj">Parsed obj</param>
+/// <param name="vert">Vertex struct, faceCount * 3</param>
+void Model::LoadBumpModel(const ObjParser &obj, BumpVertex *vert)	//convert vert/norm/tex to vert
 {
-	DirectX::XMFLOAT3 *v = new DirectX::XMFLOAT3[vertexCount];
-	DirectX::XMFLOAT2 *t = new DirectX::XMFLOAT2[texCoCount];
-	DirectX::XMFLOAT3 *n = new DirectX::XMFLOAT3[normCount];
-	Face *f = new Face[faceCount];
-
-	std::ifstream input;
-	char c;
-
-	unsigned int vertIndex = 0;
-	unsigned int texIndex = 0;
-	unsigned int normIndex = 0;
-	unsigned int faceIndex = 0;
-
-	input.open(filename);
-
-	if(input.fail())
-	{
-		return false;
-	}
-
-	input.get(c);
-	while(!input.eof())
-	{
-		switch(c)
-		{
-		case 'v':
-			input.get(c);
-			if(c == ' ')
-			{
-				input >> v[vertIndex].x >> v[vertIndex].y >> v[vertIndex].z;
-				v[vertIndex].z *= -1.0f;
-				vertIndex++;
-				break;
-			}
-
-			if(c == 't')
-			{
-				input >> t[texIndex].x >> t[texIndex].y;
-				t[texIndex].y = 1.0f - t[texIndex].y;
-				texIndex++;
-				break;
-			}
-
-			if(c == 'n')
-			{
-				input >> n[normIndex].x >> n[normIndex].y >> n[normIndex].z;
-				n[normIndex].z *= -1.0f;
-				normIndex++;
-				break;
-			}
-
-		case 'f':
-			char c2;
-			input >> f[faceIndex].vert3 >> c2 >> f[faceIndex].tex3 >> c2 >> f[faceIndex].norm3
-				>> f[faceIndex].vert2 >> c2 >> f[faceIndex].tex2 >> c2 >> f[faceIndex].norm2
-				>> f[faceIndex].vert1 >> c2 >> f[faceIndex].tex1 >> c2 >> f[faceIndex].norm1;
-			faceIndex++;
-			break;
-		}
-
-		while(c != '\n')
-		{
-			input.get(c);
-		}
-
-		input.get(c);
-	}
-
-	input.close();
-
-	vertIndex = 0;
-	texIndex = 0;
-	normIndex = 0;
+	ExpandCorners(obj, vert);
 
 	vertexCount = faceCount * 3;
 	indexCount = vertexCount;
 
-	unsigned int newIndex = 0;
-
-	for(int i = 0; i < faceCount; i++)
+	//zeroed so welding compares only what was read
+	for(unsigned int i = 0; i < vertexCount; i++)
 	{
-		vertIndex = f[i].vert1 - 1;
-		texIndex = f[i].tex1 - 1;
-		normIndex = f[i].norm1 - 1;
-
-		vert[newIndex].position.x = v[vertIndex].x;
-		vert[newIndex].position.y = v[vertIndex].y;
-		vert[newIndex].position.z = v[vertIndex].z;
-		vert[newIndex].texCoord.x = t[texIndex].x;
-		vert[newIndex].texCoord.y = t[texIndex].y;
-		vert[newIndex].normal.x = n[normIndex].x;
-		vert[newIndex].normal.y = n[normIndex].y;
-		vert[newIndex].normal.z = n[normIndex].z;
-
-		newIndex++;
-
-		vertIndex = f[i].vert2 - 1;
-		texIndex = f[i].tex2 - 1;
-		normIndex = f[i].norm2 - 1;
-
-		vert[newIndex].position.x = v[vertIndex].x;
-		vert[newIndex].position.y = v[vertIndex].y;
-		vert[newIndex].position.z = v[vertIndex].z;
-		vert[newIndex].texCoord.x = t[texIndex].x;
-		vert[newIndex].texCoord.y = t[texIndex].y;
-		vert[newIndex].normal.x = n[normIndex].x;
-		vert[newIndex].normal.y = n[normIndex].y;
-		vert[newIndex].normal.z = n[normIndex].z;
-
-		newIndex++;
-
-		vertIndex = f[i].vert3 - 1;
-		texIndex = f[i].tex3 - 1;
-		normIndex = f[i].norm3 - 1;
-
-		vert[newIndex].position.x = v[vertIndex].x;
-		vert[newIndex].position.y = v[vertIndex].y;
-		vert[newIndex].position.z = v[vertIndex].z;
-		vert[newIndex].texCoord.x = t[texIndex].x;
-		vert[newIndex].texCoord.y = t[texIndex].y;
-		vert[newIndex].normal.x = n[normIndex].x;
-		vert[newIndex].normal.y = n[normIndex].y;
-		vert[newIndex].normal.z = n[normIndex].z;
-
-		newIndex++;
-
-		DirectX::XMFLOAT3 tangent, binormal, normal;
-
-		CalculateTangBinorm(vert[newIndex - 3], vert[newIndex - 2], vert[newIndex - 1], &tangent, &binormal);
-
-		vert[newIndex - 3].tangent = tangent;
-		vert[newIndex - 3].binormal = binormal;
-		vert[newIndex - 2].tangent = tangent;
-		vert[newIndex - 2].binormal = binormal;
-		vert[newIndex - 1].tangent = tangent;
-		vert[newIndex - 1].binormal = binormal;
+		vert[i].tangent = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
 	}
-
-	Memory::SafeDeleteArr(v);
-	Memory::SafeDeleteArr(t);
-	Memory::SafeDeleteArr(n);
-	Memory::SafeDeleteArr(f);
-
-	return true;
-}
-
-void Model::CalculateTangBinorm(BumpVertex &vert1, BumpVertex &vert2, BumpVertex &vert3, DirectX::XMFLOAT3 *tangent, DirectX::XMFLOAT3 *binormal) const
-{
-	DirectX::XMVECTOR v, length;
-	DirectX::XMFLOAT3 tempVert1, tempVert2;
-	DirectX::XMFLOAT2 tempU, tempV;
-	float denominator;
-
-	v = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vert2.position), DirectX::XMLoadFloat3(&vert1.position));
-	DirectX::XMStoreFloat3(&tempVert1, v);
-	v = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&vert3.position), DirectX::XMLoadFloat3(&vert1.position));
-	DirectX::XMStoreFloat3(&tempVert2, v);
-
-	tempU.x = vert2.texCoord.x - vert1.texCoord.x;
-	tempU.y = vert3.texCoord.x - vert1.texCoord.x;
-	tempV.x = vert2.texCoord.y - vert1.texCoord.y;
-	tempV.y = vert3.texCoord.y - vert1.texCoord.y;
-
-	denominator = 1.0f / (tempU.x * tempV.y - tempU.y * tempV.x);
-
-	tangent->x = (tempV.y * tempVert1.x - tempV.x * tempVert2.x) * denominator;
-	tangent->y = (tempV.y * tempVert1.y - tempV.x * tempVert2.y) * denominator;
-	tangent->z = (tempV.y * tempVert1.z - tempV.x * tempVert2.z) * denominator;
-
-	v = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(tangent));
-	DirectX::XMStoreFloat3(tangent, v);
-
-	binormal->x = (tempU.x * tempVert2.x - tempU.y * tempVert1.x) * denominator;
-	binormal->y = (tempU.x * tempVert2.y - tempU.y * tempVert1.y) * denominator;
-	binormal->z = (tempU.x * tempVert2.z - tempU.y * tempVert1.z) * denominator;
-
-	v = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(binormal));
-	DirectX::XMStoreFloat3(binormal, v);
 }
 
+/// <summary>
+/// Load and append a texture of this model's own, AssetCache shares them across models instead
+/// </summary>
+/// <param name="dev">Standard ID3D11Device</param>
+/// <param name="filename">DDS filepath</param>
+/// <returns></returns>
 bool Model::LoadTexture(ID3D11Device *dev, const WCHAR *filename)
 {
-	textureCount = 1;
-	texture = new Texture*[textureCount]();
-	texture[0] = new Texture();
-	HRESULT result = texture[0]->Init(dev, filename);
+	std::shared_ptr<Texture> t = std::make_shared<Texture>();
+	t->Init(dev, filename);
 
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Initialise texture"))
-	{
-		return false;
-	}
+	AddTexture(t);
 
-	return true;
+	return t->GetTexture() != nullptr;
 }
 
 bool Model::LoadTextures(ID3D11Device *dev, const WCHAR *skyTexture, const WCHAR *gradientTexture)
 {
-	textureCount = 2;
-	texture = new Texture*[textureCount]();
-	for(int i = 0; i < textureCount; i++)
-	{
-		texture[i] = new Texture();
-	}
+	bool result = LoadTexture(dev, skyTexture);
+	result = LoadTexture(dev, gradientTexture) && result;
 
-	HRESULT result = texture[0]->Init(dev, skyTexture);
-
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Initialise texture"))
-	{
-		return false;
-	}
-
-	result = texture[1]->Init(dev, gradientTexture);
-
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Initialise texture"))
-	{
-		return false;
-	}
-
-	return true;
+	return result;
 }
 
 bool Model::LoadTextures(ID3D11Device *dev, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture)
 {
-	textureCount = 3;
-	texture = new Texture*[textureCount]();
-	for(int i = 0; i < textureCount; i++)
-	{
-		texture[i] = new Texture();
-	}
-
-	HRESULT result = texture[0]->Init(dev, colourTexture);
-
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Initialise texture"))
-	{
-		return false;
-	}
-
-	result = texture[1]->Init(dev, normalTexture);
+	//all three are always appended, the vertex stride comes from the mesh format, not from how many loaded
+	bool result = LoadTexture(dev, colourTexture);
+	result = LoadTexture(dev, normalTexture) && result;
+	result = LoadTexture(dev, specularTexture) && result;
 
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Initialise texture"))
-	{
-		return false;
-	}
-
-	result = texture[2]->Init(dev, specularTexture);
-
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Initialise texture"))
-	{
-		return false;
-	}
-
-	return true;
+	return result;
 }
 
 ID3D11ShaderResourceView **Model::GetTextureArray(ID3D11ShaderResourceView **textureArray) const
@@ -868,3 +700,20 @@ ID3D11ShaderResourceView **Model::GetTextureArray(ID3D11ShaderResourceView **tex
 	return textureArray;
 }
 
+/// <summary>
+/// Copy up to maxCount of the model's views, in binding order
+/// </summary>
+/// <param name="textures">Out, maxCount views</param>
+/// <param name="maxCount">Room in textures</param>
+/// <returns>Views written</returns>
+unsigned int Model::GetTextures(ID3D11ShaderResourceView **textures, unsigned int maxCount) const
+{
+	unsigned int count = (textureCount < maxCount) ? textureCount : maxCount;
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		textures[i] = texture[i]->GetTexture();
+	}
+
+	return count;
+}
@@ -3,10 +3,18 @@
 #include "DirectXMath.h"
 #include <wrl.h>
 #include <string>
-#include <iostream>
-#include <fstream>
+#include <memory>
+#include <vector>
 #include "DXUtil.h"
 #include "Texture.h"
+#include "ObjParser.h"
+#include "MeshOptimizer.h"
+#include "MeshCache.h"
+#include "TangentFrame.h"
+#include "VertexPacking.h"
+#include "MeshSimplifier.h"
+
+class WorkerPool;
 
 class Model
 {
@@ -43,17 +51,14 @@ public:
 		BumpVertex(float x, float y, float z,
 			float u, float v,
 			float n1, float n2, float n3,
-			float tx, float ty, float tz,
-			float bx, float by, float bz) : position(x, y, z),
+			float tx, float ty, float tz, float tw) : position(x, y, z),
 			texCoord(u, v),
 			normal(n1, n2, n3),
-			tangent(tx, ty, tz),
-			binormal(bx, by, bz){}
+			tangent(tx, ty, tz, tw){}
 		DirectX::XMFLOAT3 position;
 		DirectX::XMFLOAT2 texCoord;
 		DirectX::XMFLOAT3 normal;
-		DirectX::XMFLOAT3 tangent;
-		DirectX::XMFLOAT3 binormal;
+		DirectX::XMFLOAT4 tangent;	//w is the binormal's handedness, binormal = cross(normal, tangent.xyz) * w
 	};
 
 	struct SkyDomeVertex
@@ -72,12 +77,9 @@ public:
 		float domeRadius;
 	};
 
-	struct Face
-	{
-		unsigned int vert1, vert2, vert3,
-					 tex1, tex2, tex3,
-					 norm1, norm2, norm3;
-	};
+	//vertex format ids in the mesh cache, never reuse a number
+	//MESH_BUMP is the float BumpVertex stream MESH_BUMP_PACKED is encoded from, Normal.vs reads MESH_BUMP_PACKED
+	enum MeshFormat { MESH_VERTEX = 1, MESH_BUMP = 2, MESH_BUMP_PACKED = 3 };
 
 	Model();
 	~Model();
@@ -91,27 +93,62 @@ public:
 	bool InitBump(ID3D11Device *device, BumpVertex *vertices);
 	bool InitBillboared(ID3D11Device *device, const WCHAR *texture1, const WCHAR *texture2, const WCHAR *texture3);
 	void Render(ID3D11DeviceContext *devContext);
+	void Render(ID3D11DeviceContext *devContext, unsigned int lod);
+
+	//two phase loading: Read* fills the vertex/index streams on any thread, Create makes the buffers on the device's thread
+	bool ReadMesh(const WCHAR *filename, MeshFormat format);
+	void ReadBillboard();
+	void AddTexture(const std::shared_ptr<Texture> &tex);
+	bool Create(ID3D11Device *device);
 
 	unsigned int VertexCount() const { return vertexCount; }
-	unsigned int IndexCount() const { return indexCount; }
+	unsigned int IndexCount() const { return indexCount; }	//of the full mesh, LOD 0
 	ID3D11ShaderResourceView *GetTexture(unsigned int id) const { return texture[id]->GetTexture(); }
 	ID3D11ShaderResourceView **GetTextureArray(ID3D11ShaderResourceView **textureArray) const;
+	unsigned int GetTextures(ID3D11ShaderResourceView **textures, unsigned int maxCount) const;	//no allocation, returns how many were written
 	unsigned int TextureCount() const { return textureCount; }
+	DXGI_FORMAT IndexFormat() const { return indexFormat; }
+
+	//shared by every Model, .obj files too large for one thread are parsed on it
+	static WorkerPool *Workers() { return workers; }
+	static void Workers(WorkerPool *val) { workers = val; }
+	MeshFormat Format() const { return meshFormat; }
+	const DirectX::XMFLOAT3 &BoundsMin() const { return boundsMin; }	//object space, MESH_BUMP_PACKED positions are fractions of these bounds
+	const DirectX::XMFLOAT3 &BoundsMax() const { return boundsMax; }
+	float BoundsRadius() const { return boundsRadius; }	//of the sphere around the box centre holding every vertex, tighter than the box's
+
+	//LOD 0 is the full mesh, every LOD shares the vertex buffer and has its own run of the index buffer
+	unsigned int LodCount() const { return (unsigned int)lods.size(); }
+	unsigned int LodIndexCount(unsigned int lod) const { return lods[lod].indexCount; }
+	float LodError(unsigned int lod) const { return lods[lod].error; }	//object space
 	
 private:
 	Model& operator= (const Model&);
 	Model(const Model&);
 
-	bool LoadModel(const WCHAR *filename, Vertex *vert);
-	bool LoadBumpModel(const WCHAR *filename, BumpVertex *vert);
-	bool CheckModelCounts(const WCHAR *filename, unsigned int &vCount, unsigned int &tCount, unsigned int &nCount, unsigned int &iCount) const;
+	struct Staging;
+
+	bool LoadMesh(ID3D11Device *device, const WCHAR *filename, MeshFormat format);
+	void IndexSoup(void *vertices, unsigned int stride, MeshFormat format, const WCHAR *cacheSource);
+	bool InitBuffers(ID3D11Device *device, const void *vertices, unsigned int stride, const void *indices);
+	bool LoadObj(const WCHAR *filename, ObjParser &obj);
+	void LoadModel(const ObjParser &obj, Vertex *vert);
+	void LoadBumpModel(const ObjParser &obj, BumpVertex *vert);
 	bool LoadTexture(ID3D11Device *dev, const WCHAR *filename);
 	bool LoadTextures(ID3D11Device *dev, const WCHAR *skyTexture, const WCHAR *gradientTexture);
 	bool LoadTextures(ID3D11Device *device, const WCHAR *colourTexture, const WCHAR *normalTexture, const WCHAR *specularTexture);
-	void CalculateTangBinorm(BumpVertex &vert1, BumpVertex &vert2, BumpVertex &vert3, DirectX::XMFLOAT3 *tangent, DirectX::XMFLOAT3 *binormal) const;
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer, indexBuffer;
+	unsigned int vertexStride;
+	DXGI_FORMAT indexFormat;
+	DirectX::XMFLOAT3 boundsMin, boundsMax;
+	float boundsRadius;
+	MeshFormat meshFormat;
 	unsigned int vertexCount, texCoCount, normCount, faceCount, indexCount, textureCount;
-	Texture **texture;
+	std::vector<std::shared_ptr<Texture>> texture;
+	std::vector<MeshSimplifier::Lod> lods;
+	std::unique_ptr<Staging> staging;	//streams between Read* and Create
+
+	static WorkerPool *workers;
 };
 
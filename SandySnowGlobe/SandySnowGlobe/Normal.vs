@@ -1,22 +1,40 @@
-cbuffer MatricesBuffer
+//Shader::ObjectBuffer, per draw
+cbuffer ObjectBuffer : register(b0)
 {
 	matrix worldMatrix;
+};
+
+//Shader::FrameBuffer, once a frame
+cbuffer FrameBuffer : register(b1)
+{
 	matrix viewMatrix;
 	matrix projMatrix;
+	float3 cameraPosition;
+	float padding;
 };
 
-cbuffer CameraBuffer
+cbuffer MeshBoundsBuffer : register(b2)
 {
-	float3 cameraPosition;
+	float3 boundsMin;
+	float padding1;
+	float3 boundsExtent;
+	float padding2;
 };
 
+//VertexPacking::PackedBumpVertex
 struct VertexInputType
 {
-	float4 position : POSITION;
+	float4 position : POSITION;	//xyz fractions of the mesh bounds (UNORM)
 	float2 texCoord : TEXCOORD0;
-	float3 normal : NORMAL;
-	float3 tangent : TANGENT;
-	float3 binormal : BINORMAL;
+	float4 frame : NORMAL;		//xy octahedral normal, z tangent angle, w handedness (UNORM)
+};
+
+//InstanceBatcher::Transform, vs_instanced only
+struct InstanceInputType
+{
+	float4 world0 : WORLD0;
+	float4 world1 : WORLD1;
+	float4 world2 : WORLD2;
 };
 
 struct PixelInputType
@@ -29,26 +47,65 @@ struct PixelInputType
 	float3 viewDirection : TEXCOORD1;
 };
 
-PixelInputType vs_main(VertexInputType input)
+//same steps as OctDecode in VertexPacking.cpp
+float3 DecodeNormal(float2 encoded)
+{
+	encoded = (encoded * 2.0f) - 1.0f;
+
+	float3 n = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float fold = saturate(-n.z);
+	n.xy += (n.xy >= 0.0f) ? -fold : fold;
+
+	return normalize(n);
+}
+
+//tangent at angle around the normal, measured in the basis ReferenceBasis in VertexPacking.cpp builds
+float3 DecodeTangent(float3 n, float angle)
+{
+	float s = (n.z >= 0.0f) ? 1.0f : -1.0f;
+	float a = -1.0f / (s + n.z);
+	float b = n.x * n.y * a;
+	float3 b1 = float3(1.0f + (s * n.x * n.x * a), s * b, -s * n.x);
+	float3 b2 = float3(b, s + (n.y * n.y * a), -n.y);
+
+	angle = (angle - 0.5f) * 6.28318531f;
+
+	return (cos(angle) * b1) + (sin(angle) * b2);
+}
+
+PixelInputType Transform(VertexInputType input, float4x3 world)
 {
 	PixelInputType output;
 	float4 worldPosition;
 
-	input.position.w = 1.0f;
-	output.position = mul(input.position, worldMatrix);
-	output.position = mul(output.position, viewMatrix);
+	float3 normal = DecodeNormal(input.frame.xy);
+	float3 tangent = DecodeTangent(normal, input.frame.z);
+	float handedness = (input.frame.w * 2.0f) - 1.0f;
+
+	input.position = float4(boundsMin + (input.position.xyz * boundsExtent), 1.0f);
+	worldPosition = float4(mul(input.position, world), 1.0f);
+	output.position = mul(worldPosition, viewMatrix);
 	output.position = mul(output.position, projMatrix);
 	output.texCoord = input.texCoord;
 
-	output.normal = mul(input.normal, (float3x3)worldMatrix);
+	output.normal = mul(normal, (float3x3)world);
 	output.normal = normalize(output.normal);
-	output.tangent = mul(input.tangent, (float3x3)worldMatrix);
+	output.tangent = mul(tangent, (float3x3)world);
 	output.tangent = normalize(output.tangent);
-	output.binormal = mul(input.binormal, (float3x3)worldMatrix);
-	output.binormal = normalize(output.binormal);
+	output.binormal = cross(output.normal, output.tangent) * handedness;
 
-	worldPosition = mul(input.position, worldMatrix);
 	output.viewDirection = normalize(cameraPosition.xyz - worldPosition.xyz);
 
 	return output;
+}
+
+PixelInputType vs_main(VertexInputType input)
+{
+	return Transform(input, (float4x3)worldMatrix);
+}
+
+//the columns are those of a row vector matrix, transposed back into one
+PixelInputType vs_instanced(VertexInputType input, InstanceInputType instance)
+{
+	return Transform(input, transpose(float3x4(instance.world0, instance.world1, instance.world2)));
 }
\ No newline at end of file
@@ -0,0 +1,528 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	//every power of ten a double holds exactly
+	const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const int MAX_EXACT_POW10 = 22;
+	const unsigned int MAX_MANTISSA_DIGITS = 19;	//still fits in 64 bits
+
+	//parallel parsing splits the text into chunks of at least MIN_CHUNK_BYTES, a few per thread so uneven chunks balance out
+	const std::size_t MIN_CHUNK_BYTES = 1 << 20;
+	const unsigned int CHUNKS_PER_THREAD = 4;
+
+	enum LineKind
+	{
+		LINE_OTHER,
+		LINE_POSITION,
+		LINE_TEXCOORD,
+		LINE_NORMAL,
+		LINE_FACE
+	};
+
+	inline bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline const char *SkipBlank(const char *p, const char *end)
+	{
+		while(p < end && IsBlank(*p))
+		{
+			p++;
+		}
+
+		return p;
+	}
+
+	inline const char *NextLine(const char *p, const char *end)
+	{
+		const void *newline = std::memchr(p, '\n', end - p);
+
+		return (newline != nullptr) ? static_cast<const char *>(newline) + 1 : end;
+	}
+
+	//what a line holds, p is past its leading blanks
+	inline LineKind Classify(const char *p, const char *end)
+	{
+		if(end - p < 2)
+		{
+			return LINE_OTHER;
+		}
+
+		if(p[0] == 'v' && IsBlank(p[1]))
+		{
+			return LINE_POSITION;
+		}
+
+		if(p[0] == 'v' && end - p >= 3 && IsBlank(p[2]))
+		{
+			return (p[1] == 't') ? LINE_TEXCOORD : (p[1] == 'n') ? LINE_NORMAL : LINE_OTHER;
+		}
+
+		return (p[0] == 'f' && IsBlank(p[1])) ? LINE_FACE : LINE_OTHER;
+	}
+
+	/// <summary>
+	/// Decimal float without strtod or the locale, up to 19 significant digits are kept then rounded once
+	/// </summary>
+	/// <returns>Position after the number, nullptr if there were no digits</returns>
+	const char *ParseFloat(const char *p, const char *end, float &out)
+	{
+		p = SkipBlank(p, end);
+
+		bool negative = false;
+
+		if(p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			p++;
+		}
+
+		unsigned long long mantissa = 0;
+		unsigned int digits = 0;
+		int exponent = 0;
+		bool any = false;
+
+		for(; p < end && IsDigit(*p); p++)
+		{
+			if(digits < MAX_MANTISSA_DIGITS)
+			{
+				mantissa = (mantissa * 10) + (unsigned int)(*p - '0');
+				digits += (mantissa != 0) ? 1 : 0;
+			}
+			else
+			{
+				exponent++;
+			}
+
+			any = true;
+		}
+
+		if(p < end && *p == '.')
+		{
+			for(p++; p < end && IsDigit(*p); p++)
+			{
+				if(digits < MAX_MANTISSA_DIGITS)
+				{
+					mantissa = (mantissa * 10) + (unsigned int)(*p - '0');
+					digits += (mantissa != 0) ? 1 : 0;
+					exponent--;
+				}
+
+				any = true;
+			}
+		}
+
+		if(!any)
+		{
+			return nullptr;
+		}
+
+		if(p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char *q = p + 1;
+			bool negativeExponent = false;
+
+			if(q < end && (*q == '-' || *q == '+'))
+			{
+				negativeExponent = (*q == '-');
+				q++;
+			}
+
+			if(q < end && IsDigit(*q))
+			{
+				int e = 0;
+
+				for(; q < end && IsDigit(*q); q++)
+				{
+					e = (e < 10000) ? (e * 10) + (*q - '0') : e;
+				}
+
+				exponent += negativeExponent ? -e : e;
+				p = q;
+			}
+		}
+
+		double value = (double)mantissa;
+
+		if(exponent < 0)
+		{
+			value = (exponent >= -MAX_EXACT_POW10) ? value / POW10[-exponent] : value * std::pow(10.0, exponent);
+		}
+		else if(exponent > 0)
+		{
+			value = (exponent <= MAX_EXACT_POW10) ? value * POW10[exponent] : value * std::pow(10.0, exponent);
+		}
+
+		out = (float)(negative ? -value : value);
+
+		return p;
+	}
+
+	//read up to count floats, missing trailing values are left as they are
+	const char *ParseFloats(const char *p, const char *end, float *out, unsigned int count)
+	{
+		for(unsigned int i = 0; i < count; i++)
+		{
+			const char *q = ParseFloat(p, end, out[i]);
+
+			if(q == nullptr)
+			{
+				break;
+			}
+
+			p = q;
+		}
+
+		return p;
+	}
+
+	/// <summary>
+	/// Signed decimal integer, no leading blanks
+	/// </summary>
+	/// <returns>Position after the number, nullptr if there were no digits</returns>
+	const char *ParseIndex(const char *p, const char *end, long &out)
+	{
+		bool negative = false;
+
+		if(p < end && *p == '-')
+		{
+			negative = true;
+			p++;
+		}
+
+		if(p == end || !IsDigit(*p))
+		{
+			return nullptr;
+		}
+
+		long value = 0;
+
+		for(; p < end && IsDigit(*p); p++)
+		{
+			value = (value < 100000000) ? (value * 10) + (*p - '0') : value;
+		}
+
+		out = negative ? -value : value;
+
+		return p;
+	}
+
+	//1 based or negative (relative to the end) OBJ index to 0 based
+	inline unsigned int ResolveIndex(long value, unsigned int count)
+	{
+		if(value > 0 && (unsigned long)value <= count)
+		{
+			return (unsigned int)(value - 1);
+		}
+
+		if(value < 0 && (unsigned long)(-value) <= count)
+		{
+			return count - (unsigned int)(-value);
+		}
+
+		return ObjParser::NO_INDEX;
+	}
+}
+
+ObjParser::ObjParser()
+{
+	workers = nullptr;
+	positionBase = 0;
+	texCoordBase = 0;
+	normalBase = 0;
+}
+
+ObjParser::~ObjParser()
+{
+}
+
+/// <summary>
+/// Map and parse an OBJ file, anything already loaded is dropped
+/// </summary>
+/// <param name="filename">OBJ filepath</param>
+/// <returns>false if the file could not be opened</returns>
+bool ObjParser::Load(const char *filename)
+{
+	MappedFile file;
+
+	if(!file.Open(filename))
+	{
+		return false;
+	}
+
+	Parse(file.Data(), file.Size());
+
+	return true;
+}
+
+#ifdef _WIN32
+bool ObjParser::Load(const wchar_t *filename)
+{
+	MappedFile file;
+
+	if(!file.Open(filename))
+	{
+		return false;
+	}
+
+	Parse(file.Data(), file.Size());
+
+	return true;
+}
+#endif
+
+/// <summary>
+/// Read v, vt, vn and f lines in one pass, everything else (o, g, s, usemtl, comments) is skipped
+/// Corners with an out of range position are dropped, bad texcoord or normal indices become NO_INDEX
+/// With workers set, text of at least two chunks is parsed in parallel, the result is identical
+/// </summary>
+/// <param name="text">OBJ text, need not be null terminated</param>
+/// <param name="length">Bytes of text</param>
+void ObjParser::Parse(const char *text, std::size_t length)
+{
+	Clear();
+
+	if(workers != nullptr && workers->ThreadCount() > 1 && length >= MIN_CHUNK_BYTES * 2)
+	{
+		ParseParallel(text, length);
+	}
+	else
+	{
+		ParseLines(text, text + length);
+	}
+}
+
+/// <summary>
+/// Split at line boundaries, count each chunk's v/vt/vn lines, then parse chunks concurrently into their own parsers
+/// The counts' prefix sums are every chunk's bases, so a chunk resolves absolute and negative indices to final ones as it goes
+/// The merge is a copy of each chunk to its prefix-summed offset
+/// </summary>
+void ObjParser::ParseParallel(const char *text, std::size_t length)
+{
+	const char *end = text + length;
+	std::size_t chunkCount = workers->ThreadCount() * CHUNKS_PER_THREAD;
+
+	if(chunkCount > length / MIN_CHUNK_BYTES)
+	{
+		chunkCount = length / MIN_CHUNK_BYTES;
+	}
+
+	//a boundary in the middle of a line moves to the start of the next, so no line is split or read twice
+	std::vector<const char *> bounds(chunkCount + 1, end);
+	bounds[0] = text;
+
+	for(std::size_t i = 1; i < chunkCount; i++)
+	{
+		const char *split = text + ((length * i) / chunkCount);
+		bounds[i] = (split > bounds[i - 1]) ? NextLine(split - 1, end) : bounds[i - 1];
+	}
+
+	std::vector<unsigned int> lineCounts(chunkCount * 3, 0);
+
+	workers->ParallelFor((unsigned int)chunkCount, [&](unsigned int chunk)
+	{
+		unsigned int counts[LINE_FACE + 1] = { 0 };
+
+		for(const char *p = bounds[chunk]; p < bounds[chunk + 1]; p = NextLine(p, bounds[chunk + 1]))
+		{
+			p = SkipBlank(p, bounds[chunk + 1]);
+			counts[Classify(p, bounds[chunk + 1])]++;
+		}
+
+		lineCounts[chunk * 3] = counts[LINE_POSITION];
+		lineCounts[(chunk * 3) + 1] = counts[LINE_TEXCOORD];
+		lineCounts[(chunk * 3) + 2] = counts[LINE_NORMAL];
+	});
+
+	ObjParser *chunks = new ObjParser[chunkCount];
+	unsigned int positionTotal = 0, texCoordTotal = 0, normalTotal = 0;
+
+	for(std::size_t i = 0; i < chunkCount; i++)
+	{
+		chunks[i].positionBase = positionTotal;
+		chunks[i].texCoordBase = texCoordTotal;
+		chunks[i].normalBase = normalTotal;
+		chunks[i].positions.reserve(lineCounts[i * 3] * 3);
+		chunks[i].texCoords.reserve(lineCounts[(i * 3) + 1] * 2);
+		chunks[i].normals.reserve(lineCounts[(i * 3) + 2] * 3);
+
+		positionTotal += lineCounts[i * 3];
+		texCoordTotal += lineCounts[(i * 3) + 1];
+		normalTotal += lineCounts[(i * 3) + 2];
+	}
+
+	workers->ParallelFor((unsigned int)chunkCount, [&](unsigned int chunk)
+	{
+		chunks[chunk].ParseLines(bounds[chunk], bounds[chunk + 1]);
+	});
+
+	std::vector<std::size_t> cornerOffsets(chunkCount + 1, 0);
+
+	for(std::size_t i = 0; i < chunkCount; i++)
+	{
+		cornerOffsets[i + 1] = cornerOffsets[i] + chunks[i].corners.size();
+	}
+
+	positions.resize(positionTotal * 3);
+	texCoords.resize(texCoordTotal * 2);
+	normals.resize(normalTotal * 3);
+	corners.resize(cornerOffsets[chunkCount]);
+
+	workers->ParallelFor((unsigned int)chunkCount, [&](unsigned int chunk)
+	{
+		const ObjParser &source = chunks[chunk];
+
+		std::copy(source.positions.begin(), source.positions.end(), positions.begin() + (source.positionBase * 3));
+		std::copy(source.texCoords.begin(), source.texCoords.end(), texCoords.begin() + (source.texCoordBase * 2));
+		std::copy(source.normals.begin(), source.normals.end(), normals.begin() + (source.normalBase * 3));
+		std::copy(source.corners.begin(), source.corners.end(), corners.begin() + cornerOffsets[chunk]);
+	});
+
+	delete[] chunks;
+}
+
+/// <summary>
+/// Parse the lines of [p, end) onto what is already read, indices resolve against the bases plus what this parser holds
+/// </summary>
+void ObjParser::ParseLines(const char *p, const char *end)
+{
+	while(p < end)
+	{
+		p = SkipBlank(p, end);
+
+		switch(Classify(p, end))
+		{
+		case LINE_POSITION:
+			{
+				float v[3] = { 0.0f, 0.0f, 0.0f };
+				p = ParseFloats(p + 2, end, v, 3);
+
+				positions.push_back(v[0]);
+				positions.push_back(v[1]);
+				positions.push_back(-v[2]);
+				break;
+			}
+		case LINE_TEXCOORD:
+			{
+				float t[2] = { 0.0f, 0.0f };
+				p = ParseFloats(p + 3, end, t, 2);
+
+				texCoords.push_back(t[0]);
+				texCoords.push_back(1.0f - t[1]);
+				break;
+			}
+		case LINE_NORMAL:
+			{
+				float n[3] = { 0.0f, 0.0f, 0.0f };
+				p = ParseFloats(p + 3, end, n, 3);
+
+				normals.push_back(n[0]);
+				normals.push_back(n[1]);
+				normals.push_back(-n[2]);
+				break;
+			}
+		case LINE_FACE:
+			p = ParseFace(p + 2, end);
+			break;
+		default:
+			break;
+		}
+
+		p = NextLine(p, end);
+	}
+}
+
+/// <summary>
+/// Read one face's corners and fan them into clockwise triangles
+/// </summary>
+/// <returns>Position the corners ended at</returns>
+const char *ObjParser::ParseFace(const char *p, const char *end)
+{
+	unsigned int positionCount = positionBase + PositionCount();
+	unsigned int texCoordCount = texCoordBase + TexCoordCount();
+	unsigned int normalCount = normalBase + NormalCount();
+
+	polygon.clear();
+
+	for(;;)
+	{
+		long value;
+		const char *q = ParseIndex(SkipBlank(p, end), end, value);
+
+		if(q == nullptr)
+		{
+			break;
+		}
+
+		Corner corner = { ResolveIndex(value, positionCount), NO_INDEX, NO_INDEX };
+		p = q;
+
+		if(p < end && *p == '/')
+		{
+			q = ParseIndex(++p, end, value);
+
+			if(q != nullptr)
+			{
+				corner.texCoord = ResolveIndex(value, texCoordCount);
+				p = q;
+			}
+
+			if(p < end && *p == '/')
+			{
+				q = ParseIndex(++p, end, value);
+
+				if(q != nullptr)
+				{
+					corner.normal = ResolveIndex(value, normalCount);
+					p = q;
+				}
+			}
+		}
+
+		//skip whatever is left of a malformed token
+		while(p < end && !IsBlank(*p) && *p != '\r' && *p != '\n')
+		{
+			p++;
+		}
+
+		if(corner.position != NO_INDEX)
+		{
+			polygon.push_back(corner);
+		}
+	}
+
+	//OBJ is counter-clockwise, the z flip mirrors it so each triangle is emitted reversed
+	for(unsigned int i = 2; i < polygon.size(); i++)
+	{
+		corners.push_back(polygon[i]);
+		corners.push_back(polygon[i - 1]);
+		corners.push_back(polygon[0]);
+	}
+
+	return p;
+}
+
+void ObjParser::Clear()
+{
+	positions.clear();
+	texCoords.clear();
+	normals.clear();
+	corners.clear();
+	polygon.clear();
+	positionBase = 0;
+	texCoordBase = 0;
+	normalBase = 0;
+}
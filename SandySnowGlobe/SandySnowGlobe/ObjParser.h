@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class WorkerPool;
+
+//Single pass Wavefront OBJ reader over a memory-mapped file
+//Output is already in the engine's left-handed space: z and v are flipped and triangles are wound clockwise
+//Faces may be v, v/t, v//n or v/t/n with any number of corners, polygons are fanned into triangles
+//Given workers, large files are split at line boundaries and parsed in parallel
+class ObjParser
+{
+public:
+	static const unsigned int NO_INDEX = 0xFFFFFFFF;	//corner has no texcoord or normal
+
+	//indices into Positions/TexCoords/Normals, 0 based
+	struct Corner
+	{
+		unsigned int position, texCoord, normal;
+	};
+
+	ObjParser();
+	~ObjParser();
+
+	bool Load(const char *filename);
+#ifdef _WIN32
+	bool Load(const wchar_t *filename);
+#endif
+	void Parse(const char *text, std::size_t length);
+	void Clear();
+
+	WorkerPool *Workers() const { return workers; }
+	void Workers(WorkerPool *val) { workers = val; }
+
+	//xyz, uv and xyz tuples
+	const std::vector<float> &Positions() const { return positions; }
+	const std::vector<float> &TexCoords() const { return texCoords; }
+	const std::vector<float> &Normals() const { return normals; }
+
+	//three corners per triangle
+	const std::vector<Corner> &Corners() const { return corners; }
+
+	unsigned int PositionCount() const { return (unsigned int)(positions.size() / 3); }
+	unsigned int TexCoordCount() const { return (unsigned int)(texCoords.size() / 2); }
+	unsigned int NormalCount() const { return (unsigned int)(normals.size() / 3); }
+	unsigned int TriangleCount() const { return (unsigned int)(corners.size() / 3); }
+
+private:
+	ObjParser& operator= (const ObjParser&);
+	ObjParser(const ObjParser&);
+
+	void ParseParallel(const char *text, std::size_t length);
+	void ParseLines(const char *p, const char *end);
+	const char *ParseFace(const char *p, const char *end);
+
+	WorkerPool *workers;
+	unsigned int positionBase, texCoordBase, normalBase;	//elements read before this parser's text, a chunk's view of the file
+	std::vector<float> positions, texCoords, normals;
+	std::vector<Corner> corners;
+	std::vector<Corner> polygon;	//scratch for the face being read
+};
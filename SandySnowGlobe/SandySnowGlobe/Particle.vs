@@ -6,13 +6,20 @@ cbuffer MatricesBuffer
 	matrix projMatrix;
 };
 
+cbuffer InstanceBoundsBuffer : register(b1)
+{
+	float3 boundsMin;
+	float maxSize;
+	float3 boundsExtent;
+	float padding;
+};
+
 struct VertexInputType
 {
 	float4 position : POSITION;
 	float2 texCoord : TEXCOORD0;
 	float4 colour : COLOR;
-	float3 instancePos : TEXCOORD1;
-	float3 instanceRot : TEXCOORD2;
+	float4 instanceData : TEXCOORD1;	//xyz position in bounds, w size / maxSize (UNORM)
 };
 
 struct PixelInputType
@@ -26,15 +33,18 @@ PixelInputType vs_main(VertexInputType input)
 {
 	PixelInputType output;
 
+	float3 instancePos = boundsMin + (input.instanceData.xyz * boundsExtent);
+
+	input.position.xyz *= input.instanceData.w * maxSize;
 	input.position.w = 1.0f;
 
 	//output.position = mul(input.position, worldMatrix);
 
 	output.position = mul(input.position, viewInverse);
 
-	output.position.x += input.instancePos.x;
-	output.position.y += input.instancePos.y;
-	output.position.z += input.instancePos.z;
+	output.position.x += instancePos.x;
+	output.position.y += instancePos.y;
+	output.position.z += instancePos.z;
 
 	output.position = mul(output.position, viewMatrix);
 	output.position = mul(output.position, projMatrix);
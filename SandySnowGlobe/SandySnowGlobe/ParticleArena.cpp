@@ -0,0 +1,228 @@
+#include "ParticleArena.h"
+
+ParticleArena::ParticleArena()
+{
+	workers = nullptr;
+	reserved = 0;
+	emitterCount = 0;
+	chunkCount = 0;
+	liveCount = 0;
+}
+
+ParticleArena::~ParticleArena()
+{
+}
+
+/// <summary>
+/// Allocate the shared pool, any emitters are dropped
+/// </summary>
+/// <param name="particleCapacity">Total particles across every emitter</param>
+/// <returns></returns>
+bool ParticleArena::Init(unsigned int particleCapacity)
+{
+	Clear();
+
+	if(!particles.Init(particleCapacity))
+	{
+		return false;
+	}
+
+	//the arena tracks live particles per emitter, the pool is just storage
+	particles.Grow(particleCapacity);
+
+	return true;
+}
+
+void ParticleArena::Clear()
+{
+	emitters.clear();
+	chunks.clear();
+	reserved = 0;
+	emitterCount = 0;
+	chunkCount = 0;
+	liveCount = 0;
+}
+
+/// <summary>
+/// Reserve settings.maxParticles consecutive slots for a new emitter, inactive until Active(handle, true)
+/// A removed emitter's range is reused when it is large enough
+/// </summary>
+/// <param name="settings">Emission and kill parameters</param>
+/// <returns>INVALID_HANDLE if the arena is full</returns>
+ParticleArena::Handle ParticleArena::AddEmitter(const ParticleSim::Settings &settings)
+{
+	Handle handle = INVALID_HANDLE;
+
+	for(unsigned int i = 0; i < emitters.size(); i++)
+	{
+		if(!emitters[i].used && emitters[i].capacity >= settings.maxParticles)
+		{
+			handle = i;
+			break;
+		}
+	}
+
+	if(handle == INVALID_HANDLE)
+	{
+		if(settings.maxParticles > particles.Capacity() - reserved)
+		{
+			return INVALID_HANDLE;
+		}
+
+		Emitter fresh;
+		fresh.begin = reserved;
+		fresh.capacity = settings.maxParticles;
+		reserved += settings.maxParticles;
+
+		handle = (Handle)emitters.size();
+		emitters.push_back(fresh);
+	}
+
+	Emitter &emitter = emitters[handle];
+	ParticleSim::Float3 origin = { 0.0f, 0.0f, 0.0f };
+
+	emitter.settings = settings;
+	emitter.settings.maxParticles = emitter.capacity;
+	emitter.position = origin;
+	emitter.accumulatedTime = 0.0f;
+	emitter.count = 0;
+	emitter.active = false;
+	emitter.used = true;
+	emitterCount++;
+
+	return handle;
+}
+
+/// <summary>
+/// Release an emitter's range, its live particles vanish immediately
+/// </summary>
+/// <param name="emitter">Handle from AddEmitter</param>
+void ParticleArena::RemoveEmitter(Handle emitter)
+{
+	if(emitter >= emitters.size() || !emitters[emitter].used)
+	{
+		return;
+	}
+
+	emitters[emitter].used = false;
+	emitters[emitter].active = false;
+	emitters[emitter].count = 0;
+	emitterCount--;
+}
+
+/// <summary>
+/// Emit for every active emitter, then integrate and kill every emitter in one pass
+/// </summary>
+/// <param name="dt">Delta time</param>
+void ParticleArena::Update(float dt)
+{
+	//emission is cheap and draws from one stream, keep it serial so results do not depend on the thread count
+	for(unsigned int i = 0; i < emitters.size(); i++)
+	{
+		Emitter &emitter = emitters[i];
+
+		if(!emitter.used || !emitter.active)
+		{
+			continue;
+		}
+
+		unsigned int n = ParticleSim::DueCount(emitter.settings, dt, emitter.accumulatedTime);
+		unsigned int room = emitter.capacity - emitter.count;
+
+		n = (n < room) ? n : room;
+
+		ParticleSim::Spawn(particles, emitter.begin + emitter.count, n, emitter.settings, emitter.position, rng);
+		emitter.count += n;
+	}
+
+	Simulate(dt);
+	BuildChunks();
+}
+
+/// <summary>
+/// Step every emitter's range, EMITTERS_PER_TASK emitters per worker task
+/// </summary>
+/// <param name="dt">Delta time</param>
+void ParticleArena::Simulate(float dt)
+{
+	unsigned int count = (unsigned int)emitters.size();
+
+	if(count == 0)
+	{
+		return;
+	}
+
+	Emitter *emitterData = &emitters[0];
+	ParticlePool &pool = particles;
+
+	if(workers == nullptr || workers->ThreadCount() == 1 || count <= EMITTERS_PER_TASK)
+	{
+		for(unsigned int i = 0; i < count; i++)
+		{
+			SimulateEmitter(pool, emitterData[i], dt);
+		}
+
+		return;
+	}
+
+	unsigned int taskCount = (count + EMITTERS_PER_TASK - 1) / EMITTERS_PER_TASK;
+
+	workers->ParallelFor(taskCount, [&pool, emitterData, count, dt](unsigned int task)
+	{
+		unsigned int begin = task * EMITTERS_PER_TASK;
+		unsigned int end = (begin + EMITTERS_PER_TASK < count) ? begin + EMITTERS_PER_TASK : count;
+
+		for(unsigned int i = begin; i < end; i++)
+		{
+			SimulateEmitter(pool, emitterData[i], dt);
+		}
+	});
+}
+
+/// <summary>
+/// Integrate, kill and box one emitter's range, survivors stay at the front of it
+/// </summary>
+void ParticleArena::SimulateEmitter(ParticlePool &pool, Emitter &emitter, float dt)
+{
+	if(emitter.count == 0)
+	{
+		return;
+	}
+
+	unsigned int begin = emitter.begin;
+	ParticleKernels::KillBounds bounds = ParticleSim::KillBoundsAt(emitter.settings, emitter.position);
+
+	emitter.count = ParticleKernels::IntegrateAndKill(pool, begin, begin + emitter.count, dt, bounds);
+	ParticleKernels::RangeBounds(pool, begin, begin + emitter.count, emitter.bounds);
+}
+
+/// <summary>
+/// Collect the live range and box of every emitter that has particles
+/// </summary>
+void ParticleArena::BuildChunks()
+{
+	if(chunks.size() < emitters.size())
+	{
+		chunks.resize(emitters.size());
+	}
+
+	chunkCount = 0;
+	liveCount = 0;
+
+	for(unsigned int i = 0; i < emitters.size(); i++)
+	{
+		const Emitter &emitter = emitters[i];
+
+		if(emitter.count == 0)
+		{
+			continue;
+		}
+
+		ParticleSim::Chunk &chunk = chunks[chunkCount++];
+		chunk.begin = emitter.begin;
+		chunk.count = emitter.count;
+		chunk.bounds = emitter.bounds;
+
+		liveCount += emitter.count;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include "ParticleSim.h"
+
+//One pool shared by many small emitters (fire, dust), each owning a fixed contiguous range of it
+//Every emitter is stepped in the same pass and the live ranges upload as one instance run,
+//so an emitter costs a few bytes of state rather than its own pool, buffers and draw call
+class ParticleArena
+{
+public:
+	typedef unsigned int Handle;
+
+	static const Handle INVALID_HANDLE = 0xFFFFFFFF;
+	static const unsigned int EMITTERS_PER_TASK = 64;	//emitters per worker task
+
+	ParticleArena();
+	~ParticleArena();
+
+	bool Init(unsigned int particleCapacity);
+	void Clear();
+
+	Handle AddEmitter(const ParticleSim::Settings &settings);
+	void RemoveEmitter(Handle emitter);
+
+	ParticleSim::Float3 Position(Handle emitter) const { return emitters[emitter].position; }
+	void Position(Handle emitter, ParticleSim::Float3 val) { emitters[emitter].position = val; }
+
+	bool Active(Handle emitter) const { return emitters[emitter].active; }
+	void Active(Handle emitter, bool val) { emitters[emitter].active = val; }
+
+	unsigned int Alive(Handle emitter) const { return emitters[emitter].count; }
+
+	void Update(float dt);
+
+	void Seed(unsigned long long seed) { rng.Seed(seed); }
+
+	WorkerPool *Workers() const { return workers; }
+	void Workers(WorkerPool *val) { workers = val; }
+
+	const ParticlePool &Particles() const { return particles; }
+	unsigned int Capacity() const { return particles.Capacity(); }
+	unsigned int Count() const { return liveCount; }
+	unsigned int EmitterCount() const { return emitterCount; }
+
+	//one chunk per emitter with live particles, rebuilt every Update
+	const ParticleSim::Chunk *Chunks() const { return chunks.empty() ? nullptr : &chunks[0]; }
+	unsigned int ChunkCount() const { return chunkCount; }
+
+private:
+	ParticleArena& operator= (const ParticleArena&);
+	ParticleArena(const ParticleArena&);
+
+	struct Emitter
+	{
+		ParticleSim::Settings settings;
+		ParticleSim::Float3 position;
+		ParticleKernels::Aabb bounds;
+		float accumulatedTime;
+		unsigned int begin, capacity, count;
+		bool active, used;
+	};
+
+	void Simulate(float dt);
+	void BuildChunks();
+
+	static void SimulateEmitter(ParticlePool &pool, Emitter &emitter, float dt);
+
+	ParticlePool particles;
+	std::vector<Emitter> emitters;
+	std::vector<ParticleSim::Chunk> chunks;
+	Random rng;
+	WorkerPool *workers;
+	unsigned int reserved, emitterCount, chunkCount, liveCount;
+};
@@ -0,0 +1,338 @@
+#include "ParticleKernels.h"
+#include "HeightField.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PARTICLE_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define PARTICLE_KERNEL_AVX
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	//copy one survivor from slot src to slot dst (dst <= src), position already integrated
+	inline void MoveParticle(ParticlePool &pool, unsigned int dst, unsigned int src, float x, float y, float z)
+	{
+		pool.PosX()[dst] = x;
+		pool.PosY()[dst] = y;
+		pool.PosZ()[dst] = z;
+
+		if(dst != src)
+		{
+			pool.VelX()[dst] = pool.VelX()[src];
+			pool.VelY()[dst] = pool.VelY()[src];
+			pool.VelZ()[dst] = pool.VelZ()[src];
+			pool.Colour()[dst] = pool.Colour()[src];
+		}
+	}
+
+	//a particle at or above the highest ground sample cannot be under the surface, so most skip the lookup
+	inline bool AboveFloor(const ParticleKernels::KillBounds &bounds, float x, float y, float z)
+	{
+		if(bounds.ground == nullptr)
+		{
+			return y >= bounds.minY;
+		}
+
+		return y >= bounds.ground->MaxHeight() || y >= bounds.ground->Height(x, z);
+	}
+
+#ifdef PARTICLE_KERNEL_SSE2
+	//4-wide AboveFloor, lanes are all ones where the particle survives
+	inline __m128 AboveFloor4(const ParticleKernels::KillBounds &bounds, __m128 x, __m128 y, __m128 z)
+	{
+		if(bounds.ground == nullptr)
+		{
+			return _mm_cmpge_ps(y, _mm_set1_ps(bounds.minY));
+		}
+
+		__m128 above = _mm_cmpge_ps(y, _mm_set1_ps(bounds.ground->MaxHeight()));
+
+		if(_mm_movemask_ps(above) != 0xF)
+		{
+			float lanesX[4], lanesZ[4], ground[4];
+			_mm_storeu_ps(lanesX, x);
+			_mm_storeu_ps(lanesZ, z);
+
+			bounds.ground->Height4(lanesX, lanesZ, ground);
+			above = _mm_or_ps(above, _mm_cmpge_ps(y, _mm_loadu_ps(ground)));
+		}
+
+		return above;
+	}
+#endif
+
+	//scalar loop shared by the reference path and the SIMD tails
+	unsigned int IntegrateRange(ParticlePool &pool, unsigned int read, unsigned int end, unsigned int write, float dt, const ParticleKernels::KillBounds &bounds)
+	{
+		const float *posX = pool.PosX();
+		const float *posY = pool.PosY();
+		const float *posZ = pool.PosZ();
+		const float *velX = pool.VelX();
+		const float *velY = pool.VelY();
+		const float *velZ = pool.VelZ();
+
+		for(; read < end; read++)
+		{
+			float x = posX[read] + (velX[read] * dt);
+			float y = posY[read] + (velY[read] * dt);
+			float z = posZ[read] + (velZ[read] * dt);
+
+			if(AboveFloor(bounds, x, y, z) && y < bounds.maxY)
+			{
+				MoveParticle(pool, write, read, x, y, z);
+				write++;
+			}
+		}
+
+		return write;
+	}
+}
+
+namespace ParticleKernels
+{
+	/// <summary>
+	/// Integrate positions over [begin, end) and compact the survivors to the front of the range
+	/// Survivor order is preserved, so results do not depend on how a pool is split into ranges
+	/// </summary>
+	/// <param name="pool">Particle pool</param>
+	/// <param name="begin">First particle</param>
+	/// <param name="end">One past the last particle</param>
+	/// <param name="dt">Delta time</param>
+	/// <param name="bounds">Y range particles survive in</param>
+	/// <returns>Number of survivors, stored at [begin, begin + n)</returns>
+	unsigned int IntegrateAndKill(ParticlePool &pool, unsigned int begin, unsigned int end, float dt, const KillBounds &bounds)
+	{
+#ifdef PARTICLE_KERNEL_SSE2
+		return IntegrateAndKillSIMD(pool, begin, end, dt, bounds);
+#else
+		return IntegrateAndKillScalar(pool, begin, end, dt, bounds);
+#endif
+	}
+
+	/// <summary>
+	/// Reference implementation, one particle at a time
+	/// </summary>
+	unsigned int IntegrateAndKillScalar(ParticlePool &pool, unsigned int begin, unsigned int end, float dt, const KillBounds &bounds)
+	{
+		return IntegrateRange(pool, begin, end, begin, dt, bounds) - begin;
+	}
+
+	/// <summary>
+	/// 4-wide (SSE2) or 8-wide (AVX) version of IntegrateAndKillScalar
+	/// Groups where every particle survives are stored straight back, others are compacted lane by lane
+	/// </summary>
+	unsigned int IntegrateAndKillSIMD(ParticlePool &pool, unsigned int begin, unsigned int end, float dt, const KillBounds &bounds)
+	{
+		unsigned int read = begin;
+		unsigned int write = begin;
+
+#if defined(PARTICLE_KERNEL_AVX)
+		const unsigned int width = 8;
+		const int allAlive = 0xFF;
+		float *posX = pool.PosX();
+		float *posY = pool.PosY();
+		float *posZ = pool.PosZ();
+		float *velX = pool.VelX();
+		float *velY = pool.VelY();
+		float *velZ = pool.VelZ();
+		unsigned int *colour = pool.Colour();
+		float lanes[3][8];
+
+		__m256 step = _mm256_set1_ps(dt);
+		__m256 maxY = _mm256_set1_ps(bounds.maxY);
+
+		for(; read + width <= end; read += width)
+		{
+			__m256 vx = _mm256_loadu_ps(velX + read);
+			__m256 vy = _mm256_loadu_ps(velY + read);
+			__m256 vz = _mm256_loadu_ps(velZ + read);
+			__m256 x = _mm256_add_ps(_mm256_loadu_ps(posX + read), _mm256_mul_ps(vx, step));
+			__m256 y = _mm256_add_ps(_mm256_loadu_ps(posY + read), _mm256_mul_ps(vy, step));
+			__m256 z = _mm256_add_ps(_mm256_loadu_ps(posZ + read), _mm256_mul_ps(vz, step));
+
+			__m128 floorLo = AboveFloor4(bounds, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castps256_ps128(z));
+			__m128 floorHi = AboveFloor4(bounds, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), _mm256_extractf128_ps(z, 1));
+			__m256 aboveFloor = _mm256_insertf128_ps(_mm256_castps128_ps256(floorLo), floorHi, 1);
+			__m256 alive = _mm256_and_ps(aboveFloor, _mm256_cmp_ps(y, maxY, _CMP_LT_OQ));
+			int mask = _mm256_movemask_ps(alive);
+
+			if(mask == allAlive)
+			{
+				_mm256_storeu_ps(posX + write, x);
+				_mm256_storeu_ps(posY + write, y);
+				_mm256_storeu_ps(posZ + write, z);
+
+				if(write != read)
+				{
+					__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(colour + read));
+					_mm256_storeu_ps(velX + write, vx);
+					_mm256_storeu_ps(velY + write, vy);
+					_mm256_storeu_ps(velZ + write, vz);
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(colour + write), c);
+				}
+
+				write += width;
+			}
+			else if(mask != 0)
+			{
+				_mm256_storeu_ps(lanes[0], x);
+				_mm256_storeu_ps(lanes[1], y);
+				_mm256_storeu_ps(lanes[2], z);
+
+				for(unsigned int lane = 0; lane < width; lane++)
+				{
+					if(mask & (1 << lane))
+					{
+						MoveParticle(pool, write, read + lane, lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+						write++;
+					}
+				}
+			}
+		}
+#elif defined(PARTICLE_KERNEL_SSE2)
+		const unsigned int width = 4;
+		const int allAlive = 0xF;
+		float *posX = pool.PosX();
+		float *posY = pool.PosY();
+		float *posZ = pool.PosZ();
+		float *velX = pool.VelX();
+		float *velY = pool.VelY();
+		float *velZ = pool.VelZ();
+		unsigned int *colour = pool.Colour();
+		float lanes[3][4];
+
+		__m128 step = _mm_set1_ps(dt);
+		__m128 maxY = _mm_set1_ps(bounds.maxY);
+
+		for(; read + width <= end; read += width)
+		{
+			__m128 vx = _mm_loadu_ps(velX + read);
+			__m128 vy = _mm_loadu_ps(velY + read);
+			__m128 vz = _mm_loadu_ps(velZ + read);
+			__m128 x = _mm_add_ps(_mm_loadu_ps(posX + read), _mm_mul_ps(vx, step));
+			__m128 y = _mm_add_ps(_mm_loadu_ps(posY + read), _mm_mul_ps(vy, step));
+			__m128 z = _mm_add_ps(_mm_loadu_ps(posZ + read), _mm_mul_ps(vz, step));
+
+			__m128 alive = _mm_and_ps(AboveFloor4(bounds, x, y, z), _mm_cmplt_ps(y, maxY));
+			int mask = _mm_movemask_ps(alive);
+
+			if(mask == allAlive)
+			{
+				_mm_storeu_ps(posX + write, x);
+				_mm_storeu_ps(posY + write, y);
+				_mm_storeu_ps(posZ + write, z);
+
+				if(write != read)
+				{
+					__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(colour + read));
+					_mm_storeu_ps(velX + write, vx);
+					_mm_storeu_ps(velY + write, vy);
+					_mm_storeu_ps(velZ + write, vz);
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(colour + write), c);
+				}
+
+				write += width;
+			}
+			else if(mask != 0)
+			{
+				_mm_storeu_ps(lanes[0], x);
+				_mm_storeu_ps(lanes[1], y);
+				_mm_storeu_ps(lanes[2], z);
+
+				for(unsigned int lane = 0; lane < width; lane++)
+				{
+					if(mask & (1 << lane))
+					{
+						MoveParticle(pool, write, read + lane, lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+						write++;
+					}
+				}
+			}
+		}
+#endif
+
+		return IntegrateRange(pool, read, end, write, dt, bounds) - begin;
+	}
+
+	/// <summary>
+	/// Axis aligned box around the positions in [begin, end)
+	/// </summary>
+	/// <param name="pool">Particle pool</param>
+	/// <param name="begin">First particle</param>
+	/// <param name="end">One past the last particle</param>
+	/// <param name="box">Result, an empty range gives a zero sized box at the origin</param>
+	void RangeBounds(const ParticlePool &pool, unsigned int begin, unsigned int end, Aabb &box)
+	{
+		const float *streams[3] = { pool.PosX(), pool.PosY(), pool.PosZ() };
+
+		for(unsigned int axis = 0; axis < 3; axis++)
+		{
+			box.min[axis] = 0.0f;
+			box.max[axis] = 0.0f;
+
+			if(end > begin)
+			{
+				StreamRange(streams[axis] + begin, end - begin, box.min[axis], box.max[axis]);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Smallest and largest value of one stream, 4 at a time with SSE2
+	/// </summary>
+	/// <param name="stream">Values, count must be at least 1</param>
+	/// <param name="count">Number of values</param>
+	/// <param name="lo">Smallest value</param>
+	/// <param name="hi">Largest value</param>
+	void StreamRange(const float *stream, unsigned int count, float &lo, float &hi)
+	{
+		unsigned int i = 0;
+
+		lo = stream[0];
+		hi = stream[0];
+
+#ifdef PARTICLE_KERNEL_SSE2
+		if(count >= 4)
+		{
+			__m128 vLo = _mm_loadu_ps(stream);
+			__m128 vHi = vLo;
+
+			for(i = 4; i + 4 <= count; i += 4)
+			{
+				__m128 v = _mm_loadu_ps(stream + i);
+				vLo = _mm_min_ps(vLo, v);
+				vHi = _mm_max_ps(vHi, v);
+			}
+
+			float lanesLo[4], lanesHi[4];
+			_mm_storeu_ps(lanesLo, vLo);
+			_mm_storeu_ps(lanesHi, vHi);
+
+			for(unsigned int lane = 0; lane < 4; lane++)
+			{
+				lo = (lanesLo[lane] < lo) ? lanesLo[lane] : lo;
+				hi = (lanesHi[lane] > hi) ? lanesHi[lane] : hi;
+			}
+		}
+#endif
+
+		for(; i < count; i++)
+		{
+			lo = (stream[i] < lo) ? stream[i] : lo;
+			hi = (stream[i] > hi) ? stream[i] : hi;
+		}
+	}
+
+	bool SIMDEnabled()
+	{
+#ifdef PARTICLE_KERNEL_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ParticlePool.h"
+
+class HeightField;
+
+//Batched particle update kernels working over the pool's float streams
+namespace ParticleKernels
+{
+	//particles survive while minY <= y < maxY, a ground height field replaces minY when set
+	struct KillBounds
+	{
+		float minY, maxY;
+		const HeightField *ground;
+	};
+
+	struct Aabb
+	{
+		float min[3], max[3];
+	};
+
+	unsigned int IntegrateAndKill(ParticlePool &pool, unsigned int begin, unsigned int end, float dt, const KillBounds &bounds);
+	unsigned int IntegrateAndKillScalar(ParticlePool &pool, unsigned int begin, unsigned int end, float dt, const KillBounds &bounds);
+	unsigned int IntegrateAndKillSIMD(ParticlePool &pool, unsigned int begin, unsigned int end, float dt, const KillBounds &bounds);
+
+	void RangeBounds(const ParticlePool &pool, unsigned int begin, unsigned int end, Aabb &box);
+	void StreamRange(const float *stream, unsigned int count, float &lo, float &hi);
+
+	bool SIMDEnabled();
+}
@@ -0,0 +1,155 @@
+#include "ParticlePool.h"
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	const unsigned int STREAM_ALIGN = 32;		//bytes, wide enough for 8-float SIMD loads
+	const unsigned int STREAM_COUNT = 7;		//pos xyz, vel xyz, colour
+}
+
+ParticlePool::ParticlePool()
+{
+	block = nullptr;
+	posX = nullptr;
+	posY = nullptr;
+	posZ = nullptr;
+	velX = nullptr;
+	velY = nullptr;
+	velZ = nullptr;
+	colour = nullptr;
+	count = 0;
+	capacity = 0;
+}
+
+ParticlePool::~ParticlePool()
+{
+	Release();
+}
+
+/// <summary>
+/// Allocate every stream out of one aligned block
+/// </summary>
+/// <param name="maxParticles">Pool capacity</param>
+/// <returns></returns>
+bool ParticlePool::Init(unsigned int maxParticles)
+{
+	Release();
+
+	if(maxParticles == 0)
+	{
+		return true;
+	}
+
+	//pad each stream so the next one starts aligned and SIMD tails never leave the block
+	unsigned int perAlign = STREAM_ALIGN / sizeof(float);
+	unsigned int stride = ((maxParticles + perAlign - 1) / perAlign) * perAlign;
+
+	block = new unsigned char[stride * sizeof(float) * STREAM_COUNT + STREAM_ALIGN];
+
+	std::size_t base = reinterpret_cast<std::size_t>(block);
+	base = (base + STREAM_ALIGN - 1) & ~(std::size_t)(STREAM_ALIGN - 1);
+
+	float *stream = reinterpret_cast<float *>(base);
+	posX = stream;
+	posY = posX + stride;
+	posZ = posY + stride;
+	velX = posZ + stride;
+	velY = velX + stride;
+	velZ = velY + stride;
+	colour = reinterpret_cast<unsigned int *>(velZ + stride);
+
+	capacity = maxParticles;
+	count = 0;
+
+	return true;
+}
+
+void ParticlePool::Release()
+{
+	delete[] block;
+	block = nullptr;
+	posX = nullptr;
+	posY = nullptr;
+	posZ = nullptr;
+	velX = nullptr;
+	velY = nullptr;
+	velZ = nullptr;
+	colour = nullptr;
+	count = 0;
+	capacity = 0;
+}
+
+/// <summary>
+/// Append a particle to the end of the live range
+/// </summary>
+/// <returns>False if the pool is full</returns>
+bool ParticlePool::Add(float x, float y, float z, float vx, float vy, float vz, unsigned int rgba)
+{
+	if(count >= capacity)
+	{
+		return false;
+	}
+
+	posX[count] = x;
+	posY[count] = y;
+	posZ[count] = z;
+	velX[count] = vx;
+	velY[count] = vy;
+	velZ[count] = vz;
+	colour[count] = rgba;
+	count++;
+
+	return true;
+}
+
+/// <summary>
+/// Extend the live range by up to n particles, the caller fills the new slots
+/// </summary>
+/// <param name="n">Particles wanted</param>
+/// <returns>Particles added, starting at the old Count()</returns>
+unsigned int ParticlePool::Grow(unsigned int n)
+{
+	unsigned int space = capacity - count;
+
+	if(n > space)
+	{
+		n = space;
+	}
+
+	count += n;
+
+	return n;
+}
+
+/// <summary>
+/// Move n particles from slot src to slot dst in every stream, ranges may overlap
+/// </summary>
+/// <param name="dst">First destination slot</param>
+/// <param name="src">First source slot</param>
+/// <param name="n">Number of particles</param>
+void ParticlePool::MoveRange(unsigned int dst, unsigned int src, unsigned int n)
+{
+	if(dst == src || n == 0)
+	{
+		return;
+	}
+
+	std::memmove(posX + dst, posX + src, n * sizeof(float));
+	std::memmove(posY + dst, posY + src, n * sizeof(float));
+	std::memmove(posZ + dst, posZ + src, n * sizeof(float));
+	std::memmove(velX + dst, velX + src, n * sizeof(float));
+	std::memmove(velY + dst, velY + src, n * sizeof(float));
+	std::memmove(velZ + dst, velZ + src, n * sizeof(float));
+	std::memmove(colour + dst, colour + src, n * sizeof(unsigned int));
+}
+
+unsigned int ParticlePool::PackColour(float r, float g, float b, float a)
+{
+	unsigned int ur = (unsigned int)(r * 255.0f + 0.5f) & 0xFF;
+	unsigned int ug = (unsigned int)(g * 255.0f + 0.5f) & 0xFF;
+	unsigned int ub = (unsigned int)(b * 255.0f + 0.5f) & 0xFF;
+	unsigned int ua = (unsigned int)(a * 255.0f + 0.5f) & 0xFF;
+
+	return ur | (ug << 8) | (ub << 16) | (ua << 24);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+//Structure-of-arrays particle storage
+//Live particles are always packed into [0, Count()), the kernels compact survivors forward in order, so a kill never reorders the pool
+class ParticlePool
+{
+public:
+	ParticlePool();
+	~ParticlePool();
+
+	bool Init(unsigned int maxParticles);
+	void Release();
+
+	bool Add(float x, float y, float z, float vx, float vy, float vz, unsigned int rgba);
+	unsigned int Grow(unsigned int n);
+	void MoveRange(unsigned int dst, unsigned int src, unsigned int n);
+	void Clear() { count = 0; }
+	void Truncate(unsigned int newCount) { if(newCount < count) count = newCount; }
+
+	unsigned int Count() const { return count; }
+	unsigned int Capacity() const { return capacity; }
+	bool Full() const { return count >= capacity; }
+
+	float *PosX() const { return posX; }
+	float *PosY() const { return posY; }
+	float *PosZ() const { return posZ; }
+	float *VelX() const { return velX; }
+	float *VelY() const { return velY; }
+	float *VelZ() const { return velZ; }
+	unsigned int *Colour() const { return colour; }
+
+	static unsigned int PackColour(float r, float g, float b, float a);
+
+private:
+	ParticlePool& operator= (const ParticlePool&);
+	ParticlePool(const ParticlePool&);
+
+	unsigned char *block;
+	float *posX, *posY, *posZ;
+	float *velX, *velY, *velZ;
+	unsigned int *colour;
+	unsigned int count, capacity;
+};
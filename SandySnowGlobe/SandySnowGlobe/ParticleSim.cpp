@@ -0,0 +1,355 @@
+#include "ParticleSim.h"
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	//fixed size chunk index of a pool that is not being compacted
+	void BoxChunk(const ParticlePool &pool, ParticleSim::Chunk &chunk, unsigned int index)
+	{
+		unsigned int count = pool.Count();
+
+		chunk.begin = index * ParticleSim::CHUNK_SIZE;
+		chunk.count = (chunk.begin + ParticleSim::CHUNK_SIZE < count) ? ParticleSim::CHUNK_SIZE : count - chunk.begin;
+
+		ParticleKernels::RangeBounds(pool, chunk.begin, chunk.begin + chunk.count, chunk.bounds);
+	}
+}
+
+ParticleSim::ParticleSim()
+{
+	settings = PresetSettings(DUST);
+	workers = nullptr;
+	ground = nullptr;
+	position.x = 0.0f;
+	position.y = 0.0f;
+	position.z = 0.0f;
+	accumulatedTime = 0.0f;
+	chunkCount = 0;
+}
+
+ParticleSim::~ParticleSim()
+{
+}
+
+/// <summary>
+/// Emission and kill parameters for each particle type
+/// </summary>
+/// <param name="preset">Particle type</param>
+/// <returns></returns>
+ParticleSim::Settings ParticleSim::PresetSettings(Preset preset)
+{
+	Settings s;
+	Float3 zero = { 0.0f, 0.0f, 0.0f };
+
+	s.maxParticles = 0;
+	s.frequency = 0.0f;
+	s.velocity = zero;
+	s.velocityDiff = zero;
+	s.displacementDiff = zero;
+	s.colour = ParticlePool::PackColour(1.0f, 1.0f, 1.0f, 1.0f);
+	s.kill.minY = -10.0f;
+	s.kill.maxY = FLT_MAX;
+	s.kill.ground = nullptr;
+	s.killRelative = false;
+
+	switch(preset)
+	{
+		case SNOW:
+			s.maxParticles = 50000;
+			s.frequency = 5000.0f;
+			s.velocity.y = -8.0f;
+			s.velocityDiff.y = 4.0f;
+			s.displacementDiff.x = 75.0f;
+			s.displacementDiff.y = 75.0f;
+			s.displacementDiff.z = 75.0f;
+			break;
+		case FIRE:
+			s.maxParticles = 50;
+			s.frequency = 10.0f;
+			s.velocity.y = 1.5f;
+			s.velocityDiff.x = 0.75f;
+			s.velocityDiff.y = 0.5f;
+			s.velocityDiff.z = 0.75f;
+			s.displacementDiff.x = 1.0f;
+			s.displacementDiff.y = 1.0f;
+			s.displacementDiff.z = 1.0f;
+			s.kill.minY = -FLT_MAX;
+			s.kill.maxY = 15.0f;
+			s.killRelative = true;
+			break;
+		case DUST:
+			break;
+		case RAIN:
+			s.maxParticles = 50000;
+			s.frequency = 10000.0f;
+			s.velocity.y = -50.0f;
+			s.velocityDiff.y = 10.0f;
+			s.displacementDiff.x = 75.0f;
+			s.displacementDiff.y = 75.0f;
+			s.displacementDiff.z = 75.0f;
+			break;
+	}
+
+	return s;
+}
+
+/// <summary>
+/// Apply settings and allocate the pool, any live particles are dropped
+/// </summary>
+/// <param name="simSettings">Emission and kill parameters</param>
+/// <returns></returns>
+bool ParticleSim::Init(const Settings &simSettings)
+{
+	settings = simSettings;
+	accumulatedTime = 0.0f;
+	chunks.clear();
+	chunkCount = 0;
+
+	return particles.Init(settings.maxParticles);
+}
+
+/// <summary>
+/// One simulation step: emit, integrate and kill, then sort if an axis is given
+/// </summary>
+/// <param name="dt">Delta time</param>
+/// <param name="emit">Spawn new particles this step</param>
+/// <param name="sortAxis">View-space depth axis, nullptr skips sorting</param>
+void ParticleSim::Update(float dt, bool emit, const ParticleSort::DepthAxis *sortAxis)
+{
+	if(emit)
+	{
+		Emit(dt);
+	}
+
+	Simulate(dt);
+
+	if(sortAxis != nullptr)
+	{
+		Sort(*sortAxis);
+	}
+}
+
+/// <summary>
+/// Emits floor(accumulated time * freq) particles per call, the fractional remainder carries to the next call
+/// New particles are appended to the end of the pool and each stream is filled in one bulk RNG call
+/// </summary>
+/// <param name="dt">Delta time</param>
+void ParticleSim::Emit(float dt)
+{
+	unsigned int first = particles.Count();
+	unsigned int n = particles.Grow(DueCount(settings, dt, accumulatedTime));
+
+	Spawn(particles, first, n, settings, position, rng);
+}
+
+/// <summary>
+/// Particles due this step at the settings' frequency, capped at maxParticles
+/// </summary>
+/// <param name="emitSettings">Emission parameters</param>
+/// <param name="dt">Delta time</param>
+/// <param name="accumulatedTime">Emitter's carried time, updated</param>
+/// <returns></returns>
+unsigned int ParticleSim::DueCount(const Settings &emitSettings, float dt, float &accumulatedTime)
+{
+	if(emitSettings.frequency <= 0.0f)
+	{
+		return 0;
+	}
+
+	accumulatedTime += dt;
+
+	float due = floorf(accumulatedTime * emitSettings.frequency);
+	accumulatedTime -= due / emitSettings.frequency;
+
+	return (due > (float)emitSettings.maxParticles) ? emitSettings.maxParticles : (unsigned int)due;
+}
+
+/// <summary>
+/// Fill pool slots [first, first + n) with new particles around an emitter position
+/// </summary>
+/// <param name="pool">Particle pool, the slots must already be allocated</param>
+/// <param name="first">First slot</param>
+/// <param name="n">Number of particles</param>
+/// <param name="emitSettings">Emission parameters</param>
+/// <param name="origin">Emitter position</param>
+/// <param name="random">Stream to draw from</param>
+void ParticleSim::Spawn(ParticlePool &pool, unsigned int first, unsigned int n, const Settings &emitSettings, Float3 origin, Random &random)
+{
+	if(n == 0)
+	{
+		return;
+	}
+
+	float *posX = pool.PosX() + first;
+	float *posY = pool.PosY() + first;
+	float *posZ = pool.PosZ() + first;
+	float *velX = pool.VelX() + first;
+	float *velY = pool.VelY() + first;
+	float *velZ = pool.VelZ() + first;
+	unsigned int *colour = pool.Colour() + first;
+
+	random.FillSpread(posX, n, origin.x, emitSettings.displacementDiff.x);
+	random.Fill(posY, n, origin.y / 2, (origin.y / 2) + emitSettings.displacementDiff.y);
+	random.FillSpread(posZ, n, origin.z, emitSettings.displacementDiff.z);
+
+	random.FillSpread(velX, n, emitSettings.velocity.x, emitSettings.velocityDiff.x);
+	random.FillSpread(velY, n, emitSettings.velocity.y, emitSettings.velocityDiff.y);
+	random.FillSpread(velZ, n, emitSettings.velocity.z, emitSettings.velocityDiff.z);
+
+	for(unsigned int i = 0; i < n; i++)
+	{
+		colour[i] = emitSettings.colour;
+	}
+}
+
+/// <summary>
+/// Integrate and kill in CHUNK_SIZE chunks, spread over the worker pool if one is set
+/// Each chunk compacts in place, then the survivors are merged in chunk order
+/// Compaction is stable, so the result is the same for any thread count
+/// </summary>
+/// <param name="dt">Delta time</param>
+void ParticleSim::Simulate(float dt)
+{
+	unsigned int count = particles.Count();
+	ParticleKernels::KillBounds bounds = GetKillBounds();
+
+	if(workers == nullptr || workers->ThreadCount() == 1 || count <= CHUNK_SIZE)
+	{
+		particles.Truncate(ParticleKernels::IntegrateAndKill(particles, 0, count, dt, bounds));
+		BuildChunks();
+		return;
+	}
+
+	unsigned int taskCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	if(chunks.size() < taskCount)
+	{
+		chunks.resize(taskCount);
+	}
+
+	Chunk *chunkData = &chunks[0];
+	ParticlePool &pool = particles;
+
+	workers->ParallelFor(taskCount, [&pool, chunkData, count, dt, &bounds](unsigned int task)
+	{
+		Chunk &chunk = chunkData[task];
+		unsigned int begin = task * CHUNK_SIZE;
+		unsigned int end = (begin + CHUNK_SIZE < count) ? begin + CHUNK_SIZE : count;
+
+		chunk.begin = begin;
+		chunk.count = ParticleKernels::IntegrateAndKill(pool, begin, end, dt, bounds);
+
+		//survivors are still in cache, box them here rather than in a second pass
+		ParticleKernels::RangeBounds(pool, begin, begin + chunk.count, chunk.bounds);
+	});
+
+	//merging moves whole chunks, so each box still holds, empty chunks are dropped
+	unsigned int write = 0;
+	chunkCount = 0;
+
+	for(unsigned int i = 0; i < taskCount; i++)
+	{
+		if(chunkData[i].count == 0)
+		{
+			continue;
+		}
+
+		particles.MoveRange(write, chunkData[i].begin, chunkData[i].count);
+
+		chunkData[chunkCount] = chunkData[i];
+		chunkData[chunkCount].begin = write;
+		write += chunkData[i].count;
+		chunkCount++;
+	}
+
+	particles.Truncate(write);
+}
+
+/// <summary>
+/// Sort back to front, this reorders the whole pool so the chunk boxes are rebuilt
+/// Sorted chunks are depth slices, which cull well against the near and far planes
+/// </summary>
+/// <param name="axis">View-space depth axis</param>
+void ParticleSim::Sort(const ParticleSort::DepthAxis &axis)
+{
+	sorter.Sort(particles, axis);
+	BuildChunks();
+}
+
+/// <summary>
+/// Split the pool into CHUNK_SIZE chunks and box each one, over the worker pool if one is set
+/// </summary>
+void ParticleSim::BuildChunks()
+{
+	unsigned int count = particles.Count();
+
+	chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	if(chunkCount == 0)
+	{
+		return;
+	}
+
+	if(chunks.size() < chunkCount)
+	{
+		chunks.resize(chunkCount);
+	}
+
+	Chunk *chunkData = &chunks[0];
+
+	if(workers == nullptr || workers->ThreadCount() == 1 || chunkCount == 1)
+	{
+		for(unsigned int i = 0; i < chunkCount; i++)
+		{
+			BoxChunk(particles, chunkData[i], i);
+		}
+
+		return;
+	}
+
+	const ParticlePool &pool = particles;
+
+	workers->ParallelFor(chunkCount, [&pool, chunkData](unsigned int i)
+	{
+		BoxChunk(pool, chunkData[i], i);
+	});
+}
+
+/// <summary>
+/// Y range particles survive in, relative bounds follow the system position
+/// </summary>
+/// <returns></returns>
+ParticleKernels::KillBounds ParticleSim::GetKillBounds() const
+{
+	ParticleKernels::KillBounds bounds = KillBoundsAt(settings, position);
+	bounds.ground = ground;
+
+	return bounds;
+}
+
+/// <summary>
+/// Kill bounds of an emitter at origin, relative bounds are offset by origin.y
+/// </summary>
+/// <param name="emitSettings">Emitter settings</param>
+/// <param name="origin">Emitter position</param>
+/// <returns></returns>
+ParticleKernels::KillBounds ParticleSim::KillBoundsAt(const Settings &emitSettings, Float3 origin)
+{
+	ParticleKernels::KillBounds bounds = emitSettings.kill;
+
+	if(emitSettings.killRelative)
+	{
+		if(bounds.minY > -FLT_MAX)
+		{
+			bounds.minY += origin.y;
+		}
+
+		if(bounds.maxY < FLT_MAX)
+		{
+			bounds.maxY += origin.y;
+		}
+	}
+
+	return bounds;
+}
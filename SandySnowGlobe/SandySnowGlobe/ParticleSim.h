@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include "ParticlePool.h"
+#include "ParticleKernels.h"
+#include "ParticleSort.h"
+#include "WorkerPool.h"
+#include "Random.h"
+
+//Device independent particle simulation: emit, integrate, kill and sort
+//ParticleSystem wraps one of these with the D3D buffers, the benchmark drives it directly
+class ParticleSim
+{
+public:
+	enum Preset
+	{
+		SNOW,
+		FIRE,
+		DUST,
+		RAIN
+	};
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	struct Settings
+	{
+		unsigned int maxParticles;
+		float frequency;		//particles per second
+		Float3 velocity, velocityDiff, displacementDiff;
+		unsigned int colour;	//packed RGBA8
+		ParticleKernels::KillBounds kill;
+		bool killRelative;		//kill bounds are offsets from the system position's y
+	};
+
+	//consecutive pool particles and the box around them, rebuilt every Update
+	struct Chunk
+	{
+		unsigned int begin, count;
+		ParticleKernels::Aabb bounds;
+	};
+
+	ParticleSim();
+	~ParticleSim();
+
+	bool Init(const Settings &simSettings);
+	void Update(float dt, bool emit, const ParticleSort::DepthAxis *sortAxis);
+
+	void Emit(float dt);
+	void Simulate(float dt);
+	void Sort(const ParticleSort::DepthAxis &axis);
+
+	const Settings &GetSettings() const { return settings; }
+	static Settings PresetSettings(Preset preset);
+
+	static unsigned int DueCount(const Settings &emitSettings, float dt, float &accumulatedTime);
+	static void Spawn(ParticlePool &pool, unsigned int first, unsigned int n, const Settings &emitSettings, Float3 origin, Random &random);
+	static ParticleKernels::KillBounds KillBoundsAt(const Settings &emitSettings, Float3 origin);
+
+	Float3 Position() const { return position; }
+	void Position(Float3 val) { position = val; }
+
+	void Seed(unsigned long long seed) { rng.Seed(seed); }
+
+	WorkerPool *Workers() const { return workers; }
+	void Workers(WorkerPool *val) { workers = val; }
+
+	const HeightField *Ground() const { return ground; }
+	void Ground(const HeightField *val) { ground = val; }
+
+	const ParticlePool &Particles() const { return particles; }
+	unsigned int Count() const { return particles.Count(); }
+	const Chunk *Chunks() const { return chunks.empty() ? nullptr : &chunks[0]; }
+	unsigned int ChunkCount() const { return chunkCount; }
+	ParticleSort::Path LastSortPath() const { return sorter.LastPath(); }
+
+	static const unsigned int CHUNK_SIZE = 4096;	//particles per worker task
+
+private:
+	ParticleSim& operator= (const ParticleSim&);
+	ParticleSim(const ParticleSim&);
+
+	ParticleKernels::KillBounds GetKillBounds() const;
+	void BuildChunks();
+
+	Settings settings;
+	ParticlePool particles;
+	ParticleSort sorter;
+	Random rng;
+	WorkerPool *workers;
+	const HeightField *ground;	//kills at the surface instead of settings.kill.minY, not owned
+	std::vector<Chunk> chunks;
+	unsigned int chunkCount;
+	Float3 position;
+	float accumulatedTime;
+};
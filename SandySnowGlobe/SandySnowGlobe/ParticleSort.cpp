@@ -0,0 +1,225 @@
+#include "ParticleSort.h"
+#include <cstring>
+
+namespace
+{
+	template<typename T>
+	void Gather(T *stream, const unsigned int *order, T *scratch, unsigned int count)
+	{
+		for(unsigned int i = 0; i < count; i++)
+		{
+			scratch[i] = stream[order[i]];
+		}
+
+		std::memcpy(stream, scratch, count * sizeof(T));
+	}
+}
+
+ParticleSort::ParticleSort()
+{
+	lastPath = NONE;
+	keyCount = 0;
+}
+
+/// <summary>
+/// Order the pool farthest first along axis
+/// Tries a budgeted insertion sort first and falls back to a radix sort if the order changed too much
+/// </summary>
+/// <param name="pool">Particle pool</param>
+/// <param name="axis">View-space depth axis</param>
+void ParticleSort::Sort(ParticlePool &pool, const DepthAxis &axis)
+{
+	unsigned int count = pool.Count();
+
+	if(count < 2)
+	{
+		lastPath = NONE;
+		return;
+	}
+
+	BuildKeys(pool, axis);
+
+	//two radix passes move every particle twice plus histograms, roughly the cost of 4 insertion moves each
+	if(InsertionSort(count * 4))
+	{
+		lastPath = INSERTION;
+	}
+	else
+	{
+		RadixSort();
+		lastPath = RADIX;
+	}
+
+	Permute(pool);
+}
+
+/// <summary>
+/// Quantize depth into KEY_BITS over this frame's depth range, far particles get the smallest keys
+/// </summary>
+void ParticleSort::BuildKeys(const ParticlePool &pool, const DepthAxis &axis)
+{
+	unsigned int count = pool.Count();
+	const float *posX = pool.PosX();
+	const float *posY = pool.PosY();
+	const float *posZ = pool.PosZ();
+
+	if(floatScratch.size() < count)
+	{
+		floatScratch.resize(count);
+		uintScratch.resize(count);
+		keys.resize(count);
+		keysTemp.resize(count);
+		order.resize(count);
+		orderTemp.resize(count);
+	}
+
+	keyCount = count;
+
+	float *depth = &floatScratch[0];
+	float minDepth = axis.x * posX[0] + axis.y * posY[0] + axis.z * posZ[0];
+	float maxDepth = minDepth;
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		float d = axis.x * posX[i] + axis.y * posY[i] + axis.z * posZ[i];
+
+		depth[i] = d;
+		minDepth = (d < minDepth) ? d : minDepth;
+		maxDepth = (d > maxDepth) ? d : maxDepth;
+	}
+
+	//axis.w shifts every depth equally so it cannot change the order
+	const float maxKey = (float)((1 << KEY_BITS) - 1);
+	float range = maxDepth - minDepth;
+	float scale = (range > 0.0f) ? maxKey / range : 0.0f;
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		keys[i] = (unsigned short)(maxKey - ((depth[i] - minDepth) * scale));
+		order[i] = i;
+	}
+}
+
+/// <summary>
+/// Stable insertion sort of keys/order, gives up once budget element moves have been spent
+/// </summary>
+/// <param name="budget">Maximum element moves</param>
+/// <returns>False if the budget ran out, keys/order are then only partly sorted</returns>
+bool ParticleSort::InsertionSort(unsigned int budget)
+{
+	unsigned int count = keyCount;
+	unsigned int moves = 0;
+
+	unsigned short *k = &keys[0];
+	unsigned int *o = &order[0];
+
+	for(unsigned int i = 1; i < count; i++)
+	{
+		unsigned short key = k[i];
+
+		if(key >= k[i - 1])
+		{
+			continue;
+		}
+
+		unsigned int index = o[i];
+		unsigned int j = i;
+
+		while(j > 0 && k[j - 1] > key)
+		{
+			k[j] = k[j - 1];
+			o[j] = o[j - 1];
+			j--;
+		}
+
+		k[j] = key;
+		o[j] = index;
+
+		moves += i - j;
+
+		if(moves > budget)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Two 8 bit LSD passes over the 16 bit keys
+/// </summary>
+void ParticleSort::RadixSort()
+{
+	unsigned int count = keyCount;
+
+	unsigned short *srcKeys = &keys[0];
+	unsigned short *dstKeys = &keysTemp[0];
+	unsigned int *srcOrder = &order[0];
+	unsigned int *dstOrder = &orderTemp[0];
+
+	for(unsigned int shift = 0; shift < KEY_BITS; shift += 8)
+	{
+		unsigned int offsets[256];
+		std::memset(offsets, 0, sizeof(offsets));
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			offsets[(srcKeys[i] >> shift) & 0xFF]++;
+		}
+
+		unsigned int sum = 0;
+
+		for(unsigned int b = 0; b < 256; b++)
+		{
+			unsigned int c = offsets[b];
+			offsets[b] = sum;
+			sum += c;
+		}
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			unsigned int slot = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+			dstKeys[slot] = srcKeys[i];
+			dstOrder[slot] = srcOrder[i];
+		}
+
+		unsigned short *tk = srcKeys;
+		srcKeys = dstKeys;
+		dstKeys = tk;
+
+		unsigned int *to = srcOrder;
+		srcOrder = dstOrder;
+		dstOrder = to;
+	}
+
+	//even pass count leaves the result back in keys/order
+}
+
+/// <summary>
+/// Apply order to every stream of the pool
+/// </summary>
+void ParticleSort::Permute(ParticlePool &pool)
+{
+	unsigned int count = pool.Count();
+	const unsigned int *o = &order[0];
+	unsigned int first = 0;
+
+	while(first < count && o[first] == first)
+	{
+		first++;
+	}
+
+	if(first == count)
+	{
+		return;
+	}
+
+	Gather(pool.PosX(), o, &floatScratch[0], count);
+	Gather(pool.PosY(), o, &floatScratch[0], count);
+	Gather(pool.PosZ(), o, &floatScratch[0], count);
+	Gather(pool.VelX(), o, &floatScratch[0], count);
+	Gather(pool.VelY(), o, &floatScratch[0], count);
+	Gather(pool.VelZ(), o, &floatScratch[0], count);
+	Gather(pool.Colour(), o, &uintScratch[0], count);
+}
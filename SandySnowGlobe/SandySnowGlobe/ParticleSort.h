@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include "ParticlePool.h"
+
+//Back-to-front ordering of a pool by view-space depth
+//The pool is permuted in place, so next frame starts almost sorted and usually takes the insertion sort path
+class ParticleSort
+{
+public:
+	//view-space depth = x * px + y * py + z * pz + w, third column of a row-major view matrix
+	struct DepthAxis
+	{
+		float x, y, z, w;
+	};
+
+	enum Path
+	{
+		NONE,
+		INSERTION,
+		RADIX
+	};
+
+	ParticleSort();
+
+	void Sort(ParticlePool &pool, const DepthAxis &axis);
+
+	Path LastPath() const { return lastPath; }
+
+	static const unsigned int KEY_BITS = 16;
+
+private:
+	ParticleSort& operator= (const ParticleSort&);
+	ParticleSort(const ParticleSort&);
+
+	void BuildKeys(const ParticlePool &pool, const DepthAxis &axis);
+	bool InsertionSort(unsigned int budget);
+	void RadixSort();
+	void Permute(ParticlePool &pool);
+
+	std::vector<unsigned short> keys, keysTemp;
+	std::vector<unsigned int> order, orderTemp;
+	std::vector<float> floatScratch;
+	std::vector<unsigned int> uintScratch;
+	unsigned int keyCount;
+	Path lastPath;
+};
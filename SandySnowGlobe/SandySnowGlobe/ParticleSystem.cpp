@@ -4,57 +4,72 @@ ParticleSystem::ParticleSystem(ParticleType particleType, DirectX::XMFLOAT3 posi
 {
 	shader = particleShader;
 	vertexBuffer = nullptr;
-	instanceBuffer = nullptr;
 	type = particleType;
 	active = false;
+	depthSort = true;
+	frustumCull = true;
 	texture = nullptr;
 	vertexCount = 0;
 	instanceCount = 0;
 	maxParticles = 0;
-	particleCount = 0;
 	particleSize = 0.0f;
-	particleFreq = 0.0f;
-	systemPosition = position;
-	particleVelocity = DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
-	particleVelDiff = DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
-	particleDispDiff = DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
+	SystemPosition(position);
 	particleColour = DirectX::XMFLOAT4{ 1.0f, 1.0f, 1.0f, 1.0f };
-	particles = nullptr;
-	instances = nullptr;
-	accumulatedTime = 0.0f;
+	ring = nullptr;
+	ownsRing = false;
+	arena = nullptr;
+	instanceOffset = 0;
+	uploadedCount = 0;
+	ResetCullStats();
 }
 
 ParticleSystem::ParticleSystem()
 {
 	shader = nullptr;
 	vertexBuffer = nullptr;
-	instanceBuffer = nullptr;
 	type = RAIN;
 	active = false;
+	depthSort = true;
+	frustumCull = true;
 	texture = nullptr;
 	vertexCount = 0;
 	instanceCount = 0;
 	maxParticles = 0;
-	particleCount = 0;
 	particleSize = 0.0f;
-	particleFreq = 0.0f;
-	systemPosition = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);;
-	particleVelocity = DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
-	particleVelDiff = DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
-	particleDispDiff = DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f };
 	particleColour = DirectX::XMFLOAT4{ 1.0f, 1.0f, 1.0f, 1.0f };
-	particles = nullptr;
-	instances = nullptr;
-	accumulatedTime = 0.0f;
+	ring = nullptr;
+	ownsRing = false;
+	arena = nullptr;
+	instanceOffset = 0;
+	uploadedCount = 0;
+	ResetCullStats();
 }
 
 ParticleSystem::~ParticleSystem()
 {
-	delete[] particles;
-	delete[] instances;
+	if(ownsRing)
+	{
+		delete ring;
+	}
+
 	delete texture;
 }
 
+/// <summary>
+/// Share an instance ring with other systems, call before Init or Init creates a private one
+/// </summary>
+/// <param name="val">Ring owned by the caller</param>
+void ParticleSystem::InstanceBuffer(InstanceRing *val)
+{
+	if(ownsRing)
+	{
+		delete ring;
+		ownsRing = false;
+	}
+
+	ring = val;
+}
+
 /// <summary>
 /// Initialise texture, particle specific variables and buffers
 /// </summary>
@@ -90,40 +105,60 @@ bool ParticleSystem::InitParticles()
 	switch(type)
 	{
 		case ParticleSystem::SNOW:
-			maxParticles = 50000;
 			particleSize = 0.3f;
-			particleFreq = 5000.0f;
-			particleVelocity = DirectX::XMFLOAT3{ 0.0f, -8.0f, 0.0f };
-			particleVelDiff = DirectX::XMFLOAT3{ 0.0f, 4.0f, 0.0f };
-			particleDispDiff = DirectX::XMFLOAT3{ 75.0f, 75.0f, 75.0f };
 			break;
 		case ParticleSystem::FIRE:
-			maxParticles = 50;
 			particleSize = 0.2f;
-			particleFreq = 10.0f;
-			particleVelocity = DirectX::XMFLOAT3{ 0.0f, 1.5f, 0.0f };
-			particleVelDiff = DirectX::XMFLOAT3{ 0.75f, 0.5f, 0.75f };
-			particleDispDiff = DirectX::XMFLOAT3{ 1.0f, 1.0f, 1.0f };
 			particleColour = DirectX::XMFLOAT4{ 1.0f, 1.0f, 1.0f, 1.0f };
 			break;
 		case ParticleSystem::DUST:
 			break;
 		case ParticleSystem::RAIN:
-			maxParticles = 50000;
 			particleSize = 0.1f;
-			particleFreq = 10000.0f;
-			particleVelocity = DirectX::XMFLOAT3{ 0.0f, -50.0f, 0.0f };
-			particleVelDiff = DirectX::XMFLOAT3{ 0.0f, 10.0f, 0.0f };
-			particleDispDiff = DirectX::XMFLOAT3{ 75.0f, 75.0f, 75.0f };
 			break;
 	}
 
-	particles = new Particle[maxParticles];
+	ParticleSim::Settings settings = ParticleSim::PresetSettings(SimPreset());
+	settings.colour = ParticlePool::PackColour(particleColour.x, particleColour.y, particleColour.z, particleColour.w);
+	maxParticles = settings.maxParticles;
 
-	particleCount = 0;
-	accumulatedTime = 0.0f;
+	//the arena owns the particles, this system only draws them
+	if(arena != nullptr)
+	{
+		maxParticles = arena->Capacity();
+		return maxParticles > 0;
+	}
 
-	return true;
+	return sim.Init(settings);
+}
+
+ParticleSim::Preset ParticleSystem::SimPreset() const
+{
+	switch(type)
+	{
+		case ParticleSystem::SNOW:
+			return ParticleSim::SNOW;
+		case ParticleSystem::FIRE:
+			return ParticleSim::FIRE;
+		case ParticleSystem::RAIN:
+			return ParticleSim::RAIN;
+		default:
+			return ParticleSim::DUST;
+	}
+}
+
+DirectX::XMFLOAT3 ParticleSystem::SystemPosition() const
+{
+	ParticleSim::Float3 p = sim.Position();
+
+	return DirectX::XMFLOAT3(p.x, p.y, p.z);
+}
+
+void ParticleSystem::SystemPosition(DirectX::XMFLOAT3 val)
+{
+	ParticleSim::Float3 p = { val.x, val.y, val.z };
+
+	sim.Position(p);
 }
 
 /// <summary>
@@ -181,29 +216,21 @@ bool ParticleSystem::InitBuffers(ID3D11Device *dev)
 		return false;
 	}
 
-	instances = new ParticleInstance[maxParticles];
-
-	memset(instances, 0, sizeof(ParticleInstance) * maxParticles);
-
-	D3D11_BUFFER_DESC instanceDesc;
-	D3D11_SUBRESOURCE_DATA instanceData;
-
-	instanceDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	instanceDesc.ByteWidth = sizeof(ParticleInstance) * maxParticles;
-	instanceDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	instanceDesc.MiscFlags = 0;
-	instanceDesc.StructureByteStride = 0;
-	instanceDesc.Usage = D3D11_USAGE_DYNAMIC;
-
-	instanceData.pSysMem = instances;
-	instanceData.SysMemPitch = 0;
-	instanceData.SysMemSlicePitch = 0;
+	if(ring == nullptr)
+	{
+		//double size so consecutive frames append with NO_OVERWRITE
+		ring = new InstanceRing();
+		ownsRing = true;
 
-	result = dev->CreateBuffer(&instanceDesc, &instanceData, instanceBuffer.GetAddressOf());
+		ID3D11DeviceContext *devCon = nullptr;
+		dev->GetImmediateContext(&devCon);
+		bool ringInit = ring->Init(dev, devCon, sizeof(ParticleInstance) * maxParticles * 2);
+		devCon->Release();
 
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create index buffer"))
-	{
-		return false;
+		if(!ringInit)
+		{
+			return false;
+		}
 	}
 
 	Memory::SafeDelete(vertices);
@@ -212,31 +239,48 @@ bool ParticleSystem::InitBuffers(ID3D11Device *dev)
 }
 
 /// <summary>
-/// Remove "dead particles", emit new ones and update position of those alive
+/// Step the simulation (emit, integrate, kill, sort back to front) and upload the chunks inside the view frustum
+/// With an arena every emitter is stepped in one pass instead and left unsorted, each emitter is one chunk
 /// </summary>
-/// <param name="devCon">Standard ID3D11DeviceContext</param>
 /// <param name="dt">Delta time</param>
-void ParticleSystem::Update(ID3D11DeviceContext *devCon, float dt)
+/// <param name="vMatrix">View matrix to sort and cull by, nullptr skips both</param>
+/// <param name="pMatrix">Projection matrix to cull by, nullptr uploads every chunk</param>
+void ParticleSystem::Update(float dt, const DirectX::XMFLOAT4X4 *vMatrix, const DirectX::XMFLOAT4X4 *pMatrix)
 {
-	Kill();
-
-	if(active)
+	if(arena != nullptr)
 	{
-		Emit(dt);
+		arena->Update(dt);
 	}
-
-	for(int i = 0; i < particleCount; i++)
+	else if(depthSort && vMatrix != nullptr)
+	{
+		ParticleSort::DepthAxis axis = { vMatrix->_13, vMatrix->_23, vMatrix->_33, vMatrix->_43 };
+		sim.Update(dt, active, &axis);
+	}
+	else
 	{
-		particles[i].position.x = particles[i].position.x + (particles[i].velocity.x * dt);
-		particles[i].position.y = particles[i].position.y + (particles[i].velocity.y * dt);
-		particles[i].position.z = particles[i].position.z + (particles[i].velocity.z * dt);
+		sim.Update(dt, active, nullptr);
 	}
 
-	UpdateVertices(devCon);
+	if(frustumCull && vMatrix != nullptr && pMatrix != nullptr)
+	{
+		//Particle.vs places instances straight in world space, the world matrix is never applied
+		DirectX::XMFLOAT4X4 viewProj;
+		DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(vMatrix), DirectX::XMLoadFloat4x4(pMatrix)));
+
+		Frustum frustum;
+		frustum.Build(&viewProj.m[0][0]);
+
+		UpdateVertices(&frustum);
+	}
+	else
+	{
+		UpdateVertices(nullptr);
+	}
 }
 
 void ParticleSystem::Render(ID3D11DeviceContext *devCon, const DirectX::XMFLOAT4X4 *wMatrix, DirectX::XMFLOAT4X4 *vMatrix, DirectX::XMFLOAT4X4 *pMatrix)
 {
+	DirectX::XMFLOAT3 systemPosition = SystemPosition();
 	DirectX::XMMATRIX m = DirectX::XMLoadFloat4x4(wMatrix);
 	m = DirectX::XMMatrixMultiply(m, DirectX::XMMatrixTranslation(systemPosition.x, systemPosition.y, systemPosition.z));
 	DirectX::XMFLOAT4X4 worldTemp;
@@ -248,155 +292,123 @@ void ParticleSystem::Render(ID3D11DeviceContext *devCon, const DirectX::XMFLOAT4
 
 	unsigned int offsets[2];
 	offsets[0] = 0;
-	offsets[1] = 0;
+	offsets[1] = instanceOffset;
 
 	ID3D11Buffer *buffers[2];
 	buffers[0] = vertexBuffer.Get();
-	buffers[1] = instanceBuffer.Get();
+	buffers[1] = ring->Buffer();
 
 	devCon->IASetVertexBuffers(0, 2, buffers, strides, offsets);
 	devCon->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	shader->Render(devCon, particleCount, &worldTemp, vMatrix, pMatrix, texture->GetTexture());
-}
-
-/// <summary>
-/// Update instance buffer with new positions
-/// </summary>
-/// <param name="devCon">Standard ID3D11DeviceContext</param>
-/// <returns></returns>
-bool ParticleSystem::UpdateVertices(ID3D11DeviceContext *devCon)
-{
-	D3D11_MAPPED_SUBRESOURCE resource;
-	ParticleInstance *instancePtr;
-
-	memset(instances, 0, sizeof(ParticleInstance) * particleCount);
-
-	for(int i = 0; i < particleCount; i++)
+	if(uploadedCount == 0)
 	{
-		instances[i].position = particles[i].position;
+		return;
 	}
 
-	HRESULT result = devCon->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	shader->SetInstanceBounds(devCon,
+		DirectX::XMFLOAT3(uploadBounds.min[0], uploadBounds.min[1], uploadBounds.min[2]),
+		DirectX::XMFLOAT3(uploadBounds.extent[0], uploadBounds.extent[1], uploadBounds.extent[2]),
+		ParticleUpload::MAX_SIZE);
 
-	if(result != S_OK)
-	{
-		return false;
-	}
-
-	instancePtr = (ParticleInstance *)resource.pData;
-	memcpy(instancePtr, (void*)instances, sizeof(ParticleInstance) * particleCount);
-	devCon->Unmap(instanceBuffer.Get(), 0);
-
-	return true;
+	shader->Render(devCon, uploadedCount, &worldTemp, vMatrix, pMatrix, texture->GetTexture());
 }
 
 /// <summary>
-/// Emits new particles if time req is met and count < max 
+/// Quantize the visible chunks straight into the mapped ring, no staging copy
+/// The quantization bounds are the union of the visible chunk boxes, so culling also tightens the step size
 /// </summary>
-/// <param name="dt">Delta time</param>
-void ParticleSystem::Emit(float dt)
+/// <param name="frustum">Chunks fully outside are skipped, nullptr uploads every chunk</param>
+/// <returns></returns>
+bool ParticleSystem::UpdateVertices(const Frustum *frustum)
 {
-	bool emit = false;
-	DirectX::XMFLOAT3 pos, vel;
-	float dtReq = (1000.0f / particleFreq);
-	int loopCounter;
+	uploadedCount = 0;
+	ResetCullStats();
 
-	accumulatedTime += dt * 1000.0f;
-
-	if(accumulatedTime > dtReq)
+	if(ring == nullptr)
 	{
-		accumulatedTime = 0.0f;
-		emit = true;
+		return false;
 	}
 
-	if(emit && particleCount < (maxParticles - 1))
-	{
-		particleCount++;
-
-		pos.x = (((float)(rand()) - (float)(rand())) / (float)(RAND_MAX)* particleDispDiff.x) + systemPosition.x;
-		pos.y = (((float)(rand()) / (float)(RAND_MAX)) * particleDispDiff.y) + (systemPosition.y / 2);
-		pos.z = (((float)(rand()) - (float)(rand())) / (float)(RAND_MAX)* particleDispDiff.z) + systemPosition.z;
+	const ParticlePool &pool = (arena != nullptr) ? arena->Particles() : sim.Particles();
+	const ParticleSim::Chunk *chunks = (arena != nullptr) ? arena->Chunks() : sim.Chunks();
+	unsigned int chunkCount = (arena != nullptr) ? arena->ChunkCount() : sim.ChunkCount();
+	ParticleKernels::Aabb visible = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+	float reach = particleSize * 1.415f;	//billboard corner distance from the particle centre
 
-		vel.x = particleVelocity.x + ((float)(rand()) - (float)(rand())) / (float)(RAND_MAX)* particleVelDiff.x;
-		vel.y = particleVelocity.y + ((float)(rand()) - (float)(rand())) / (float)(RAND_MAX)* particleVelDiff.y;
-		vel.z = particleVelocity.z + ((float)(rand()) - (float)(rand())) / (float)(RAND_MAX)* particleVelDiff.z;
+	uploadRanges.clear();
 
-		unsigned int i = 0;
-		bool placed = false;
+	for(unsigned int i = 0; i < chunkCount; i++)
+	{
+		const ParticleSim::Chunk &chunk = chunks[i];
 
-		while(!placed)
+		if(frustum != nullptr)
 		{
-			if((particles[i].alive == false) || particles[i].position.z < pos.z)
+			float lo[3], hi[3];
+
+			for(unsigned int axis = 0; axis < 3; axis++)
 			{
-				placed = true;
+				lo[axis] = chunk.bounds.min[axis] - reach;
+				hi[axis] = chunk.bounds.max[axis] + reach;
 			}
-			else
+
+			if(!frustum->Intersects(lo, hi))
 			{
-				i++;
+				cullStats.culledChunks++;
+				cullStats.culledParticles += chunk.count;
+				continue;
 			}
 		}
 
-		int j = particleCount;
-		int k = j - 1;
-
-		while(j != i && j > 0)
-		{
-			particles[j].position = particles[k].position;
-			particles[j].velocity = particles[k].velocity;
-			particles[j].colour = particles[k].colour;
-			particles[j].alive = particles[k].alive;
-			j--;
-			k--;
-		}
-
-		particles[i].position = pos;
-		particles[i].velocity = vel;
-		particles[i].colour = particleColour;
-		particles[i].alive = true;
-	}
-}
-
-/// <summary>
-/// Remove particles if they reach their "cutoff point"
-/// </summary>
-void ParticleSystem::Kill()
-{
-	for(int i = 0; i < maxParticles; i++)
-	{
-		if(type != FIRE)
+		if(uploadRanges.empty())
 		{
-			if(particles[i].alive && particles[i].position.y < -10.0f)
-			{
-				particles[i].alive = false;
-				particleCount--;
-
-				for(int j = i; j < maxParticles - 1; j++)
-				{
-					particles[j].position = particles[j + 1].position;
-					particles[j].velocity = particles[j + 1].velocity;
-					particles[j].colour = particles[j + 1].colour;
-					particles[j].alive = particles[j + 1].alive;
-				}
-			}
+			visible = chunk.bounds;
 		}
 		else
 		{
-			if(particles[i].alive && particles[i].position.y >= systemPosition.y + 15.0f)
+			for(unsigned int axis = 0; axis < 3; axis++)
 			{
-				particles[i].alive = false;
-				particleCount--;
-
-				for(int j = i; j < maxParticles - 1; j++)
-				{
-					particles[j].position = particles[j + 1].position;
-					particles[j].velocity = particles[j + 1].velocity;
-					particles[j].colour = particles[j + 1].colour;
-					particles[j].alive = particles[j + 1].alive;
-				}
+				visible.min[axis] = (chunk.bounds.min[axis] < visible.min[axis]) ? chunk.bounds.min[axis] : visible.min[axis];
+				visible.max[axis] = (chunk.bounds.max[axis] > visible.max[axis]) ? chunk.bounds.max[axis] : visible.max[axis];
 			}
 		}
+
+		ParticleUpload::Range range = { chunk.begin, chunk.count };
+		uploadRanges.push_back(range);
+
+		cullStats.visibleChunks++;
+		cullStats.visibleParticles += chunk.count;
+	}
+
+	if(uploadRanges.empty())
+	{
+		return false;
+	}
+
+	uploadBounds = ParticleUpload::MakeBounds(visible);
+
+	//a private ring has this system as its only writer, every upload starts a frame, shared rings are started by their owner
+	if(ownsRing && !ring->BeginFrame(ring->Capacity() / 2))
+	{
+		return false;
+	}
+
+	if(!ParticleUpload::Write(pool, &uploadRanges[0], (unsigned int)uploadRanges.size(), uploadBounds, *ring, instanceOffset))
+	{
+		return false;
 	}
+
+	uploadedCount = cullStats.visibleParticles;
+
+	return true;
+}
+
+void ParticleSystem::ResetCullStats()
+{
+	cullStats.visibleChunks = 0;
+	cullStats.culledChunks = 0;
+	cullStats.visibleParticles = 0;
+	cullStats.culledParticles = 0;
 }
 
 bool ParticleSystem::LoadTexture(ID3D11Device *dev, const WCHAR *textureName)
@@ -414,26 +426,38 @@ bool ParticleSystem::LoadTexture(ID3D11Device *dev, const WCHAR *textureName)
 
 ParticleSystem& ParticleSystem::operator=(const ParticleSystem& p)
 {
+	if(this == &p)
+	{
+		return *this;
+	}
+
+	if(ownsRing)
+	{
+		delete ring;
+	}
+
 	shader = p.shader;
 	vertexBuffer = nullptr;
-	instanceBuffer = nullptr;
 	type = p.type;
 	active = p.active;
+	depthSort = p.depthSort;
+	frustumCull = p.frustumCull;
 	texture = nullptr;
 	vertexCount = p.vertexCount;
 	instanceCount = p.instanceCount;
 	maxParticles = p.maxParticles;
-	particleCount = p.particleCount;
 	particleSize = p.particleSize;
-	particleFreq = p.particleFreq;
-	systemPosition = p.systemPosition;
-	particleVelocity = p.particleVelocity;
-	particleVelDiff = p.particleVelDiff;
-	particleDispDiff = p.particleDispDiff;
 	particleColour = p.particleColour;
-	particles = nullptr;
-	instances = nullptr;
-	accumulatedTime = 0.0f;
+	sim.Init(p.sim.GetSettings());
+	sim.Position(p.sim.Position());
+	sim.Workers(p.sim.Workers());
+	sim.Ground(p.sim.Ground());
+	arena = p.arena;
+	ring = p.ownsRing ? nullptr : p.ring;
+	ownsRing = false;
+	instanceOffset = 0;
+	uploadedCount = 0;
+	ResetCullStats();
 
 	return *this;
 }
@@ -442,24 +466,26 @@ ParticleSystem::ParticleSystem(const ParticleSystem& p)
 {
 	shader = p.shader;
 	vertexBuffer = nullptr;
-	instanceBuffer = nullptr;
 	type = p.type;
 	active = p.active;
+	depthSort = p.depthSort;
+	frustumCull = p.frustumCull;
 	texture = nullptr;
 	vertexCount = p.vertexCount;
 	instanceCount = p.instanceCount;
 	maxParticles = p.maxParticles;
-	particleCount = p.particleCount;
 	particleSize = p.particleSize;
-	particleFreq = p.particleFreq;
-	systemPosition = p.systemPosition;
-	particleVelocity = p.particleVelocity;
-	particleVelDiff = p.particleVelDiff;
-	particleDispDiff = p.particleDispDiff;
 	particleColour = p.particleColour;
-	particles = nullptr;
-	instances = nullptr;
-	accumulatedTime = 0.0f;
+	sim.Init(p.sim.GetSettings());
+	sim.Position(p.sim.Position());
+	sim.Workers(p.sim.Workers());
+	sim.Ground(p.sim.Ground());
+	arena = p.arena;
+	ring = p.ownsRing ? nullptr : p.ring;
+	ownsRing = false;
+	instanceOffset = 0;
+	uploadedCount = 0;
+	ResetCullStats();
 }
 
 
@@ -4,19 +4,16 @@
 #include "DirectXMath.h"
 #include "Texture.h"
 #include "Shader.h"
+#include "ParticleSim.h"
+#include "ParticleArena.h"
+#include "ParticleUpload.h"
+#include "InstanceRing.h"
+#include "Frustum.h"
+#include <vector>
 
 class ParticleSystem
 {
 public:
-	struct Particle
-	{
-		Particle() : alive(false){};
-		DirectX::XMFLOAT3 position;
-		DirectX::XMFLOAT3 velocity;
-		DirectX::XMFLOAT4 colour;
-		bool alive;
-	};
-
 	struct ParticleVertex
 	{
 		DirectX::XMFLOAT3 position;
@@ -24,10 +21,13 @@ public:
 		DirectX::XMFLOAT4 colour;
 	};
 
-	struct ParticleInstance
+	typedef ParticleUpload::Instance ParticleInstance;
+
+	//chunk culling results of the last Update
+	struct CullStats
 	{
-		DirectX::XMFLOAT3 position;
-		DirectX::XMFLOAT3 rotation;
+		unsigned int visibleChunks, culledChunks;
+		unsigned int visibleParticles, culledParticles;
 	};
 
 	enum ParticleType
@@ -47,34 +47,60 @@ public:
 
 	bool Init(ID3D11Device *dev, const WCHAR *textureName);
 	bool Init(ID3D11Device *dev, const WCHAR *tex1, const WCHAR *tex2, const WCHAR *tex3);
-	void Update(ID3D11DeviceContext *devCon, float dt);
+	void Update(float dt, const DirectX::XMFLOAT4X4 *vMatrix = nullptr, const DirectX::XMFLOAT4X4 *pMatrix = nullptr);
 	void Render(ID3D11DeviceContext *devCon, const DirectX::XMFLOAT4X4 *wMatrix, DirectX::XMFLOAT4X4 *vMatrix, DirectX::XMFLOAT4X4 *pMatrix);
 
 	bool *Active() { return &active; }
 	void Active(bool val) { active = val; }
+	bool *DepthSort() { return &depthSort; }
+	void DepthSort(bool val) { depthSort = val; }
+	bool *FrustumCull() { return &frustumCull; }
+	void FrustumCull(bool val) { frustumCull = val; }
+
+	CullStats *Culling() { return &cullStats; }
+
+	DirectX::XMFLOAT3 SystemPosition() const;
+	void SystemPosition(DirectX::XMFLOAT3 val);
+
+	void Seed(unsigned long long seed) { sim.Seed(seed); }
+
+	WorkerPool *Workers() const { return sim.Workers(); }
+	void Workers(WorkerPool *val) { sim.Workers(val); }
+
+	const HeightField *Ground() const { return sim.Ground(); }
+	void Ground(const HeightField *val) { sim.Ground(val); }
+
+	const ParticleSim &Sim() const { return sim; }
+
+	InstanceRing *InstanceBuffer() const { return ring; }
+	void InstanceBuffer(InstanceRing *val);
 
-	DirectX::XMFLOAT3 SystemPosition() const { return systemPosition; }
-	void SystemPosition(DirectX::XMFLOAT3 val) { systemPosition = val; }
+	//draw a shared arena's emitters instead of owning a sim, set before Init
+	ParticleArena *Arena() const { return arena; }
+	void Arena(ParticleArena *val) { arena = val; }
 
 private:
 	bool LoadTexture(ID3D11Device *dev, const WCHAR *textureName);
 	bool InitParticles();
 	bool InitBuffers(ID3D11Device *dev);
-	bool UpdateVertices(ID3D11DeviceContext *devCon);
-	void Emit(float dt);
-	void Kill();
+	bool UpdateVertices(const Frustum *frustum);
+	void ResetCullStats();
+	ParticleSim::Preset SimPreset() const;
 
-	Particle *particles;
-	ParticleInstance *instances;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer, instanceBuffer;
+	ParticleSim sim;
+	ParticleArena *arena;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+	InstanceRing *ring;
 	ParticleType type;
 	Texture *texture;
 	Shader *shader;
-	unsigned int maxParticles, particleCount, vertexCount, instanceCount;
-	float particleSize, particleFreq, accumulatedTime;
-	DirectX::XMFLOAT3 systemPosition, particleVelocity, particleVelDiff, particleDispDiff;
+	unsigned int maxParticles, vertexCount, instanceCount, instanceOffset, uploadedCount;
+	ParticleUpload::Bounds uploadBounds;
+	std::vector<ParticleUpload::Range> uploadRanges;
+	CullStats cullStats;
+	float particleSize;
 
 	DirectX::XMFLOAT4 particleColour;
-	bool active;
+	bool active, depthSort, frustumCull, ownsRing;
 };
 
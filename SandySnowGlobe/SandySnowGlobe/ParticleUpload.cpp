@@ -0,0 +1,219 @@
+#include "ParticleUpload.h"
+#include <cfloat>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PARTICLE_UPLOAD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const float QUANT_MAX = 65535.0f;
+
+	//clamps written as selects so the write loop stays branch free
+	inline unsigned short Quantize(float value, float min, float scale)
+	{
+		float q = ((value - min) * scale) + 0.5f;
+
+		q = (q > 0.0f) ? q : 0.0f;
+		q = (q < QUANT_MAX) ? q : QUANT_MAX;
+
+		return (unsigned short)(int)q;
+	}
+
+	inline float QuantScale(float extent)
+	{
+		return (extent > 0.0f) ? QUANT_MAX / extent : 0.0f;
+	}
+
+	//quantize count consecutive particles into out, the caller maps the memory
+	void QuantizeRange(const float *posX, const float *posY, const float *posZ, unsigned int count, const ParticleUpload::Bounds &bounds, ParticleUpload::Instance *out)
+	{
+		float scaleX = QuantScale(bounds.extent[0]);
+		float scaleY = QuantScale(bounds.extent[1]);
+		float scaleZ = QuantScale(bounds.extent[2]);
+		unsigned short size = Quantize(1.0f, 0.0f, QUANT_MAX / ParticleUpload::MAX_SIZE);
+		unsigned int i = 0;
+
+		//mapped memory is write combined, fill every field in order and never read it back
+#ifdef PARTICLE_UPLOAD_SSE2
+		__m128 minX = _mm_set1_ps(bounds.min[0]);
+		__m128 minY = _mm_set1_ps(bounds.min[1]);
+		__m128 minZ = _mm_set1_ps(bounds.min[2]);
+		__m128 half = _mm_set1_ps(0.5f);
+		__m128 vScaleX = _mm_set1_ps(scaleX);
+		__m128 vScaleY = _mm_set1_ps(scaleY);
+		__m128 vScaleZ = _mm_set1_ps(scaleZ);
+		__m128 zero = _mm_setzero_ps();
+		__m128 top = _mm_set1_ps(QUANT_MAX);
+		__m128i bias = _mm_set1_epi32(0x8000);
+		__m128i flip = _mm_set1_epi16((short)0x8000);
+		__m128i sizes = _mm_set1_epi16((short)size);
+
+		for(; i + 4 <= count; i += 4)
+		{
+			//same operation order as Quantize so both paths round identically
+			__m128 x = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(posX + i), minX), vScaleX), half);
+			__m128 y = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(posY + i), minY), vScaleY), half);
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(posZ + i), minZ), vScaleZ), half);
+
+			x = _mm_min_ps(_mm_max_ps(x, zero), top);
+			y = _mm_min_ps(_mm_max_ps(y, zero), top);
+			z = _mm_min_ps(_mm_max_ps(z, zero), top);
+
+			//SSE2 only packs signed, shift into range and flip the top bit back afterwards
+			__m128i qx = _mm_sub_epi32(_mm_cvttps_epi32(x), bias);
+			__m128i qy = _mm_sub_epi32(_mm_cvttps_epi32(y), bias);
+			__m128i qz = _mm_sub_epi32(_mm_cvttps_epi32(z), bias);
+			__m128i xy = _mm_xor_si128(_mm_packs_epi32(qx, qy), flip);	//x0..x3 y0..y3
+			__m128i zs = _mm_xor_si128(_mm_packs_epi32(qz, qz), flip);	//z0..z3 z0..z3
+
+			__m128i xyLanes = _mm_unpacklo_epi16(xy, _mm_unpackhi_epi64(xy, xy));	//x0 y0 x1 y1 ..
+			__m128i zsLanes = _mm_unpacklo_epi16(zs, sizes);						//z0 s z1 s ..
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_unpacklo_epi32(xyLanes, zsLanes));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 2), _mm_unpackhi_epi32(xyLanes, zsLanes));
+		}
+#endif
+
+		for(; i < count; i++)
+		{
+			out[i].position[0] = Quantize(posX[i], bounds.min[0], scaleX);
+			out[i].position[1] = Quantize(posY[i], bounds.min[1], scaleY);
+			out[i].position[2] = Quantize(posZ[i], bounds.min[2], scaleZ);
+			out[i].size = size;
+		}
+	}
+}
+
+namespace ParticleUpload
+{
+	/// <summary>
+	/// Axis aligned box around every live particle
+	/// </summary>
+	/// <param name="pool">Particle pool</param>
+	/// <returns>Empty pool gives a zero sized box at the origin</returns>
+	Bounds ComputeBounds(const ParticlePool &pool)
+	{
+		ParticleKernels::Aabb box;
+		ParticleKernels::RangeBounds(pool, 0, pool.Count(), box);
+
+		return MakeBounds(box);
+	}
+
+	/// <summary>
+	/// Quantization bounds covering box, e.g. the union of the chunks being uploaded
+	/// </summary>
+	Bounds MakeBounds(const ParticleKernels::Aabb &box)
+	{
+		Bounds bounds;
+
+		for(unsigned int axis = 0; axis < 3; axis++)
+		{
+			bounds.min[axis] = box.min[axis];
+			bounds.extent[axis] = box.max[axis] - box.min[axis];
+		}
+
+		return bounds;
+	}
+
+	/// <summary>
+	/// Largest position error Encode/Decode can introduce for points inside bounds
+	/// Half a quantization step plus float rounding at the largest coordinate, worst axis
+	/// </summary>
+	float MaxError(const Bounds &bounds)
+	{
+		float worst = 0.0f;
+
+		for(unsigned int axis = 0; axis < 3; axis++)
+		{
+			float lo = bounds.min[axis];
+			float hi = lo + bounds.extent[axis];
+			float magnitude = (-lo > hi) ? -lo : hi;
+			float error = (bounds.extent[axis] / (2.0f * QUANT_MAX)) + (magnitude * 4.0f * FLT_EPSILON);
+
+			worst = (error > worst) ? error : worst;
+		}
+
+		return worst;
+	}
+
+	/// <summary>
+	/// Quantize one particle, values outside bounds clamp to the nearest edge
+	/// </summary>
+	void Encode(const Bounds &bounds, float x, float y, float z, float size, Instance &out)
+	{
+		out.position[0] = Quantize(x, bounds.min[0], QuantScale(bounds.extent[0]));
+		out.position[1] = Quantize(y, bounds.min[1], QuantScale(bounds.extent[1]));
+		out.position[2] = Quantize(z, bounds.min[2], QuantScale(bounds.extent[2]));
+		out.size = Quantize(size, 0.0f, QUANT_MAX / MAX_SIZE);
+	}
+
+	/// <summary>
+	/// Inverse of Encode, matches what Particle.vs reconstructs
+	/// </summary>
+	void Decode(const Bounds &bounds, const Instance &in, float &x, float &y, float &z, float &size)
+	{
+		x = bounds.min[0] + ((float)in.position[0] / QUANT_MAX) * bounds.extent[0];
+		y = bounds.min[1] + ((float)in.position[1] / QUANT_MAX) * bounds.extent[1];
+		z = bounds.min[2] + ((float)in.position[2] / QUANT_MAX) * bounds.extent[2];
+		size = ((float)in.size / QUANT_MAX) * MAX_SIZE;
+	}
+
+	/// <summary>
+	/// Quantize every live particle straight into sink memory in one pass, 4 at a time with SSE2
+	/// </summary>
+	/// <param name="pool">Particle pool</param>
+	/// <param name="bounds">Box the positions are quantized in, normally ComputeBounds(pool)</param>
+	/// <param name="sink">Destination</param>
+	/// <param name="offset">Byte offset the instances landed at, bind the buffer here</param>
+	/// <returns>False if nothing was written</returns>
+	bool Write(const ParticlePool &pool, const Bounds &bounds, InstanceSink &sink, unsigned int &offset)
+	{
+		Range all = { 0, pool.Count() };
+
+		return Write(pool, &all, 1, bounds, sink, offset);
+	}
+
+	/// <summary>
+	/// Quantize only the given ranges, packed back to back in range order
+	/// Used to skip chunks culled against the view frustum
+	/// </summary>
+	/// <param name="pool">Particle pool</param>
+	/// <param name="ranges">Ranges to upload</param>
+	/// <param name="rangeCount">Number of ranges</param>
+	/// <param name="bounds">Box the positions are quantized in, must cover every range</param>
+	/// <param name="sink">Destination</param>
+	/// <param name="offset">Byte offset the instances landed at, bind the buffer here</param>
+	/// <returns>False if nothing was written</returns>
+	bool Write(const ParticlePool &pool, const Range *ranges, unsigned int rangeCount, const Bounds &bounds, InstanceSink &sink, unsigned int &offset)
+	{
+		unsigned int count = 0;
+		InstanceSink::Allocation allocation;
+
+		for(unsigned int r = 0; r < rangeCount; r++)
+		{
+			count += ranges[r].count;
+		}
+
+		if(count == 0 || !sink.Begin(count * sizeof(Instance), allocation))
+		{
+			return false;
+		}
+
+		Instance *out = static_cast<Instance *>(allocation.data);
+
+		for(unsigned int r = 0; r < rangeCount; r++)
+		{
+			unsigned int begin = ranges[r].begin;
+
+			QuantizeRange(pool.PosX() + begin, pool.PosY() + begin, pool.PosZ() + begin, ranges[r].count, bounds, out);
+			out += ranges[r].count;
+		}
+
+		sink.End();
+		offset = allocation.offset;
+
+		return true;
+	}
+}
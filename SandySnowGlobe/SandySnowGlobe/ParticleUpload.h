@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ParticlePool.h"
+#include "ParticleKernels.h"
+#include "InstanceSink.h"
+
+//Writes pool particles into an InstanceSink in the layout Particle.vs reads
+//Positions are 16 bit fractions of a bounding box sent alongside in a constant buffer
+namespace ParticleUpload
+{
+	//R16G16B16A16_UNORM, xyz position in bounds, w size as a fraction of MAX_SIZE
+	struct Instance
+	{
+		unsigned short position[3];
+		unsigned short size;
+	};
+
+	struct Bounds
+	{
+		float min[3];
+		float extent[3];
+	};
+
+	//run of consecutive pool particles to upload
+	struct Range
+	{
+		unsigned int begin, count;
+	};
+
+	const float MAX_SIZE = 4.0f;	//largest size multiplier w can hold
+
+	Bounds ComputeBounds(const ParticlePool &pool);
+	Bounds MakeBounds(const ParticleKernels::Aabb &box);
+	float MaxError(const Bounds &bounds);
+
+	void Encode(const Bounds &bounds, float x, float y, float z, float size, Instance &out);
+	void Decode(const Bounds &bounds, const Instance &in, float &x, float &y, float &z, float &size);
+
+	bool Write(const ParticlePool &pool, const Bounds &bounds, InstanceSink &sink, unsigned int &offset);
+	bool Write(const ParticlePool &pool, const Range *ranges, unsigned int rangeCount, const Bounds &bounds, InstanceSink &sink, unsigned int &offset);
+}
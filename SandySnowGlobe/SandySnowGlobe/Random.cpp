@@ -0,0 +1,241 @@
+#include "Random.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define RANDOM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const unsigned long long DEFAULT_SEED = 0x5EED5EED5EED5EEDULL;
+
+	unsigned long long SplitMix(unsigned long long &state)
+	{
+		unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	inline unsigned long long RotL(unsigned long long x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	//top 23 bits as the mantissa of a float in [1, 2), minus 1
+	inline float ToUnitFloat(unsigned int bits)
+	{
+		union { unsigned int u; float f; } v;
+		v.u = (bits >> 9) | 0x3F800000u;
+		return v.f - 1.0f;
+	}
+}
+
+Random::Random()
+{
+	Seed(DEFAULT_SEED);
+}
+
+Random::Random(unsigned long long seed)
+{
+	Seed(seed);
+}
+
+/// <summary>
+/// Reset every generator from one 64 bit seed
+/// </summary>
+/// <param name="seed">Seed, any value including 0 is fine</param>
+void Random::Seed(unsigned long long seed)
+{
+	unsigned long long state = seed;
+
+	s0 = SplitMix(state);
+	s1 = SplitMix(state);
+
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		unsigned long long a = SplitMix(state);
+		unsigned long long b = SplitMix(state);
+
+		lanes[0][i] = (unsigned int)a;
+		lanes[1][i] = (unsigned int)(a >> 32);
+		lanes[2][i] = (unsigned int)b;
+		lanes[3][i] = (unsigned int)(b >> 32) | 1u;	//xorshift state must not be all zero
+	}
+}
+
+/// <summary>
+/// Derive an independent seed for a numbered stream, so one config seed can feed every system
+/// </summary>
+/// <param name="seed">Base seed</param>
+/// <param name="stream">Stream id</param>
+/// <returns></returns>
+unsigned long long Random::StreamSeed(unsigned long long seed, unsigned int stream)
+{
+	unsigned long long state = seed ^ ((unsigned long long)stream * 0xD1B54A32D192ED03ULL);
+
+	return SplitMix(state);
+}
+
+unsigned long long Random::Next()
+{
+	unsigned long long a = s0;
+	unsigned long long b = s1;
+	unsigned long long result = a + b;
+
+	b ^= a;
+	s0 = RotL(a, 24) ^ b ^ (b << 16);
+	s1 = RotL(b, 37);
+
+	return result;
+}
+
+/// <summary>
+/// Uniform float in [0, 1)
+/// </summary>
+float Random::NextFloat()
+{
+	return (float)(Next() >> 40) * (1.0f / 16777216.0f);
+}
+
+/// <summary>
+/// Uniform float in [min, max)
+/// </summary>
+float Random::Range(float min, float max)
+{
+	return min + (NextFloat() * (max - min));
+}
+
+/// <summary>
+/// Advance all four lanes once, scalar twin of the SSE2 loops below
+/// </summary>
+void Random::Step4(float out[4])
+{
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		unsigned int t = lanes[0][i] ^ (lanes[0][i] << 11);
+		unsigned int w = lanes[3][i];
+
+		lanes[0][i] = lanes[1][i];
+		lanes[1][i] = lanes[2][i];
+		lanes[2][i] = w;
+		lanes[3][i] = (w ^ (w >> 19)) ^ (t ^ (t >> 8));
+
+		out[i] = ToUnitFloat(lanes[3][i]);
+	}
+}
+
+/// <summary>
+/// Fill out with n uniform floats in [min, max)
+/// Output is identical with or without SSE2
+/// </summary>
+/// <param name="out">Destination</param>
+/// <param name="n">Number of floats</param>
+/// <param name="min">Lower bound</param>
+/// <param name="max">Upper bound</param>
+void Random::Fill(float *out, unsigned int n, float min, float max)
+{
+	float range = max - min;
+	unsigned int i = 0;
+
+#ifdef RANDOM_SSE2
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[0]));
+	__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[1]));
+	__m128i z = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[2]));
+	__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[3]));
+	__m128i one = _mm_set1_epi32(0x3F800000);
+	__m128 unitOne = _mm_set1_ps(1.0f);
+	__m128 vMin = _mm_set1_ps(min);
+	__m128 vRange = _mm_set1_ps(range);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128i t = _mm_xor_si128(x, _mm_slli_epi32(x, 11));
+		x = y;
+		y = z;
+		z = w;
+		w = _mm_xor_si128(_mm_xor_si128(w, _mm_srli_epi32(w, 19)), _mm_xor_si128(t, _mm_srli_epi32(t, 8)));
+
+		__m128 u = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(w, 9), one)), unitOne);
+		_mm_storeu_ps(out + i, _mm_add_ps(vMin, _mm_mul_ps(u, vRange)));
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[0]), x);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[1]), y);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[2]), z);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[3]), w);
+#endif
+
+	float u[4];
+
+	while(i < n)
+	{
+		Step4(u);
+
+		for(unsigned int lane = 0; lane < 4 && i < n; lane++, i++)
+		{
+			out[i] = min + (u[lane] * range);
+		}
+	}
+}
+
+/// <summary>
+/// Fill out with n floats of centre + (a - b) * spread, a and b uniform in [0, 1)
+/// Triangular distribution over (centre - spread, centre + spread), denser near the centre
+/// </summary>
+/// <param name="out">Destination</param>
+/// <param name="n">Number of floats</param>
+/// <param name="centre">Distribution centre</param>
+/// <param name="spread">Maximum distance from the centre</param>
+void Random::FillSpread(float *out, unsigned int n, float centre, float spread)
+{
+	unsigned int i = 0;
+
+#ifdef RANDOM_SSE2
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[0]));
+	__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[1]));
+	__m128i z = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[2]));
+	__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[3]));
+	__m128i one = _mm_set1_epi32(0x3F800000);
+	__m128 vCentre = _mm_set1_ps(centre);
+	__m128 vSpread = _mm_set1_ps(spread);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128i t = _mm_xor_si128(x, _mm_slli_epi32(x, 11));
+		x = y;
+		y = z;
+		z = w;
+		w = _mm_xor_si128(_mm_xor_si128(w, _mm_srli_epi32(w, 19)), _mm_xor_si128(t, _mm_srli_epi32(t, 8)));
+		__m128 a = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(w, 9), one));
+
+		t = _mm_xor_si128(x, _mm_slli_epi32(x, 11));
+		x = y;
+		y = z;
+		z = w;
+		w = _mm_xor_si128(_mm_xor_si128(w, _mm_srli_epi32(w, 19)), _mm_xor_si128(t, _mm_srli_epi32(t, 8)));
+		__m128 b = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(w, 9), one));
+
+		//(a + 1) - (b + 1) == a - b, the offsets cancel exactly
+		_mm_storeu_ps(out + i, _mm_add_ps(vCentre, _mm_mul_ps(_mm_sub_ps(a, b), vSpread)));
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[0]), x);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[1]), y);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[2]), z);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[3]), w);
+#endif
+
+	float a[4], b[4];
+
+	while(i < n)
+	{
+		Step4(a);
+		Step4(b);
+
+		for(unsigned int lane = 0; lane < 4 && i < n; lane++, i++)
+		{
+			out[i] = centre + ((a[lane] - b[lane]) * spread);
+		}
+	}
+}
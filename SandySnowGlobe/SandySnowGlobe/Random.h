@@ -0,0 +1,28 @@
+#pragma once
+
+//Seedable random number generator, xoroshiro128+ for single values and a 4-lane xorshift128 for bulk fills
+//Instances hold all their state, give each system or thread its own stream instead of sharing one
+class Random
+{
+public:
+	Random();
+	explicit Random(unsigned long long seed);
+
+	void Seed(unsigned long long seed);
+
+	unsigned long long Next();
+	float NextFloat();
+	float Range(float min, float max);
+	bool Chance(float probability) { return NextFloat() < probability; }
+
+	void Fill(float *out, unsigned int n, float min, float max);
+	void FillSpread(float *out, unsigned int n, float centre, float spread);
+
+	static unsigned long long StreamSeed(unsigned long long seed, unsigned int stream);
+
+private:
+	void Step4(float out[4]);
+
+	unsigned long long s0, s1;
+	unsigned int lanes[4][4];	//xorshift128 x, y, z, w per lane
+};
@@ -0,0 +1,202 @@
+#include "RenderQueue.h"
+#include <cstring>
+
+namespace
+{
+	//per RenderQueue::Field, high to low
+	const unsigned int FIELD_BITS[RenderQueue::FIELD_COUNT] = { RenderQueue::PASS_BITS, RenderQueue::SHADER_BITS, RenderQueue::TEXTURE_BITS, RenderQueue::MESH_BITS, RenderQueue::DEPTH_BITS };
+	const unsigned int FIELD_SHIFT[RenderQueue::FIELD_COUNT] =
+	{
+		RenderQueue::SHADER_BITS + RenderQueue::TEXTURE_BITS + RenderQueue::MESH_BITS + RenderQueue::DEPTH_BITS,
+		RenderQueue::TEXTURE_BITS + RenderQueue::MESH_BITS + RenderQueue::DEPTH_BITS,
+		RenderQueue::MESH_BITS + RenderQueue::DEPTH_BITS,
+		RenderQueue::DEPTH_BITS,
+		0
+	};
+	const unsigned int DIGIT_COUNT = 8;
+
+	inline unsigned int FieldMax(unsigned int field)
+	{
+		return (1u << FIELD_BITS[field]) - 1;
+	}
+
+	inline unsigned long long Place(unsigned int value, unsigned int field)
+	{
+		value = (value < FieldMax(field)) ? value : FieldMax(field);
+
+		return (unsigned long long)value << FIELD_SHIFT[field];
+	}
+}
+
+bool RenderQueue::Resources::operator<(const Resources &other) const
+{
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		if(pointers[i] != other.pointers[i])
+		{
+			return pointers[i] < other.pointers[i];
+		}
+	}
+
+	return false;
+}
+
+RenderQueue::RenderQueue()
+{
+	lastSortPasses = 0;
+}
+
+/// <summary>
+/// Empty the queue for the next frame, interned ids and the storage are kept
+/// </summary>
+void RenderQueue::Clear()
+{
+	items.clear();
+}
+
+/// <summary>
+/// Add a draw
+/// </summary>
+/// <param name="key">From MakeKey</param>
+/// <param name="payload">Caller's index of the draw's own record</param>
+void RenderQueue::Submit(unsigned long long key, unsigned int payload)
+{
+	Item item = { key, payload };
+	items.push_back(item);
+}
+
+/// <summary>
+/// Stable LSD radix sort on the whole key, 8 bits a pass
+/// All eight histograms come from one sweep, digits every key shares need no pass, so a queue that only differs in
+/// shader and depth usually takes three or four
+/// </summary>
+void RenderQueue::Sort()
+{
+	unsigned int count = (unsigned int)items.size();
+	lastSortPasses = 0;
+
+	if(count < 2)
+	{
+		return;
+	}
+
+	unsigned int histograms[DIGIT_COUNT][256];
+	std::memset(histograms, 0, sizeof(histograms));
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		unsigned long long key = items[i].key;
+
+		for(unsigned int d = 0; d < DIGIT_COUNT; d++)
+		{
+			histograms[d][(key >> (d * 8)) & 0xFF]++;
+		}
+	}
+
+	scratch.resize(count);
+
+	for(unsigned int d = 0; d < DIGIT_COUNT; d++)
+	{
+		unsigned int *offsets = histograms[d];
+
+		if(offsets[(items[0].key >> (d * 8)) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		unsigned int sum = 0;
+
+		for(unsigned int b = 0; b < 256; b++)
+		{
+			unsigned int c = offsets[b];
+			offsets[b] = sum;
+			sum += c;
+		}
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			scratch[offsets[(items[i].key >> (d * 8)) & 0xFF]++] = items[i];
+		}
+
+		items.swap(scratch);
+		lastSortPasses++;
+	}
+}
+
+/// <summary>
+/// Id for a resource combination in one of the interned key fields, new combinations get the next id
+/// </summary>
+/// <param name="field">FIELD_SHADER, FIELD_TEXTURES or FIELD_MESH</param>
+/// <param name="a">First resource</param>
+/// <param name="b">Second, nullptr for none</param>
+/// <param name="c">Third, nullptr for none</param>
+/// <returns>0 for the other fields</returns>
+unsigned int RenderQueue::Intern(Field field, const void *a, const void *b, const void *c)
+{
+	if(field != FIELD_SHADER && field != FIELD_TEXTURES && field != FIELD_MESH)
+	{
+		return 0;
+	}
+
+	Resources resources = { { a, b, c } };
+	std::map<Resources, unsigned int>::const_iterator it = ids[field].find(resources);
+
+	if(it != ids[field].end())
+	{
+		return it->second;
+	}
+
+	//the last id is kept for overflow
+	if(ids[field].size() >= FieldMax(field))
+	{
+		return FieldMax(field);
+	}
+
+	unsigned int id = (unsigned int)ids[field].size();
+	ids[field][resources] = id;
+
+	return id;
+}
+
+/// <summary>
+/// Pack a draw's sort key, values too large for their field are clamped to its last value
+/// </summary>
+/// <param name="pass">Pass, drawn in ascending order</param>
+/// <param name="shader">Interned shader id</param>
+/// <param name="textures">Interned texture set id</param>
+/// <param name="mesh">Interned mesh id</param>
+/// <param name="depth">0 to 1, ascending, pass 1 - depth for back to front</param>
+/// <returns></returns>
+unsigned long long RenderQueue::MakeKey(unsigned int pass, unsigned int shader, unsigned int textures, unsigned int mesh, float depth)
+{
+	//written so NaN lands on 0
+	float clamped = (depth > 0.0f) ? ((depth < 1.0f) ? depth : 1.0f) : 0.0f;
+
+	return Place(pass, FIELD_PASS) | Place(shader, FIELD_SHADER) | Place(textures, FIELD_TEXTURES) | Place(mesh, FIELD_MESH) |
+		Place((unsigned int)(clamped * (float)FieldMax(FIELD_DEPTH)), FIELD_DEPTH);
+}
+
+unsigned int RenderQueue::FieldValue(unsigned long long key, Field field)
+{
+	return (unsigned int)(key >> FIELD_SHIFT[field]) & FieldMax(field);
+}
+
+/// <summary>
+/// Whether two keys agree on every field from the pass down to field, in which case that state need not be bound again
+/// Overflowed interned ids stand for many combinations and never compare equal
+/// </summary>
+bool RenderQueue::SamePrefix(unsigned long long a, unsigned long long b, Field field)
+{
+	for(unsigned int f = FIELD_PASS; f <= (unsigned int)field; f++)
+	{
+		unsigned int value = FieldValue(a, (Field)f);
+		bool interned = f == FIELD_SHADER || f == FIELD_TEXTURES || f == FIELD_MESH;
+
+		if(value != FieldValue(b, (Field)f) || (interned && value == FieldMax(f)))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+//Sort-keyed draw list, no D3D dependency
+//Each draw submits a 64 bit key and a payload, the caller's index into its own draw records, Sort orders them once per frame
+//Key, high to low: pass 4 | shader 8 | texture set 16 | mesh 12 | depth 24, so draws sharing state end up next to each other
+//and an equal key prefix between neighbours means that state is already bound
+class RenderQueue
+{
+public:
+	struct Item
+	{
+		unsigned long long key;
+		unsigned int payload;
+	};
+
+	//key fields, high to low
+	enum Field
+	{
+		FIELD_PASS,
+		FIELD_SHADER,
+		FIELD_TEXTURES,
+		FIELD_MESH,
+		FIELD_DEPTH,
+		FIELD_COUNT
+	};
+
+	static const unsigned int PASS_BITS = 4;
+	static const unsigned int SHADER_BITS = 8;
+	static const unsigned int TEXTURE_BITS = 16;
+	static const unsigned int MESH_BITS = 12;
+	static const unsigned int DEPTH_BITS = 24;
+
+	RenderQueue();
+
+	void Clear();
+	void Submit(unsigned long long key, unsigned int payload);
+	void Sort();
+
+	unsigned int Count() const { return (unsigned int)items.size(); }
+	const Item *Items() const { return items.empty() ? nullptr : &items[0]; }
+	unsigned int LastSortPasses() const { return lastSortPasses; }	//radix passes the last Sort needed, digits every key shares are skipped
+
+	//small ids that stay the same across frames for a resource or a combination of up to three, per key field
+	//once a field runs out of ids every new combination shares the last one, which SamePrefix never treats as equal
+	unsigned int Intern(Field field, const void *a, const void *b = nullptr, const void *c = nullptr);
+
+	static unsigned long long MakeKey(unsigned int pass, unsigned int shader, unsigned int textures, unsigned int mesh, float depth);
+	static unsigned int FieldValue(unsigned long long key, Field field);
+	static bool SamePrefix(unsigned long long a, unsigned long long b, Field field);
+
+private:
+	RenderQueue& operator= (const RenderQueue&);
+	RenderQueue(const RenderQueue&);
+
+	struct Resources
+	{
+		const void *pointers[3];
+
+		bool operator<(const Resources &other) const;
+	};
+
+	std::vector<Item> items, scratch;
+	std::map<Resources, unsigned int> ids[FIELD_COUNT];
+	unsigned int lastSortPasses;
+};
@@ -1,4 +1,35 @@
 #include "Shader.h"
+#include "InstanceBatcher.h"
+#include <cstring>
+
+namespace
+{
+	//ConstantBlocks writes through the device context, one buffer per block
+	class ContextConstantWriter : public ConstantWriter
+	{
+	public:
+		ContextConstantWriter(ID3D11DeviceContext *devCon, ID3D11Buffer *const *buffers) : devCon(devCon), buffers(buffers) {}
+
+		bool Write(unsigned int block, const void *data, unsigned int bytes) override
+		{
+			D3D11_MAPPED_SUBRESOURCE resource;
+
+			if(devCon->Map(buffers[block], 0, D3D11_MAP_WRITE_DISCARD, 0, &resource) != S_OK)
+			{
+				return false;
+			}
+
+			std::memcpy(resource.pData, data, bytes);
+			devCon->Unmap(buffers[block], 0);
+
+			return true;
+		}
+
+	private:
+		ID3D11DeviceContext *devCon;
+		ID3D11Buffer *const *buffers;
+	};
+}
 
 
 Shader::Shader(ShaderType shaderType)
@@ -10,10 +41,10 @@ Shader::Shader(ShaderType shaderType)
 	matrixBuffer = nullptr;
 	sampleState = nullptr;
 	lightBuffer = nullptr;
-	cameraBuffer = nullptr;
 	timeBuffer = nullptr;
 	noiseBuffer = nullptr;
 	distortionBuffer = nullptr;
+	instancedBound = false;
 }
 
 Shader::~Shader()
@@ -21,6 +52,26 @@ Shader::~Shader()
 	//all comptrs
 }
 
+/// <summary>
+/// Compile both stages ahead of Init, D3DCompile is thread safe and this touches no device object, so it can run on a worker
+/// A failed stage is left for Init, which compiles it again and reports the error as before
+/// </summary>
+/// <param name="vsFile">Vertex shader filepath</param>
+/// <param name="psFile">Pixel shader filepath</param>
+/// <returns></returns>
+bool Shader::Compile(const std::wstring &vsFile, const std::wstring &psFile)
+{
+	HRESULT vsResult = D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_main", "vs_5_0", 0, 0, vertexBlob.ReleaseAndGetAddressOf(), nullptr);
+	HRESULT psResult = D3DCompileFromFile(psFile.c_str(), nullptr, nullptr, "ps_main", "ps_5_0", 0, 0, pixelBlob.ReleaseAndGetAddressOf(), nullptr);
+
+	if(type == NORMAL)
+	{
+		D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_instanced", "vs_5_0", 0, 0, instancedBlob.ReleaseAndGetAddressOf(), nullptr);
+	}
+
+	return SUCCEEDED(vsResult) && SUCCEEDED(psResult);
+}
+
 /// <summary>
 /// Initialise various shader types
 /// </summary>
@@ -162,200 +213,280 @@ void Shader::Render(ID3D11DeviceContext *devCon, unsigned int indexCount, const
 	}
 	else
 	{
-		MatricesBuffer *matricesPtr;
-
-		DirectX::XMMATRIX worldMatrixCopy = DirectX::XMLoadFloat4x4(worldMatrix);
-		DirectX::XMMATRIX viewMatrixCopy = DirectX::XMLoadFloat4x4(viewMatrix);
-		DirectX::XMMATRIX projectionMatrixCopy = DirectX::XMLoadFloat4x4(projMatrix);
+		//TEXTURE, the render queue pieces for a single draw
+		Bind(devCon);
 
-		//transpose copy (editing original caused flickering)
-		worldMatrixCopy = XMMatrixTranspose(worldMatrixCopy);
-		viewMatrixCopy = XMMatrixTranspose(viewMatrixCopy);
-		projectionMatrixCopy = XMMatrixTranspose(projectionMatrixCopy);
-
-		HRESULT result = devCon->Map(matrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-		if(result != S_OK)
+		if(!SetFrame(devCon, viewMatrix, projMatrix, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f)))
 		{
 			return;
 		}
 
-		matricesPtr = (MatricesBuffer*)resource.pData;
-		DirectX::XMStoreFloat4x4(&(matricesPtr->worldMatrix), worldMatrixCopy);
-		DirectX::XMStoreFloat4x4(&(matricesPtr->viewMatrix), viewMatrixCopy);
-		DirectX::XMStoreFloat4x4(&(matricesPtr->projMatrix), projectionMatrixCopy);
-
-		devCon->Unmap(matrixBuffer.Get(), 0);
-		devCon->VSSetConstantBuffers(bufferID, 1, matrixBuffer.GetAddressOf());
-		devCon->PSSetShaderResources(0, 1, &texture);
-		devCon->IASetInputLayout(inputLayout.Get());
-		devCon->VSSetShader(vertexShader.Get(), nullptr, 0);
-		devCon->PSSetShader(pixelShader.Get(), nullptr, 0);
-		devCon->PSSetSamplers(0, 1, sampleState.GetAddressOf());
-		devCon->DrawIndexed(indexCount, 0, 0);
+		SetTextures(devCon, &texture, 1);
+		Draw(devCon, indexCount, worldMatrix);
 	}
 }
 
 /// <summary>
-/// Render method for single colour texture based lighting
+/// Box the quantized particle instances decode against, bound to VS slot 1
 /// </summary>
-void Shader::Render(ID3D11DeviceContext *devCon, unsigned int indexCount, const DirectX::XMFLOAT4X4 *worldMatrix, const DirectX::XMFLOAT4X4 *viewMatrix, const DirectX::XMFLOAT4X4 *projMatrix, ID3D11ShaderResourceView *texture,
-					DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[], DirectX::XMFLOAT4 specularColour[])
+/// <param name="devCon">Standard ID3D11DeviceContext</param>
+/// <param name="boundsMin">Box minimum</param>
+/// <param name="boundsExtent">Box size</param>
+/// <param name="maxSize">Size multiplier of a full scale instance w</param>
+/// <returns></returns>
+bool Shader::SetInstanceBounds(ID3D11DeviceContext *devCon, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsExtent, float maxSize)
 {
 	D3D11_MAPPED_SUBRESOURCE resource;
-	MatricesBuffer *matricesPtr;
-	LightBuffer *lightPtr;
-	CameraBuffer *cameraPtr;
-	unsigned int bufferID = 0;
 
-	DirectX::XMMATRIX worldMatrixCopy = DirectX::XMLoadFloat4x4(worldMatrix);
-	DirectX::XMMATRIX viewMatrixCopy = DirectX::XMLoadFloat4x4(viewMatrix);
-	DirectX::XMMATRIX projectionMatrixCopy = DirectX::XMLoadFloat4x4(projMatrix);
-
-	//transpose copy (editing original caused flickering)
-	worldMatrixCopy = XMMatrixTranspose(worldMatrixCopy);
-	viewMatrixCopy = XMMatrixTranspose(viewMatrixCopy);
-	projectionMatrixCopy = XMMatrixTranspose(projectionMatrixCopy);
+	if(instanceBoundsBuffer == nullptr)
+	{
+		return false;
+	}
 
-	HRESULT result = devCon->Map(matrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	HRESULT result = devCon->Map(instanceBoundsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
 	if(result != S_OK)
 	{
-		return;
+		return false;
 	}
 
-	matricesPtr = (MatricesBuffer*)resource.pData;
-	DirectX::XMStoreFloat4x4(&(matricesPtr->worldMatrix), worldMatrixCopy);
-	DirectX::XMStoreFloat4x4(&(matricesPtr->viewMatrix), viewMatrixCopy);
-	DirectX::XMStoreFloat4x4(&(matricesPtr->projMatrix), projectionMatrixCopy);
+	InstanceBoundsBuffer *boundsPtr = (InstanceBoundsBuffer*)resource.pData;
+	boundsPtr->boundsMin = boundsMin;
+	boundsPtr->maxSize = maxSize;
+	boundsPtr->boundsExtent = boundsExtent;
+	boundsPtr->padding = 0.0f;
 
-	devCon->Unmap(matrixBuffer.Get(), 0);
-	devCon->VSSetConstantBuffers(bufferID, 1, matrixBuffer.GetAddressOf());
-	bufferID++;
+	devCon->Unmap(instanceBoundsBuffer.Get(), 0);
+	devCon->VSSetConstantBuffers(1, 1, instanceBoundsBuffer.GetAddressOf());
 
-	result = devCon->Map(cameraBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-	if(result != S_OK)
-	{
-		return;
-	}
+	return true;
+}
 
-	cameraPtr = (CameraBuffer *)resource.pData;
-	cameraPtr->cameraPosition = cameraPosition;
+/// <summary>
+/// Bounds a packed mesh's positions are fractions of, Normal.vs reads them from slot 2
+/// </summary>
+bool Shader::SetMeshBounds(ID3D11DeviceContext *devCon, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsExtent)
+{
+	D3D11_MAPPED_SUBRESOURCE resource;
 
-	devCon->Unmap(cameraBuffer.Get(), 0);
-	devCon->VSSetConstantBuffers(bufferID, 1, cameraBuffer.GetAddressOf());
-	bufferID--;
+	if(meshBoundsBuffer == nullptr)
+	{
+		return false;
+	}
 
-	result = devCon->Map(lightBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	HRESULT result = devCon->Map(meshBoundsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
 	if(result != S_OK)
 	{
-		return;
+		return false;
 	}
 
-	lightPtr = (LightBuffer *)resource.pData;
-	lightPtr->sDiffuseColour = diffuseColour[0];
-	lightPtr->sLightDirection = lightDirection[0];
-	lightPtr->sSpecularIntensity = specularIntensity[0];
-	lightPtr->sSpecularColour = specularColour[0];
-	
-	lightPtr->mDiffuseColour = diffuseColour[1];
-	lightPtr->mLightDirection = lightDirection[1];
-	lightPtr->mSpecularIntensity = specularIntensity[1];
-	lightPtr->mSpecularColour = specularColour[1];
-	
-
-// 	for(int i = 0; i < NUM_LIGHTS; i++)
-// 	{
-// 		lightPtr->diffuseColour[i] = diffuseColour[i];
-// 		lightPtr->lightDirection[i] = lightDirection[i];
-// 		lightPtr->specularIntensity[i] = specularIntensity[i];
-// 		lightPtr->specularColour[i] = specularColour[i];
-// 	}
-
-	devCon->Unmap(lightBuffer.Get(), 0);
-	devCon->PSSetConstantBuffers(bufferID, 1, lightBuffer.GetAddressOf());
-	devCon->PSSetShaderResources(0, 1, &texture);
+	MeshBoundsBuffer *boundsPtr = (MeshBoundsBuffer*)resource.pData;
+	boundsPtr->boundsMin = boundsMin;
+	boundsPtr->padding1 = 0.0f;
+	boundsPtr->boundsExtent = boundsExtent;
+	boundsPtr->padding2 = 0.0f;
 
-	devCon->IASetInputLayout(inputLayout.Get());
-	devCon->VSSetShader(vertexShader.Get(), nullptr, 0);
+	devCon->Unmap(meshBoundsBuffer.Get(), 0);
+	devCon->VSSetConstantBuffers(2, 1, meshBoundsBuffer.GetAddressOf());
+
+	return true;
+}
+
+/// <summary>
+/// Input layout, shaders, sampler and constant buffer slots, what every draw with this shader shares
+/// </summary>
+/// <param name="devCon">Standard ID3D11DeviceContext</param>
+void Shader::Bind(ID3D11DeviceContext *devCon)
+{
+	ID3D11Buffer *vsBuffers[2] = { objectBuffer.Get(), frameBuffer.Get() };
+
+	BindStage(devCon, false);
 	devCon->PSSetShader(pixelShader.Get(), nullptr, 0);
 	devCon->PSSetSamplers(0, 1, sampleState.GetAddressOf());
-	devCon->DrawIndexed(indexCount, 0, 0);
+	devCon->VSSetConstantBuffers(0, 2, vsBuffers);
+
+	if(lightBuffer != nullptr)
+	{
+		devCon->PSSetConstantBuffers(0, 1, lightBuffer.GetAddressOf());
+	}
 }
 
 /// <summary>
-/// Render method for multi-texture lighting (colour, norm, spec)
+/// Input layout and vertex shader of the plain or the instanced path
 /// </summary>
-void Shader::Render(ID3D11DeviceContext *devCon, unsigned int indexCount, const DirectX::XMFLOAT4X4 *worldMatrix, const DirectX::XMFLOAT4X4 *viewMatrix, const DirectX::XMFLOAT4X4 *projMatrix, ID3D11ShaderResourceView **textureArray,
-					DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[], DirectX::XMFLOAT4 specularColour[])
+void Shader::BindStage(ID3D11DeviceContext *devCon, bool instanced)
 {
-	D3D11_MAPPED_SUBRESOURCE resource;
-	MatricesBuffer *matricesPtr;
-	LightBuffer *lightPtr;
-	CameraBuffer *cameraPtr;
-	unsigned int bufferID = 0;
+	devCon->IASetInputLayout(instanced ? instancedLayout.Get() : inputLayout.Get());
+	devCon->VSSetShader(instanced ? instancedVertexShader.Get() : vertexShader.Get(), nullptr, 0);
+	instancedBound = instanced;
+}
 
-	DirectX::XMMATRIX worldMatrixCopy = DirectX::XMLoadFloat4x4(worldMatrix);
-	DirectX::XMMATRIX viewMatrixCopy = DirectX::XMLoadFloat4x4(viewMatrix);
-	DirectX::XMMATRIX projectionMatrixCopy = DirectX::XMLoadFloat4x4(projMatrix);
+/// <summary>
+/// View, projection and camera position to VS slot 1, only mapped when they changed since this shader last uploaded them
+/// </summary>
+/// <param name="devCon">Standard ID3D11DeviceContext</param>
+/// <param name="viewMatrix">View matrix</param>
+/// <param name="projMatrix">Projection matrix</param>
+/// <param name="cameraPosition">Camera position</param>
+/// <returns>false if the buffer could not be mapped</returns>
+bool Shader::SetFrame(ID3D11DeviceContext *devCon, const DirectX::XMFLOAT4X4 *viewMatrix, const DirectX::XMFLOAT4X4 *projMatrix, DirectX::XMFLOAT3 cameraPosition)
+{
+	FrameBuffer frame;
+	DirectX::XMStoreFloat4x4(&frame.viewMatrix, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(viewMatrix)));
+	DirectX::XMStoreFloat4x4(&frame.projMatrix, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(projMatrix)));
+	frame.cameraPosition = cameraPosition;
+	frame.padding = 0.0f;
 
-	//transpose copy (editing original caused flickering)
-	worldMatrixCopy = XMMatrixTranspose(worldMatrixCopy);
-	viewMatrixCopy = XMMatrixTranspose(viewMatrixCopy);
-	projectionMatrixCopy = XMMatrixTranspose(projectionMatrixCopy);
+	return UploadBlock(devCon, ConstantBlocks::BLOCK_FRAME, &frame);
+}
 
-	HRESULT result = devCon->Map(matrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-	if(result != S_OK)
+/// <summary>
+/// Both lights to PS slot 0, only mapped when they changed since this shader last uploaded them
+/// </summary>
+/// <param name="devCon">Standard ID3D11DeviceContext</param>
+/// <param name="diffuseColour">NUM_LIGHTS diffuse colours</param>
+/// <param name="lightDirection">NUM_LIGHTS directions</param>
+/// <param name="specularIntensity">NUM_LIGHTS specular intensities</param>
+/// <param name="specularColour">NUM_LIGHTS specular colours</param>
+/// <returns>false if this shader has no lights or the buffer could not be mapped</returns>
+bool Shader::SetLights(ID3D11DeviceContext *devCon, DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[],
+	DirectX::XMFLOAT4 specularColour[])
+{
+	if(lightBuffer == nullptr)
 	{
-		return;
+		return false;
 	}
 
-	matricesPtr = (MatricesBuffer*)resource.pData;
-	DirectX::XMStoreFloat4x4(&(matricesPtr->worldMatrix), worldMatrixCopy);
-	DirectX::XMStoreFloat4x4(&(matricesPtr->viewMatrix), viewMatrixCopy);
-	DirectX::XMStoreFloat4x4(&(matricesPtr->projMatrix), projectionMatrixCopy);
+	LightBuffer lights;
+	lights.sDiffuseColour = diffuseColour[0];
+	lights.sLightDirection = lightDirection[0];
+	lights.sSpecularIntensity = specularIntensity[0];
+	lights.sSpecularColour = specularColour[0];
 
-	devCon->Unmap(matrixBuffer.Get(), 0);
-	devCon->VSSetConstantBuffers(bufferID, 1, matrixBuffer.GetAddressOf());
-	
-	devCon->PSSetShaderResources(0, 3, textureArray);
+	lights.mDiffuseColour = diffuseColour[1];
+	lights.mLightDirection = lightDirection[1];
+	lights.mSpecularIntensity = specularIntensity[1];
+	lights.mSpecularColour = specularColour[1];
 
-	result = devCon->Map(lightBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-	if(result != S_OK)
+	return UploadBlock(devCon, ConstantBlocks::BLOCK_PASS, &lights);
+}
+
+/// <summary>
+/// Pixel shader textures from slot 0
+/// </summary>
+/// <param name="devCon">Standard ID3D11DeviceContext</param>
+/// <param name="textures">Shader resource views</param>
+/// <param name="count">Views</param>
+void Shader::SetTextures(ID3D11DeviceContext *devCon, ID3D11ShaderResourceView *const *textures, unsigned int count)
+{
+	devCon->PSSetShaderResources(0, count, textures);
+}
+
+/// <summary>
+/// World matrix to VS slot 0 and the draw, everything else was bound by Bind, SetFrame, SetLights and SetTextures
+/// </summary>
+/// <param name="devCon">Standard ID3D11DeviceContext</param>
+/// <param name="indexCount">Indices from the bound index buffer offset</param>
+/// <param name="worldMatrix">World matrix</param>
+/// <returns>false if the buffer could not be mapped, nothing is drawn</returns>
+bool Shader::Draw(ID3D11DeviceContext *devCon, unsigned int indexCount, const DirectX::XMFLOAT4X4 *worldMatrix)
+{
+	ObjectBuffer object;
+	DirectX::XMStoreFloat4x4(&object.worldMatrix, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(worldMatrix)));
+
+	if(!UploadBlock(devCon, ConstantBlocks::BLOCK_OBJECT, &object))
 	{
-		return;
+		return false;
 	}
 
-	lightPtr = (LightBuffer *)resource.pData;
-	lightPtr->sDiffuseColour = diffuseColour[0];
-	lightPtr->sLightDirection = lightDirection[0];
-	lightPtr->sSpecularIntensity = specularIntensity[0];
-	lightPtr->sSpecularColour = specularColour[0];
+	if(instancedBound)
+	{
+		BindStage(devCon, false);
+	}
 
-	lightPtr->mDiffuseColour = diffuseColour[1];
-	lightPtr->mLightDirection = lightDirection[1];
-	lightPtr->mSpecularIntensity = specularIntensity[1];
-	lightPtr->mSpecularColour = specularColour[1];
+	devCon->DrawIndexed(indexCount, 0, 0);
 
-	devCon->Unmap(lightBuffer.Get(), 0);
-	devCon->PSSetConstantBuffers(bufferID, 1, lightBuffer.GetAddressOf());
+	return true;
+}
 
-	result = devCon->Map(cameraBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-	if(result != S_OK)
+/// <summary>
+/// One draw for instanceCount objects sharing the bound mesh and textures, vs_instanced takes each world matrix from the instance stream
+/// so nothing is mapped
+/// </summary>
+/// <param name="devCon">Standard ID3D11DeviceContext</param>
+/// <param name="indexCount">Indices from the bound index buffer offset</param>
+/// <param name="instances">Vertex buffer holding InstanceBatcher::Transform</param>
+/// <param name="instanceOffset">Byte offset of the first transform</param>
+/// <param name="instanceCount">Transforms, one per object</param>
+/// <returns>false if this shader has no instanced path, nothing is drawn</returns>
+bool Shader::DrawInstanced(ID3D11DeviceContext *devCon, unsigned int indexCount, ID3D11Buffer *instances, unsigned int instanceOffset, unsigned int instanceCount)
+{
+	if(!Instanced())
+	{
+		return false;
+	}
+
+	if(!instancedBound)
+	{
+		BindStage(devCon, true);
+	}
+
+	unsigned int stride = sizeof(InstanceBatcher::Transform);
+	devCon->IASetVertexBuffers(1, 1, &instances, &stride, &instanceOffset);
+	devCon->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
+
+	return true;
+}
+
+/// <summary>
+/// Set a block and map its buffer if the contents changed
+/// </summary>
+bool Shader::UploadBlock(ID3D11DeviceContext *devCon, ConstantBlocks::Block block, const void *data)
+{
+	ID3D11Buffer *buffers[ConstantBlocks::BLOCK_COUNT] = { frameBuffer.Get(), lightBuffer.Get(), objectBuffer.Get() };
+
+	if(buffers[block] == nullptr)
+	{
+		return false;
+	}
+
+	ContextConstantWriter writer(devCon, buffers);
+	constants.Set(block, data);
+
+	return constants.Upload(block, writer);
+}
+
+/// <summary>
+/// Render method for single colour texture based lighting, the render queue pieces for a single draw
+/// </summary>
+void Shader::Render(ID3D11DeviceContext *devCon, unsigned int indexCount, const DirectX::XMFLOAT4X4 *worldMatrix, const DirectX::XMFLOAT4X4 *viewMatrix, const DirectX::XMFLOAT4X4 *projMatrix, ID3D11ShaderResourceView *texture,
+					DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[], DirectX::XMFLOAT4 specularColour[])
+{
+	Bind(devCon);
+
+	if(!SetFrame(devCon, viewMatrix, projMatrix, cameraPosition) || !SetLights(devCon, diffuseColour, lightDirection, specularIntensity, specularColour))
 	{
 		return;
 	}
 
-	cameraPtr = (CameraBuffer*)resource.pData;
-	cameraPtr->cameraPosition = cameraPosition;
+	SetTextures(devCon, &texture, 1);
+	Draw(devCon, indexCount, worldMatrix);
+}
 
-	devCon->Unmap(cameraBuffer.Get(), 0);
-	bufferID++;
-	devCon->VSSetConstantBuffers(bufferID, 1, cameraBuffer.GetAddressOf());
-	
-	devCon->IASetInputLayout(inputLayout.Get());
-	devCon->VSSetShader(vertexShader.Get(), nullptr, 0);
-	devCon->PSSetShader(pixelShader.Get(), nullptr, 0);
-	devCon->PSSetSamplers(0, 1, sampleState.GetAddressOf());
-	devCon->DrawIndexed(indexCount, 0, 0);
+/// <summary>
+/// Render method for multi-texture lighting (colour, norm, spec), the render queue pieces for a single draw
+/// </summary>
+void Shader::Render(ID3D11DeviceContext *devCon, unsigned int indexCount, const DirectX::XMFLOAT4X4 *worldMatrix, const DirectX::XMFLOAT4X4 *viewMatrix, const DirectX::XMFLOAT4X4 *projMatrix, ID3D11ShaderResourceView **textureArray,
+					DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[], DirectX::XMFLOAT4 specularColour[])
+{
+	Bind(devCon);
+
+	if(!SetFrame(devCon, viewMatrix, projMatrix, cameraPosition) || !SetLights(devCon, diffuseColour, lightDirection, specularIntensity, specularColour))
+	{
+		return;
+	}
+
+	SetTextures(devCon, textureArray, 3);
+	Draw(devCon, indexCount, worldMatrix);
 }
 
 /// <summary>
@@ -464,6 +595,27 @@ void Shader::Render(ID3D11DeviceContext *devCon, unsigned int indexCount, const
 	devCon->DrawIndexed(indexCount, 0, 0);
 }
 
+/// <summary>
+/// Hand over the blob Compile already built for a stage, else compile the file now
+/// </summary>
+/// <param name="file">Shader filepath</param>
+/// <param name="entry">Entry point</param>
+/// <param name="target">Shader model</param>
+/// <param name="compiled">vertexBlob or pixelBlob, emptied</param>
+/// <param name="blob">Out, compiled stage</param>
+/// <param name="errors">Out, compiler messages when compiling now fails</param>
+/// <returns></returns>
+HRESULT Shader::CompileStage(const std::wstring &file, const char *entry, const char *target, Microsoft::WRL::ComPtr<ID3D10Blob> &compiled, ID3D10Blob **blob, ID3D10Blob **errors)
+{
+	if(compiled)
+	{
+		*blob = compiled.Detach();
+		return S_OK;
+	}
+
+	return D3DCompileFromFile(file.c_str(), nullptr, nullptr, entry, target, 0, 0, blob, errors);
+}
+
 bool Shader::InitColourShader(ID3D11Device *dev, const std::wstring &vsFile, const std::wstring &psFile)
 {
 	Microsoft::WRL::ComPtr<ID3D10Blob> vShaderBuffer = nullptr;
@@ -474,7 +626,7 @@ bool Shader::InitColourShader(ID3D11Device *dev, const std::wstring &vsFile, con
 	D3D11_INPUT_ELEMENT_DESC polygonLayout[2];
 	unsigned int layoutCount = 0;
 
-	HRESULT result = D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_main", "vs_5_0", 0, 0, &vShaderBuffer, errorMSG.GetAddressOf());
+	HRESULT result = CompileStage(vsFile, "vs_main", "vs_5_0", vertexBlob, &vShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile vertex shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -489,7 +641,7 @@ bool Shader::InitColourShader(ID3D11Device *dev, const std::wstring &vsFile, con
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> pShaderBuffer = nullptr;
 
-	result = D3DCompileFromFile(psFile.c_str(), nullptr, nullptr, "ps_main", "ps_5_0", 0, 0, &pShaderBuffer, errorMSG.GetAddressOf());
+	result = CompileStage(psFile, "ps_main", "ps_5_0", pixelBlob, &pShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile pixel shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -540,17 +692,7 @@ bool Shader::InitColourShader(ID3D11Device *dev, const std::wstring &vsFile, con
 		return false;
 	}
 
-	D3D11_BUFFER_DESC matrixDesc;
-
-	matrixDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixDesc.ByteWidth = sizeof(MatricesBuffer);
-	matrixDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixDesc.MiscFlags = 0;
-	matrixDesc.StructureByteStride = 0;
-
-	result = dev->CreateBuffer(&matrixDesc, nullptr, matrixBuffer.GetAddressOf());
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create matrix buffer"))
+	if(!InitBlockBuffers(dev, false))
 	{
 		return false;
 	}
@@ -590,7 +732,7 @@ bool Shader::InitTextureShader(ID3D11Device *dev, const std::wstring &vsFile, co
 	D3D11_INPUT_ELEMENT_DESC polygonLayout[3];
 	unsigned int layoutCount = 0;
 
-	HRESULT result = D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_main", "vs_5_0", 0, 0, &vShaderBuffer, errorMSG.GetAddressOf());
+	HRESULT result = CompileStage(vsFile, "vs_main", "vs_5_0", vertexBlob, &vShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile vertex shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -605,7 +747,7 @@ bool Shader::InitTextureShader(ID3D11Device *dev, const std::wstring &vsFile, co
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> pShaderBuffer = nullptr;
 
-	result = D3DCompileFromFile(psFile.c_str(), nullptr, nullptr, "ps_main", "ps_5_0", 0, 0, &pShaderBuffer, errorMSG.GetAddressOf());
+	result = CompileStage(psFile, "ps_main", "ps_5_0", pixelBlob, &pShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile pixel shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -664,17 +806,7 @@ bool Shader::InitTextureShader(ID3D11Device *dev, const std::wstring &vsFile, co
 		return false;
 	}
 
-	D3D11_BUFFER_DESC matrixDesc;
-
-	matrixDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixDesc.ByteWidth = sizeof(MatricesBuffer);
-	matrixDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixDesc.MiscFlags = 0;
-	matrixDesc.StructureByteStride = 0;
-
-	result = dev->CreateBuffer(&matrixDesc, nullptr, matrixBuffer.GetAddressOf());
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create matrix buffer"))
+	if(!InitBlockBuffers(dev, false))
 	{
 		return false;
 	}
@@ -707,7 +839,6 @@ bool Shader::InitTextureShader(ID3D11Device *dev, const std::wstring &vsFile, co
 bool Shader::InitLightShader(ID3D11Device *dev, const std::wstring &vsFile, const std::wstring &psFile)
 {
 	lightBuffer = nullptr;
-	cameraBuffer = nullptr;
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> vShaderBuffer = nullptr;
 	Microsoft::WRL::ComPtr<ID3D10Blob> errorMSG = nullptr;
@@ -717,7 +848,7 @@ bool Shader::InitLightShader(ID3D11Device *dev, const std::wstring &vsFile, cons
 	D3D11_INPUT_ELEMENT_DESC polygonLayout[3];
 	unsigned int layoutCount = 0;
 
-	HRESULT result = D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_main", "vs_5_0", 0, 0, &vShaderBuffer, errorMSG.GetAddressOf());
+	HRESULT result = CompileStage(vsFile, "vs_main", "vs_5_0", vertexBlob, &vShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile vertex shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -732,7 +863,7 @@ bool Shader::InitLightShader(ID3D11Device *dev, const std::wstring &vsFile, cons
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> pShaderBuffer = nullptr;
 
-	result = D3DCompileFromFile(psFile.c_str(), nullptr, nullptr, "ps_main", "ps_5_0", 0, 0, &pShaderBuffer, errorMSG.GetAddressOf());
+	result = CompileStage(psFile, "ps_main", "ps_5_0", pixelBlob, &pShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile pixel shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -791,47 +922,7 @@ bool Shader::InitLightShader(ID3D11Device *dev, const std::wstring &vsFile, cons
 		return false;
 	}
 
-	D3D11_BUFFER_DESC matrixDesc;
-
-	matrixDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixDesc.ByteWidth = sizeof(MatricesBuffer);
-	matrixDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixDesc.MiscFlags = 0;
-	matrixDesc.StructureByteStride = 0;
-
-	result = dev->CreateBuffer(&matrixDesc, nullptr, matrixBuffer.GetAddressOf());
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create matrix buffer"))
-	{
-		return false;
-	}
-
-	D3D11_BUFFER_DESC lightDesc;
-
-	lightDesc.Usage = D3D11_USAGE_DYNAMIC;
-	lightDesc.ByteWidth = sizeof(LightBuffer);
-	lightDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	lightDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	lightDesc.MiscFlags = 0;
-	lightDesc.StructureByteStride = 0;
-
-	result = dev->CreateBuffer(&lightDesc, nullptr, lightBuffer.GetAddressOf());
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create light buffer"))
-	{
-		return false;
-	}
-
-	D3D11_BUFFER_DESC cameraDesc;
-
-	cameraDesc.Usage = D3D11_USAGE_DYNAMIC;
-	cameraDesc.ByteWidth = sizeof(CameraBuffer);
-	cameraDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	cameraDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	cameraDesc.MiscFlags = 0;
-	cameraDesc.StructureByteStride = 0;
-
-	result = dev->CreateBuffer(&cameraDesc, nullptr, cameraBuffer.GetAddressOf());
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create camera buffer"))
+	if(!InitBlockBuffers(dev, true))
 	{
 		return false;
 	}
@@ -864,17 +955,16 @@ bool Shader::InitLightShader(ID3D11Device *dev, const std::wstring &vsFile, cons
 bool Shader::InitNormalShader(ID3D11Device *dev, const std::wstring &vsFile, const std::wstring &psFile)
 {
 	lightBuffer = nullptr;
-	cameraBuffer = nullptr;
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> vShaderBuffer = nullptr;
 	Microsoft::WRL::ComPtr<ID3D10Blob> errorMSG = nullptr;
 	char *msg = nullptr;
 	long bufferSize = 0;
 	std::string strMSG = "";
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[5];
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[3];
 	unsigned int layoutCount = 0;
 
-	HRESULT result = D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_main", "vs_5_0", 0, 0, &vShaderBuffer, errorMSG.GetAddressOf());
+	HRESULT result = CompileStage(vsFile, "vs_main", "vs_5_0", vertexBlob, &vShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile vertex shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -889,7 +979,7 @@ bool Shader::InitNormalShader(ID3D11Device *dev, const std::wstring &vsFile, con
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> pShaderBuffer = nullptr;
 
-	result = D3DCompileFromFile(psFile.c_str(), nullptr, nullptr, "ps_main", "ps_5_0", 0, 0, &pShaderBuffer, errorMSG.GetAddressOf());
+	result = CompileStage(psFile, "ps_main", "ps_5_0", pixelBlob, &pShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile pixel shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -916,9 +1006,10 @@ bool Shader::InitNormalShader(ID3D11Device *dev, const std::wstring &vsFile, con
 		return false;
 	}
 
+	//VertexPacking::PackedBumpVertex, Normal.vs decodes it
 	polygonLayout[0].SemanticName = "POSITION";
 	polygonLayout[0].SemanticIndex = 0;
-	polygonLayout[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	polygonLayout[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;	//fractions of the mesh bounds
 	polygonLayout[0].InputSlot = 0;
 	polygonLayout[0].AlignedByteOffset = 0;
 	polygonLayout[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
@@ -926,7 +1017,7 @@ bool Shader::InitNormalShader(ID3D11Device *dev, const std::wstring &vsFile, con
 
 	polygonLayout[1].SemanticName = "TEXCOORD";
 	polygonLayout[1].SemanticIndex = 0;
-	polygonLayout[1].Format = DXGI_FORMAT_R32G32_FLOAT;
+	polygonLayout[1].Format = DXGI_FORMAT_R16G16_FLOAT;
 	polygonLayout[1].InputSlot = 0;
 	polygonLayout[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 	polygonLayout[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
@@ -934,28 +1025,12 @@ bool Shader::InitNormalShader(ID3D11Device *dev, const std::wstring &vsFile, con
 
 	polygonLayout[2].SemanticName = "NORMAL";
 	polygonLayout[2].SemanticIndex = 0;
-	polygonLayout[2].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	polygonLayout[2].Format = DXGI_FORMAT_R10G10B10A2_UNORM;	//octahedral normal, tangent angle, handedness
 	polygonLayout[2].InputSlot = 0;
 	polygonLayout[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 	polygonLayout[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	polygonLayout[2].InstanceDataStepRate = 0;
 
-	polygonLayout[3].SemanticName = "TANGENT";
-	polygonLayout[3].SemanticIndex = 0;
-	polygonLayout[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	polygonLayout[3].InputSlot = 0;
-	polygonLayout[3].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-	polygonLayout[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	polygonLayout[3].InstanceDataStepRate = 0;
-
-	polygonLayout[4].SemanticName = "BINORMAL";
-	polygonLayout[4].SemanticIndex = 0;
-	polygonLayout[4].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	polygonLayout[4].InputSlot = 0;
-	polygonLayout[4].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-	polygonLayout[4].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	polygonLayout[4].InstanceDataStepRate = 0;
-
 	layoutCount = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
 	result = dev->CreateInputLayout(polygonLayout, layoutCount, vShaderBuffer->GetBufferPointer(), vShaderBuffer->GetBufferSize(), inputLayout.GetAddressOf());
@@ -964,47 +1039,28 @@ bool Shader::InitNormalShader(ID3D11Device *dev, const std::wstring &vsFile, con
 		return false;
 	}
 
-	D3D11_BUFFER_DESC matrixDesc;
-
-	matrixDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixDesc.ByteWidth = sizeof(MatricesBuffer);
-	matrixDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixDesc.MiscFlags = 0;
-	matrixDesc.StructureByteStride = 0;
-
-	result = dev->CreateBuffer(&matrixDesc, nullptr, matrixBuffer.GetAddressOf());
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create matrix buffer"))
+	//without it the cacti are still drawn, one at a time
+	if(!InitInstancedStage(dev, vsFile, polygonLayout, layoutCount))
 	{
-		return false;
+		Logger::Log("Normal shader has no instanced path, objects are drawn one at a time");
 	}
 
-	D3D11_BUFFER_DESC lightDesc;
-
-	lightDesc.Usage = D3D11_USAGE_DYNAMIC;
-	lightDesc.ByteWidth = sizeof(LightBuffer);
-	lightDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	lightDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	lightDesc.MiscFlags = 0;
-	lightDesc.StructureByteStride = 0;
-
-	result = dev->CreateBuffer(&lightDesc, nullptr, lightBuffer.GetAddressOf());
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create light buffer"))
+	if(!InitBlockBuffers(dev, true))
 	{
 		return false;
 	}
 
-	D3D11_BUFFER_DESC cameraDesc;
+	D3D11_BUFFER_DESC boundsDesc;
 
-	cameraDesc.Usage = D3D11_USAGE_DYNAMIC;
-	cameraDesc.ByteWidth = sizeof(CameraBuffer);
-	cameraDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	cameraDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	cameraDesc.MiscFlags = 0;
-	cameraDesc.StructureByteStride = 0;
+	boundsDesc.Usage = D3D11_USAGE_DYNAMIC;
+	boundsDesc.ByteWidth = sizeof(MeshBoundsBuffer);
+	boundsDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	boundsDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	boundsDesc.MiscFlags = 0;
+	boundsDesc.StructureByteStride = 0;
 
-	result = dev->CreateBuffer(&cameraDesc, nullptr, cameraBuffer.GetAddressOf());
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create camera buffer"))
+	result = dev->CreateBuffer(&boundsDesc, nullptr, meshBoundsBuffer.GetAddressOf());
+	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create mesh bounds buffer"))
 	{
 		return false;
 	}
@@ -1034,6 +1090,115 @@ bool Shader::InitNormalShader(ID3D11Device *dev, const std::wstring &vsFile, con
 	return true;
 }
 
+/// <summary>
+/// vs_instanced from the vertex shader file and its layout, the per vertex elements followed by the transform's three columns in slot 1
+/// </summary>
+/// <param name="dev">Standard ID3D11Device</param>
+/// <param name="vsFile">Vertex shader filepath</param>
+/// <param name="vertexLayout">Per vertex elements of the plain path</param>
+/// <param name="vertexLayoutCount">Elements</param>
+/// <returns>false if the entry point is missing or a create failed, the plain path still works</returns>
+bool Shader::InitInstancedStage(ID3D11Device *dev, const std::wstring &vsFile, const D3D11_INPUT_ELEMENT_DESC *vertexLayout, unsigned int vertexLayoutCount)
+{
+	const unsigned int MAX_ELEMENTS = 8;
+	Microsoft::WRL::ComPtr<ID3D10Blob> shaderBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D10Blob> errorMSG = nullptr;
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[MAX_ELEMENTS];
+
+	if(vertexLayoutCount + 3 > MAX_ELEMENTS)
+	{
+		return false;
+	}
+
+	HRESULT result = CompileStage(vsFile, "vs_instanced", "vs_5_0", instancedBlob, shaderBuffer.GetAddressOf(), errorMSG.GetAddressOf());
+	if(FAILED(result))
+	{
+		return false;
+	}
+
+	result = dev->CreateVertexShader(shaderBuffer->GetBufferPointer(), shaderBuffer->GetBufferSize(), nullptr, instancedVertexShader.GetAddressOf());
+	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create instanced vertex shader"))
+	{
+		return false;
+	}
+
+	for(unsigned int i = 0; i < vertexLayoutCount; i++)
+	{
+		polygonLayout[i] = vertexLayout[i];
+	}
+
+	//InstanceBatcher::Transform
+	for(unsigned int c = 0; c < 3; c++)
+	{
+		D3D11_INPUT_ELEMENT_DESC &element = polygonLayout[vertexLayoutCount + c];
+
+		element.SemanticName = "WORLD";
+		element.SemanticIndex = c;
+		element.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		element.InputSlot = 1;
+		element.AlignedByteOffset = c * sizeof(float) * 4;
+		element.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		element.InstanceDataStepRate = 1;
+	}
+
+	result = dev->CreateInputLayout(polygonLayout, vertexLayoutCount + 3, shaderBuffer->GetBufferPointer(), shaderBuffer->GetBufferSize(), instancedLayout.GetAddressOf());
+	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create instanced input layout"))
+	{
+		instancedVertexShader = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Per object and per frame constant buffers of the render queue shaders, with the light buffer for lit ones
+/// </summary>
+/// <param name="dev">Standard ID3D11Device</param>
+/// <param name="lit">LIGHTS and NORMAL</param>
+/// <returns></returns>
+bool Shader::InitBlockBuffers(ID3D11Device *dev, bool lit)
+{
+	D3D11_BUFFER_DESC bufferDesc;
+
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags = 0;
+	bufferDesc.StructureByteStride = 0;
+
+	bufferDesc.ByteWidth = sizeof(ObjectBuffer);
+	HRESULT result = dev->CreateBuffer(&bufferDesc, nullptr, objectBuffer.GetAddressOf());
+	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create object buffer"))
+	{
+		return false;
+	}
+
+	bufferDesc.ByteWidth = sizeof(FrameBuffer);
+	result = dev->CreateBuffer(&bufferDesc, nullptr, frameBuffer.GetAddressOf());
+	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create frame buffer"))
+	{
+		return false;
+	}
+
+	constants.Init(ConstantBlocks::BLOCK_OBJECT, sizeof(ObjectBuffer));
+	constants.Init(ConstantBlocks::BLOCK_FRAME, sizeof(FrameBuffer));
+
+	if(lit)
+	{
+		bufferDesc.ByteWidth = sizeof(LightBuffer);
+		result = dev->CreateBuffer(&bufferDesc, nullptr, lightBuffer.GetAddressOf());
+		if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create light buffer"))
+		{
+			return false;
+		}
+
+		constants.Init(ConstantBlocks::BLOCK_PASS, sizeof(LightBuffer));
+	}
+
+	return true;
+}
+
 bool Shader::InitSkyDomeShader(ID3D11Device *dev, const std::wstring &vsFile, const std::wstring &psFile)
 {
 	Microsoft::WRL::ComPtr<ID3D10Blob> vShaderBuffer = nullptr;
@@ -1044,7 +1209,7 @@ bool Shader::InitSkyDomeShader(ID3D11Device *dev, const std::wstring &vsFile, co
 	D3D11_INPUT_ELEMENT_DESC polygonLayout[3];
 	unsigned int layoutCount = 0;
 
-	HRESULT result = D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_main", "vs_5_0", 0, 0, &vShaderBuffer, errorMSG.GetAddressOf());
+	HRESULT result = CompileStage(vsFile, "vs_main", "vs_5_0", vertexBlob, &vShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile vertex shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -1059,7 +1224,7 @@ bool Shader::InitSkyDomeShader(ID3D11Device *dev, const std::wstring &vsFile, co
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> pShaderBuffer = nullptr;
 
-	result = D3DCompileFromFile(psFile.c_str(), nullptr, nullptr, "ps_main", "ps_5_0", 0, 0, &pShaderBuffer, errorMSG.GetAddressOf());
+	result = CompileStage(psFile, "ps_main", "ps_5_0", pixelBlob, &pShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile pixel shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -1180,10 +1345,10 @@ bool Shader::InitParticleShader(ID3D11Device * dev, const std::wstring & vsFile,
 	char *msg = nullptr;
 	long bufferSize = 0;
 	std::string strMSG = "";
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[5];
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[4];
 	unsigned int layoutCount = 0;
 
-	HRESULT result = D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_main", "vs_5_0", 0, 0, &vShaderBuffer, errorMSG.GetAddressOf());
+	HRESULT result = CompileStage(vsFile, "vs_main", "vs_5_0", vertexBlob, &vShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile vertex shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -1198,7 +1363,7 @@ bool Shader::InitParticleShader(ID3D11Device * dev, const std::wstring & vsFile,
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> pShaderBuffer = nullptr;
 
-	result = D3DCompileFromFile(psFile.c_str(), nullptr, nullptr, "ps_main", "ps_5_0", 0, 0, &pShaderBuffer, errorMSG.GetAddressOf());
+	result = CompileStage(psFile, "ps_main", "ps_5_0", pixelBlob, &pShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile pixel shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -1249,22 +1414,15 @@ bool Shader::InitParticleShader(ID3D11Device * dev, const std::wstring & vsFile,
 	polygonLayout[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	polygonLayout[2].InstanceDataStepRate = 0;
 
+	//quantized instance, see ParticleUpload::Instance
 	polygonLayout[3].SemanticName = "TEXCOORD";
 	polygonLayout[3].SemanticIndex = 1;
-	polygonLayout[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	polygonLayout[3].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
 	polygonLayout[3].InputSlot = 1;
 	polygonLayout[3].AlignedByteOffset = 0;
 	polygonLayout[3].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
 	polygonLayout[3].InstanceDataStepRate = 1;
 
-	polygonLayout[4].SemanticName = "TEXCOORD";
-	polygonLayout[4].SemanticIndex = 2;
-	polygonLayout[4].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	polygonLayout[4].InputSlot = 1;
-	polygonLayout[4].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-	polygonLayout[4].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
-	polygonLayout[4].InstanceDataStepRate = 1;
-
 	layoutCount = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
 	result = dev->CreateInputLayout(polygonLayout, layoutCount, vShaderBuffer->GetBufferPointer(), vShaderBuffer->GetBufferSize(), inputLayout.GetAddressOf());
@@ -1288,6 +1446,21 @@ bool Shader::InitParticleShader(ID3D11Device * dev, const std::wstring & vsFile,
 		return false;
 	}
 
+	D3D11_BUFFER_DESC boundsDesc;
+
+	boundsDesc.Usage = D3D11_USAGE_DYNAMIC;
+	boundsDesc.ByteWidth = sizeof(InstanceBoundsBuffer);
+	boundsDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	boundsDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	boundsDesc.MiscFlags = 0;
+	boundsDesc.StructureByteStride = 0;
+
+	result = dev->CreateBuffer(&boundsDesc, nullptr, instanceBoundsBuffer.GetAddressOf());
+	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create instance bounds buffer"))
+	{
+		return false;
+	}
+
 	D3D11_SAMPLER_DESC sampleDesc;
 
 	sampleDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
@@ -1323,7 +1496,7 @@ bool Shader::InitFireShader(ID3D11Device *dev, const std::wstring &vsFile, const
 	D3D11_INPUT_ELEMENT_DESC polygonLayout[3];
 	unsigned int layoutCount = 0;
 
-	HRESULT result = D3DCompileFromFile(vsFile.c_str(), nullptr, nullptr, "vs_main", "vs_5_0", 0, 0, &vShaderBuffer, errorMSG.GetAddressOf());
+	HRESULT result = CompileStage(vsFile, "vs_main", "vs_5_0", vertexBlob, &vShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile vertex shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
@@ -1338,7 +1511,7 @@ bool Shader::InitFireShader(ID3D11Device *dev, const std::wstring &vsFile, const
 
 	Microsoft::WRL::ComPtr<ID3D10Blob> pShaderBuffer = nullptr;
 
-	result = D3DCompileFromFile(psFile.c_str(), nullptr, nullptr, "ps_main", "ps_5_0", 0, 0, &pShaderBuffer, errorMSG.GetAddressOf());
+	result = CompileStage(psFile, "ps_main", "ps_5_0", pixelBlob, &pShaderBuffer, errorMSG.GetAddressOf());
 	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Compile pixel shader"))
 	{
 		msg = (char*)(errorMSG.Get()->GetBufferPointer());
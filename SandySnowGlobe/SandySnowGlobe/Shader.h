@@ -6,6 +6,7 @@
 #include <wrl.h>
 #include <d3dcompiler.h>
 #include "DXUtil.h"
+#include "ConstantBlocks.h"
 
 const int NUM_LIGHTS = 2;
 
@@ -27,6 +28,22 @@ public:
 		DirectX::XMFLOAT4X4 projMatrix;
 	};
 
+	struct InstanceBoundsBuffer
+	{
+		DirectX::XMFLOAT3 boundsMin;
+		float maxSize;
+		DirectX::XMFLOAT3 boundsExtent;
+		float padding;
+	};
+
+	struct MeshBoundsBuffer
+	{
+		DirectX::XMFLOAT3 boundsMin;
+		float padding1;
+		DirectX::XMFLOAT3 boundsExtent;
+		float padding2;
+	};
+
 	struct LightBuffer
 	{
 		DirectX::XMFLOAT4 sDiffuseColour;
@@ -39,12 +56,21 @@ public:
 		DirectX::XMFLOAT4 mSpecularColour;
 	};
 
-	struct CameraBuffer
+	//COLOUR, TEXTURE, LIGHTS and NORMAL split their constants by how often they change: FrameBuffer (VS b1) once a frame,
+	//LightBuffer (PS b0) once a pass, ObjectBuffer (VS b0) per draw
+	struct FrameBuffer
 	{
+		DirectX::XMFLOAT4X4 viewMatrix;
+		DirectX::XMFLOAT4X4 projMatrix;
 		DirectX::XMFLOAT3 cameraPosition;
 		float padding;
 	};
 
+	struct ObjectBuffer
+	{
+		DirectX::XMFLOAT4X4 worldMatrix;
+	};
+
 	struct TimeBuffer
 	{
 		DirectX::XMFLOAT3 time;
@@ -82,6 +108,7 @@ public:
 	explicit Shader(ShaderType shaderType);
 	~Shader();
 
+	bool Compile(const std::wstring &vsFile, const std::wstring &psFile);	//optional, any thread, Init then uses the result
 	bool Init(ID3D11Device *dev, const std::wstring &vsFile, const std::wstring &psFile);
 
 	void Render(ID3D11DeviceContext *devCon, unsigned int indexCount, const DirectX::XMFLOAT4X4 *worldMatrix, const DirectX::XMFLOAT4X4 *viewMatrix,
@@ -102,6 +129,24 @@ public:
 		ID3D11ShaderResourceView *texture1, ID3D11ShaderResourceView *texture2, ID3D11ShaderResourceView *texture3, float animTime, DirectX::XMFLOAT3 scrollSpeeds, DirectX::XMFLOAT3 scales,
 		DirectX::XMFLOAT2 distortion1, DirectX::XMFLOAT2 distortion2, DirectX::XMFLOAT2 distortion3, float distortionScale, float distortionBias);
 
+	bool SetInstanceBounds(ID3D11DeviceContext *devCon, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsExtent, float maxSize);
+	bool SetMeshBounds(ID3D11DeviceContext *devCon, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsExtent);	//NORMAL, before Render
+
+	//Render in pieces for a render queue, each uploaded only when it changed: Bind per shader, SetFrame and SetLights (LIGHTS, NORMAL)
+	//after each Bind, SetTextures per texture set, then Draw per object, COLOUR, TEXTURE, LIGHTS and NORMAL only
+	void Bind(ID3D11DeviceContext *devCon);
+	bool SetFrame(ID3D11DeviceContext *devCon, const DirectX::XMFLOAT4X4 *viewMatrix, const DirectX::XMFLOAT4X4 *projMatrix, DirectX::XMFLOAT3 cameraPosition);
+	bool SetLights(ID3D11DeviceContext *devCon, DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[],
+		DirectX::XMFLOAT4 specularColour[]);
+	void SetTextures(ID3D11DeviceContext *devCon, ID3D11ShaderResourceView *const *textures, unsigned int count);
+	bool Draw(ID3D11DeviceContext *devCon, unsigned int indexCount, const DirectX::XMFLOAT4X4 *worldMatrix);
+
+	//Draw for many objects at once, world matrices come from an InstanceBatcher::Transform stream in slot 1, NORMAL only
+	bool Instanced() const { return instancedVertexShader != nullptr; }
+	bool DrawInstanced(ID3D11DeviceContext *devCon, unsigned int indexCount, ID3D11Buffer *instances, unsigned int instanceOffset, unsigned int instanceCount);
+
+	unsigned int ConstantUploads() const { return constants.Uploads(); }	//constant buffer maps the pieces made, from Init
+
 private:
 	ShaderType type;
 
@@ -112,15 +157,28 @@ private:
 	bool InitSkyDomeShader(ID3D11Device *dev, const std::wstring &vsFile, const std::wstring &psFile);
 	bool InitParticleShader(ID3D11Device * dev, const std::wstring & vsFile, const std::wstring & psFile);
 	bool InitFireShader(ID3D11Device *dev, const std::wstring &vsFile, const std::wstring &psFile);
+	HRESULT CompileStage(const std::wstring &file, const char *entry, const char *target, Microsoft::WRL::ComPtr<ID3D10Blob> &compiled, ID3D10Blob **blob, ID3D10Blob **errors);
+	bool InitInstancedStage(ID3D11Device *dev, const std::wstring &vsFile, const D3D11_INPUT_ELEMENT_DESC *vertexLayout, unsigned int vertexLayoutCount);
+	void BindStage(ID3D11DeviceContext *devCon, bool instanced);
+	bool InitBlockBuffers(ID3D11Device *dev, bool lit);
+	bool UploadBlock(ID3D11DeviceContext *devCon, ConstantBlocks::Block block, const void *data);
+	Microsoft::WRL::ComPtr<ID3D10Blob> vertexBlob, pixelBlob, instancedBlob;	//from Compile until Init
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> pixelShader;
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> matrixBuffer;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> instancedVertexShader;	//vs_instanced, the same file's second entry point
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> instancedLayout;
+	bool instancedBound;	//which vertex stage Bind, Draw or DrawInstanced left bound
+	Microsoft::WRL::ComPtr<ID3D11Buffer> matrixBuffer;		//SKYDOME, PARTICLE and FIRE, the others split it into frameBuffer and objectBuffer
 	Microsoft::WRL::ComPtr<ID3D11Buffer> lightBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> cameraBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> frameBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> objectBuffer;
+	ConstantBlocks constants;	//frameBuffer, lightBuffer and objectBuffer as last uploaded
 	Microsoft::WRL::ComPtr<ID3D11Buffer> timeBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> noiseBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> distortionBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBoundsBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> meshBoundsBuffer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampleState;		//wrap
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampleState2;	//clamp
 };
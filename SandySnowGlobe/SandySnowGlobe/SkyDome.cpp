@@ -1,7 +1,7 @@
 #include "SkyDome.h"
 
 
-SkyDome::SkyDome(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture, Shader *objectShader, ParticleSystem *rainSys, ParticleSystem *snowSys) : GameObject(device, filename, skyTexture, gradientTexture, objectShader)
+SkyDome::SkyDome(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture, Shader *objectShader, ParticleSystem *rainSys, ParticleSystem *snowSys) : GameObject(device, assets, filename, skyTexture, gradientTexture, objectShader)
 {
 	season = Season(Season::SPRING);
 	currentTime = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
@@ -90,13 +90,13 @@ void SkyDome::Update(float dt)
 		rain->Active(false);
 		snow->Active(false);
 
-		if(((float)(rand()) / (float)(RAND_MAX)) <= GetRainChance() && !(*particleActive))
+		if(rng.Chance(GetRainChance()) && !(*particleActive))
 		{
 			particleActive = rain->Active();
 			rain->Active(true);
 		}
 
-		if(((float)(rand()) / (float)(RAND_MAX)) <= GetSnowChance() && !(*particleActive))
+		if(rng.Chance(GetSnowChance()) && !(*particleActive))
 		{
 			particleActive = snow->Active();
 			snow->Active(true);
@@ -3,13 +3,14 @@
 #include "GameObject.h"
 #include "Season.h"
 #include "ParticleSystem.h"
+#include "Random.h"
 #include "DirectXMath.h"
 #include "AntTweakBar.h"
 
 class SkyDome : public GameObject
 {
 public:
-	SkyDome(ID3D11Device *device, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture, Shader *objectShader, ParticleSystem *rainSys, ParticleSystem *snowSys);
+	SkyDome(ID3D11Device *device, AssetCache *assets, const WCHAR *filename, const WCHAR *skyTexture, const WCHAR *gradientTexture, Shader *objectShader, ParticleSystem *rainSys, ParticleSystem *snowSys);
 	virtual ~SkyDome();
 
 	void Update(float dt);
@@ -34,6 +35,7 @@ public:
 	void SeasonLength(unsigned int val) { seasonLength = val; }
 
 	void Reset();
+	void Seed(unsigned long long seed) { rng.Seed(seed); }
 
 private:
 	Season season;
@@ -41,6 +43,7 @@ private:
 	float stepCounter, stepAmount;
 	DirectX::XMFLOAT3 currentTime;
 	ParticleSystem *rain, *snow;
+	Random rng;
 	bool *particleActive, *sunny, prevSunny;
 	
 };
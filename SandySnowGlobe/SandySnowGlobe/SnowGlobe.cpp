@@ -1,4 +1,24 @@
 #include "SnowGlobe.h"
+#include <cstddef>
+
+namespace
+{
+	//Random stream ids, see SeedStreams
+	const unsigned int STREAM_RAIN = 1;
+	const unsigned int STREAM_SNOW = 2;
+	const unsigned int STREAM_SKY = 3;
+	const unsigned int STREAM_FIRE = 4;
+	const unsigned int STREAM_CACTUS = 16;
+
+	const unsigned int CACTUS_COUNT = 8;
+
+	//render queue passes, unlit objects first
+	const unsigned int PASS_UNLIT = 0;
+	const unsigned int PASS_LIT = 1;
+	const unsigned int MAX_DRAW_TEXTURES = 3;
+	const unsigned int MAX_OBJECT_INSTANCES = 1024;	//per frame, past this the whole queue is drawn one at a time
+	const unsigned int OBJECT_FRAME_BYTES = (sizeof(InstanceBatcher::Transform) * MAX_OBJECT_INSTANCES) + InstanceSink::ALIGNMENT;
+}
 
 SnowGlobe::SnowGlobe(const HINSTANCE &hInstance, const int &cmdShow, const std::string &windowName, unsigned int windowWidth, unsigned int windowHeight) : DXBase(hInstance, cmdShow, windowName, windowWidth, windowHeight)
 {
@@ -28,6 +48,16 @@ SnowGlobe::SnowGlobe(const HINSTANCE &hInstance, const int &cmdShow, const std::
 	rain = nullptr;
 	snow = nullptr;
 	fire = nullptr;
+	fireArena = nullptr;
+	workers = nullptr;
+	particleRing = nullptr;
+	particleFrameBytes = 0;
+	objectRing = nullptr;
+	ground = nullptr;
+	assets = nullptr;
+	loader = nullptr;
+	simThreads = 0;
+	rngSeed = 1;
 	
 	twUsageBar = nullptr;
 	fpsCounter = nullptr;
@@ -42,6 +72,18 @@ SnowGlobe::SnowGlobe(const HINSTANCE &hInstance, const int &cmdShow, const std::
 	dt = 0;
 	dtMod = 1.0f;
 	baseInit = false;
+	cullObjects = true;
+	cullStats.drawnObjects = 0;
+	cullStats.culledObjects = 0;
+	queueStats.draws = 0;
+	queueStats.shaderBinds = 0;
+	queueStats.textureBinds = 0;
+	queueStats.meshBinds = 0;
+	queueStats.constantMaps = 0;
+	instanceObjects = true;
+	instanceStats.draws = 0;
+	instanceStats.instancedDraws = 0;
+	instanceStats.instances = 0;
 }
 
 SnowGlobe::~SnowGlobe()
@@ -67,6 +109,12 @@ SnowGlobe::~SnowGlobe()
 		Memory::SafeDelete(rain);
 		Memory::SafeDelete(snow);
 		Memory::SafeDelete(fire);
+		Memory::SafeDelete(loader);	//waits for work still running on the pool
+		Model::Workers(nullptr);
+		Memory::SafeDelete(workers);
+		Memory::SafeDelete(particleRing);
+		Memory::SafeDelete(objectRing);
+		Memory::SafeDelete(ground);
 
 
 		for each (GameObject* o in colObjectList)
@@ -89,7 +137,10 @@ SnowGlobe::~SnowGlobe()
 			Memory::SafeDelete(o);
 		}
 
+		//after the cacti, their fires release emitters on destruction
+		Memory::SafeDelete(fireArena);
 		Memory::SafeDelete(globe);
+		Memory::SafeDelete(assets);	//last, releases the models and textures no object holds any more
 	}
 	catch(int &e)
 	{
@@ -111,6 +162,12 @@ SnowGlobe::~SnowGlobe()
 		delete rain;
 		delete snow;
 		delete fire;
+		delete loader;
+		Model::Workers(nullptr);
+		delete workers;
+		delete particleRing;
+		delete objectRing;
+		delete ground;
 		delete c1;
 		delete c2;
 		delete c3;
@@ -135,7 +192,9 @@ SnowGlobe::~SnowGlobe()
 			delete o;
 		}
 
+		delete fireArena;
 		delete globe;
+		delete assets;
 	}
 }
 
@@ -213,47 +272,98 @@ bool SnowGlobe::Init(bool vsync)
 	pListElement = pElement->FirstChildElement("Length");
 	pListElement->QueryIntText(&seasonLength);
 
+	int threads = 0;	//0 = one per hardware thread
+
+	pElement = pRoot->FirstChildElement("Simulation");
+	if(pElement)
+	{
+		pListElement = pElement->FirstChildElement("Threads");
+		if(pListElement)
+			pListElement->QueryIntText(&threads);
+
+		pListElement = pElement->FirstChildElement("Seed");
+		if(pListElement)
+			pListElement->QueryUnsignedText(&rngSeed);
+	}
+
 	fclose(configFile);
 
 	#pragma endregion
 
 	CameraInit();
 
+	workers = new WorkerPool(threads > 0 ? (unsigned int)threads : 0);
+	simThreads = workers->ThreadCount();
+	Model::Workers(workers);
+
+	//shaders compile, meshes parse and textures read on the workers while the rest of Init runs,
+	//their device objects are made on this thread as each is waited on
+	loader = new AssetLoader();
+	loader->Workers(workers);
+
+	std::vector<AssetLoader::Handle> shaderJobs;
+
 	colourShader = new Shader(Shader::COLOUR);
-	if(!colourShader->Init(dev.Get(), L"Colour.vs", L"Colour.ps"))
-		return false;
+	shaderJobs.push_back(LoadShader(colourShader, L"Colour.vs", L"Colour.ps"));
 
 	textureShader = new Shader(Shader::TEXTURE);
-	if(!textureShader->Init(dev.Get(), L"Texture.vs", L"Texture.ps"))
-		return false;
+	shaderJobs.push_back(LoadShader(textureShader, L"Texture.vs", L"Texture.ps"));
 
 	lightsShader = new Shader(Shader::LIGHTS);
-	if(!lightsShader->Init(dev.Get(), L"Lights.vs", L"Lights.ps"))
-		return false;
+	shaderJobs.push_back(LoadShader(lightsShader, L"Lights.vs", L"Lights.ps"));
 
 	normShader = new Shader(Shader::NORMAL);
-	if(!normShader->Init(dev.Get(), L"Normal.vs", L"Normal.ps"))
-		return false;
+	shaderJobs.push_back(LoadShader(normShader, L"Normal.vs", L"Normal.ps"));
 
 	skyDomeShader = new Shader(Shader::SKYDOME);
-	if(!skyDomeShader->Init(dev.Get(), L"SkyCycle.vs", L"SkyCycle.ps"))
-		return false;
+	shaderJobs.push_back(LoadShader(skyDomeShader, L"SkyCycle.vs", L"SkyCycle.ps"));
 
 	particleShader = new Shader(Shader::PARTICLE);
-	if(!particleShader->Init(dev.Get(), L"Particle.vs", L"Particle.ps"))
-		return false;
+	shaderJobs.push_back(LoadShader(particleShader, L"Particle.vs", L"Particle.ps"));
 
 	fireShader = new Shader(Shader::FIRE);
-	if(!fireShader->Init(dev.Get(), L"Fire.vs", L"Fire.ps"))
+	shaderJobs.push_back(LoadShader(fireShader, L"Fire.vs", L"Fire.ps"));
+
+	//one model per mesh/texture set, every cactus and fire shares the first one loaded
+	assets = new AssetCache(loader);
+	assets->PrefetchModel(dev.Get(), L"desert.obj", L"sand.dds", L"sand_norm.dds", L"sand_spec.dds");
+	assets->PrefetchModel(dev.Get(), L"dome.obj", L"sky.dds", L"SkyMapSmooth.dds");
+	assets->PrefetchModel(dev.Get(), L"snowglobebase.obj", L"wood.dds");
+	assets->PrefetchModel(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds");
+	assets->PrefetchBillboard(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds");
+
+	//every cactus fire emits into one arena, drawn by a single system
+	fireArena = new ParticleArena();
+	if(!fireArena->Init(ParticleSim::PresetSettings(ParticleSim::FIRE).maxParticles * CACTUS_COUNT))
+		return false;
+	fireArena->Workers(workers);
+
+	//rain, snow and fire append to one ring, sized for two frames of all three at full budget, Update starts each frame on it
+	particleFrameBytes = (sizeof(ParticleSystem::ParticleInstance) * (ParticleSim::PresetSettings(ParticleSim::RAIN).maxParticles + ParticleSim::PresetSettings(ParticleSim::SNOW).maxParticles + fireArena->Capacity())) + (InstanceSink::ALIGNMENT * 3);
+	particleRing = new InstanceRing();
+	if(!particleRing->Init(dev.Get(), devCon.Get(), particleFrameBytes * 2))
+		return false;
+
+	//objects get a ring of their own, a discard there must not orphan particles already uploaded this frame
+	objectRing = new InstanceRing();
+	if(!objectRing->Init(dev.Get(), devCon.Get(), OBJECT_FRAME_BYTES * 2))
 		return false;
 
 	rain = new ParticleSystem(ParticleSystem::RAIN, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), particleShader);
+	rain->InstanceBuffer(particleRing);
 	rain->Init(dev.Get(), L"raindrop.dds");
+	rain->Workers(workers);
 
 	snow = new ParticleSystem(ParticleSystem::SNOW, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), particleShader);
+	snow->InstanceBuffer(particleRing);
 	snow->Init(dev.Get(), L"snowflake.dds");
+	snow->Workers(workers);
 
 	fire = new ParticleSystem(ParticleSystem::FIRE, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), particleShader);
+	fire->Arena(fireArena);
+	fire->InstanceBuffer(particleRing);
+	fire->Init(dev.Get(), L"fire01.dds");
+	fire->Active(true);
 
 	sun = new Light();
 	sun->DiffuseColour(DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
@@ -267,30 +377,76 @@ bool SnowGlobe::Init(bool vsync)
 	moon->SpecularColour(DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
 	moon->SpecularIntensity(500.0f);
 
-	desert = new GameObject(dev.Get(), L"desert.obj", L"sand.dds", L"sand_norm.dds", L"sand_spec.dds", normShader);
+	desert = new GameObject(dev.Get(), assets, L"desert.obj", L"sand.dds", L"sand_norm.dds", L"sand_spec.dds", normShader);
 	desert->Position(posList[0]);
 	desert->Scale(DirectX::XMFLOAT3(0.985f, 0.985f, 0.985f));
 	normObjectList.push_back(desert);
 
-	globe = new SkyDome(dev.Get(), L"dome.obj", L"sky.dds", L"SkyMapSmooth.dds", skyDomeShader, rain, snow);
+	globe = new SkyDome(dev.Get(), assets, L"dome.obj", L"sky.dds", L"SkyMapSmooth.dds", skyDomeShader, rain, snow);
 	globe->Position(DirectX::XMFLOAT3(0.0f, -10.0f, 0.0f));
 	globe->SeasonLength(seasonLength);
 
-	globeBase = new GameObject(dev.Get(), L"snowglobebase.obj", L"wood.dds", textureShader);
+	globeBase = new GameObject(dev.Get(), assets, L"snowglobebase.obj", L"wood.dds", textureShader);
 	globeBase->Position(posList[1]);
 	globeBase->Scale(DirectX::XMFLOAT3(3.75f, 1.8f, 3.75f));
 	texObjectList.push_back(globeBase);
 
+	//rasterized on a worker from the placed surfaces while the cacti are made
+	ground = new HeightField();
+	ground->Workers(workers);
+	AssetLoader::Handle groundJob = loader->Submit("ground", [this]() { return GroundInit(); }, nullptr);
+
+	rain->Ground(ground);
+	snow->Ground(ground);
+
 	CactusInit(posList);
+	SeedStreams();
+	loader->Mark("objects created");
+
+	for(unsigned int i = 0; i < shaderJobs.size(); i++)
+	{
+		if(!loader->Wait(shaderJobs[i]))
+			return false;
+	}
+
+	if(!loader->Wait(groundJob))
+		return false;
+
+	assets->Complete();
+	loader->Mark("loaded");
+	Logger::Log(loader->Report());
+	assets->LogStats();
 
 	TweakInit();
 	
 	return true;
 }
 
+/// <summary>
+/// Compile a shader's stages on a worker, its Init runs on this thread when the job is waited on
+/// </summary>
+/// <param name="shader">Shader to initialise</param>
+/// <param name="vsFile">Vertex shader filepath</param>
+/// <param name="psFile">Pixel shader filepath</param>
+/// <returns>Job to wait on, false from Init fails it</returns>
+AssetLoader::Handle SnowGlobe::LoadShader(Shader *shader, const std::wstring &vsFile, const std::wstring &psFile)
+{
+	ID3D11Device *device = dev.Get();
+	std::string name;
+
+	for(unsigned int i = 0; i < vsFile.size(); i++)
+	{
+		name.push_back((char)vsFile[i]);
+	}
+
+	//a stage that fails to compile here is compiled again by Init, which reports it
+	return loader->Submit(name, [shader, vsFile, psFile]() { shader->Compile(vsFile, psFile); return true; },
+		[shader, device, vsFile, psFile]() { return shader->Init(device, vsFile, psFile); });
+}
+
 void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 {
-	cactus1 = new Cactus(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds", *fire, fireShader), normShader);
+	cactus1 = new Cactus(dev.Get(), assets, L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), assets, L"fire01.dds", L"noise01.dds", L"alpha01.dds", fireArena, fireShader), normShader);
 	cactus1->Position(p[2]);
 	cactus1->Raining(globe->GetRaining());
 	cactus1->Snowing(globe->GetSnowing());
@@ -298,7 +454,7 @@ void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 	cactus1->GetFire()->Position(cactus1->Position());
 	normObjectList.push_back(cactus1);
 
-	cactus2 = new Cactus(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds", *fire, fireShader), normShader);
+	cactus2 = new Cactus(dev.Get(), assets, L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), assets, L"fire01.dds", L"noise01.dds", L"alpha01.dds", fireArena, fireShader), normShader);
 	cactus2->Position(p[3]);
 	cactus2->Raining(globe->GetRaining());
 	cactus2->Snowing(globe->GetSnowing());
@@ -307,7 +463,7 @@ void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 	cactus2->GetFire()->Position(cactus2->Position());
 	normObjectList.push_back(cactus2);
 
-	cactus3 = new Cactus(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds", *fire, fireShader), normShader);
+	cactus3 = new Cactus(dev.Get(), assets, L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), assets, L"fire01.dds", L"noise01.dds", L"alpha01.dds", fireArena, fireShader), normShader);
 	cactus3->Position(p[4]);
 	cactus3->Raining(globe->GetRaining());
 	cactus3->Snowing(globe->GetSnowing());
@@ -315,7 +471,7 @@ void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 	cactus3->GetFire()->Position(cactus3->Position());
 	normObjectList.push_back(cactus3);
 
-	cactus4 = new Cactus(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds", *fire, fireShader), normShader);
+	cactus4 = new Cactus(dev.Get(), assets, L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), assets, L"fire01.dds", L"noise01.dds", L"alpha01.dds", fireArena, fireShader), normShader);
 	cactus4->Position(p[5]);
 	cactus4->Raining(globe->GetRaining());
 	cactus4->Snowing(globe->GetSnowing());
@@ -323,7 +479,7 @@ void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 	cactus4->GetFire()->Position(cactus4->Position());
 	normObjectList.push_back(cactus4);
 
-	cactus5 = new Cactus(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds", *fire, fireShader), normShader);
+	cactus5 = new Cactus(dev.Get(), assets, L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), assets, L"fire01.dds", L"noise01.dds", L"alpha01.dds", fireArena, fireShader), normShader);
 	cactus5->Position(p[6]);
 	cactus5->Raining(globe->GetRaining());
 	cactus5->Snowing(globe->GetSnowing());
@@ -331,7 +487,7 @@ void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 	cactus5->GetFire()->Position(cactus5->Position());
 	normObjectList.push_back(cactus5);
 
-	cactus6 = new Cactus(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds", *fire, fireShader), normShader);
+	cactus6 = new Cactus(dev.Get(), assets, L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), assets, L"fire01.dds", L"noise01.dds", L"alpha01.dds", fireArena, fireShader), normShader);
 	cactus6->Position(p[7]);
 	cactus6->Raining(globe->GetRaining());
 	cactus6->Snowing(globe->GetSnowing());
@@ -339,7 +495,7 @@ void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 	cactus6->GetFire()->Position(cactus6->Position());
 	normObjectList.push_back(cactus6);
 
-	cactus7 = new Cactus(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds", *fire, fireShader), normShader);
+	cactus7 = new Cactus(dev.Get(), assets, L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), assets, L"fire01.dds", L"noise01.dds", L"alpha01.dds", fireArena, fireShader), normShader);
 	cactus7->Position(p[8]);
 	cactus7->Raining(globe->GetRaining());
 	cactus7->Snowing(globe->GetSnowing());
@@ -347,7 +503,7 @@ void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 	cactus7->GetFire()->Position(cactus7->Position());
 	normObjectList.push_back(cactus7);
 
-	cactus8 = new Cactus(dev.Get(), L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), L"fire01.dds", L"noise01.dds", L"alpha01.dds", *fire, fireShader), normShader);
+	cactus8 = new Cactus(dev.Get(), assets, L"cactus.obj", L"cactus.dds", L"cactus_norm.dds", L"blank_spec.dds", new Fire(dev.Get(), assets, L"fire01.dds", L"noise01.dds", L"alpha01.dds", fireArena, fireShader), normShader);
 	cactus8->Position(p[9]);
 	cactus8->Raining(globe->GetRaining());
 	cactus8->Snowing(globe->GetSnowing());
@@ -356,6 +512,29 @@ void SnowGlobe::CactusInit(std::vector<DirectX::XMFLOAT3> p)
 	normObjectList.push_back(cactus8);
 }
 
+/// <summary>
+/// Remove the cacti from the object list and delete them, their fires free their arena emitters
+/// </summary>
+void SnowGlobe::CactusRelease()
+{
+	Cactus *cacti[] = { cactus1, cactus2, cactus3, cactus4, cactus5, cactus6, cactus7, cactus8 };
+
+	for(unsigned int i = 0; i < CACTUS_COUNT; i++)
+	{
+		normObjectList.remove(cacti[i]);
+		delete cacti[i];
+	}
+
+	cactus1 = nullptr;
+	cactus2 = nullptr;
+	cactus3 = nullptr;
+	cactus4 = nullptr;
+	cactus5 = nullptr;
+	cactus6 = nullptr;
+	cactus7 = nullptr;
+	cactus8 = nullptr;
+}
+
 bool SnowGlobe::CameraInit()
 {
 	camera = new Camera();
@@ -378,7 +557,11 @@ bool SnowGlobe::CameraInit()
 	return true;
 }
 
-void SnowGlobe::Reset()
+/// <summary>
+/// Reload config.xml and put the globe, ground and cacti back to their starting state
+/// </summary>
+/// <returns>false if the ground could not be rebuilt, rain and snow would fall through it</returns>
+bool SnowGlobe::Reset()
 {
 	#pragma region ConfigLoad
 
@@ -440,6 +623,14 @@ void SnowGlobe::Reset()
 	pListElement = pElement->FirstChildElement("Length");
 	pListElement->QueryIntText(&seasonLength);
 
+	pElement = pRoot->FirstChildElement("Simulation");
+	if(pElement)
+	{
+		pListElement = pElement->FirstChildElement("Seed");
+		if(pListElement)
+			pListElement->QueryUnsignedText(&rngSeed);
+	}
+
 	fclose(configFile);
 
 	#pragma endregion
@@ -454,7 +645,65 @@ void SnowGlobe::Reset()
 
 	globeBase->Position(posList[1]);
 
+	if(!GroundInit())
+	{
+		Logger::Log("Reset: ground height field could not be rebuilt from desert.obj and snowglobebase.obj");
+		return false;
+	}
+
+	CactusRelease();
 	CactusInit(posList);
+	SeedStreams();
+
+	return true;
+}
+
+/// <summary>
+/// Rasterize the desert and globe base into the ground grid rain and snow die on
+/// Cacti are left out, they grow while running
+/// </summary>
+/// <returns></returns>
+bool SnowGlobe::GroundInit()
+{
+	GameObject *surfaces[] = { desert, globeBase };
+	const char *files[] = { "desert.obj", "snowglobebase.obj" };
+
+	//base is 60 units across scaled by 3.75, 2^8 cells gives ~0.9 unit spacing, about a third of a desert triangle
+	if(!ground->Init(-112.5f, -112.5f, 112.5f, 112.5f, 257, 257, globeBase->Position().y))
+	{
+		return false;
+	}
+
+	for(unsigned int i = 0; i < 2; i++)
+	{
+		DirectX::XMFLOAT3 scale = surfaces[i]->Scale();
+		DirectX::XMFLOAT3 position = surfaces[i]->Position();
+
+		if(!ground->AddMesh(files[i], &scale.x, &position.x))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Give every simulation system its own random stream derived from the config seed
+/// </summary>
+void SnowGlobe::SeedStreams()
+{
+	rain->Seed(Random::StreamSeed(rngSeed, STREAM_RAIN));
+	snow->Seed(Random::StreamSeed(rngSeed, STREAM_SNOW));
+	globe->Seed(Random::StreamSeed(rngSeed, STREAM_SKY));
+	fireArena->Seed(Random::StreamSeed(rngSeed, STREAM_FIRE));
+
+	Cactus *cacti[] = { cactus1, cactus2, cactus3, cactus4, cactus5, cactus6, cactus7, cactus8 };
+
+	for(unsigned int i = 0; i < CACTUS_COUNT; i++)
+	{
+		cacti[i]->Seed(Random::StreamSeed(rngSeed, STREAM_CACTUS + i));
+	}
 }
 
 void SnowGlobe::ToggleVsync()
@@ -479,11 +728,37 @@ bool SnowGlobe::TweakInit()
 	TwAddVarRO(twUsageBar, "CPU", TW_TYPE_DOUBLE, &cpu, " label='CPU (%)' group='Graphics Stats'");
 	TwAddVarRO(twUsageBar, "UsedRAM", TW_TYPE_FLOAT, &usedRam, " label='RAM Used (MB)' group='Graphics Stats'");
 	TwAddVarRO(twUsageBar, "TotalUsedRAM", TW_TYPE_STDSTRING, &ram, " label='Total RAM (MB)' group='Graphics Stats'");
+	TwAddVarRW(twUsageBar, "ObjectCull", TW_TYPE_BOOLCPP, &cullObjects, " label='Cull Objects' group='Graphics Stats'");
+	TwAddVarRO(twUsageBar, "ObjectsDrawn", TW_TYPE_UINT32, &cullStats.drawnObjects, " label='Objects Drawn' group='Graphics Stats'");
+	TwAddVarRO(twUsageBar, "ObjectsCulled", TW_TYPE_UINT32, &cullStats.culledObjects, " label='Objects Culled' group='Graphics Stats'");
+	TwAddVarRO(twUsageBar, "ShaderBinds", TW_TYPE_UINT32, &queueStats.shaderBinds, " label='Shader Binds' group='Graphics Stats'");
+	TwAddVarRO(twUsageBar, "TextureBinds", TW_TYPE_UINT32, &queueStats.textureBinds, " label='Texture Binds' group='Graphics Stats'");
+	TwAddVarRO(twUsageBar, "MeshBinds", TW_TYPE_UINT32, &queueStats.meshBinds, " label='Mesh Binds' group='Graphics Stats'");
+	TwAddVarRO(twUsageBar, "ConstantMaps", TW_TYPE_UINT32, &queueStats.constantMaps, " label='Constant Buffer Maps' group='Graphics Stats'");
+	TwAddVarRW(twUsageBar, "ObjectInstancing", TW_TYPE_BOOLCPP, &instanceObjects, " label='Instance Objects' group='Graphics Stats'");
+	TwAddVarRO(twUsageBar, "DrawCalls", TW_TYPE_UINT32, &instanceStats.draws, " label='Object Draw Calls' group='Graphics Stats'");
+	TwAddVarRO(twUsageBar, "InstancedObjects", TW_TYPE_UINT32, &instanceStats.instances, " label='Instanced Objects' group='Graphics Stats'");
 	TwAddSeparator(twUsageBar, "", " group= 'Simulation Stats' ");
 	TwAddVarRO(twUsageBar, "Time", TW_TYPE_UINT32, globe->GetHours(), " label='Time (hours)' group= 'Simulation Stats'");
 	TwAddVarRW(twUsageBar, "TimePercent", TW_TYPE_FLOAT, globe->GetTime(), " label='Time (%)' group= 'Simulation Stats'");
 	TwAddVarRO(twUsageBar, "Time Mod", TW_TYPE_FLOAT, &dtMod, " label='Time Modifier' group= 'Simulation Stats'");
 	TwAddVarRO(twUsageBar, "Season", TW_TYPE_STDSTRING, globe->GetSeasonString(), " label='Season' group='Simulation Stats'");
+	TwAddVarRW(twUsageBar, "RainSort", TW_TYPE_BOOLCPP, rain->DepthSort(), " label='Sort Rain' group='Simulation Stats'");
+	TwAddVarRW(twUsageBar, "SnowSort", TW_TYPE_BOOLCPP, snow->DepthSort(), " label='Sort Snow' group='Simulation Stats'");
+	TwAddVarRO(twUsageBar, "SimThreads", TW_TYPE_UINT32, &simThreads, " label='Sim Threads' group='Simulation Stats'");
+	TwAddVarRW(twUsageBar, "RainCull", TW_TYPE_BOOLCPP, rain->FrustumCull(), " label='Cull Rain' group='Simulation Stats'");
+	TwAddVarRW(twUsageBar, "SnowCull", TW_TYPE_BOOLCPP, snow->FrustumCull(), " label='Cull Snow' group='Simulation Stats'");
+	TwAddVarRO(twUsageBar, "RainVisible", TW_TYPE_UINT32, &rain->Culling()->visibleParticles, " label='Rain Visible' group='Simulation Stats'");
+	TwAddVarRO(twUsageBar, "RainCulled", TW_TYPE_UINT32, &rain->Culling()->culledParticles, " label='Rain Culled' group='Simulation Stats'");
+	TwAddVarRO(twUsageBar, "SnowVisible", TW_TYPE_UINT32, &snow->Culling()->visibleParticles, " label='Snow Visible' group='Simulation Stats'");
+	TwAddVarRO(twUsageBar, "SnowCulled", TW_TYPE_UINT32, &snow->Culling()->culledParticles, " label='Snow Culled' group='Simulation Stats'");
+	TwAddSeparator(twUsageBar, "", " group= 'Asset Stats' ");
+	TwAddVarRO(twUsageBar, "ModelsLoaded", TW_TYPE_UINT32, &assets->Stats()->models, " label='Models' group='Asset Stats'");
+	TwAddVarRO(twUsageBar, "ModelHits", TW_TYPE_UINT32, &assets->Stats()->modelHits, " label='Model Hits' group='Asset Stats'");
+	TwAddVarRO(twUsageBar, "ModelMisses", TW_TYPE_UINT32, &assets->Stats()->modelMisses, " label='Model Misses' group='Asset Stats'");
+	TwAddVarRO(twUsageBar, "TexturesLoaded", TW_TYPE_UINT32, &assets->Stats()->textures, " label='Textures' group='Asset Stats'");
+	TwAddVarRO(twUsageBar, "TextureHits", TW_TYPE_UINT32, &assets->Stats()->textureHits, " label='Texture Hits' group='Asset Stats'");
+	TwAddVarRO(twUsageBar, "TextureMisses", TW_TYPE_UINT32, &assets->Stats()->textureMisses, " label='Texture Misses' group='Asset Stats'");
 
 	TwDefine(" UsageStats label='Usage Stats' size='250 350' valueswidth=75 ");
 
@@ -535,8 +810,8 @@ void SnowGlobe::Update()
 		cactus1->GetFire()->Active(true);
 	}
 
-	if(inputHandler.IsKeyPressed('R'))
-		Reset();
+	if(inputHandler.IsKeyPressed('R') && !Reset())
+		PostQuitMessage(0);
 
 	if(inputHandler.IsKeyDown(VK_LEFT))
 	{
@@ -654,8 +929,10 @@ void SnowGlobe::Update()
 
 	globe->Update(dt);
 
-	rain->Update(devCon.Get(), dt);
-	snow->Update(devCon.Get(), dt);
+	DirectX::XMFLOAT4X4 viewMatrix = camera->ViewMatrix();
+	particleRing->BeginFrame(particleFrameBytes);	//before the first upload, rain, snow and fire are drawn in Render
+	rain->Update(dt, &viewMatrix, projMatrix);
+	snow->Update(dt, &viewMatrix, projMatrix);
 	//fireBase->Update(dt);
 
 	for each (GameObject* o in colObjectList)
@@ -689,58 +966,289 @@ void SnowGlobe::Update()
 			o->Update(dt);
 		}
 	}
+
+	//after the cacti so every fire emitter has this frame's position and state
+	fire->Update(dt, &viewMatrix, projMatrix);
 }
 
-void SnowGlobe::Render()
+/// <summary>
+/// Mark every object in the four lists visible or hidden against the camera frustum, before any draw is issued
+/// World bounding spheres go through Frustum::IntersectSpheres four at a time, the survivors' world boxes are then tested one by one
+/// </summary>
+void SnowGlobe::CullObjects()
 {
-	float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-	DirectX::XMFLOAT4 diffuseColour[NUM_LIGHTS];
-	DirectX::XMFLOAT3 lightDirection[NUM_LIGHTS];
-	DirectX::XMFLOAT4 specularColour[NUM_LIGHTS];
-	float specularIntensity[NUM_LIGHTS];
-
-	diffuseColour[0] = sun->DiffuseColour();
-	diffuseColour[1] = moon->DiffuseColour();
-	lightDirection[0] = sun->LightDirection();
-	lightDirection[1] = moon->LightDirection();
-	specularColour[0] = sun->SpecularColour();
-	specularColour[1] = moon->SpecularColour();
-	specularIntensity[0] = sun->SpecularIntensity();
-	specularIntensity[1] = moon->SpecularIntensity();
-
-	BeginDraw();
+	cullList.clear();
 
 	for each (GameObject* o in colObjectList)
 	{
-		o->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix);
+		cullList.push_back(o);
 	}
 
 	for each (GameObject* o in texObjectList)
 	{
-		o->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix);
+		cullList.push_back(o);
 	}
 
 	for each (GameObject* o in litObjectList)
 	{
-		o->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix, camera->Position(), 
-				  diffuseColour, lightDirection, specularIntensity, specularColour);
+		cullList.push_back(o);
 	}
 
 	for each (GameObject* o in normObjectList)
 	{
-		if(Cactus *c = dynamic_cast <Cactus*>(o))
+		cullList.push_back(o);
+	}
+
+	unsigned int count = (unsigned int)cullList.size();
+
+	if(!cullObjects || count == 0)
+	{
+		for(unsigned int i = 0; i < count; i++)
 		{
-			c->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix, camera->Position(),
-				diffuseColour, lightDirection, specularIntensity, specularColour);
+			cullList[i]->Visible(true);
 		}
-		else
+
+		cullStats.drawnObjects = count;
+		cullStats.culledObjects = 0;
+		return;
+	}
+
+	cullX.resize(count);
+	cullY.resize(count);
+	cullZ.resize(count);
+	cullRadius.resize(count);
+	cullVisible.resize(count);
+	cullMin.resize(count);
+	cullMax.resize(count);
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		DirectX::XMFLOAT3 center;
+
+		cullList[i]->WorldBounds(center, cullRadius[i], cullMin[i], cullMax[i]);
+		cullX[i] = center.x;
+		cullY[i] = center.y;
+		cullZ[i] = center.z;
+	}
+
+	//objects are placed in world space by their own matrices, so the planes come from view * projection alone
+	DirectX::XMFLOAT4X4 viewMatrix = camera->ViewMatrix();
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&viewMatrix), DirectX::XMLoadFloat4x4(projMatrix)));
+
+	Frustum frustum;
+	frustum.Build(&viewProj.m[0][0]);
+	frustum.IntersectSpheres(&cullX[0], &cullY[0], &cullZ[0], &cullRadius[0], count, &cullVisible[0]);
+
+	cullStats.drawnObjects = 0;
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		bool visible = cullVisible[i] != 0 && frustum.Intersects(&cullMin[i].x, &cullMax[i].x);
+
+		cullList[i]->Visible(visible);
+		cullStats.drawnObjects += visible ? 1 : 0;
+	}
+
+	cullStats.culledObjects = count - cullStats.drawnObjects;
+}
+
+/// <summary>
+/// Submit every visible object to the render queue with its key and sort it, the world matrix and LOD are worked out once here
+/// Lit objects whose texture count neither lights path handles are skipped, as GameObject::Render skips them
+/// </summary>
+void SnowGlobe::QueueObjects()
+{
+	DirectX::XMFLOAT4X4 viewMatrix = camera->ViewMatrix();
+	std::list<GameObject*> *lists[] = { &colObjectList, &texObjectList, &litObjectList, &normObjectList };
+
+	renderQueue.Clear();
+	drawRecords.clear();
+
+	for(unsigned int l = 0; l < sizeof(lists) / sizeof(lists[0]); l++)
+	{
+		std::list<GameObject*> &list = *lists[l];
+		bool lit = lists[l] == &litObjectList || lists[l] == &normObjectList;
+
+		for each (GameObject* o in list)
 		{
-			o->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix, camera->Position(),
-				diffuseColour, lightDirection, specularIntensity, specularColour);
+			Model *model = o->GetModel();
+			unsigned int textureCount = model->TextureCount();
+
+			if(!o->Visible() || (lit && textureCount != 1 && textureCount != 3))
+			{
+				continue;
+			}
+
+			DrawRecord draw;
+			draw.object = o;
+			draw.world = o->World();
+			draw.lod = o->SelectLod(draw.world, &viewMatrix, projMatrix);
+			draw.lit = lit;
+
+			ID3D11ShaderResourceView *textures[MAX_DRAW_TEXTURES] = { nullptr, nullptr, nullptr };
+			model->GetTextures(textures, lit ? MAX_DRAW_TEXTURES : 1);
+
+			//front to back inside each state group, from the view depth of the bounds centre
+			DirectX::XMFLOAT3 center, boundsMin, boundsMax;
+			float radius;
+			o->WorldBounds(center, radius, boundsMin, boundsMax);
+			float depth = (center.x * viewMatrix._13) + (center.y * viewMatrix._23) + (center.z * viewMatrix._33) + viewMatrix._43;
+
+			unsigned int shaderId = renderQueue.Intern(RenderQueue::FIELD_SHADER, o->GetShader());
+			unsigned int textureId = renderQueue.Intern(RenderQueue::FIELD_TEXTURES, textures[0], textures[1], textures[2]);
+			unsigned int meshId = (renderQueue.Intern(RenderQueue::FIELD_MESH, model) * MeshSimplifier::MAX_LODS) + draw.lod;
+
+			renderQueue.Submit(RenderQueue::MakeKey(lit ? PASS_LIT : PASS_UNLIT, shaderId, textureId, meshId, depth / farDepth), (unsigned int)drawRecords.size());
+			drawRecords.push_back(draw);
 		}
 	}
 
+	renderQueue.Sort();
+}
+
+/// <summary>
+/// Draw the sorted queue, runs sharing shader, textures and mesh go out as one instanced draw where the shader allows it
+/// Frame constants and lights go with each shader bind, a shader only maps them when they changed since it last uploaded them
+/// </summary>
+void SnowGlobe::DrawQueue(DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[], DirectX::XMFLOAT4 specularColour[])
+{
+	ObjectDrawTarget target(*this, diffuseColour, lightDirection, specularIntensity, specularColour);
+	InstanceBatcher::Layout layout = { drawRecords.empty() ? nullptr : &drawRecords[0], sizeof(DrawRecord), offsetof(DrawRecord, world) };
+
+	Shader *shaders[] = { colourShader, textureShader, lightsShader, normShader };
+	unsigned int uploads = 0;
+
+	for(unsigned int i = 0; i < sizeof(shaders) / sizeof(shaders[0]); i++)
+	{
+		uploads += shaders[i]->ConstantUploads();
+	}
+
+	queueStats.draws = renderQueue.Count();
+	queueStats.shaderBinds = 0;
+	queueStats.textureBinds = 0;
+	queueStats.meshBinds = 0;
+
+	objectRing->BeginFrame(OBJECT_FRAME_BYTES);
+	InstanceBatcher::Submit(renderQueue.Items(), renderQueue.Count(), layout, *objectRing, target, instanceStats);
+
+	queueStats.constantMaps = 0;
+
+	for(unsigned int i = 0; i < sizeof(shaders) / sizeof(shaders[0]); i++)
+	{
+		queueStats.constantMaps += shaders[i]->ConstantUploads();
+	}
+
+	queueStats.constantMaps -= uploads;
+}
+
+SnowGlobe::ObjectDrawTarget::ObjectDrawTarget(SnowGlobe &owner, DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[],
+	DirectX::XMFLOAT4 specularColour[]) : owner(owner)
+{
+	viewMatrix = owner.camera->ViewMatrix();
+	this->diffuseColour = diffuseColour;
+	this->lightDirection = lightDirection;
+	this->specularIntensity = specularIntensity;
+	this->specularColour = specularColour;
+	previousKey = 0;
+	first = true;
+}
+
+bool SnowGlobe::ObjectDrawTarget::Instanced(const RenderQueue::Item &item)
+{
+	return owner.instanceObjects && owner.drawRecords[item.payload].object->GetShader()->Instanced();
+}
+
+void SnowGlobe::ObjectDrawTarget::Draw(const RenderQueue::Item &item)
+{
+	const DrawRecord &draw = owner.drawRecords[item.payload];
+
+	BindState(item);
+	draw.object->GetShader()->Draw(owner.devCon.Get(), draw.object->GetModel()->LodIndexCount(draw.lod), &draw.world);
+}
+
+void SnowGlobe::ObjectDrawTarget::DrawInstanced(const RenderQueue::Item &first, unsigned int instanceCount, unsigned int instanceOffset)
+{
+	const DrawRecord &draw = owner.drawRecords[first.payload];
+
+	BindState(first);
+	draw.object->GetShader()->DrawInstanced(owner.devCon.Get(), draw.object->GetModel()->LodIndexCount(draw.lod), owner.objectRing->Buffer(), instanceOffset, instanceCount);
+}
+
+/// <summary>
+/// Bind shaders, textures and meshes only where the key prefix changes from the previous draw
+/// </summary>
+void SnowGlobe::ObjectDrawTarget::BindState(const RenderQueue::Item &item)
+{
+	const DrawRecord &draw = owner.drawRecords[item.payload];
+	ID3D11DeviceContext *devCon = owner.devCon.Get();
+	Shader *shader = draw.object->GetShader();
+	Model *model = draw.object->GetModel();
+
+	if(first || !RenderQueue::SamePrefix(previousKey, item.key, RenderQueue::FIELD_SHADER))
+	{
+		shader->Bind(devCon);
+		shader->SetFrame(devCon, &viewMatrix, owner.projMatrix, owner.camera->Position());
+
+		if(draw.lit)
+		{
+			shader->SetLights(devCon, diffuseColour, lightDirection, specularIntensity, specularColour);
+		}
+
+		owner.queueStats.shaderBinds++;
+	}
+
+	if(first || !RenderQueue::SamePrefix(previousKey, item.key, RenderQueue::FIELD_TEXTURES))
+	{
+		ID3D11ShaderResourceView *textures[MAX_DRAW_TEXTURES];
+		unsigned int textureCount = model->GetTextures(textures, draw.lit ? MAX_DRAW_TEXTURES : 1);
+
+		shader->SetTextures(devCon, textures, textureCount);
+		owner.queueStats.textureBinds++;
+	}
+
+	if(first || !RenderQueue::SamePrefix(previousKey, item.key, RenderQueue::FIELD_MESH))
+	{
+		model->Render(devCon, draw.lod);
+
+		if(model->Format() == Model::MESH_BUMP_PACKED)
+		{
+			DirectX::XMFLOAT3 extent(model->BoundsMax().x - model->BoundsMin().x, model->BoundsMax().y - model->BoundsMin().y, model->BoundsMax().z - model->BoundsMin().z);
+			shader->SetMeshBounds(devCon, model->BoundsMin(), extent);
+		}
+
+		owner.queueStats.meshBinds++;
+	}
+
+	previousKey = item.key;
+	first = false;
+}
+
+void SnowGlobe::Render()
+{
+	float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	DirectX::XMFLOAT4 diffuseColour[NUM_LIGHTS];
+	DirectX::XMFLOAT3 lightDirection[NUM_LIGHTS];
+	DirectX::XMFLOAT4 specularColour[NUM_LIGHTS];
+	float specularIntensity[NUM_LIGHTS];
+
+	diffuseColour[0] = sun->DiffuseColour();
+	diffuseColour[1] = moon->DiffuseColour();
+	lightDirection[0] = sun->LightDirection();
+	lightDirection[1] = moon->LightDirection();
+	specularColour[0] = sun->SpecularColour();
+	specularColour[1] = moon->SpecularColour();
+	specularIntensity[0] = sun->SpecularIntensity();
+	specularIntensity[1] = moon->SpecularIntensity();
+
+	CullObjects();
+	QueueObjects();
+
+	BeginDraw();
+
+	DrawQueue(diffuseColour, lightDirection, specularIntensity, specularColour);
+
 	devCon->RSSetState(rasterStateFCull.Get());
 	globe->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix);
 	devCon->RSSetState(rasterStateBCull.Get());
@@ -748,15 +1256,18 @@ void SnowGlobe::Render()
 	devCon->OMSetBlendState(particleBlendState.Get(), blendFactor, 0xffffffff);
 	rain->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix);
 	snow->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix);
+	fire->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix);
 
 	devCon->OMSetDepthStencilState(depthDisabledState.Get(), 0);
 	devCon->OMSetBlendState(alphaBlendState.Get(), blendFactor, 0xffffffff);
 
-	for each (GameObject* o in normObjectList)
+	Cactus *cacti[] = { cactus1, cactus2, cactus3, cactus4, cactus5, cactus6, cactus7, cactus8 };
+
+	for(unsigned int i = 0; i < CACTUS_COUNT; i++)
 	{
-		if(Cactus *c = dynamic_cast <Cactus*>(o))
+		if(cacti[i] != nullptr)
 		{
-			c->GetFire()->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix);
+			cacti[i]->GetFire()->Render(devCon.Get(), worldMatrix, &camera->ViewMatrix(), projMatrix);
 		}
 	}
 
@@ -17,6 +17,14 @@
 #include "tinyxml2.h"
 #include <vector>
 #include "Fire.h"
+#include "WorkerPool.h"
+#include "InstanceRing.h"
+#include "HeightField.h"
+#include "AssetCache.h"
+#include "AssetLoader.h"
+#include "Frustum.h"
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
 
 class SnowGlobe : public DXBase
 {
@@ -37,7 +45,14 @@ private:
 
 	bool CameraInit();
 	void CactusInit(std::vector<DirectX::XMFLOAT3> p);
-	void Reset();
+	void CactusRelease();
+	bool Reset();
+	void SeedStreams();
+	bool GroundInit();
+	AssetLoader::Handle LoadShader(Shader *shader, const std::wstring &vsFile, const std::wstring &psFile);
+	void CullObjects();
+	void QueueObjects();
+	void DrawQueue(DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[], DirectX::XMFLOAT4 specularColour[]);
 	FPSCounter *fpsCounter;
 	unsigned int fps;
 	CPUCounter *cpuCounter;
@@ -51,6 +66,67 @@ private:
 	TwBar *twUsageBar;
 
 	std::list<GameObject*> colObjectList, texObjectList, litObjectList, normObjectList;
+
+	//object culling of the last Render, the spheres are gathered into arrays for the SSE2 test, survivors then test their box
+	struct CullStats
+	{
+		unsigned int drawnObjects, culledObjects;
+	};
+
+	CullStats cullStats;
+	bool cullObjects;
+	std::vector<GameObject*> cullList;
+	std::vector<float> cullX, cullY, cullZ, cullRadius;
+	std::vector<unsigned char> cullVisible;
+	std::vector<DirectX::XMFLOAT3> cullMin, cullMax;
+
+	//visible objects of the last Render, the queue's payloads index them, sorted by pass, shader, textures, mesh then depth
+	struct DrawRecord
+	{
+		GameObject *object;
+		DirectX::XMFLOAT4X4 world;
+		unsigned int lod;
+		bool lit;
+	};
+
+	//binds DrawQueue made for its draws, the rest were skipped as already bound, and the constant buffers it mapped
+	struct QueueStats
+	{
+		unsigned int draws, shaderBinds, textureBinds, meshBinds, constantMaps;
+	};
+
+	//issues the batcher's draws, binding only what changed since the previous one
+	class ObjectDrawTarget : public DrawTarget
+	{
+	public:
+		ObjectDrawTarget(SnowGlobe &owner, DirectX::XMFLOAT4 diffuseColour[], DirectX::XMFLOAT3 lightDirection[], float specularIntensity[], DirectX::XMFLOAT4 specularColour[]);
+
+		bool Instanced(const RenderQueue::Item &item) override;
+		void Draw(const RenderQueue::Item &item) override;
+		void DrawInstanced(const RenderQueue::Item &first, unsigned int instanceCount, unsigned int instanceOffset) override;
+
+	private:
+		ObjectDrawTarget& operator= (const ObjectDrawTarget&);
+		ObjectDrawTarget(const ObjectDrawTarget&);
+
+		void BindState(const RenderQueue::Item &item);
+
+		SnowGlobe &owner;
+		DirectX::XMFLOAT4X4 viewMatrix;
+		DirectX::XMFLOAT4 *diffuseColour;
+		DirectX::XMFLOAT3 *lightDirection;
+		float *specularIntensity;
+		DirectX::XMFLOAT4 *specularColour;
+		unsigned long long previousKey;
+		bool first;
+	};
+
+	RenderQueue renderQueue;
+	std::vector<DrawRecord> drawRecords;
+	QueueStats queueStats;
+	InstanceBatcher::Stats instanceStats;
+	bool instanceObjects;
+	InstanceRing *objectRing;	//packed world matrices of the instanced draws
 	Camera *camera, *c1, *c2, *c3;
 	Shader *colourShader, *textureShader, *lightsShader, *normShader, *skyDomeShader, *particleShader, *fireShader;
 	
@@ -59,6 +135,14 @@ private:
 	Cactus *cactus1, *cactus2, *cactus3, *cactus4, *cactus5, *cactus6, *cactus7, *cactus8;
 	SkyDome *globe;
 	ParticleSystem *rain, *snow, *fire;
+	WorkerPool *workers;
+	ParticleArena *fireArena;
+	InstanceRing *particleRing;
+	unsigned int particleFrameBytes;	//worst case of one frame's rain, snow and fire uploads
+	HeightField *ground;
+	AssetCache *assets;
+	AssetLoader *loader;
+	unsigned int simThreads, rngSeed;
 	tinyxml2::XMLDocument configXML;
 	bool baseInit;
 };
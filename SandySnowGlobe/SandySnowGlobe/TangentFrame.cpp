@@ -0,0 +1,460 @@
+#include "TangentFrame.h"
+#include "WorkerPool.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TANGENT_FRAME_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const unsigned int NONE = 0xFFFFFFFF;
+	const unsigned int BLOCK = 4096;			//triangles or vertices per parallel task
+	const float DEGENERATE = 1e-20f;			//UV area or squared tangent length treated as zero
+
+	//unnormalized tangent and bitangent of a triangle, padded so each is one 4-wide load when the sums are gathered
+	struct FaceFrame
+	{
+		float t[4];
+		float b[4];
+	};
+
+	inline const float *Attribute(const unsigned char *data, unsigned int vertex, unsigned int stride, unsigned int offset)
+	{
+		return reinterpret_cast<const float *>(data + ((std::size_t)vertex * stride) + offset);
+	}
+
+	//run task over [0, count) in BLOCK sized pieces, on the pool when it is worth waking
+	template <typename Task> void ForBlocks(WorkerPool *workers, unsigned int count, bool parallel, const Task &task)
+	{
+		unsigned int blocks = (count + BLOCK - 1) / BLOCK;
+
+		if(workers != nullptr && parallel && blocks > 1)
+		{
+			workers->ParallelFor(blocks, [&](unsigned int block)
+			{
+				unsigned int begin = block * BLOCK;
+				task(begin, (begin + BLOCK < count) ? begin + BLOCK : count);
+			});
+		}
+		else if(count > 0)
+		{
+			task(0, count);
+		}
+	}
+
+	/// <summary>
+	/// Lengyel's per triangle tangent and bitangent, left unnormalized so larger triangles weigh more in the vertex sums
+	/// Triangles with no UV area contribute nothing
+	/// </summary>
+	void FaceTangentsScalar(const unsigned char *data, const TangentFrame::Layout &layout, const unsigned int *indices, unsigned int begin, unsigned int end, FaceFrame *faces)
+	{
+		for(unsigned int t = begin; t < end; t++)
+		{
+			const unsigned int *tri = indices + (t * 3);
+			const float *p0 = Attribute(data, tri[0], layout.stride, layout.position);
+			const float *p1 = Attribute(data, tri[1], layout.stride, layout.position);
+			const float *p2 = Attribute(data, tri[2], layout.stride, layout.position);
+			const float *uv0 = Attribute(data, tri[0], layout.stride, layout.texCoord);
+			const float *uv1 = Attribute(data, tri[1], layout.stride, layout.texCoord);
+			const float *uv2 = Attribute(data, tri[2], layout.stride, layout.texCoord);
+
+			float e1x = p1[0] - p0[0], e1y = p1[1] - p0[1], e1z = p1[2] - p0[2];
+			float e2x = p2[0] - p0[0], e2y = p2[1] - p0[1], e2z = p2[2] - p0[2];
+			float du1 = uv1[0] - uv0[0], dv1 = uv1[1] - uv0[1];
+			float du2 = uv2[0] - uv0[0], dv2 = uv2[1] - uv0[1];
+			float det = (du1 * dv2) - (du2 * dv1);
+			float r = (std::fabs(det) > DEGENERATE) ? 1.0f / det : 0.0f;
+
+			FaceFrame &face = faces[t];
+
+			face.t[0] = ((e1x * dv2) - (e2x * dv1)) * r;
+			face.t[1] = ((e1y * dv2) - (e2y * dv1)) * r;
+			face.t[2] = ((e1z * dv2) - (e2z * dv1)) * r;
+			face.t[3] = 0.0f;
+			face.b[0] = ((e2x * du1) - (e1x * du2)) * r;
+			face.b[1] = ((e2y * du1) - (e1y * du2)) * r;
+			face.b[2] = ((e2z * du1) - (e1z * du2)) * r;
+			face.b[3] = 0.0f;
+		}
+	}
+
+	//tangent for a vertex whose faces cancel out or have no UV area, any unit vector perpendicular to the normal
+	void AnyPerpendicular(const float *n, float *out)
+	{
+		float ax = (std::fabs(n[0]) < 0.9f) ? 1.0f : 0.0f;
+		float ay = 1.0f - ax;
+		float d = (n[0] * ax) + (n[1] * ay);
+		float x = ax - (n[0] * d), y = ay - (n[1] * d), z = -(n[2] * d);
+		float length = std::sqrt((x * x) + (y * y) + (z * z));
+
+		if(length > 0.0f)
+		{
+			out[0] = x / length;
+			out[1] = y / length;
+			out[2] = z / length;
+		}
+		else
+		{
+			out[0] = 1.0f;
+			out[1] = 0.0f;
+			out[2] = 0.0f;
+		}
+	}
+
+	//sum the face tangents around vertex v
+	inline void SumFaces(const FaceFrame *faces, const unsigned int *adjacency, const unsigned int *offsets, unsigned int v, float *t, float *b)
+	{
+		t[0] = t[1] = t[2] = b[0] = b[1] = b[2] = 0.0f;
+
+		for(unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+		{
+			const FaceFrame &face = faces[adjacency[a]];
+
+			t[0] += face.t[0];
+			t[1] += face.t[1];
+			t[2] += face.t[2];
+			b[0] += face.b[0];
+			b[1] += face.b[1];
+			b[2] += face.b[2];
+		}
+	}
+
+	//Gram-Schmidt t against n, normalize, handedness of b in w; the SIMD path matches this operation for operation
+	inline void Orthonormalize(const float *n, const float *t, const float *b, float *tangent)
+	{
+		float d = (n[0] * t[0]) + (n[1] * t[1]) + (n[2] * t[2]);
+		float x = t[0] - (n[0] * d), y = t[1] - (n[1] * d), z = t[2] - (n[2] * d);
+		float length2 = (x * x) + (y * y) + (z * z);
+
+		if(length2 > DEGENERATE)
+		{
+			float inverse = 1.0f / std::sqrt(length2);
+
+			tangent[0] = x * inverse;
+			tangent[1] = y * inverse;
+			tangent[2] = z * inverse;
+		}
+		else
+		{
+			AnyPerpendicular(n, tangent);
+		}
+
+		float h = (((n[1] * tangent[2]) - (n[2] * tangent[1])) * b[0]) + (((n[2] * tangent[0]) - (n[0] * tangent[2])) * b[1]) + (((n[0] * tangent[1]) - (n[1] * tangent[0])) * b[2]);
+		tangent[3] = (h < 0.0f) ? -1.0f : 1.0f;
+	}
+
+	void VertexTangentsScalar(unsigned char *data, const TangentFrame::Layout &layout, const FaceFrame *faces, const unsigned int *adjacency, const unsigned int *offsets,
+		unsigned int begin, unsigned int end)
+	{
+		for(unsigned int v = begin; v < end; v++)
+		{
+			float t[3], b[3];
+			SumFaces(faces, adjacency, offsets, v, t, b);
+
+			Orthonormalize(Attribute(data, v, layout.stride, layout.normal), t, b, reinterpret_cast<float *>(data + ((std::size_t)v * layout.stride) + layout.tangent));
+		}
+	}
+
+#ifdef TANGENT_FRAME_SSE2
+	/// <summary>
+	/// FaceTangentsScalar 4 triangles at a time, the corners are gathered into lanes and the arithmetic runs 4-wide
+	/// </summary>
+	void FaceTangentsSIMD(const unsigned char *data, const TangentFrame::Layout &layout, const unsigned int *indices, unsigned int begin, unsigned int end, FaceFrame *faces)
+	{
+		const __m128 degenerate = _mm_set1_ps(DEGENERATE);
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		const __m128 one = _mm_set1_ps(1.0f);
+		unsigned int t = begin;
+
+		for(; t + 4 <= end; t += 4)
+		{
+			const unsigned int *tri = indices + (t * 3);
+			const float *p[12], *uv[12];
+
+			for(unsigned int c = 0; c < 12; c++)
+			{
+				p[c] = Attribute(data, tri[c], layout.stride, layout.position);
+				uv[c] = Attribute(data, tri[c], layout.stride, layout.texCoord);
+			}
+
+			//built in registers, lanes written through memory would stall every load on store forwarding
+			__m128 p0x = _mm_set_ps(p[9][0], p[6][0], p[3][0], p[0][0]), p0y = _mm_set_ps(p[9][1], p[6][1], p[3][1], p[0][1]), p0z = _mm_set_ps(p[9][2], p[6][2], p[3][2], p[0][2]);
+			__m128 e1x = _mm_sub_ps(_mm_set_ps(p[10][0], p[7][0], p[4][0], p[1][0]), p0x);
+			__m128 e1y = _mm_sub_ps(_mm_set_ps(p[10][1], p[7][1], p[4][1], p[1][1]), p0y);
+			__m128 e1z = _mm_sub_ps(_mm_set_ps(p[10][2], p[7][2], p[4][2], p[1][2]), p0z);
+			__m128 e2x = _mm_sub_ps(_mm_set_ps(p[11][0], p[8][0], p[5][0], p[2][0]), p0x);
+			__m128 e2y = _mm_sub_ps(_mm_set_ps(p[11][1], p[8][1], p[5][1], p[2][1]), p0y);
+			__m128 e2z = _mm_sub_ps(_mm_set_ps(p[11][2], p[8][2], p[5][2], p[2][2]), p0z);
+			__m128 u0 = _mm_set_ps(uv[9][0], uv[6][0], uv[3][0], uv[0][0]), v0 = _mm_set_ps(uv[9][1], uv[6][1], uv[3][1], uv[0][1]);
+			__m128 du1 = _mm_sub_ps(_mm_set_ps(uv[10][0], uv[7][0], uv[4][0], uv[1][0]), u0), dv1 = _mm_sub_ps(_mm_set_ps(uv[10][1], uv[7][1], uv[4][1], uv[1][1]), v0);
+			__m128 du2 = _mm_sub_ps(_mm_set_ps(uv[11][0], uv[8][0], uv[5][0], uv[2][0]), u0), dv2 = _mm_sub_ps(_mm_set_ps(uv[11][1], uv[8][1], uv[5][1], uv[2][1]), v0);
+			__m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+			__m128 r = _mm_and_ps(_mm_cmpgt_ps(_mm_and_ps(det, absMask), degenerate), _mm_div_ps(one, det));
+
+			__m128 tx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1x, dv2), _mm_mul_ps(e2x, dv1)), r);
+			__m128 ty = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1y, dv2), _mm_mul_ps(e2y, dv1)), r);
+			__m128 tz = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1z, dv2), _mm_mul_ps(e2z, dv1)), r);
+			__m128 tw = _mm_setzero_ps();
+			__m128 bx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2x, du1), _mm_mul_ps(e1x, du2)), r);
+			__m128 by = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2y, du1), _mm_mul_ps(e1y, du2)), r);
+			__m128 bz = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2z, du1), _mm_mul_ps(e1z, du2)), r);
+			__m128 bw = _mm_setzero_ps();
+
+			//lanes back to one record per triangle
+			_MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+			_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+			_mm_storeu_ps(faces[t].t, tx);
+			_mm_storeu_ps(faces[t].b, bx);
+			_mm_storeu_ps(faces[t + 1].t, ty);
+			_mm_storeu_ps(faces[t + 1].b, by);
+			_mm_storeu_ps(faces[t + 2].t, tz);
+			_mm_storeu_ps(faces[t + 2].b, bz);
+			_mm_storeu_ps(faces[t + 3].t, tw);
+			_mm_storeu_ps(faces[t + 3].b, bw);
+		}
+
+		FaceTangentsScalar(data, layout, indices, t, end, faces);
+	}
+
+	/// <summary>
+	/// VertexTangentsScalar 4 vertices at a time, each vertex's sums are two 4-wide adds per face, Gram-Schmidt and handedness run 4-wide
+	/// Lanes with a degenerate tangent are redone by the scalar fallback
+	/// </summary>
+	void VertexTangentsSIMD(unsigned char *data, const TangentFrame::Layout &layout, const FaceFrame *faces, const unsigned int *adjacency, const unsigned int *offsets,
+		unsigned int begin, unsigned int end)
+	{
+		const __m128 degenerate = _mm_set1_ps(DEGENERATE);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 signBit = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+		unsigned int v = begin;
+
+		for(; v + 4 <= end; v += 4)
+		{
+			__m128 sumT[4], sumB[4];
+			const float *n[4];
+
+			for(unsigned int lane = 0; lane < 4; lane++)
+			{
+				__m128 t = _mm_setzero_ps(), b = _mm_setzero_ps();
+
+				for(unsigned int a = offsets[v + lane]; a < offsets[v + lane + 1]; a++)
+				{
+					const FaceFrame &face = faces[adjacency[a]];
+
+					t = _mm_add_ps(t, _mm_loadu_ps(face.t));
+					b = _mm_add_ps(b, _mm_loadu_ps(face.b));
+				}
+
+				sumT[lane] = t;
+				sumB[lane] = b;
+				n[lane] = Attribute(data, v + lane, layout.stride, layout.normal);
+			}
+
+			//one vertex per lane from here
+			_MM_TRANSPOSE4_PS(sumT[0], sumT[1], sumT[2], sumT[3]);
+			_MM_TRANSPOSE4_PS(sumB[0], sumB[1], sumB[2], sumB[3]);
+
+			__m128 nx = _mm_set_ps(n[3][0], n[2][0], n[1][0], n[0][0]);
+			__m128 ny = _mm_set_ps(n[3][1], n[2][1], n[1][1], n[0][1]);
+			__m128 nz = _mm_set_ps(n[3][2], n[2][2], n[1][2], n[0][2]);
+			__m128 tx = sumT[0], ty = sumT[1], tz = sumT[2];
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, tx), _mm_mul_ps(ny, ty)), _mm_mul_ps(nz, tz));
+
+			tx = _mm_sub_ps(tx, _mm_mul_ps(nx, d));
+			ty = _mm_sub_ps(ty, _mm_mul_ps(ny, d));
+			tz = _mm_sub_ps(tz, _mm_mul_ps(nz, d));
+
+			__m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+			__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(length2));
+
+			tx = _mm_mul_ps(tx, inverse);
+			ty = _mm_mul_ps(ty, inverse);
+			tz = _mm_mul_ps(tz, inverse);
+
+			__m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+			__m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+			__m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+			__m128 h = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, sumB[0]), _mm_mul_ps(cy, sumB[1])), _mm_mul_ps(cz, sumB[2]));
+			__m128 w = _mm_or_ps(one, _mm_and_ps(_mm_cmplt_ps(h, _mm_setzero_ps()), signBit));
+			int valid = _mm_movemask_ps(_mm_cmpgt_ps(length2, degenerate));
+			//back to one tangent per register, each is the vertex's whole float4
+			_MM_TRANSPOSE4_PS(tx, ty, tz, w);
+
+			__m128 out[4] = { tx, ty, tz, w };
+
+			for(unsigned int lane = 0; lane < 4; lane++)
+			{
+				float *tangent = reinterpret_cast<float *>(data + ((std::size_t)(v + lane) * layout.stride) + layout.tangent);
+
+				if(valid & (1 << lane))
+				{
+					_mm_storeu_ps(tangent, out[lane]);
+				}
+				else
+				{
+					float t[3], b[3];
+
+					SumFaces(faces, adjacency, offsets, v + lane, t, b);
+					Orthonormalize(Attribute(data, v + lane, layout.stride, layout.normal), t, b, tangent);
+				}
+			}
+		}
+
+		VertexTangentsScalar(data, layout, faces, adjacency, offsets, v, end);
+	}
+#endif
+
+	/// <summary>
+	/// Vertices where faces of opposite handedness meet (UV mirror seams) cannot share one tangent
+	/// The corners that disagree with the first face seen move to a copy of the vertex, appended after the others
+	/// </summary>
+	/// <returns>Vertex count after splitting, never more than capacity</returns>
+	unsigned int SplitMirrored(unsigned char *data, unsigned int vertexCount, unsigned int capacity, const TangentFrame::Layout &layout, unsigned int *indices,
+		unsigned int indexCount, const FaceFrame *faces)
+	{
+		std::vector<signed char> handedness(vertexCount, 0);
+		std::vector<unsigned int> mirror(vertexCount, NONE);
+		unsigned int count = vertexCount;
+
+		for(unsigned int c = 0; c < indexCount; c++)
+		{
+			unsigned int v = indices[c];
+			unsigned int f = c / 3;
+			const float *n = Attribute(data, v, layout.stride, layout.normal);
+			const float *t = faces[f].t, *b = faces[f].b;
+			float h = (((n[1] * t[2]) - (n[2] * t[1])) * b[0]) + (((n[2] * t[0]) - (n[0] * t[2])) * b[1]) + (((n[0] * t[1]) - (n[1] * t[0])) * b[2]);
+
+			if(h == 0.0f)
+			{
+				continue;
+			}
+
+			signed char side = (h < 0.0f) ? -1 : 1;
+
+			if(handedness[v] == 0)
+			{
+				handedness[v] = side;
+			}
+			else if(handedness[v] != side)
+			{
+				if(mirror[v] == NONE)
+				{
+					if(count == capacity)
+					{
+						continue;
+					}
+
+					std::memcpy(data + ((std::size_t)count * layout.stride), data + ((std::size_t)v * layout.stride), layout.stride);
+					mirror[v] = count++;
+				}
+
+				indices[c] = mirror[v];
+			}
+		}
+
+		return count;
+	}
+
+	unsigned int Run(void *vertices, unsigned int vertexCount, unsigned int vertexCapacity, const TangentFrame::Layout &layout,
+		unsigned int *indices, unsigned int indexCount, WorkerPool *workers, bool simd)
+	{
+		unsigned char *data = static_cast<unsigned char *>(vertices);
+		unsigned int triangleCount = indexCount / 3;
+		bool parallel = triangleCount >= TangentFrame::PARALLEL_MIN_TRIANGLES;
+		std::vector<FaceFrame> faceFrames(triangleCount);
+		FaceFrame *faces = faceFrames.empty() ? nullptr : &faceFrames[0];
+
+		ForBlocks(workers, triangleCount, parallel, [&](unsigned int begin, unsigned int end)
+		{
+#ifdef TANGENT_FRAME_SSE2
+			if(simd)
+			{
+				FaceTangentsSIMD(data, layout, indices, begin, end, faces);
+				return;
+			}
+#endif
+			FaceTangentsScalar(data, layout, indices, begin, end, faces);
+		});
+
+		vertexCount = SplitMirrored(data, vertexCount, vertexCapacity, layout, indices, triangleCount * 3, faces);
+
+		//triangles around each vertex, in index order so the sums do not depend on the thread count
+		std::vector<unsigned int> offsets(vertexCount + 1, 0);
+		std::vector<unsigned int> adjacency(triangleCount * 3);
+
+		for(unsigned int c = 0; c < triangleCount * 3; c++)
+		{
+			offsets[indices[c] + 1]++;
+		}
+
+		for(unsigned int v = 0; v < vertexCount; v++)
+		{
+			offsets[v + 1] += offsets[v];
+		}
+
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+
+		for(unsigned int c = 0; c < triangleCount * 3; c++)
+		{
+			adjacency[fill[indices[c]]++] = c / 3;
+		}
+
+		const unsigned int *adjacencyData = adjacency.empty() ? nullptr : &adjacency[0];
+
+		ForBlocks(workers, vertexCount, parallel, [&](unsigned int begin, unsigned int end)
+		{
+#ifdef TANGENT_FRAME_SSE2
+			if(simd)
+			{
+				VertexTangentsSIMD(data, layout, faces, adjacencyData, &offsets[0], begin, end);
+				return;
+			}
+#endif
+			VertexTangentsScalar(data, layout, faces, adjacencyData, &offsets[0], begin, end);
+		});
+
+		return vertexCount;
+	}
+}
+
+namespace TangentFrame
+{
+	/// <summary>
+	/// Write a tangent frame into every vertex of an indexed triangle list
+	/// Vertices on UV mirror seams are split so each side keeps its own handedness, the copies are appended
+	/// </summary>
+	/// <param name="vertices">Vertices, tangents written in place</param>
+	/// <param name="vertexCount">Vertices in use</param>
+	/// <param name="vertexCapacity">Vertices the buffer holds, room for split vertices</param>
+	/// <param name="layout">Attribute offsets</param>
+	/// <param name="indices">Triangle list, split corners are remapped in place</param>
+	/// <param name="indexCount">Index count</param>
+	/// <param name="workers">Pool for large meshes, nullptr to stay on this thread</param>
+	/// <returns>Vertex count after splitting</returns>
+	unsigned int Generate(void *vertices, unsigned int vertexCount, unsigned int vertexCapacity, const Layout &layout,
+		unsigned int *indices, unsigned int indexCount, WorkerPool *workers)
+	{
+		return Run(vertices, vertexCount, vertexCapacity, layout, indices, indexCount, workers, SIMDEnabled());
+	}
+
+	//reference path, bit-identical to Generate
+	unsigned int GenerateScalar(void *vertices, unsigned int vertexCount, unsigned int vertexCapacity, const Layout &layout,
+		unsigned int *indices, unsigned int indexCount, WorkerPool *workers)
+	{
+		return Run(vertices, vertexCount, vertexCapacity, layout, indices, indexCount, workers, false);
+	}
+
+	bool SIMDEnabled()
+	{
+#ifdef TANGENT_FRAME_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+class WorkerPool;
+
+//Per-vertex tangent frames for indexed meshes, no D3D dependency
+//Face tangents are summed over every triangle a vertex is in, orthogonalized against its normal (Gram-Schmidt)
+//and stored with the bitangent's handedness in w, the shader rebuilds the bitangent as cross(normal, tangent.xyz) * w
+namespace TangentFrame
+{
+	const unsigned int PARALLEL_MIN_TRIANGLES = 16384;	//below this one thread is faster than waking the pool
+
+	//byte offsets of the attributes in a vertex: float3 position, float2 texCoord, float3 normal, float4 tangent
+	struct Layout
+	{
+		unsigned int stride;
+		unsigned int position, texCoord, normal, tangent;
+	};
+
+	unsigned int Generate(void *vertices, unsigned int vertexCount, unsigned int vertexCapacity, const Layout &layout,
+		unsigned int *indices, unsigned int indexCount, WorkerPool *workers);
+	unsigned int GenerateScalar(void *vertices, unsigned int vertexCount, unsigned int vertexCapacity, const Layout &layout,
+		unsigned int *indices, unsigned int indexCount, WorkerPool *workers);
+
+	bool SIMDEnabled();
+}
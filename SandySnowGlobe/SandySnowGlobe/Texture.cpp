@@ -1,8 +1,29 @@
 #include "Texture.h"
+#include <fstream>
+#include <cstring>
+
+namespace
+{
+	const unsigned int DDS_MAGIC = 0x20534444;		//"DDS "
+	const unsigned int DDS_FOURCC_DX10 = 0x30315844;	//"DX10"
+	const std::size_t DDS_HEADER_BYTES = 4 + 124;		//magic + DDS_HEADER
+	const std::size_t DDS_DX10_BYTES = 20;			//DDS_HEADER_DXT10 after it when the fourCC is DX10
+
+	inline unsigned int ReadUInt(const unsigned char *data, std::size_t offset)
+	{
+		unsigned int value;
+		std::memcpy(&value, data + offset, sizeof(value));
+
+		return value;
+	}
+}
 
 Texture::Texture()
 {
 	texture = nullptr;
+	width = 0;
+	height = 0;
+	mipLevels = 0;
 }
 
 
@@ -12,12 +33,90 @@ Texture::~Texture()
 
 bool Texture::Init(ID3D11Device *dev, const std::wstring &filename)
 {
-	HRESULT result = DirectX::CreateDDSTextureFromFile(dev, filename.c_str(), nullptr, texture.GetAddressOf());
+	if(!Read(filename))
+	{
+		return false;
+	}
+
+	return Create(dev);
+}
+
+/// <summary>
+/// Read a DDS file into memory and check its header, touches no D3D object so it can run on a worker
+/// </summary>
+/// <param name="filename">DDS filepath</param>
+/// <returns>false if the file is missing or not a DDS</returns>
+bool Texture::Read(const std::wstring &filename)
+{
+	std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+
+	if(!file.is_open())
+	{
+		Logger::Log("Failed: texture file could not be opened");
+		return false;
+	}
+
+	std::streamoff size = file.tellg();
+
+	if(size < (std::streamoff)DDS_HEADER_BYTES)
+	{
+		Logger::Log("Failed: texture file too small for a DDS header");
+		return false;
+	}
+
+	data.resize((std::size_t)size);
+	file.seekg(0, std::ios::beg);
+
+	if(!file.read(reinterpret_cast<char *>(&data[0]), size))
+	{
+		data.clear();
+		Logger::Log("Failed: texture file could not be read");
+		return false;
+	}
+
+	//magic, DDS_HEADER.dwSize, DDS_PIXELFORMAT.dwSize and, for DX10 files, room for the extended header
+	bool valid = ReadUInt(&data[0], 0) == DDS_MAGIC && ReadUInt(&data[0], 4) == 124 && ReadUInt(&data[0], 76) == 32 &&
+		(ReadUInt(&data[0], 84) != DDS_FOURCC_DX10 || data.size() >= DDS_HEADER_BYTES + DDS_DX10_BYTES);
+
+	if(!valid)
+	{
+		data.clear();
+		Logger::Log("Failed: texture file is not a DDS");
+		return false;
+	}
+
+	height = ReadUInt(&data[0], 12);
+	width = ReadUInt(&data[0], 16);
+	mipLevels = ReadUInt(&data[0], 28);
+
+	if(mipLevels == 0)
+	{
+		mipLevels = 1;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Create the texture and its view from what Read loaded, then free the file bytes
+/// </summary>
+/// <param name="dev">Standard ID3D11Device</param>
+/// <returns></returns>
+bool Texture::Create(ID3D11Device *dev)
+{
+	if(data.empty())
+	{
+		return false;
+	}
 
-	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create DDS texture from file"))
+	HRESULT result = DirectX::CreateDDSTextureFromMemory(dev, &data[0], data.size(), nullptr, texture.GetAddressOf());
+
+	std::vector<unsigned char>().swap(data);
+
+	if(!Validation::ErrCheck(result, __FILE__, __LINE__, "Create DDS texture from memory"))
 	{
 		return false;
 	}
 
 	return true;
-}
\ No newline at end of file
+}
@@ -3,8 +3,12 @@
 #include <d3d11.h>
 #include <DDSTextureLoader.h>
 #include <wrl.h>
+#include <string>
+#include <vector>
 #include "DXUtil.h"
 
+//DDS texture, loaded in one go by Init or in two halves:
+//Read (file and header, any thread) then Create (the view, on the device's thread)
 class Texture
 {
 public:
@@ -12,10 +16,16 @@ public:
 	~Texture();
 
 	bool Init(ID3D11Device *dev, const std::wstring &filename);
+	bool Read(const std::wstring &filename);
+	bool Create(ID3D11Device *dev);
 
 	ID3D11ShaderResourceView *GetTexture() const { return texture.Get(); }
+	unsigned int Width() const { return width; }	//from the DDS header, known once Read
+	unsigned int Height() const { return height; }
+	unsigned int MipLevels() const { return mipLevels; }
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture;
+	std::vector<unsigned char> data;	//whole file from Read until Create
+	unsigned int width, height, mipLevels;
 };
-
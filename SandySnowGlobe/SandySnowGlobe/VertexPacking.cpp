@@ -0,0 +1,350 @@
+#include "VertexPacking.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float QUANT_MAX = 65535.0f;
+	const float FRAME_MAX = 1023.0f;	//10 bit channels
+	const float TWO_PI = 6.28318531f;
+
+	inline unsigned short Quantize(float value, float min, float scale)
+	{
+		float q = ((value - min) * scale) + 0.5f;
+
+		q = (q > 0.0f) ? q : 0.0f;
+		q = (q < QUANT_MAX) ? q : QUANT_MAX;
+
+		return (unsigned short)(int)q;
+	}
+
+	inline float QuantScale(float extent)
+	{
+		return (extent > 0.0f) ? QUANT_MAX / extent : 0.0f;
+	}
+
+	inline float Sign(float value)
+	{
+		return (value >= 0.0f) ? 1.0f : -1.0f;
+	}
+
+	inline float Dot(const float *a, const float *b)
+	{
+		return (a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]);
+	}
+
+	inline void Normalize(float *v)
+	{
+		float length = std::sqrt(Dot(v, v));
+
+		if(length > 0.0f)
+		{
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+
+	/// <summary>
+	/// Unit vector from a pair of 10 bit octahedral codes, the same steps as DecodeNormal in Normal.vs
+	/// </summary>
+	void OctDecode(unsigned int x, unsigned int y, float *n)
+	{
+		float u = (((float)x / FRAME_MAX) * 2.0f) - 1.0f;
+		float v = (((float)y / FRAME_MAX) * 2.0f) - 1.0f;
+		float z = 1.0f - std::fabs(u) - std::fabs(v);
+		float fold = (-z > 0.0f) ? -z : 0.0f;
+
+		n[0] = u + ((u >= 0.0f) ? -fold : fold);
+		n[1] = v + ((v >= 0.0f) ? -fold : fold);
+		n[2] = z;
+		Normalize(n);
+	}
+
+	/// <summary>
+	/// Octahedral codes of a unit vector, of the four codes around it the one that decodes closest
+	/// Plain rounding can be off by most of a step at the folds, the search keeps the error near half a step everywhere
+	/// </summary>
+	void OctEncode(const float *n, unsigned int &x, unsigned int &y)
+	{
+		float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+		float u = (l1 > 0.0f) ? n[0] / l1 : 0.0f;
+		float v = (l1 > 0.0f) ? n[1] / l1 : 0.0f;
+
+		if(n[2] < 0.0f)
+		{
+			float foldU = (1.0f - std::fabs(v)) * Sign(u);
+			float foldV = (1.0f - std::fabs(u)) * Sign(v);
+			u = foldU;
+			v = foldV;
+		}
+
+		float codeU = ((u * 0.5f) + 0.5f) * FRAME_MAX;
+		float codeV = ((v * 0.5f) + 0.5f) * FRAME_MAX;
+		unsigned int baseU = (codeU > 0.0f) ? (unsigned int)codeU : 0;
+		unsigned int baseV = (codeV > 0.0f) ? (unsigned int)codeV : 0;
+		float best = -2.0f;
+
+		baseU = (baseU < 1022) ? baseU : 1022;
+		baseV = (baseV < 1022) ? baseV : 1022;
+
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			unsigned int candidateU = baseU + (i & 1);
+			unsigned int candidateV = baseV + (i >> 1);
+			float decoded[3];
+
+			OctDecode(candidateU, candidateV, decoded);
+
+			float similarity = Dot(decoded, n);
+
+			if(similarity > best)
+			{
+				best = similarity;
+				x = candidateU;
+				y = candidateV;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Orthonormal basis around a unit normal with no branch on its direction but the sign of z (Duff et al. 2017)
+	/// Normal.vs builds the same basis, the tangent angle is measured from b1 towards b2
+	/// </summary>
+	void ReferenceBasis(const float *n, float *b1, float *b2)
+	{
+		float s = Sign(n[2]);
+		float a = -1.0f / (s + n[2]);
+		float b = n[0] * n[1] * a;
+
+		b1[0] = 1.0f + (s * n[0] * n[0] * a);
+		b1[1] = s * b;
+		b1[2] = -s * n[0];
+
+		b2[0] = b;
+		b2[1] = s + (n[1] * n[1] * a);
+		b2[2] = -n[1];
+	}
+}
+
+namespace VertexPacking
+{
+	/// <summary>
+	/// Quantization bounds of a mesh from its bounding box
+	/// </summary>
+	Bounds MakeBounds(const float *boundsMin, const float *boundsMax)
+	{
+		Bounds bounds;
+
+		for(unsigned int axis = 0; axis < 3; axis++)
+		{
+			bounds.min[axis] = boundsMin[axis];
+			bounds.extent[axis] = boundsMax[axis] - boundsMin[axis];
+		}
+
+		return bounds;
+	}
+
+	/// <summary>
+	/// Largest position error Encode/Decode can introduce for points inside bounds
+	/// Half a quantization step plus float rounding at the largest coordinate, worst axis
+	/// </summary>
+	float MaxPositionError(const Bounds &bounds)
+	{
+		float worst = 0.0f;
+
+		for(unsigned int axis = 0; axis < 3; axis++)
+		{
+			float lo = bounds.min[axis];
+			float hi = lo + bounds.extent[axis];
+			float magnitude = (-lo > hi) ? -lo : hi;
+			float error = (bounds.extent[axis] / (2.0f * QUANT_MAX)) + (magnitude * 4.0f * FLT_EPSILON);
+
+			worst = (error > worst) ? error : worst;
+		}
+
+		return worst;
+	}
+
+	/// <summary>
+	/// Largest texture coordinate error for coordinates up to magnitude, half rounding (11 significant bits) plus the smallest subnormal
+	/// </summary>
+	float MaxTexCoordError(float magnitude)
+	{
+		return (magnitude / 2048.0f) + (1.0f / 33554432.0f);
+	}
+
+	/// <summary>
+	/// Pack one vertex, positions outside bounds clamp to the nearest edge
+	/// </summary>
+	/// <param name="bounds">Mesh bounds, normally MakeBounds of Model's BoundsMin/BoundsMax</param>
+	/// <param name="position">float3</param>
+	/// <param name="texCoord">float2</param>
+	/// <param name="normal">float3, normalized here</param>
+	/// <param name="tangent">float4, xyz need not be orthogonal to the normal, w is the handedness</param>
+	/// <param name="out">Packed vertex</param>
+	void Encode(const Bounds &bounds, const float *position, const float *texCoord, const float *normal, const float *tangent, PackedBumpVertex &out)
+	{
+		out.position[0] = Quantize(position[0], bounds.min[0], QuantScale(bounds.extent[0]));
+		out.position[1] = Quantize(position[1], bounds.min[1], QuantScale(bounds.extent[1]));
+		out.position[2] = Quantize(position[2], bounds.min[2], QuantScale(bounds.extent[2]));
+		out.position[3] = 0;
+
+		out.texCoord[0] = FloatToHalf(texCoord[0]);
+		out.texCoord[1] = FloatToHalf(texCoord[1]);
+
+		float n[3] = { normal[0], normal[1], normal[2] };
+		float decoded[3], b1[3], b2[3];
+		unsigned int x = 0, y = 0;
+
+		Normalize(n);
+		OctEncode(n, x, y);
+
+		//the angle is taken against what the shader will decode, so normal error does not turn into tangent error twice
+		OctDecode(x, y, decoded);
+		ReferenceBasis(decoded, b1, b2);
+
+		float angle = std::atan2(Dot(tangent, b2), Dot(tangent, b1));
+		float code = (((angle / TWO_PI) + 0.5f) * FRAME_MAX) + 0.5f;
+		unsigned int z = (code > 0.0f) ? (unsigned int)code : 0;
+		unsigned int w = (tangent[3] >= 0.0f) ? 3 : 0;
+
+		z = (z < 1023) ? z : 1023;
+
+		out.frame = x | (y << 10) | (z << 20) | (w << 30);
+	}
+
+	/// <summary>
+	/// Inverse of Encode, matches what Normal.vs reconstructs
+	/// </summary>
+	void Decode(const Bounds &bounds, const PackedBumpVertex &in, float *position, float *texCoord, float *normal, float *tangent)
+	{
+		for(unsigned int axis = 0; axis < 3; axis++)
+		{
+			position[axis] = bounds.min[axis] + ((float)in.position[axis] / QUANT_MAX) * bounds.extent[axis];
+		}
+
+		texCoord[0] = HalfToFloat(in.texCoord[0]);
+		texCoord[1] = HalfToFloat(in.texCoord[1]);
+
+		float b1[3], b2[3];
+
+		OctDecode(in.frame & 0x3ff, (in.frame >> 10) & 0x3ff, normal);
+		ReferenceBasis(normal, b1, b2);
+
+		float angle = (((float)((in.frame >> 20) & 0x3ff) / FRAME_MAX) - 0.5f) * TWO_PI;
+		float c = std::cos(angle);
+		float s = std::sin(angle);
+
+		for(unsigned int axis = 0; axis < 3; axis++)
+		{
+			tangent[axis] = (c * b1[axis]) + (s * b2[axis]);
+		}
+
+		tangent[3] = ((in.frame >> 30) != 0) ? 1.0f : -1.0f;
+	}
+
+	/// <summary>
+	/// Pack a welded vertex stream, e.g. Model's BumpVertex once TangentFrame has filled the tangents
+	/// </summary>
+	/// <param name="vertices">Float vertices</param>
+	/// <param name="vertexCount">Vertices to pack</param>
+	/// <param name="layout">Stride and attribute offsets of vertices</param>
+	/// <param name="bounds">Bounds every position lies in</param>
+	/// <param name="out">vertexCount packed vertices</param>
+	void EncodeMesh(const void *vertices, unsigned int vertexCount, const TangentFrame::Layout &layout, const Bounds &bounds, PackedBumpVertex *out)
+	{
+		const unsigned char *data = static_cast<const unsigned char *>(vertices);
+
+		for(unsigned int i = 0; i < vertexCount; i++)
+		{
+			const unsigned char *vertex = data + (i * layout.stride);
+
+			Encode(bounds, reinterpret_cast<const float *>(vertex + layout.position), reinterpret_cast<const float *>(vertex + layout.texCoord),
+				reinterpret_cast<const float *>(vertex + layout.normal), reinterpret_cast<const float *>(vertex + layout.tangent), out[i]);
+		}
+	}
+
+	/// <summary>
+	/// Round to the nearest half, ties to even, beyond the largest half clamps to it rather than to infinity
+	/// </summary>
+	unsigned short FloatToHalf(float value)
+	{
+		unsigned int bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		unsigned int sign = (bits >> 16) & 0x8000;
+		unsigned int mantissa = bits & 0x7fffff;
+		int exponent = (int)((bits >> 23) & 0xff);
+
+		if(exponent == 0xff)
+		{
+			return (unsigned short)(sign | 0x7c00 | ((mantissa != 0) ? 0x200 : 0));
+		}
+
+		exponent = exponent - 127 + 15;
+
+		if(exponent <= 0)
+		{
+			if(exponent < -10)
+			{
+				return (unsigned short)sign;
+			}
+
+			//subnormal half, shift the full mantissa down to units of 2^-24
+			mantissa |= 0x800000;
+			unsigned int shift = (unsigned int)(14 - exponent);
+			unsigned int half = mantissa >> shift;
+			unsigned int rest = mantissa & ((1u << shift) - 1);
+			unsigned int middle = 1u << (shift - 1);
+
+			if(rest > middle || (rest == middle && (half & 1)))
+			{
+				half++;
+			}
+
+			return (unsigned short)(sign | half);
+		}
+
+		unsigned int half = ((unsigned int)exponent << 10) | (mantissa >> 13);
+		unsigned int rest = mantissa & 0x1fff;
+
+		if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		{
+			half++;	//a carry into the exponent is still the right rounding
+		}
+
+		half = (half < 0x7c00) ? half : 0x7bff;
+
+		return (unsigned short)(sign | half);
+	}
+
+	float HalfToFloat(unsigned short value)
+	{
+		unsigned int sign = (unsigned int)(value & 0x8000) << 16;
+		unsigned int exponent = (value >> 10) & 0x1f;
+		unsigned int mantissa = value & 0x3ff;
+		unsigned int bits;
+
+		if(exponent == 0)
+		{
+			float magnitude = std::ldexp((float)mantissa, -24);
+			return (sign != 0) ? -magnitude : magnitude;
+		}
+
+		if(exponent == 0x1f)
+		{
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		}
+		else
+		{
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+
+		return result;
+	}
+}
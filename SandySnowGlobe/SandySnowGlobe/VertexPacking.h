@@ -0,0 +1,39 @@
+#pragma once
+
+#include "TangentFrame.h"
+
+//Compressed Model::BumpVertex, 16 bytes against 48, no D3D dependency
+//position: R16G16B16A16_UNORM, xyz fractions of the mesh bounds sent alongside in a constant buffer, w unused
+//texCoord: R16G16_FLOAT, halves so tiled coordinates outside 0-1 survive
+//frame: R10G10B10A2_UNORM, xy octahedral normal, z tangent angle around the normal, w bitangent handedness (0 is -1, 3 is +1)
+//The tangent angle is measured in a basis built from the decoded normal alone, Normal.vs builds the same one to rebuild it
+namespace VertexPacking
+{
+	struct PackedBumpVertex
+	{
+		unsigned short position[4];
+		unsigned short texCoord[2];
+		unsigned int frame;
+	};
+
+	struct Bounds
+	{
+		float min[3];
+		float extent[3];
+	};
+
+	//worst angle between a unit vector and its decoded frame, radians, checked by objbench --packed over the whole sphere
+	const float MAX_NORMAL_ERROR = 0.005f;	//about 0.29 degrees, 20 bit octahedral
+	const float MAX_TANGENT_ERROR = 0.008f;	//the normal's error plus half an angle step, the tangent is projected onto the decoded normal
+
+	Bounds MakeBounds(const float *boundsMin, const float *boundsMax);
+	float MaxPositionError(const Bounds &bounds);
+	float MaxTexCoordError(float magnitude);
+
+	void Encode(const Bounds &bounds, const float *position, const float *texCoord, const float *normal, const float *tangent, PackedBumpVertex &out);
+	void Decode(const Bounds &bounds, const PackedBumpVertex &in, float *position, float *texCoord, float *normal, float *tangent);
+	void EncodeMesh(const void *vertices, unsigned int vertexCount, const TangentFrame::Layout &layout, const Bounds &bounds, PackedBumpVertex *out);
+
+	unsigned short FloatToHalf(float value);
+	float HalfToFloat(unsigned short value);
+}
@@ -0,0 +1,179 @@
+#include "WorkerPool.h"
+#include <atomic>
+#include <memory>
+
+namespace
+{
+	//shared between the caller and helper jobs of one ParallelFor
+	struct ForState
+	{
+		std::atomic<unsigned int> next;
+		std::atomic<unsigned int> done;
+		unsigned int count;
+		const std::function<void(unsigned int)> *task;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	void RunTasks(ForState &state)
+	{
+		unsigned int i = state.next++;
+
+		while(i < state.count)
+		{
+			(*state.task)(i);
+
+			if(++state.done == state.count)
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.finished.notify_all();
+			}
+
+			i = state.next++;
+		}
+	}
+}
+
+/// <summary>
+/// Start the worker threads
+/// </summary>
+/// <param name="threadCount">Total threads including the caller, 0 picks one per hardware thread</param>
+WorkerPool::WorkerPool(unsigned int threadCount)
+{
+	stopping = false;
+
+	if(threadCount == 0)
+	{
+		threadCount = DefaultThreadCount();
+	}
+
+	for(unsigned int i = 1; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = true;
+	}
+
+	jobReady.notify_all();
+
+	for(unsigned int i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+unsigned int WorkerPool::DefaultThreadCount()
+{
+	unsigned int hw = std::thread::hardware_concurrency();
+
+	return (hw == 0) ? 1 : hw;
+}
+
+/// <summary>
+/// Run task(0) .. task(taskCount - 1) across the pool, the calling thread takes part
+/// Returns once every task has finished
+/// </summary>
+/// <param name="taskCount">Number of tasks</param>
+/// <param name="task">Task body, called with the task index</param>
+void WorkerPool::ParallelFor(unsigned int taskCount, const std::function<void(unsigned int)> &task)
+{
+	if(taskCount == 0)
+	{
+		return;
+	}
+
+	if(workers.empty() || taskCount == 1)
+	{
+		for(unsigned int i = 0; i < taskCount; i++)
+		{
+			task(i);
+		}
+
+		return;
+	}
+
+	std::shared_ptr<ForState> state = std::make_shared<ForState>();
+	state->next = 0;
+	state->done = 0;
+	state->count = taskCount;
+	state->task = &task;
+
+	unsigned int helpers = (unsigned int)workers.size();
+
+	if(helpers > taskCount - 1)
+	{
+		helpers = taskCount - 1;
+	}
+
+	//helpers that start after every task is claimed exit without touching task
+	for(unsigned int i = 0; i < helpers; i++)
+	{
+		Enqueue([state]() { RunTasks(*state); });
+	}
+
+	RunTasks(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	while(state->done < taskCount)
+	{
+		state->finished.wait(lock);
+	}
+}
+
+/// <summary>
+/// Queue one job for a worker and return without waiting for it, it runs on the caller when there are no workers
+/// </summary>
+/// <param name="job">Job body</param>
+void WorkerPool::Run(const std::function<void()> &job)
+{
+	if(workers.empty())
+	{
+		job();
+		return;
+	}
+
+	Enqueue(job);
+}
+
+void WorkerPool::Enqueue(const std::function<void()> &job)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push_back(job);
+	}
+
+	jobReady.notify_one();
+}
+
+void WorkerPool::WorkerLoop()
+{
+	for(;;)
+	{
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+
+			while(!stopping && jobs.empty())
+			{
+				jobReady.wait(lock);
+			}
+
+			if(stopping && jobs.empty())
+			{
+				return;
+			}
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		job();
+	}
+}
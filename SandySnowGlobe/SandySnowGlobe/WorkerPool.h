@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//Fixed set of worker threads fed from one job queue
+class WorkerPool
+{
+public:
+	explicit WorkerPool(unsigned int threadCount);
+	~WorkerPool();
+
+	void ParallelFor(unsigned int taskCount, const std::function<void(unsigned int)> &task);
+	void Run(const std::function<void()> &job);
+
+	unsigned int ThreadCount() const { return (unsigned int)workers.size() + 1; }	//workers + calling thread
+
+	static unsigned int DefaultThreadCount();
+
+private:
+	WorkerPool& operator= (const WorkerPool&);
+	WorkerPool(const WorkerPool&);
+
+	void Enqueue(const std::function<void()> &job);
+	void WorkerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex jobMutex;
+	std::condition_variable jobReady;
+	bool stopping;
+};